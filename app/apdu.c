@@ -0,0 +1,123 @@
+#include "common.h"
+#include "apdu.h"
+#include "tty.h"
+
+#include "avp_cmd.h"
+
+#include <string.h>
+
+static const u8 _aid[] = {0xF0, 'A', 'V', 'P', 0x01};
+
+static char _json[TTY_BUF_SIZE]; // same request limit as the serial ports
+
+// response text collected from avp_cmd_process()
+static u8 *_out;
+static u16 _out_len;
+static u16 _out_max;
+static bool _out_overflow;
+
+static void _put_text(const char *text)
+{
+    size_t n = strlen(text);
+
+    if (_out_overflow || (n > (size_t)(_out_max - _out_len)))
+    {
+        _out_overflow = true;
+        return;
+    }
+    memcpy(&_out[_out_len], text, n);
+    _out_len += n;
+}
+
+static u16 _sw(u8 *resp, u16 len, u16 sw)
+{
+    resp[len] = (u8)(sw >> 8);
+    resp[len + 1] = (u8)sw;
+    return (len + 2);
+}
+
+// Command data of cases 1-4, short or extended, Le is skipped
+static bool _parse(const u8 *apdu, u16 len, const u8 **data, u16 *lc)
+{
+    u16 n;
+
+    *data = NULL;
+    *lc = 0;
+
+    if (len <= 5)
+        return (len >= 4); // no data, short Le
+
+    if (apdu[4] != 0)
+    {   // short Lc
+        n = apdu[4];
+        *data = &apdu[5];
+        *lc = n;
+        return ((len == 5 + n) || (len == 6 + n));
+    }
+
+    if (len == 7)
+        return (true); // no data, extended Le
+
+    n = (u16)((apdu[5] << 8) | apdu[6]);
+    *data = &apdu[7];
+    *lc = n;
+    return ((n > 0) && ((len == 7 + n) || (len == 9 + n)));
+}
+
+static u16 _select(const u8 *data, u16 lc, u8 p1, u8 *resp)
+{
+    if ((p1 != 0x04) || (lc != sizeof(_aid)) || (memcmp(data, _aid, sizeof(_aid)) != 0))
+        return (_sw(resp, 0, APDU_SW_NOT_FOUND));
+
+    return (_sw(resp, 0, APDU_SW_OK));
+}
+
+static u16 _avp_json(const u8 *data, u16 lc, u8 *resp, u16 resp_max)
+{
+    if ((lc == 0) || (lc >= sizeof(_json)))
+        return (_sw(resp, 0, APDU_SW_WRONG_LENGTH));
+
+    memcpy(_json, data, lc);
+    _json[lc] = '\0';
+
+    _out = resp;
+    _out_len = 0;
+    _out_max = resp_max - 2; // room for SW
+    _out_overflow = false;
+
+    avp_cmd_process(_json, _put_text);
+
+    if (_out_overflow)
+        return (_sw(resp, 0, APDU_SW_NO_SPACE));
+
+    return (_sw(resp, _out_len, APDU_SW_OK));
+}
+
+u16 apdu_process(const u8 *apdu, u16 len, u8 *resp, u16 resp_max)
+{
+    const u8 *data;
+    u16 lc;
+
+    if (resp_max < 2)
+        return (0);
+
+    if (! _parse(apdu, len, &data, &lc))
+        return (_sw(resp, 0, APDU_SW_WRONG_LENGTH));
+
+    switch (apdu[0])
+    {
+    case APDU_CLA_ISO:
+        if (apdu[1] == APDU_INS_SELECT)
+            return (_select(data, lc, apdu[2], resp));
+        return (_sw(resp, 0, APDU_SW_INS_UNKNOWN));
+
+    case APDU_CLA_AVP:
+        if (apdu[1] == APDU_INS_AVP_JSON)
+            return (_avp_json(data, lc, resp, resp_max));
+        return (_sw(resp, 0, APDU_SW_INS_UNKNOWN));
+
+    default:
+        break;
+    }
+    return (_sw(resp, 0, APDU_SW_CLA_UNKNOWN));
+}
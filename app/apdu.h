@@ -0,0 +1,32 @@
+#ifndef APDU_H
+#define APDU_H
+
+#include "type.h"
+
+// AVP over ISO 7816-4 APDUs, served on the CCID smart card interface
+//
+// SELECT:   00 A4 04 00 05 F0 41 56 50 01         -> 90 00
+// AVP JSON: 80 10 00 00 <Lc> <JSON request> <Le>  -> <JSON response lines> 90 00
+//
+// Short and extended Lc/Le are accepted. Le is not enforced, the reader
+// returns the whole response (extended APDU level exchange). Requests need
+// no SELECT first, any process sharing the reader through pcscd can send
+// them at any time.
+
+#define APDU_CLA_ISO            0x00
+#define APDU_CLA_AVP            0x80
+
+#define APDU_INS_SELECT         0xA4
+#define APDU_INS_AVP_JSON       0x10
+
+#define APDU_SW_OK              0x9000
+#define APDU_SW_WRONG_LENGTH    0x6700
+#define APDU_SW_NOT_FOUND       0x6A82 // unknown AID
+#define APDU_SW_NO_SPACE        0x6A84 // response longer than USB_CCID_RESP_MAX
+#define APDU_SW_INS_UNKNOWN     0x6D00
+#define APDU_SW_CLA_UNKNOWN     0x6E00
+
+// usb_ccid_apdu_pfunc_t, runs the request and returns the response length
+u16 apdu_process(const u8 *apdu, u16 len, u8 *resp, u16 resp_max);
+
+#endif // ! APDU_H
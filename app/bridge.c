@@ -0,0 +1,279 @@
+#include "common.h"
+#include "hardware.h"
+#include "bridge.h"
+#include "tty.h"
+#include "spi.h"
+#include "time.h"
+#include "scratch.h"
+
+#include "avp_l2.h"
+
+#define _HDR_LEN            (4)     // magic, seq, len
+#define _OP_HDR_LEN         (3)     // op, len
+#define _OP_REPLY_HDR_LEN   (4)     // op, status, len
+#define _REPLY_MAX          (2*BRIDGE_PAYLOAD_MAX)
+#define _RQ_TIMEOUT         (500*TIMER_MS) // partial request dropped after
+
+#if ((_HDR_LEN + _REPLY_MAX) > SCRATCH_SIZE)
+  #error "bridge reply does not fit the scratch arena"
+#endif
+
+static bool _bridge_on = false;
+static bool _exit_rq = false;
+
+// the request collects across USB packets, the reply is per request scratch
+static u8 _rq[_HDR_LEN + BRIDGE_PAYLOAD_MAX];
+static size_t _rq_len = 0;
+static os_timer_t _rq_time;
+
+// L2 exchange result, frame copied by the callback
+static volatile avp_l2_state_t _l2_result;
+static u8 *_l2_out;
+static size_t _l2_out_len;
+
+static u16 _get_u16(const u8 *p)
+{
+    return ((u16)(p[0] | (p[1] << 8)));
+}
+
+static void _put_u16(u8 *p, u16 value)
+{
+    p[0] = (u8)value;
+    p[1] = (u8)(value >> 8);
+}
+
+static u8 _op_xfer(u8 flags, u8 *data, size_t len, u8 *out, size_t out_max, size_t *out_len)
+{
+    if (len > out_max)
+        return (BRIDGE_ERR_FORMAT);
+
+    if (avp_l2_busy())
+        return (BRIDGE_ERR_BUSY);
+
+    if (flags & BRIDGE_CS_START)
+        spi1_cs(SPI_CS_ACTIVE);
+
+    if (len > 0)
+        spi1_data_transfer(out, data, len);
+
+    if (flags & BRIDGE_CS_END)
+        spi1_cs(SPI_CS_IDLE);
+
+    *out_len = len;
+    return (BRIDGE_OK);
+}
+
+static u8 _op_delay(u8 *data, size_t len)
+{
+    os_timer_t until;
+
+    if (len != 2)
+        return (BRIDGE_ERR_FORMAT);
+
+    until = timer_get_time() + (os_timer_t)_get_u16(data) * TIMER_MS;
+    while (timer_get_time() < until)
+    {
+        avp_l2_yield(); // USB and watchdog keep running
+    }
+    return (BRIDGE_OK);
+}
+
+static u8 _op_wait_ready(u8 *data, size_t len, u8 *out, size_t out_max, size_t *out_len)
+{
+    if ((len != 2) || (out_max < 1))
+        return (BRIDGE_ERR_FORMAT);
+
+    out[0] = avp_l2_wait_ready(_get_u16(data)) ? 1 : 0;
+    *out_len = 1;
+    return (BRIDGE_OK);
+}
+
+static void _l2_done(avp_l2_state_t result, const uint8_t *frame, size_t len)
+{
+    _l2_out_len = 0;
+    if (frame != NULL)
+    {
+        memcpy(_l2_out, frame, len);
+        _l2_out_len = len;
+    }
+    _l2_result = result;
+}
+
+static u8 _op_l2(u8 *data, size_t len, u8 *out, size_t out_max, size_t *out_len)
+{
+    u32 timeout_ms;
+    bool started;
+
+    if ((len < 2) || (out_max < AVP_L2_FRAME_MAX))
+        return (BRIDGE_ERR_FORMAT);
+
+    if (spi1_cs_state() == SPI_CS_ACTIVE)
+        return (BRIDGE_ERR_BUSY); // CS held by previous XFER
+
+    timeout_ms = _get_u16(data);
+    _l2_out = out;
+    _l2_result = AVP_L2_IDLE;
+
+    if (len > 2)
+        started = avp_l2_request(&data[2], len - 2, timeout_ms, _l2_done);
+    else
+        started = avp_l2_read(AVP_L2_GET_RESP, AVP_L2_NO_RESP, timeout_ms, _l2_done);
+
+    if (! started)
+        return (avp_l2_busy() ? BRIDGE_ERR_BUSY : BRIDGE_ERR_FORMAT);
+
+    while (_l2_result == AVP_L2_IDLE)
+    {
+        avp_l2_step();
+        avp_l2_yield();
+    }
+
+    *out_len = _l2_out_len;
+    switch (_l2_result)
+    {
+    case AVP_L2_DONE:        return (BRIDGE_OK);
+    case AVP_L2_ERR_CRC:     return (BRIDGE_ERR_CRC);
+    case AVP_L2_EMPTY:
+    case AVP_L2_ERR_TIMEOUT: return (BRIDGE_ERR_TIMEOUT);
+    default:
+        break;
+    }
+    return (BRIDGE_ERR_SPI);
+}
+
+static u8 _op(u8 op, u8 *data, size_t len, u8 *out, size_t out_max, size_t *out_len)
+{
+    *out_len = 0;
+
+    switch (op & 0x0F)
+    {
+    case BRIDGE_OP_XFER:       return (_op_xfer(op & 0xF0, data, len, out, out_max, out_len));
+    case BRIDGE_OP_DELAY:      return (_op_delay(data, len));
+    case BRIDGE_OP_WAIT_READY: return (_op_wait_ready(data, len, out, out_max, out_len));
+    case BRIDGE_OP_L2:         return (_op_l2(data, len, out, out_max, out_len));
+    case BRIDGE_OP_EXIT:
+        _exit_rq = true;
+        return (BRIDGE_OK);
+    default:
+        break;
+    }
+    return (BRIDGE_ERR_FORMAT);
+}
+
+static void _bridge_execute(void)
+{
+    u8 *reply = scratch_alloc(_HDR_LEN + _REPLY_MAX);
+    u8 *p = &_rq[_HDR_LEN];
+    size_t left = _rq_len - _HDR_LEN;
+    u8 *out;
+    size_t out_left = _REPLY_MAX;
+    size_t n;
+    u16 len;
+    u8 op;
+    u8 status = BRIDGE_OK;
+
+    if (reply == NULL)
+    {   // arena not released by the previous request, host times out
+        scratch_reset();
+        return;
+    }
+    out = &reply[_HDR_LEN];
+
+    // ops run in order, stop at the first failure
+    while ((left > 0) && (out_left >= _OP_REPLY_HDR_LEN))
+    {
+        n = 0;
+        op = p[0];
+        if ((left < _OP_HDR_LEN) || ((len = _get_u16(&p[1])) > (left - _OP_HDR_LEN)))
+        {
+            status = BRIDGE_ERR_FORMAT;
+        }
+        else
+        {
+            status = _op(op, &p[_OP_HDR_LEN], len, &out[_OP_REPLY_HDR_LEN],
+                         out_left - _OP_REPLY_HDR_LEN, &n);
+        }
+
+        out[0] = op;
+        out[1] = status;
+        _put_u16(&out[2], (u16)n);
+        out += _OP_REPLY_HDR_LEN + n;
+        out_left -= _OP_REPLY_HDR_LEN + n;
+
+        if (status != BRIDGE_OK)
+            break;
+
+        p += _OP_HDR_LEN + len;
+        left -= _OP_HDR_LEN + len;
+    }
+
+    if ((status != BRIDGE_OK) && (! avp_l2_busy()))
+        spi1_cs(SPI_CS_IDLE); // never leave CS stuck after a failed request
+
+    reply[0] = BRIDGE_MAGIC;
+    reply[1] = _rq[1]; // sequence number
+    _put_u16(&reply[2], (u16)(out - &reply[_HDR_LEN]));
+    tty_put_binary(reply, out - reply);
+    tty_flush(false); // host waits for this reply
+    scratch_reset();
+
+    if (_exit_rq)
+        bridge_stop();
+}
+
+static size_t _bridge_feed(const u8 *data, size_t len)
+{
+    os_timer_t now = timer_get_time();
+    size_t i;
+
+    if ((_rq_len > 0) && (now > (_rq_time + _RQ_TIMEOUT)))
+        _rq_len = 0; // stale partial request
+    _rq_time = now;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((_rq_len == 0) && (data[i] != BRIDGE_MAGIC))
+            continue; // resync on magic
+
+        _rq[_rq_len++] = data[i];
+
+        if (_rq_len < _HDR_LEN)
+            continue;
+
+        if (_get_u16(&_rq[2]) > BRIDGE_PAYLOAD_MAX)
+        {   // not a valid header, look for the next magic
+            _rq_len = 0;
+            continue;
+        }
+
+        if (_rq_len == (size_t)(_HDR_LEN + _get_u16(&_rq[2])))
+        {
+            _bridge_execute();
+            _rq_len = 0;
+            if (! _bridge_on)
+                return (i + 1); // rest goes to text console
+        }
+    }
+    return (len);
+}
+
+void bridge_start(void)
+{
+    _rq_len = 0;
+    _exit_rq = false;
+    _bridge_on = true;
+    tty_set_raw(_bridge_feed);
+}
+
+void bridge_stop(void)
+{
+    tty_set_raw(NULL);
+    _bridge_on = false;
+    _exit_rq = false;
+    _rq_len = 0;
+}
+
+bool bridge_active(void)
+{
+    return (_bridge_on);
+}
@@ -0,0 +1,43 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include "type.h"
+
+// Binary SPI bridge, entered with BRIDGE=BIN console command
+//
+// Request:  B5 <seq> <len lo> <len hi> <ops...>
+// Reply:    B5 <seq> <len lo> <len hi> <op replies...>
+//
+// Op:       <op> <len lo> <len hi> <data...>
+// Op reply: <op> <status> <len lo> <len hi> <data...>
+//
+// All ops of one request run in order within one USB round trip.
+
+#define BRIDGE_MAGIC            0xB5
+#define BRIDGE_PAYLOAD_MAX      (1024)
+
+// op codes, low nibble
+#define BRIDGE_OP_XFER          0x01 // data: TX bytes; reply: RX bytes
+#define BRIDGE_OP_DELAY         0x02 // data: u16 ms
+#define BRIDGE_OP_WAIT_READY    0x03 // data: u16 timeout ms; reply: 1 == GPO fired
+#define BRIDGE_OP_L2            0x04 // data: u16 timeout ms, L2 request (empty == read only)
+                                     // reply: STATUS, LEN, data, CRC
+#define BRIDGE_OP_EXIT          0x0F // back to text console after reply
+
+// XFER flags, high nibble
+#define BRIDGE_CS_START         0x10 // CS active before transfer
+#define BRIDGE_CS_END           0x20 // CS idle after transfer
+
+// op reply status
+#define BRIDGE_OK               0x00
+#define BRIDGE_ERR_FORMAT       0x01 // unknown op, bad length, reply too long
+#define BRIDGE_ERR_SPI          0x02
+#define BRIDGE_ERR_TIMEOUT      0x03
+#define BRIDGE_ERR_CRC          0x04
+#define BRIDGE_ERR_BUSY         0x05 // SPI link busy
+
+void bridge_start(void);
+void bridge_stop(void);
+bool bridge_active(void);
+
+#endif // ! BRIDGE_H
@@ -0,0 +1,96 @@
+#include "common.h"
+#include "clock.h"
+#include "spi.h"
+
+#include "avp_l2.h"
+
+static const char *_mode_name[CLOCK_MODE_AUTO + 1] = {"low", "perf", "auto"};
+
+static u8 _mode = CLOCK_MODE_LOW;
+static timer_time_t _last = 0;  // last SE command in AUTO
+static u32 _boosts = 0;
+
+bool clock_set_mode(u8 mode)
+{
+    if (mode > CLOCK_MODE_AUTO)
+        return (false);
+
+    if ((mode != CLOCK_MODE_AUTO) && (! sys_set_profile(mode)))
+        return (false);
+
+    _mode = mode;
+    _last = timer_get_time(); // AUTO from PERF holds it a while
+    return (true);
+}
+
+static u8 _mode_find(const char *name)
+{
+    u8 mode;
+
+    for (mode = 0; mode <= CLOCK_MODE_AUTO; mode++)
+    {
+        if (strcasecmp(name, _mode_name[mode]) == 0)
+            break;
+    }
+    return (mode); // > CLOCK_MODE_AUTO: unknown
+}
+
+u8 clock_get_mode(void)
+{
+    return (_mode);
+}
+
+const char *clock_mode_str(u8 mode)
+{
+    return ((mode <= CLOCK_MODE_AUTO) ? _mode_name[mode] : "?");
+}
+
+u32 clock_boosts(void)
+{
+    return (_boosts);
+}
+
+void clock_boost(void)
+{
+    if (_mode != CLOCK_MODE_AUTO)
+        return;
+
+    _last = timer_get_time();
+    if ((sys_get_profile() != SYS_PROFILE_PERF) && sys_set_profile(SYS_PROFILE_PERF))
+        _boosts++;
+}
+
+void clock_service(void)
+{   // also runs from sched_yield(), never inside an exchange
+    if ((_mode != CLOCK_MODE_AUTO) || (sys_get_profile() == SYS_PROFILE_LOW) || avp_l2_busy())
+        return;
+
+    if ((timer_get_time() - _last) >= CLOCK_BOOST_HOLD)
+        sys_set_profile(SYS_PROFILE_LOW);
+}
+
+avp_ret_t clock_json(const char *profile, char *json, size_t len)
+{
+    const sys_clock_stats_t *stats = sys_clock_stats();
+    u8 mode;
+    u8 now;
+    int n;
+
+    if (profile[0] != '\0')
+    {
+        mode = _mode_find(profile);
+        if (mode > CLOCK_MODE_AUTO)
+            return (AVP_ERR_INVALID_PARAM);
+        if (! clock_set_mode(mode))
+            return (AVP_ERR_HARDWARE); // SPI transfer in flight
+    }
+
+    now = sys_get_profile();
+    n = snprintf(json, len,
+        "{\"ok\":true,\"clock\":\"%s\",\"profile\":\"%s\",\"hclk_mhz\":%lu,\"spi_khz\":%lu,"
+        "\"switches\":%lu,\"switch_us\":%lu,\"switch_max_us\":%lu,\"boosts\":%lu}",
+        clock_mode_str(_mode), clock_mode_str(now), sys_profile_hclk(now) / 1000000UL,
+        spi1_get_frequency() / 1000UL, stats->switches, stats->switch_time,
+        stats->switch_max, _boosts);
+    return (((n > 0) && ((size_t)n < len)) ? AVP_OK : AVP_ERR_INTERNAL);
+}
@@ -0,0 +1,33 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "type.h"
+#include "sys.h"
+#include "time.h"
+
+#include "avp.h"
+
+// Clock profile policy
+//
+// LOW and PERF pin the system clock profile (sys.h). AUTO runs LOW and
+// boosts to PERF when a TROPIC01 command goes out (avp_l2_request() or a
+// libtropic frame, avp_l2_external()), so libtropic's L3 crypto and the
+// SPI frames of a command burst run at full speed; the clock drops back
+// once the link has been quiet for CLOCK_BOOST_HOLD.
+// Switches happen between SPI transfers only.
+
+#define CLOCK_MODE_LOW      SYS_PROFILE_LOW
+#define CLOCK_MODE_PERF     SYS_PROFILE_PERF
+#define CLOCK_MODE_AUTO     (SYS_PROFILES)
+
+#define CLOCK_BOOST_HOLD    (100*TIMER_MS)
+
+bool clock_set_mode(u8 mode);               // false: SPI busy, try again
+u8   clock_get_mode(void);
+const char *clock_mode_str(u8 mode);        // "low", "perf", "auto"
+u32  clock_boosts(void);
+void clock_boost(void);                     // avp_l2 request hook
+void clock_service(void);                   // periodic, AUTO drops back after the hold time
+avp_ret_t clock_json(const char *profile, char *json, size_t len); // avp_cmd_set_clock() handler
+
+#endif // ! CLOCK_H
@@ -6,6 +6,23 @@
 #include "wd.h"
 #include "main.h"
 #include "spi.h"
+#include "sys.h"
+#include "mem.h"
+#include "scratch.h"
+#include "avp_cmd.h"
+#include "avp_hw.h"
+#include "avp_spi_tune.h"
+#include "bridge.h"
+#include "usb_device.h"
+#include "sched.h"
+#include "pwr.h"
+#include "stats.h"
+#include "tty.h"
+#include "avp_l2.h"
+#include "clock.h"
+#if (USB_ECM == 1)
+#include "net.h"
+#endif
 
 #include "version.h"
 
@@ -22,6 +39,7 @@ static const char *ERR_INVALID_PARAMETER = "invalid parameter";
 static const char *ERR_MISSING_PARAMETER = "missing parameter";
 static const char *ERR_ILLEGAL_PARAMETER = "illegal parameter";
 static const char *ERR_UNKNOWN_COMMAND   = "unknown command";
+static const char *ERR_NO_RESPONSE       = "no response";
 
 #define _PIN_STATE(pin) ((pin) ? 1 : 0)
 
@@ -245,10 +263,26 @@ static bool _cmd_cs_set(const struct _cmd_t *cmd, const char **pptext)
     return (true);
 }
 
+static bool _cmd_bridge_set(const struct _cmd_t *cmd, const char **pptext)
+{   // binary mode starts after the OK line, BRIDGE_OP_EXIT returns
+    if (strnicmp(*pptext, "BIN", 3) != 0)
+    {
+        _cmd_error(ERR_INVALID_PARAMETER);
+        return (false);
+    }
+
+    bridge_start();
+    return (true);
+}
+
 static bool _cmd_clkdiv(const cmd_t *cmd)
 {
+    const avp_spi_tune_t *tune = avp_spi_tune_get();
+
     _cmd_basic_reply(cmd);
-    OS_PRINTF("%lu" NL, spi1_get_prescaler());
+    OS_PRINTF("%lu, slew %u, calibrated %u%s, fallbacks %lu, SCK %lu kHz" NL, spi1_get_prescaler(),
+              spi1_get_slew(), tune->prescaler, tune->saved ? " (saved)" : "",
+              tune->fallbacks, spi1_get_frequency() / 1000UL);
     return (true);
 }
 
@@ -256,6 +290,18 @@ static bool _cmd_clkdiv_set(const struct _cmd_t *cmd, const char **pptext)
 {
     s32 value;
 
+    if (strnicmp(*pptext, "AUTO", 4) == 0)
+    {   // calibrate against TROPIC01 and store the result
+        if (spi1_cs_state() == SPI_CS_ACTIVE)
+            goto err;
+
+        if (avp_spi_tune_calibrate())
+            return (true);
+
+        _cmd_error(ERR_NO_RESPONSE);
+        return (false);
+    }
+
     if (! _cmd_fetch_num(&value, pptext))
     {
         goto err;
@@ -269,6 +315,104 @@ err:
     return (false);
 }
 
+static bool _cmd_entropy(const cmd_t *cmd)
+{
+    const avp_entropy_t *pool;
+    u16 ring;
+
+    pool = avp_hw_entropy(&ring);
+    _cmd_basic_reply(cmd);
+    OS_PRINTF("%s, fill %u%%, ring %u, reseeds %lu, rct %lu, apt %lu, errors %lu, mixes %lu, out %lu" NL,
+              avp_entropy_health_str((avp_entropy_health_t)pool->health),
+              avp_entropy_fill(pool), ring, pool->reseeds,
+              pool->rct_failures, pool->apt_failures, pool->source_errors,
+              pool->mixes, pool->bytes_out);
+    return (true);
+}
+
+static bool _cmd_keypool(const cmd_t *cmd)
+{
+    u8 ready[2], target[2];
+    u32 hits, misses;
+
+    avp_cmd_key_pool_status(ready, target, &hits, &misses);
+    _cmd_basic_reply(cmd);
+    OS_PRINTF("P256 %u/%u, Ed25519 %u/%u, hits %lu, misses %lu" NL,
+              ready[0], target[0], ready[1], target[1], hits, misses);
+    return (true);
+}
+
+static bool _cmd_keypool_set(const struct _cmd_t *cmd, const char **pptext)
+{
+    s32 p256;
+    s32 ed25519 = 0;
+
+    if (! _cmd_fetch_num(&p256, pptext))
+        goto err;
+
+    if (_cmd_fetch_next(pptext))
+    {   // second parameter is Ed25519 count
+        if (! _cmd_fetch_num(&ed25519, pptext))
+            goto err;
+    }
+
+    if ((p256 < 0) || (ed25519 < 0) || (p256 > 255) || (ed25519 > 255))
+        goto err;
+
+    if (avp_cmd_key_pool_set(p256, ed25519))
+        return (true);
+
+err:
+    _cmd_error(ERR_INVALID_PARAMETER);
+    return (false);
+}
+
+static u32 _permille(u64 part, u64 whole)
+{
+    return ((whole > 0) ? (u32)((part * 1000) / whole) : 0);
+}
+
+static bool _cmd_tasks(const cmd_t *cmd)
+{
+    const sched_stats_t *stats;
+    const pwr_stats_t *pwr;
+    timer_time_t elapsed = sched_elapsed();
+    u32 load;
+    u8 id;
+
+    _cmd_basic_reply(cmd);
+    load = _permille(sched_sleep_time(), elapsed);
+    OS_PRINTF("up %lu ms, sleep %lu.%lu%%", (u32)(elapsed / TIMER_MS), load / 10, load % 10);
+    for (id = 0; id <= sched_task_count(); id++)
+    {   // last one is the idle hooks
+        stats = sched_get_stats(id);
+        load = _permille(stats->time_total, elapsed);
+        OS_PRINTF("; %s prio %u, runs %lu, load %lu.%lu%%, max %lu us",
+                  stats->name, stats->prio, stats->runs, load / 10, load % 10, stats->time_max);
+    }
+    OS_PRINTF(NL);
+    pwr = pwr_get_stats();
+    OS_PRINTF("stop %lu, %lu ms, resume %lu us (max %lu), wake to first byte %lu us (max %lu)" NL,
+              pwr->stops, (u32)(pwr->stop_time / TIMER_MS), pwr->resume_time, pwr->resume_max,
+              pwr->first_byte_time, pwr->first_byte_max);
+    return (true);
+}
+
+static bool _cmd_tasks_set(const struct _cmd_t *cmd, const char **pptext)
+{
+    s32 value;
+
+    if ((! _cmd_fetch_num(&value, pptext)) || (value != 0))
+    {
+        _cmd_error(ERR_INVALID_PARAMETER);
+        return (false);
+    }
+
+    sched_stats_reset();
+    pwr_stats_reset();
+    return (true);
+}
+
 static bool _cmd_id(const cmd_t *cmd)
 {
     _cmd_basic_reply(cmd);
@@ -297,11 +441,122 @@ static bool _cmd_ver(const cmd_t *cmd)
 static bool _cmd_reset(const cmd_t *cmd)
 {
     OS_PRINTF("RESET" NL);
-    OS_DELAY(10);
+    fflush(stdout);
+    tty_flush(true);
     wd_reset(GPREG_BOOT_REBOOT);
     return (true);
 }
 
+static bool _cmd_usb(const cmd_t *cmd)
+{
+    static const char *name[USB_CDC_PORTS] = {"console", "avp", "vendor"};
+    const usb_cdc_tx_stats_t *stats;
+#if (USB_ECM == 1)
+    const net_stats_t *net_stats;
+#endif
+    u8 port;
+
+    _cmd_basic_reply(cmd);
+    for (port = 0; port < USB_CDC_PORTS; port++)
+    {
+        stats = usb_cdc_tx_stats(port);
+        OS_PRINTF("%s%s %s, tx high water %u/%u, full %lu, dropped %lu",
+                  (port > 0) ? "; " : "", name[port],
+                  usb_cdc_connected(port) ? "connected" : "disconnected",
+                  stats->high_water, USB_CDC_TX_QUEUE,
+                  stats->full_waits, stats->dropped);
+    }
+#if (USB_ECM == 1)
+    net_stats = net_get_stats();
+    OS_PRINTF("; ecm %s, rx %lu tx %lu dropped %lu, udp %lu, tcp %u/%u accepted %lu reset %lu",
+              net_connected() ? "connected" : "disconnected",
+              net_stats->rx_frames, net_stats->tx_frames, net_stats->dropped,
+              net_stats->udp_requests, net_tcp_active(), NET_TCP_CONNS,
+              net_stats->tcp_accepted, net_stats->tcp_resets);
+#endif
+    OS_PRINTF("; ccid %s" NL, usb_ccid_connected() ? "connected" : "disconnected");
+    return (true);
+}
+
+static bool _cmd_stats(const cmd_t *cmd)
+{
+    const avp_l2_stats_t *l2 = avp_l2_get_stats();
+    const metrics_hist_t *hist;
+    const char *kind;
+    const char *name;
+    u32 pool_size;
+    u32 pool_free;
+    u32 pool_min;
+    u32 hits;
+    u32 misses;
+    u8 i;
+    u8 b;
+
+    _cmd_basic_reply(cmd);
+    usb_device_pool(&pool_size, &pool_free, &pool_min);
+    OS_PRINTF("usb pool %lu/%lu free (min %lu), rx high water %u/%u/%u packets; "
+              "se frames %lu, crc errors %lu, timeouts %lu, spi errors %lu, clock fallbacks %lu" NL,
+              pool_free, pool_size, pool_min, tty_rx_high_water(USB_CDC_CONSOLE),
+              tty_rx_high_water(USB_CDC_AVP), tty_rx_high_water(USB_VENDOR_AVP),
+              l2->frames, l2->crc_errors, l2->timeouts, l2->spi_errors,
+              avp_spi_tune_get()->fallbacks);
+    sys_icache_stats(&hits, &misses);
+    OS_PRINTF("icache %s, hits %lu, misses %lu%s" NL, (PROFILE_PERF == 1) ? "2-way" : "1-way",
+              hits, misses, (misses == 0xFFFF) ? "+" : "");
+
+    // buckets: <1, 1, 2, 4 .. 16384+ us
+    for (i = 0; (hist = stats_hist(i, &kind, &name)) != NULL; i++)
+    {
+        if (hist->count == 0)
+            continue;
+        OS_PRINTF("%s %s: n %lu, avg %lu us, max %lu us, hist", kind, name,
+                  hist->count, (u32)(hist->total / hist->count), hist->max);
+        for (b = 0; b < METRICS_BUCKETS; b++)
+        {
+            OS_PRINTF(" %lu", hist->bucket[b]);
+        }
+        OS_PRINTF(NL);
+    }
+    return (true);
+}
+
+static bool _cmd_stats_set(const struct _cmd_t *cmd, const char **pptext)
+{
+    s32 value;
+
+    if ((! _cmd_fetch_num(&value, pptext)) || (value != 0))
+    {
+        _cmd_error(ERR_INVALID_PARAMETER);
+        return (false);
+    }
+
+    metrics_reset();
+    sys_icache_reset();
+    return (true);
+}
+
+static bool _cmd_mem(const cmd_t *cmd)
+{
+    mem_module_t module;
+    u32 pool_size;
+    u32 pool_free;
+    u32 pool_min;
+    u8 i;
+
+    _cmd_basic_reply(cmd);
+    usb_device_pool(&pool_size, &pool_free, &pool_min);
+    OS_PRINTF("stack %lu used, %lu peak of %lu; usb pool %lu/%lu free, %lu min; ramfunc %lu" NL,
+              mem_stack_used(), mem_stack_peak(), mem_stack_size(),
+              pool_free, pool_size, pool_min, mem_ramfunc_size());
+    OS_PRINTF("scratch %lu peak of %u, %lu failures" NL,
+              scratch_peak(), SCRATCH_SIZE, scratch_failures());
+    for (i = 0; mem_module(i, &module); i++)
+    {
+        OS_PRINTF("%s: data %lu, bss %lu" NL, module.name, module.data, module.bss);
+    }
+    return (true);
+}
+
 static bool _cmd_gpo(const cmd_t *cmd)
 {
     _cmd_basic_reply(cmd);
@@ -416,19 +671,61 @@ void cmd_parse(const char *ptext)
     OS_PRINTF("OK" NL);
 }
 
+static bool _cmd_clock(const cmd_t *cmd)
+{
+    const sys_clock_stats_t *stats = sys_clock_stats();
+    u8 profile = sys_get_profile();
+
+    _cmd_basic_reply(cmd);
+    OS_PRINTF("%s, %s %lu MHz, SCK %lu kHz, switches %lu (last %lu us, max %lu us), boosts %lu" NL,
+              clock_mode_str(clock_get_mode()), clock_mode_str(profile),
+              sys_profile_hclk(profile) / 1000000UL, spi1_get_frequency() / 1000UL,
+              stats->switches, stats->switch_time, stats->switch_max, clock_boosts());
+    return (true);
+}
+
+static bool _cmd_clock_set(const struct _cmd_t *cmd, const char **pptext)
+{
+    u8 mode;
+
+    if (strnicmp(*pptext, "LOW", 3) == 0)
+        mode = CLOCK_MODE_LOW;
+    else if (strnicmp(*pptext, "PERF", 4) == 0)
+        mode = CLOCK_MODE_PERF;
+    else if (strnicmp(*pptext, "AUTO", 4) == 0)
+        mode = CLOCK_MODE_AUTO;
+    else
+        goto err;
+
+    if (clock_set_mode(mode))
+        return (true);
+
+err:
+    _cmd_error(ERR_INVALID_PARAMETER);
+    return (false);
+}
+
 static const cmd_t _CMD_TABLE[] = {
     {"AUTO",      _cmd_auto,    _cmd_auto_set,  "Automatic response reading get/set"},
 #ifdef HW_BUTTON_PRESSED
     {"BUTTON",    _cmd_button,  NULL,           "Get button state"},
 #endif // defined HW_BUTTON_PRESSED
+    {"BRIDGE",    NULL,         _cmd_bridge_set,"Binary SPI bridge mode"},
     {"CLKDIV",    _cmd_clkdiv,  _cmd_clkdiv_set,"Clock divisor get/set"},
+    {"CLOCK",     _cmd_clock,   _cmd_clock_set, "System clock profile LOW/PERF/AUTO get/set"},
     {"CS",        _cmd_cs,      _cmd_cs_set,    "SPI chip select direct control"},
+    {"ENTROPY",   _cmd_entropy, NULL,           "Entropy pool status"},
     {"GPO",       _cmd_gpo,     NULL,           "Show GPO state"},
     {"HELP",      _cmd_help,    NULL,           "This help text"},
     {"ID",        _cmd_id,      NULL,           "Request product id"},
+    {"KEYPOOL",   _cmd_keypool, _cmd_keypool_set,"Spare key pool get/set"},
+    {"MEM",       _cmd_mem,     NULL,           "Stack and scratch high water marks, static RAM per module"},
     {"PWR",       _cmd_pwr,     _cmd_pwr_set,   "Get/set target power"},
     {"RESET",     _cmd_reset,   NULL,           "Instant reset"},
     {"SN",        _cmd_sn,      NULL,           "Request product serial number"},
+    {"STATS",     _cmd_stats,   _cmd_stats_set, "Latency histograms and error counts get/reset"},
+    {"TASKS",     _cmd_tasks,   _cmd_tasks_set, "Scheduler task runtime get/reset"},
+    {"USB",       _cmd_usb,     NULL,           "USB console status"},
     {"VER",       _cmd_ver,     NULL,           "Request version information"},
 
     {NULL, NULL, 0, NULL} // command list termination
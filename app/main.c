@@ -8,14 +8,29 @@
 #include "gpreg.h"
 #include "led.h"
 #include "sys.h"
+#include "mem.h"
 #include "usb_device.h"
 #include "spi.h"
+#include "exti.h"
 #include "cmd.h"
+#include "bridge.h"
+#include "apdu.h"
 #include "log.h"
+#include "sched.h"
+#include "pwr.h"
+#include "metrics.h"
+#include "stats.h"
+#include "clock.h"
+#include "scratch.h"
+#if (USB_ECM == 1)
+#include "net.h"
+#endif
 
 /* AVP Protocol Support */
 #include "avp.h"
 #include "avp_cmd.h"
+#include "avp_l2.h"
+#include "avp_spi_tune.h"
 
 LOG_DEF("main");
 
@@ -26,6 +41,10 @@ u8 main_spi_no_resp = 0;
 static bool _spi_cs_active = false;
 #define _SPI_BUF_SIZE (512)
 
+#if ((2*_SPI_BUF_SIZE) > SCRATCH_SIZE)
+  #error "SPI text buffers do not fit the scratch arena"
+#endif
+
 #define MAIN_LED_INIT  HW_LED1_INIT
 #define MAIN_LED_ON    HW_LED1_ON
 #define MAIN_LED_OFF   HW_LED1_OFF
@@ -101,42 +120,26 @@ static void _spi_cs_disable(void)
     _spi_cs_active = false;
 }
 
-static void _spi_auto_task(void)
-{   // automatic response reading task
-    char spi_buf[_SPI_BUF_SIZE];
-    int i, l;
-
-    spi1_flush();
-
-    _spi_cs_enable();
+static void _spi_auto_done(avp_l2_state_t result, const uint8_t *frame, size_t len)
+{   // automatic response received, print it as read (CRC errors included)
+    size_t i;
 
-    spi_buf[0] = spi1_transfer(main_spi_get_resp);
-    // TODO: we can check busy bit here
-    spi_buf[0] = spi1_transfer(0); // header
-
-    if (spi_buf[0] == main_spi_no_resp)
-    {   // no response to read
-        _spi_cs_disable();
-        // TODO: automatic read TS_L2_GET_LOG_REQ ?
-        return;
-    }
+    (void)result;
+    if (frame == NULL)
+        return; // no response to read
+    // TODO: automatic read TS_L2_GET_LOG_REQ ?
 
-    l = spi1_transfer(0);
-    spi_buf[1] = l; // data length
-
-    for (i=2; i<(2+l+2); i++)
+    for (i=0; i<len; i++)
     {
-        spi_buf[i] = spi1_transfer(0);
-    }
-    
-    _spi_cs_disable();
-
-    // print result
-    for (i=0; i<(2+l+2); i++)
-    {
-        OS_PRINTF("%02X", spi_buf[i]);
+        OS_PRINTF("%02X", frame[i]);
     }
     OS_PRINTF(NL);
+    OS_FLUSH();
+}
+
+static void _spi_auto_task(void)
+{   // automatic response reading task, single poll, finished in avp_l2_step()
+    avp_l2_read(main_spi_get_resp, main_spi_no_resp, 0, _spi_auto_done);
 }
 
 static bool _skip_cs_char(char ch)
@@ -147,8 +150,8 @@ static bool _skip_cs_char(char ch)
 
 static bool _parse_hex(char *data)
 {
-    char spi_tx_buf[_SPI_BUF_SIZE];
-    char spi_rx_buf[_SPI_BUF_SIZE];
+    char *spi_tx_buf;
+    char *spi_rx_buf;
     int buf_size = 0;
     int i;
     u8 tmp;
@@ -163,6 +166,16 @@ static bool _parse_hex(char *data)
     if (! _get_hex(&tmp, data))
         return (false);
 
+    // per request scratch, like the binary bridge
+    spi_tx_buf = scratch_alloc(_SPI_BUF_SIZE);
+    spi_rx_buf = scratch_alloc(_SPI_BUF_SIZE);
+    if ((spi_tx_buf == NULL) || (spi_rx_buf == NULL))
+    {   // arena not released by the previous request, still answer the line
+        scratch_reset();
+        OS_PRINTF("ERROR: no buffer" NL);
+        return (true);
+    }
+
     // convert HEX to binary data to buffer
     do
     {
@@ -196,6 +209,9 @@ static bool _parse_hex(char *data)
         OS_PRINTF("%02X", spi_rx_buf[i]);
     }
     OS_PRINTF(NL);
+
+    // reply printed, the arena goes to the next request
+    scratch_reset();
     return (true);
 }
 
@@ -207,7 +223,7 @@ static void _tty_rx_parser(char *data)
     /* Check for AVP JSON command (starts with '{') */
     if (avp_cmd_is_avp(data))
     {
-        avp_cmd_process(data);
+        avp_cmd_process(data, NULL);
         OS_FLUSH();
         return;
     }
@@ -219,6 +235,18 @@ static void _tty_rx_parser(char *data)
     OS_FLUSH();
 }
 
+static void _avp_rx_parser(char *data)
+{   // AVP port: JSON requests and responses only, logs stay on console
+    avp_cmd_process(data, tty_avp_put_text);
+    tty_flush(false);
+}
+
+static void _vendor_rx_parser(char *data)
+{   // vendor bulk interface, same as the AVP port without the tty layer on host
+    avp_cmd_process(data, tty_vendor_put_text);
+    tty_flush(false);
+}
+
 static void _usb_update_state(void)
 {
     static bool prev_state = false;
@@ -238,14 +266,110 @@ static void _usb_update_state(void)
     {
         led_cyclic_sequence(&led1, _LED_MODE_IDLE);
         HW_SPI_OE_DISABLE;
+        bridge_stop(); // next host starts in text mode
     }
 
     prev_state = state;
 }
 
+// scheduler tasks, see sched.h
+static u8 _task_usb;
+static u8 _task_link;
+static u8 _task_rx;
+static u8 _task_auto;
+
+static void _usb_task(void)
+{   // also runs from sched_yield() while SE is busy
+    bool busy;
+
+    usb_device_task();
+    busy = usb_device_busy();
+#if (USB_ECM == 1)
+    net_task();
+    busy = busy || net_busy();
+#endif
+    // interrupts wake us, poll only while transfers or TCP timers are pending
+    if (busy)
+        sched_at(_task_usb, 1*TIMER_MS);
+    sched_post(_task_rx); // data read in this pass is served next
+}
+
+static void _service_task(void)
+{   // 100 ms, also runs from sched_yield()
+    _usb_update_state();
+    led_tick(&led1);
+    wd_feed();
+    clock_service();
+}
+
+static void _link_task(void)
+{
+    static bool busy = false;
+    u32 errors;
+    u32 code;
+
+    if ((errors = spi1_error_take(&code)) != 0)
+        LOG_ERROR("SPI1 transfer error %lx (%lu)", code, errors); // latched in the SPI ISR
+
+    avp_l2_step();
+    avp_spi_tune_check();
+
+    if (busy && (! avp_l2_busy()))
+        sched_post(_task_rx); // queued requests go on right away
+    busy = avp_l2_busy();
+    if (busy)
+        sched_at(_task_link, 1*TIMER_MS); // SPI poll and timeouts
+}
+
+static void _rx_task(void)
+{   // new requests stay queued in tty buffer (CCID: host gets time
+    // extensions) while SPI link is busy
+    if (avp_l2_busy())
+        return;
+
+    tty_rx_task();
+    usb_ccid_task();
+#if (USB_ECM == 1)
+    if (net_avp_task())
+        sched_post(_task_rx); // more may be queued, one per pass
+#endif
+    sched_post(_task_link); // requests may have started a link exchange
+}
+
+static void _auto_task(void)
+{   // read right away when GPO signals a response, poll only as fallback
+    if (main_spi_auto && (! bridge_active()) && (_spi_cs_active == false) && (! avp_l2_busy()))
+    {
+        _spi_auto_task();
+        sched_post(_task_link);
+    }
+    sched_at(_task_auto, (avp_l2_ready_live() || (! main_spi_auto)) ? 1000*TIMER_MS : 100*TIMER_MS);
+}
+
+static void _idle_task(void)
+{   // spare key generation etc., never while the SPI bridge holds CS
+    // or a host drives the chip through the binary bridge
+    if ((! avp_l2_busy()) && (_spi_cs_active == false) && (! bridge_active()))
+        avp_cmd_idle();
+}
+
+static bool _deep_sleep(timer_time_t next)
+{   // Stop 1 only while the host has the bus suspended: USB needs its
+    // clock otherwise, and the SE link keeps its DMA running
+    if ((! usb_device_suspended()) || avp_l2_busy())
+        return (false);
+    return (pwr_stop(next));
+}
+
+static void _gpo_irq(void)
+{
+    avp_l2_ready_irq();
+    sched_event(SCHED_EV_GPO);
+}
+
 static void _main_task(void)
 {
-    os_timer_t now, timer_100ms = 0;
+    u8 id;
 
     reset_clear();
     
@@ -255,36 +379,36 @@ static void _main_task(void)
     led_cyclic_sequence(&led1, _LED_MODE_IDLE);
    
     usb_device_init();
+    pwr_init();
     spi1_init();
+    avp_l2_init(sched_yield);
+    avp_l2_set_request_hook(clock_boost); // CLOCK=AUTO raises the clock for SE commands
+    // GPO signals response ready, wakes the link and auto read at once
+    exti_rising_init(HW_GPO_IN_PORT, HW_GPO_IN_BIT, _gpo_irq);
+    avp_spi_tune_boot();
 
-    timer_100ms = timer_get_time();
-
-    while (1)
-    {
-        now = timer_get_time();
-        tty_rx_task();
-        usb_device_task();
-
-        if (now > timer_100ms)
-        {
-            _usb_update_state();
-            timer_100ms += 100*TIMER_MS;
-            led_tick(&led1);
-            wd_feed();
-            if (main_spi_auto)
-            {
-                if (_spi_cs_active == false)
-                {
-                    _spi_auto_task();
-                }
-            }
-        }
-        __WFI(); // at least 1ms timer IRQ running
-    }
+    /* Initialize AVP Protocol, needs SPI for TROPIC01 */
+    avp_cmd_init();
+    avp_cmd_set_metrics(stats_json);
+    avp_cmd_set_clock(clock_json);
+
+    // event driven, tasks re-arm a 1 ms poll only while they have work pending
+    _task_usb = sched_task_add("usb", _usb_task, SCHED_PRIO_IO, SCHED_EV_USB);
+    id = sched_task_add("service", _service_task, SCHED_PRIO_SERVICE, 0);
+    sched_timer(id, 100*TIMER_MS);
+    _task_link = sched_task_add("link", _link_task, SCHED_PRIO_LINK, SCHED_EV_SPI | SCHED_EV_GPO);
+    _task_rx = sched_task_add("rx", _rx_task, SCHED_PRIO_REQUEST, SCHED_EV_UART);
+    _task_auto = sched_task_add("auto", _auto_task, SCHED_PRIO_POLL, SCHED_EV_GPO);
+    sched_at(_task_auto, 100*TIMER_MS);
+    sched_idle_add(_idle_task);
+    sched_sleep_set(_deep_sleep);
+
+    sched_run();
 }
 
 int main(void)
 {
+    mem_init(); // stack painting, before any deep call
     sys_init();
     sys_clock_config();
     
@@ -296,9 +420,16 @@ int main(void)
     reset_type = reset_get_type();
 
     timer_init();
+    metrics_init();
 
     OS_DELAY(10);
     tty_init(_tty_rx_parser);
+    tty_avp_init(_avp_rx_parser);
+    tty_vendor_init(_vendor_rx_parser);
+    usb_ccid_init(apdu_process);
+#if (USB_ECM == 1)
+    net_init();
+#endif
     OS_DELAY(10);
 
     OS_PUTTEXT(NL);
@@ -307,9 +438,6 @@ int main(void)
     
     OS_PUTTEXT("# BUILD DATE: " __DATE__ NL);
 
-    /* Initialize AVP Protocol */
-    avp_cmd_init();
-
     OS_PUTTEXT("# RESET TYPE: ");
     switch (reset_type)
     {
@@ -0,0 +1,1112 @@
+#include "common.h"
+#include "net.h"
+#include "usb_device.h"
+#include "tty.h"
+#include "time.h"
+
+#include "avp_cmd.h"
+#include "avp_l2.h"
+
+#define _ETH_HDR            (14)
+#define _IP_HDR             (20)
+#define _UDP_HDR            (8)
+#define _TCP_HDR            (20)
+#define _IP_MTU             (1500)
+#define _UDP_DATA           (_ETH_HDR + _IP_HDR + _UDP_HDR)
+#define _TCP_MSS            (_IP_MTU - _IP_HDR - _TCP_HDR)
+#define _TCP_MSS_DEFAULT    (536)
+
+#define _ETH_TYPE_IP        (0x0800)
+#define _ETH_TYPE_ARP       (0x0806)
+#define _IP_PROTO_ICMP      (1)
+#define _IP_PROTO_TCP       (6)
+#define _IP_PROTO_UDP       (17)
+#define _IP_BROADCAST       (0xFFFFFFFFUL)
+#define _IP_SUBNET_BCAST    (NET_DEVICE_IP | ~NET_NETMASK)
+
+#define _DHCP_SERVER_PORT   (67)
+#define _DHCP_CLIENT_PORT   (68)
+#define _DHCP_MAGIC         (0x63825363UL)
+#define _DHCP_LEASE_S       (86400)
+
+#define _TCP_FIN            (0x01)
+#define _TCP_SYN            (0x02)
+#define _TCP_RST            (0x04)
+#define _TCP_PSH            (0x08)
+#define _TCP_ACK            (0x10)
+
+#define _RX_FRAMES          (2)
+#define _TX_FRAMES          (4)
+#define _TCP_RX_SIZE        (TTY_BUF_SIZE)      // longest request line
+#define _TCP_TX_SIZE        (2048)
+#define _TCP_RTO            (200*TIMER_MS)
+#define _TCP_RTO_MAX        (3000*TIMER_MS)
+#define _TCP_RETRIES        (8)                 // then the peer is gone, reset
+#define _SEND_TIMEOUT       (5000*TIMER_MS)     // peer not reading, output dropped
+
+typedef enum {
+    _TCP_FREE = 0,
+    _TCP_SYN_RCVD,
+    _TCP_ESTABLISHED,
+} _tcp_state_e;
+
+typedef struct {
+    u8 data[USB_ECM_FRAME_MAX] __attribute__((aligned(4)));
+    u16 len;
+} _frame_t;
+
+typedef struct {
+    u8 state;
+    bool peer_fin;      // no more data from the peer
+    bool fin;           // close once tx is sent
+    bool fin_sent;
+    bool ack_now;
+    bool probe;         // send one byte into a zero window
+    u8 retries;
+    u32 ip;
+    u16 port;
+    u16 mss;
+    u16 snd_wnd;        // peer receive window
+    u32 snd_una;        // tx[0] once established
+    u32 snd_nxt;        // back to snd_una on retransmission
+    u32 snd_max;        // highest sent
+    u32 rcv_nxt;
+    os_timer_t rto;
+    os_timer_t rto_time; // 0 when nothing is outstanding
+    os_timer_t last;    // last segment from the peer
+    u16 rx_len;
+    u16 tx_len;
+    u8 rx[_TCP_RX_SIZE];
+    u8 tx[_TCP_TX_SIZE];
+} _tcp_t;
+
+static const u8 _bcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static u8 _mac[6];
+static u8 _peer_mac[6];
+static bool _link = false;
+static u16 _ip_id = 0;
+static u32 _tcp_iss = 0;
+static net_stats_t _stats;
+
+// frames from the host, slot lent to the USB class is the one at _rx_wr
+static _frame_t _rx[_RX_FRAMES];
+static u8 _rx_wr = 0;
+static u8 _rx_rd = 0;
+
+// frames to the host, the one at _tx_rd is on the wire when _tx_started
+static _frame_t _tx[_TX_FRAMES];
+static u8 _tx_wr = 0;
+static u8 _tx_rd = 0;
+static bool _tx_started = false;
+
+static _tcp_t _tcp[NET_TCP_CONNS];
+static _tcp_t *_out_conn = NULL;    // connection of the request being served
+
+static struct {
+    bool busy;
+    u32 ip;
+    u16 port;
+    char line[TTY_BUF_SIZE];
+    u16 out_len;
+    u8 out[NET_UDP_PAYLOAD];
+} _udp;
+
+static u16 _get16(const u8 *p)
+{
+    return ((u16)((p[0] << 8) | p[1]));
+}
+
+static u32 _get32(const u8 *p)
+{
+    return (((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3]);
+}
+
+static void _put16(u8 *p, u16 value)
+{
+    p[0] = (u8)(value >> 8);
+    p[1] = (u8)value;
+}
+
+static void _put32(u8 *p, u32 value)
+{
+    p[0] = (u8)(value >> 24);
+    p[1] = (u8)(value >> 16);
+    p[2] = (u8)(value >> 8);
+    p[3] = (u8)value;
+}
+
+static u32 _csum_add(u32 sum, const u8 *p, u16 len)
+{
+    while (len > 1)
+    {
+        sum += (u32)((p[0] << 8) | p[1]);
+        p += 2;
+        len -= 2;
+    }
+    if (len > 0)
+        sum += (u32)(p[0] << 8);
+    return (sum);
+}
+
+static u16 _csum(u32 sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ((u16)~sum);
+}
+
+static u32 _csum_pseudo(u32 src, u32 dst, u8 proto, u16 len)
+{
+    return ((src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) + proto + len);
+}
+
+//-----------------------------------------------------------------------------
+// frame queues
+
+static u8 *_rx_buffer(void)
+{
+    if ((u8)(_rx_wr - _rx_rd) >= _RX_FRAMES)
+        return (NULL); // class holds the frame on the endpoint until a slot frees
+    return (_rx[_rx_wr % _RX_FRAMES].data);
+}
+
+static void _rx_frame_done(u8 *frame, u16 len)
+{
+    (void)frame; // always the slot at _rx_wr
+    _rx[_rx_wr % _RX_FRAMES].len = len;
+    _rx_wr++;
+    _stats.rx_frames++;
+}
+
+static void _tx_run(void)
+{
+    _frame_t *f;
+
+    if (_tx_started && (! usb_ecm_tx_busy()))
+    {
+        _tx_rd++;
+        _tx_started = false;
+    }
+
+    if (_tx_started || (_tx_rd == _tx_wr))
+        return;
+
+    f = &_tx[_tx_rd % _TX_FRAMES];
+    if (usb_ecm_tx(f->data, f->len))
+        _tx_started = true;
+    else if (! usb_ecm_connected())
+        _tx_rd = _tx_wr;
+}
+
+// frame to fill, valid until _tx_send(), NULL when the queue is full
+static u8 *_tx_get(void)
+{
+    _tx_run();
+    if ((u8)(_tx_wr - _tx_rd) >= _TX_FRAMES)
+        return (NULL);
+    return (_tx[_tx_wr % _TX_FRAMES].data);
+}
+
+static void _tx_send(u16 len)
+{
+    _tx[_tx_wr % _TX_FRAMES].len = len;
+    _tx_wr++;
+    _stats.tx_frames++;
+    _tx_run();
+}
+
+//-----------------------------------------------------------------------------
+// IPv4
+
+// IP and Ethernet headers in front of a payload already in place
+static u16 _ip_finish(u8 *f, u32 dst, u8 proto, u16 payload_len)
+{
+    u8 *ip = &f[_ETH_HDR];
+    u16 total = _IP_HDR + payload_len;
+
+    memcpy(&f[0], (dst == _IP_BROADCAST) ? _bcast_mac : _peer_mac, 6);
+    memcpy(&f[6], _mac, 6);
+    _put16(&f[12], _ETH_TYPE_IP);
+
+    ip[0] = 0x45;
+    ip[1] = 0;
+    _put16(&ip[2], total);
+    _put16(&ip[4], _ip_id++);
+    _put16(&ip[6], 0x4000); // don't fragment
+    ip[8] = 64;
+    ip[9] = proto;
+    _put16(&ip[10], 0);
+    _put32(&ip[12], NET_DEVICE_IP);
+    _put32(&ip[16], dst);
+    _put16(&ip[10], _csum(_csum_add(0, ip, _IP_HDR)));
+    return (_ETH_HDR + total);
+}
+
+static u16 _udp_finish(u8 *f, u32 dst, u16 src_port, u16 dst_port, u16 len)
+{
+    u8 *udp = &f[_ETH_HDR + _IP_HDR];
+    u16 sum;
+
+    _put16(&udp[0], src_port);
+    _put16(&udp[2], dst_port);
+    _put16(&udp[4], _UDP_HDR + len);
+    _put16(&udp[6], 0);
+    sum = _csum(_csum_add(_csum_pseudo(NET_DEVICE_IP, dst, _IP_PROTO_UDP, _UDP_HDR + len), udp, _UDP_HDR + len));
+    _put16(&udp[6], (sum == 0) ? 0xFFFF : sum);
+    return (_ip_finish(f, dst, _IP_PROTO_UDP, _UDP_HDR + len));
+}
+
+static void _rx_arp(const u8 *p, u16 len)
+{
+    u8 *f;
+    u8 *a;
+
+    if ((len < 28) || (_get16(&p[0]) != 1) || (_get16(&p[2]) != _ETH_TYPE_IP) ||
+        (p[4] != 6) || (p[5] != 4) || (_get16(&p[6]) != 1) || (_get32(&p[24]) != NET_DEVICE_IP))
+        return; // only requests for our address
+
+    memcpy(_peer_mac, &p[8], 6);
+    if ((f = _tx_get()) == NULL)
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    memcpy(&f[0], &p[8], 6);
+    memcpy(&f[6], _mac, 6);
+    _put16(&f[12], _ETH_TYPE_ARP);
+    a = &f[_ETH_HDR];
+    memcpy(&a[0], &p[0], 6);    // htype, ptype, hlen, plen
+    _put16(&a[6], 2);           // reply
+    memcpy(&a[8], _mac, 6);
+    _put32(&a[14], NET_DEVICE_IP);
+    memcpy(&a[18], &p[8], 10);  // requester MAC and IP
+    _tx_send(_ETH_HDR + 28);
+}
+
+static void _rx_icmp(u32 src, const u8 *p, u16 len)
+{
+    u8 *f;
+    u8 *icmp;
+
+    if ((len < 8) || (p[0] != 8) || (_csum(_csum_add(0, p, len)) != 0))
+        return; // echo request only
+
+    if ((f = _tx_get()) == NULL)
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    icmp = &f[_ETH_HDR + _IP_HDR];
+    memcpy(icmp, p, len);
+    icmp[0] = 0; // echo reply
+    _put16(&icmp[2], 0);
+    _put16(&icmp[2], _csum(_csum_add(0, icmp, len)));
+    _tx_send(_ip_finish(f, src, _IP_PROTO_ICMP, len));
+}
+
+//-----------------------------------------------------------------------------
+// DHCP server, one lease: NET_HOST_IP
+
+static void _rx_dhcp(const u8 *p, u16 len)
+{
+    u32 requested = 0;
+    u8 type = 0;
+    u8 reply;
+    u16 i;
+    u8 *f;
+    u8 *b;
+    u8 *o;
+
+    if ((len < 240) || (p[0] != 1) || (_get32(&p[236]) != _DHCP_MAGIC))
+        return;
+
+    for (i = 240; i < len; )
+    {
+        if (p[i] == 0)
+        {
+            i++; // pad
+            continue;
+        }
+        if ((p[i] == 255) || ((i + 2) > len) || ((i + 2 + p[i + 1]) > len))
+            break;
+        if ((p[i] == 53) && (p[i + 1] >= 1))
+            type = p[i + 2];
+        if ((p[i] == 50) && (p[i + 1] >= 4))
+            requested = _get32(&p[i + 2]);
+        i += 2 + p[i + 1];
+    }
+
+    if (type == 1)
+        reply = 2; // DISCOVER -> OFFER
+    else if (type == 3)
+        reply = ((requested == 0) || (requested == NET_HOST_IP)) ? 5 : 6; // REQUEST -> ACK or NAK
+    else
+        return;
+
+    if ((f = _tx_get()) == NULL)
+    {
+        _stats.dropped++;
+        return; // client retries
+    }
+
+    b = &f[_UDP_DATA];
+    memset(b, 0, 240);
+    b[0] = 2; // BOOTREPLY
+    b[1] = 1;
+    b[2] = 6;
+    memcpy(&b[4], &p[4], 4);    // xid
+    memcpy(&b[10], &p[10], 2);  // flags
+    if (reply != 6)
+        _put32(&b[16], NET_HOST_IP);
+    _put32(&b[20], NET_DEVICE_IP);
+    memcpy(&b[28], &p[28], 16); // chaddr
+    _put32(&b[236], _DHCP_MAGIC);
+
+    o = &b[240];
+    *o++ = 53; *o++ = 1; *o++ = reply;
+    *o++ = 54; *o++ = 4; _put32(o, NET_DEVICE_IP); o += 4;
+    if (reply != 6)
+    {
+        *o++ = 51; *o++ = 4; _put32(o, _DHCP_LEASE_S); o += 4;
+        *o++ = 1;  *o++ = 4; _put32(o, NET_NETMASK); o += 4;
+    }
+    *o++ = 255;
+
+    _tx_send(_udp_finish(f, _IP_BROADCAST, _DHCP_SERVER_PORT, _DHCP_CLIENT_PORT, (u16)(o - b)));
+}
+
+//-----------------------------------------------------------------------------
+// UDP
+
+static void _rx_udp(u32 src, u32 dst, const u8 *p, u16 len)
+{
+    u16 ulen;
+    u16 n;
+
+    if ((len < _UDP_HDR) || ((ulen = _get16(&p[4])) < _UDP_HDR) || (ulen > len))
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    if ((_get16(&p[6]) != 0) && (_csum(_csum_add(_csum_pseudo(src, dst, _IP_PROTO_UDP, ulen), p, ulen)) != 0))
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    if ((_get16(&p[2]) == _DHCP_SERVER_PORT) && (_get16(&p[0]) == _DHCP_CLIENT_PORT))
+    {
+        _rx_dhcp(&p[_UDP_HDR], ulen - _UDP_HDR);
+        return;
+    }
+
+    if ((_get16(&p[2]) != NET_AVP_PORT) || (dst != NET_DEVICE_IP))
+        return;
+
+    if (_udp.busy)
+    {
+        _stats.dropped++; // one request at a time, client retries
+        return;
+    }
+
+    n = ulen - _UDP_HDR;
+    if (n > (sizeof(_udp.line) - 1))
+        n = sizeof(_udp.line) - 1;
+    memcpy(_udp.line, &p[_UDP_HDR], n);
+    _udp.line[n] = '\0';
+    _udp.ip = src;
+    _udp.port = _get16(&p[0]);
+    _udp.busy = true;
+    _stats.udp_requests++;
+}
+
+// next frame to fill, waits while the queue drains
+static u8 *_tx_wait(void)
+{
+    os_timer_t until = timer_get_time() + _SEND_TIMEOUT;
+    u8 *f;
+
+    while ((f = _tx_get()) == NULL)
+    {
+        if ((! usb_ecm_connected()) || (timer_get_time() > until))
+            return (NULL);
+        avp_l2_yield(); // USB and watchdog keep running
+    }
+    return (f);
+}
+
+static void _udp_flush(void)
+{
+    u8 *f;
+
+    if (_udp.out_len == 0)
+        return;
+
+    if ((f = _tx_wait()) != NULL)
+    {
+        memcpy(&f[_UDP_DATA], _udp.out, _udp.out_len);
+        _tx_send(_udp_finish(f, _udp.ip, NET_AVP_PORT, _udp.port, _udp.out_len));
+    }
+    else
+    {
+        _stats.dropped++;
+    }
+    _udp.out_len = 0;
+}
+
+static void _udp_put_text(const char *text)
+{
+    size_t len = strlen(text);
+    size_t n;
+
+    while (len > 0)
+    {
+        n = sizeof(_udp.out) - _udp.out_len;
+        if (n > len)
+            n = len;
+        memcpy(&_udp.out[_udp.out_len], text, n);
+        _udp.out_len += n;
+        text += n;
+        len -= n;
+        if (_udp.out_len == sizeof(_udp.out))
+            _udp_flush();
+    }
+}
+
+static void _udp_serve(void)
+{
+    char *line = _udp.line;
+    char *end;
+
+    // lines in the datagram run in order, responses share datagrams
+    while (*line != '\0')
+    {
+        end = line + strcspn(line, "\r\n");
+        if (*end != '\0')
+            *end++ = '\0';
+        if (*line != '\0')
+            avp_cmd_process(line, _udp_put_text);
+        line = end;
+    }
+    _udp_flush();
+    _udp.busy = false;
+}
+
+//-----------------------------------------------------------------------------
+// TCP
+
+static void _tcp_arm(_tcp_t *c)
+{
+    if (c->rto_time == 0)
+        c->rto_time = timer_get_time() + c->rto;
+}
+
+static u16 _tcp_window(_tcp_t *c)
+{
+    return (_TCP_RX_SIZE - c->rx_len);
+}
+
+static bool _tcp_segment(u32 ip, u16 port, u32 seq, u32 ack, u8 flags, u16 wnd, const u8 *data, u16 len)
+{
+    u8 hdr = (flags & _TCP_SYN) ? (_TCP_HDR + 4) : _TCP_HDR;
+    u8 *f;
+    u8 *t;
+
+    if ((f = _tx_get()) == NULL)
+        return (false);
+
+    t = &f[_ETH_HDR + _IP_HDR];
+    _put16(&t[0], NET_AVP_PORT);
+    _put16(&t[2], port);
+    _put32(&t[4], seq);
+    _put32(&t[8], ack);
+    t[12] = (u8)((hdr / 4) << 4);
+    t[13] = flags;
+    _put16(&t[14], wnd);
+    _put16(&t[16], 0);
+    _put16(&t[18], 0);
+    if (flags & _TCP_SYN)
+    {
+        t[20] = 2; // MSS
+        t[21] = 4;
+        _put16(&t[22], _TCP_MSS);
+    }
+    if (len > 0)
+        memcpy(&t[hdr], data, len);
+
+    _put16(&t[16], _csum(_csum_add(_csum_pseudo(NET_DEVICE_IP, ip, _IP_PROTO_TCP, hdr + len), t, hdr + len)));
+    _tx_send(_ip_finish(f, ip, _IP_PROTO_TCP, hdr + len));
+    return (true);
+}
+
+static bool _tcp_send(_tcp_t *c, u32 seq, u8 flags, const u8 *data, u16 len)
+{
+    if (! _tcp_segment(c->ip, c->port, seq, c->rcv_nxt, flags, _tcp_window(c), data, len))
+        return (false);
+
+    c->ack_now = false;
+    return (true);
+}
+
+// answer to a segment without connection
+static void _tcp_reset(u32 ip, const u8 *t, u16 len)
+{
+    u8 flags = t[13];
+    u32 ack;
+
+    if (flags & _TCP_ACK)
+    {
+        _tcp_segment(ip, _get16(&t[0]), _get32(&t[8]), 0, _TCP_RST, 0, NULL, 0);
+        return;
+    }
+    ack = _get32(&t[4]) + len + ((flags & _TCP_SYN) ? 1 : 0) + ((flags & _TCP_FIN) ? 1 : 0);
+    _tcp_segment(ip, _get16(&t[0]), 0, ack, _TCP_RST | _TCP_ACK, 0, NULL, 0);
+}
+
+static void _tcp_abort(_tcp_t *c)
+{
+    if (c->state == _TCP_FREE)
+        return;
+    _tcp_send(c, c->snd_nxt, _TCP_RST | _TCP_ACK, NULL, 0);
+    c->state = _TCP_FREE;
+    _stats.tcp_resets++;
+}
+
+static _tcp_t *_tcp_find(u32 ip, u16 port)
+{
+    u8 i;
+
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        if ((_tcp[i].state != _TCP_FREE) && (_tcp[i].ip == ip) && (_tcp[i].port == port))
+            return (&_tcp[i]);
+    }
+    return (NULL);
+}
+
+static _tcp_t *_tcp_alloc(void)
+{
+    _tcp_t *idle = NULL;
+    u8 i;
+
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        if (&_tcp[i] == _out_conn)
+            continue; // request still writing to it
+        if (_tcp[i].state == _TCP_FREE)
+            return (&_tcp[i]);
+        if ((_tcp[i].rx_len == 0) && (_tcp[i].tx_len == 0) &&
+            ((idle == NULL) || (_tcp[i].last < idle->last)))
+            idle = &_tcp[i];
+    }
+
+    if (idle != NULL)
+        _tcp_abort(idle);
+    return (idle);
+}
+
+static void _tcp_output(_tcp_t *c)
+{
+    u16 sent;
+    u16 avail;
+    u16 wnd;
+    u16 n;
+
+    if (c->state != _TCP_ESTABLISHED)
+        return;
+
+    while (! c->fin_sent)
+    {
+        sent = (u16)(c->snd_nxt - c->snd_una);
+        avail = c->tx_len - sent;
+        wnd = (c->snd_wnd > sent) ? (c->snd_wnd - sent) : 0;
+        if ((wnd == 0) && c->probe && (avail > 0))
+            wnd = 1;
+
+        n = avail;
+        if (n > wnd)
+            n = wnd;
+        if (n > c->mss)
+            n = c->mss;
+
+        if (n > 0)
+        {
+            if (! _tcp_send(c, c->snd_nxt, _TCP_ACK | ((n == avail) ? _TCP_PSH : 0), &c->tx[sent], n))
+                return;
+            c->snd_nxt += n;
+            if ((s32)(c->snd_nxt - c->snd_max) > 0)
+                c->snd_max = c->snd_nxt;
+            c->probe = false;
+            _tcp_arm(c);
+            continue;
+        }
+
+        if (avail > 0)
+        {
+            _tcp_arm(c); // zero window, probe on timeout
+            break;
+        }
+
+        if (c->fin)
+        {
+            if (! _tcp_send(c, c->snd_nxt, _TCP_FIN | _TCP_ACK, NULL, 0))
+                return;
+            c->snd_nxt++;
+            if ((s32)(c->snd_nxt - c->snd_max) > 0)
+                c->snd_max = c->snd_nxt;
+            c->fin_sent = true;
+            _tcp_arm(c);
+        }
+        break;
+    }
+
+    if (c->ack_now)
+        _tcp_send(c, c->snd_nxt, _TCP_ACK, NULL, 0);
+}
+
+static void _tcp_timer(_tcp_t *c, os_timer_t now)
+{
+    if ((c->rto_time == 0) || (now < c->rto_time))
+        return;
+
+    if (++c->retries > _TCP_RETRIES)
+    {
+        _tcp_abort(c);
+        return;
+    }
+
+    c->rto = (c->rto < (_TCP_RTO_MAX / 2)) ? (c->rto * 2) : _TCP_RTO_MAX;
+    c->rto_time = now + c->rto;
+
+    if (c->state == _TCP_SYN_RCVD)
+    {
+        _tcp_send(c, c->snd_una, _TCP_SYN | _TCP_ACK, NULL, 0);
+        return;
+    }
+
+    // go back N: everything after the last ACK goes out again
+    c->snd_nxt = c->snd_una;
+    c->fin_sent = false;
+    c->probe = true;
+}
+
+static void _tcp_accept(u32 src, const u8 *t, u16 hdr)
+{
+    _tcp_t *c;
+    u16 i;
+
+    if ((c = _tcp_alloc()) == NULL)
+    {
+        _tcp_reset(src, t, 0);
+        return;
+    }
+
+    memset(c, 0, offsetof(_tcp_t, rx));
+    c->ip = src;
+    c->port = _get16(&t[0]);
+    c->rcv_nxt = _get32(&t[4]) + 1;
+    c->snd_wnd = _get16(&t[14]);
+    c->mss = _TCP_MSS_DEFAULT;
+    for (i = _TCP_HDR; (i < hdr) && (t[i] != 0); )
+    {
+        if (t[i] == 1)
+        {
+            i++; // NOP
+            continue;
+        }
+        if (((i + 1) >= hdr) || (t[i + 1] < 2))
+            break;
+        if ((t[i] == 2) && (t[i + 1] == 4) && ((i + 4) <= hdr))
+            c->mss = _get16(&t[i + 2]);
+        i += t[i + 1];
+    }
+    if ((c->mss == 0) || (c->mss > _TCP_MSS))
+        c->mss = _TCP_MSS;
+
+    _tcp_iss += 64000 + (u32)timer_get_time();
+    c->snd_una = _tcp_iss;
+    c->snd_nxt = _tcp_iss + 1;
+    c->snd_max = c->snd_nxt;
+    c->rto = _TCP_RTO;
+    c->last = timer_get_time();
+    c->state = _TCP_SYN_RCVD;
+    _tcp_send(c, c->snd_una, _TCP_SYN | _TCP_ACK, NULL, 0);
+    _tcp_arm(c);
+}
+
+static void _tcp_ack(_tcp_t *c, u32 ack)
+{
+    u32 acked = ack - c->snd_una;
+
+    if ((acked == 0) || (acked > (c->snd_max - c->snd_una)))
+        return; // duplicate or not sent yet
+
+    if (c->state == _TCP_SYN_RCVD)
+    {
+        c->state = _TCP_ESTABLISHED; // SYN acknowledged, tx[0] is at snd_una
+        _stats.tcp_accepted++;
+    }
+    else
+    {
+        if (acked > c->tx_len)
+        {   // peer has our FIN too, both sides done
+            c->state = _TCP_FREE;
+            return;
+        }
+        memmove(c->tx, &c->tx[acked], c->tx_len - acked);
+        c->tx_len -= acked;
+    }
+
+    c->snd_una = ack;
+    if ((s32)(c->snd_nxt - ack) < 0)
+        c->snd_nxt = ack; // ACK for data sent before a retransmission
+    c->retries = 0;
+    c->rto = _TCP_RTO;
+    c->rto_time = 0;
+    if (c->snd_max != c->snd_una)
+        _tcp_arm(c);
+}
+
+static void _rx_tcp(u32 src, const u8 *t, u16 len)
+{
+    _tcp_t *c;
+    u16 hdr;
+    u8 flags;
+    u32 seq;
+    u16 dlen;
+    u16 n;
+
+    if ((len < _TCP_HDR) || (_csum(_csum_add(_csum_pseudo(src, NET_DEVICE_IP, _IP_PROTO_TCP, len), t, len)) != 0) ||
+        ((hdr = (t[12] >> 4) * 4) < _TCP_HDR) || (hdr > len))
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    flags = t[13];
+    seq = _get32(&t[4]);
+    dlen = len - hdr;
+
+    c = _tcp_find(src, _get16(&t[0]));
+    if ((c == NULL) || (_get16(&t[2]) != NET_AVP_PORT))
+    {
+        if (flags & _TCP_RST)
+            return;
+        if ((_get16(&t[2]) == NET_AVP_PORT) && ((flags & (_TCP_SYN | _TCP_ACK)) == _TCP_SYN))
+            _tcp_accept(src, t, hdr);
+        else
+            _tcp_reset(src, t, dlen);
+        return;
+    }
+
+    if (flags & _TCP_RST)
+    {
+        if ((seq - c->rcv_nxt) <= _tcp_window(c))
+        {
+            c->state = _TCP_FREE;
+            _stats.tcp_resets++;
+        }
+        return;
+    }
+
+    if (flags & _TCP_SYN)
+    {
+        if ((c->state == _TCP_SYN_RCVD) && ((seq + 1) == c->rcv_nxt))
+            _tcp_send(c, c->snd_una, _TCP_SYN | _TCP_ACK, NULL, 0); // SYN-ACK lost
+        else
+            c->ack_now = true;
+        return;
+    }
+
+    if (! (flags & _TCP_ACK))
+        return;
+
+    c->last = timer_get_time();
+    _tcp_ack(c, _get32(&t[8]));
+    if (c->state != _TCP_ESTABLISHED)
+        return;
+    c->snd_wnd = _get16(&t[14]);
+
+    if ((dlen == 0) && (! (flags & _TCP_FIN)))
+        return;
+
+    if ((seq == c->rcv_nxt) && (! c->peer_fin))
+    {
+        n = _tcp_window(c);
+        if (n > dlen)
+            n = dlen;
+        memcpy(&c->rx[c->rx_len], &t[hdr], n);
+        c->rx_len += n;
+        c->rcv_nxt += n;
+        if ((flags & _TCP_FIN) && (n == dlen))
+        {
+            c->rcv_nxt++;
+            c->peer_fin = true;
+        }
+    }
+    c->ack_now = true; // out of order segments get a duplicate ACK
+}
+
+static void _tcp_put_text(const char *text)
+{
+    _tcp_t *c = _out_conn;
+    size_t len = strlen(text);
+    os_timer_t until = 0;
+    size_t n;
+
+    while ((len > 0) && (c->state == _TCP_ESTABLISHED))
+    {
+        n = _TCP_TX_SIZE - c->tx_len;
+        if (n == 0)
+        {   // peer reads slower than we answer
+            if (until == 0)
+                until = timer_get_time() + _SEND_TIMEOUT;
+            else if (timer_get_time() > until)
+            {
+                _tcp_abort(c);
+                break;
+            }
+            _tcp_output(c);
+            avp_l2_yield(); // USB, ACKs and watchdog keep running
+            continue;
+        }
+
+        if (n > len)
+            n = len;
+        memcpy(&c->tx[c->tx_len], text, n);
+        c->tx_len += n;
+        text += n;
+        len -= n;
+        until = 0;
+    }
+}
+
+// next complete line of a connection, NULL if none yet
+static char *_tcp_line(_tcp_t *c, char *line)
+{
+    u16 wnd = _tcp_window(c);
+    u16 len;
+    u16 n;
+
+    while (c->rx_len > 0)
+    {
+        for (n = 0; (n < c->rx_len) && (c->rx[n] != '\n') && (c->rx[n] != '\r'); n++)
+            ;
+        if ((n == c->rx_len) && (! c->peer_fin) && (c->rx_len < _TCP_RX_SIZE))
+            break; // line not complete, a full buffer or the peer closing ends it
+
+        len = n;
+        memcpy(line, c->rx, len);
+        line[len] = '\0';
+        if (n < c->rx_len)
+            n++;
+        memmove(c->rx, &c->rx[n], c->rx_len - n);
+        c->rx_len -= n;
+        if (wnd < (_TCP_RX_SIZE / 2))
+            c->ack_now = true; // window update
+
+        if (len > 0)
+            return (line); // \r\n leaves an empty line, skipped
+    }
+    return (NULL);
+}
+
+//-----------------------------------------------------------------------------
+
+static void _rx_ip(u8 *f, u16 len)
+{
+    u8 *ip = &f[_ETH_HDR];
+    u16 ihl;
+    u16 total;
+    u32 src;
+    u32 dst;
+
+    len -= _ETH_HDR;
+    if ((len < _IP_HDR) || ((ip[0] >> 4) != 4) || ((ihl = (ip[0] & 0x0F) * 4) < _IP_HDR) ||
+        ((total = _get16(&ip[2])) < ihl) || (total > len) || (_csum(_csum_add(0, ip, ihl)) != 0))
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    if (_get16(&ip[6]) & 0x3FFF)
+    {
+        _stats.dropped++; // fragment
+        return;
+    }
+
+    src = _get32(&ip[12]);
+    dst = _get32(&ip[16]);
+    if ((dst != NET_DEVICE_IP) && (dst != _IP_BROADCAST) && (dst != _IP_SUBNET_BCAST))
+        return;
+
+    memcpy(_peer_mac, &f[6], 6);
+    switch (ip[9])
+    {
+    case _IP_PROTO_ICMP:
+        if (dst == NET_DEVICE_IP)
+            _rx_icmp(src, &ip[ihl], total - ihl);
+        break;
+    case _IP_PROTO_UDP:
+        _rx_udp(src, dst, &ip[ihl], total - ihl);
+        break;
+    case _IP_PROTO_TCP:
+        if (dst == NET_DEVICE_IP)
+            _rx_tcp(src, &ip[ihl], total - ihl);
+        break;
+    default:
+        break;
+    }
+}
+
+static void _rx_frame(u8 *f, u16 len)
+{
+    if (len < _ETH_HDR)
+    {
+        _stats.dropped++;
+        return;
+    }
+
+    if ((memcmp(f, _mac, 6) != 0) && (memcmp(f, _bcast_mac, 6) != 0))
+        return; // multicast and frames for others
+
+    switch (_get16(&f[12]))
+    {
+    case _ETH_TYPE_ARP: _rx_arp(&f[_ETH_HDR], len - _ETH_HDR); break;
+    case _ETH_TYPE_IP:  _rx_ip(f, len); break;
+    default:
+        break;
+    }
+}
+
+static void _net_reset(void)
+{
+    u8 i;
+
+    for (i = 0; i < NET_TCP_CONNS; i++)
+        _tcp[i].state = _TCP_FREE;
+    _rx_rd = _rx_wr;
+    _tx_rd = _tx_wr;
+    _tx_started = false;
+}
+
+void net_init(void)
+{
+    usb_ecm_mac(_mac);
+    memset(&_stats, 0, sizeof(_stats));
+    _net_reset();
+    usb_ecm_init(_rx_buffer, _rx_frame_done);
+}
+
+void net_task(void)
+{
+    _frame_t *f;
+    os_timer_t now;
+    u8 i;
+
+    if (! usb_ecm_connected())
+    {
+        if (_link)
+            _net_reset(); // host took the interface down, connections are gone
+        _link = false;
+        return;
+    }
+    _link = true;
+
+    // replies need a free tx frame, leave the rest queued
+    while ((_rx_rd != _rx_wr) && ((u8)(_tx_wr - _tx_rd) < _TX_FRAMES))
+    {
+        f = &_rx[_rx_rd % _RX_FRAMES];
+        _rx_frame(f->data, f->len);
+        _rx_rd++;
+    }
+
+    now = timer_get_time();
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        if (_tcp[i].state == _TCP_FREE)
+            continue;
+        _tcp_timer(&_tcp[i], now);
+        _tcp_output(&_tcp[i]);
+    }
+    _tx_run();
+}
+
+bool net_busy(void)
+{
+    u8 i;
+
+    if ((_rx_rd != _rx_wr) || (_tx_rd != _tx_wr))
+        return (true);
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        if ((_tcp[i].state != _TCP_FREE) && ((_tcp[i].rto_time != 0) || _tcp[i].ack_now))
+            return (true);
+    }
+    return (false);
+}
+
+bool net_avp_task(void)
+{
+    static char line[_TCP_RX_SIZE + 1];
+    static u8 next = 0;
+    _tcp_t *c;
+    u8 i;
+
+    if (_udp.busy)
+    {
+        _udp_serve();
+        return (true);
+    }
+
+    // one request per pass, connections take turns
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        c = &_tcp[(next + i) % NET_TCP_CONNS];
+        if ((c->state != _TCP_ESTABLISHED) || c->fin)
+            continue;
+
+        if (_tcp_line(c, line) != NULL)
+        {
+            next = (next + i + 1) % NET_TCP_CONNS;
+            _out_conn = c;
+            avp_cmd_process(line, _tcp_put_text);
+            _out_conn = NULL;
+            _tcp_output(c);
+            return (true);
+        }
+
+        if (c->peer_fin)
+        {
+            c->fin = true; // all requests answered, close our side
+            _tcp_output(c);
+        }
+    }
+    return (false);
+}
+
+bool net_connected(void)
+{
+    return (usb_ecm_connected());
+}
+
+u8 net_tcp_active(void)
+{
+    u8 count = 0;
+    u8 i;
+
+    for (i = 0; i < NET_TCP_CONNS; i++)
+    {
+        if (_tcp[i].state == _TCP_ESTABLISHED)
+            count++;
+    }
+    return (count);
+}
+
+const net_stats_t *net_get_stats(void)
+{
+    return (&_stats);
+}
@@ -0,0 +1,47 @@
+#ifndef NET_H
+#define NET_H
+
+#include "type.h"
+
+// IPv4 on the CDC-ECM function (make USB_ECM=1), AVP JSON over UDP and TCP
+//
+// Static buffers, one host on the link: ARP for our address only, ICMP
+// echo, no fragments, no IP options. A DHCP server gives the host its
+// address without router or DNS, so the host never routes through us.
+//
+// UDP: one request per datagram (lines ended by \n as on the AVP port),
+//      response lines go back to the sender in datagrams of up to
+//      NET_UDP_PAYLOAD bytes; a long response spans several datagrams.
+// TCP: up to NET_TCP_CONNS connections, each a stream of request lines
+//      as on the AVP port. Requests are served one at a time, so clients
+//      on different connections never see each other's responses. When
+//      all connections are in use, a new one resets the longest idle.
+
+#define NET_IP(a, b, c, d)  (((u32)(a) << 24) | ((u32)(b) << 16) | ((u32)(c) << 8) | (u32)(d))
+
+#define NET_DEVICE_IP       NET_IP(192, 168, 78, 1)
+#define NET_HOST_IP         NET_IP(192, 168, 78, 2)  // DHCP lease
+#define NET_NETMASK         NET_IP(255, 255, 255, 0)
+#define NET_AVP_PORT        (7780)                   // UDP and TCP
+
+#define NET_UDP_PAYLOAD     (1472)
+#define NET_TCP_CONNS       (4)
+
+typedef struct {
+    u32 rx_frames;
+    u32 tx_frames;
+    u32 dropped;        // malformed, no buffer, UDP request while one is queued
+    u32 udp_requests;
+    u32 tcp_accepted;
+    u32 tcp_resets;     // peer stopped answering or reading, slot reused
+} net_stats_t;
+
+void net_init(void);
+void net_task(void);        // frames and timers, background service (also while a request runs)
+bool net_busy(void);        // net_task() has frames or timers pending
+bool net_avp_task(void);    // runs one queued request, main loop only; true when it did
+bool net_connected(void);
+u8   net_tcp_active(void);
+const net_stats_t *net_get_stats(void);
+
+#endif // ! NET_H
@@ -0,0 +1,145 @@
+#include "common.h"
+#include "stats.h"
+#include "time.h"
+#include "tty.h"
+#include "usb_device.h"
+#include "mem.h"
+#include "scratch.h"
+
+#include "avp.h"
+#include "avp_l2.h"
+#include "avp_spi_tune.h"
+
+static const char *_stage_name[METRICS_STAGES] = {"rx", "parse", "exec", "format", "drain"};
+static const char *_spi_name[METRICS_SPI_TYPES] = {"request", "read", "poll"};
+
+const metrics_hist_t *stats_hist(u8 index, const char **kind, const char **name)
+{
+    if (index < METRICS_STAGES)
+    {
+        *kind = "stage";
+        *name = _stage_name[index];
+        return (metrics_get_stage(index));
+    }
+    index -= METRICS_STAGES;
+
+    if (index < METRICS_SPI_TYPES)
+    {
+        *kind = "spi";
+        *name = _spi_name[index];
+        return (metrics_get_spi(index));
+    }
+    index -= METRICS_SPI_TYPES;
+
+    if (index < AVP_OP_COUNT)
+    {
+        *kind = "op";
+        *name = avp_op_str((avp_op_t)index);
+        return (metrics_get_op(index));
+    }
+    return (NULL);
+}
+
+static int _summary(char *json, size_t len)
+{
+    const avp_l2_stats_t *l2 = avp_l2_get_stats();
+    const metrics_hist_t *hist;
+    const char *kind;
+    const char *name;
+    mem_module_t module;
+    u32 pool_size;
+    u32 pool_free;
+    u32 pool_min;
+    int n;
+    int k;
+    u8 hists = 0;
+    u8 i;
+
+    for (i = 0; (hist = stats_hist(i, &kind, &name)) != NULL; i++)
+    {
+        if (hist->count > 0)
+            hists++;
+    }
+    usb_device_pool(&pool_size, &pool_free, &pool_min);
+
+    n = snprintf(json, len,
+        "{\"ok\":true,\"metrics\":\"summary\",\"uptime_ms\":%lu,\"hists\":%u,"
+        "\"usb_pool\":{\"size\":%lu,\"free\":%lu,\"min_free\":%lu},"
+        "\"tx_high_water\":[%u,%u,%u],\"rx_high_water\":[%u,%u,%u],"
+        "\"se\":{\"frames\":%lu,\"crc_errors\":%lu,\"timeouts\":%lu,\"spi_errors\":%lu,"
+        "\"polls\":%lu,\"clock_fallbacks\":%lu},"
+        "\"mem\":{\"stack\":{\"size\":%lu,\"used\":%lu,\"peak\":%lu},"
+        "\"scratch\":{\"size\":%u,\"peak\":%lu,\"failures\":%lu},\"ramfunc\":%lu,\"modules\":{",
+        (u32)(timer_get_time() / TIMER_MS), hists, pool_size, pool_free, pool_min,
+        usb_cdc_tx_stats(USB_CDC_CONSOLE)->high_water, usb_cdc_tx_stats(USB_CDC_AVP)->high_water,
+        usb_cdc_tx_stats(USB_VENDOR_AVP)->high_water,
+        tty_rx_high_water(USB_CDC_CONSOLE), tty_rx_high_water(USB_CDC_AVP),
+        tty_rx_high_water(USB_VENDOR_AVP),
+        l2->frames, l2->crc_errors, l2->timeouts, l2->spi_errors, l2->polls,
+        avp_spi_tune_get()->fallbacks,
+        mem_stack_size(), mem_stack_used(), mem_stack_peak(),
+        SCRATCH_SIZE, scratch_peak(), scratch_failures(), mem_ramfunc_size());
+
+    // static RAM per module: [data, bss]
+    for (i = 0; mem_module(i, &module) && (n > 0) && ((size_t)n < len); i++)
+    {
+        k = snprintf(&json[n], len - n, "%s\"%s\":[%lu,%lu]", (i > 0) ? "," : "",
+                     module.name, module.data, module.bss);
+        n = (k < 0) ? k : (n + k);
+    }
+    if ((n > 0) && ((size_t)n < len))
+    {
+        k = snprintf(&json[n], len - n, "}}}");
+        n = (k < 0) ? k : (n + k);
+    }
+    return (n);
+}
+
+static int _hist(char *json, size_t len, const metrics_hist_t *hist, const char *kind, const char *name)
+{
+    int n;
+    int k;
+    u8 i;
+
+    n = snprintf(json, len,
+        "{\"ok\":true,\"metrics\":\"%s\",\"name\":\"%s\",\"count\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"hist\":[",
+        kind, name, hist->count, (u32)(hist->total / hist->count), hist->max);
+
+    for (i = 0; (i < METRICS_BUCKETS) && (n > 0) && ((size_t)n < len); i++)
+    {
+        k = snprintf(&json[n], len - n, "%s%lu", (i > 0) ? "," : "", hist->bucket[i]);
+        n = (k < 0) ? k : (n + k);
+    }
+    if ((n > 0) && ((size_t)n < len))
+    {
+        k = snprintf(&json[n], len - n, "]}");
+        n = (k < 0) ? k : (n + k);
+    }
+    return (n);
+}
+
+bool stats_json(unsigned int line, char *json, size_t len)
+{
+    const metrics_hist_t *hist;
+    const char *kind;
+    const char *name;
+    int n;
+    u8 i;
+
+    if (line == 0)
+    {
+        n = _summary(json, len);
+        return ((n > 0) && ((size_t)n < len));
+    }
+
+    // line n is the n-th histogram with counts
+    for (i = 0; (hist = stats_hist(i, &kind, &name)) != NULL; i++)
+    {
+        if ((hist->count == 0) || (--line > 0))
+            continue;
+
+        n = _hist(json, len, hist, kind, name);
+        return ((n > 0) && ((size_t)n < len));
+    }
+    return (false);
+}
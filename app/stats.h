@@ -0,0 +1,18 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "type.h"
+#include "metrics.h"
+
+// Device metrics report
+//
+// Latency histograms (metrics.h) for request stages, SPI transactions and
+// AVP ops, USBX memory pool use, USB queue high water marks, SE link
+// error counts and the RAM budget (mem.h). Served as {"op":"METRICS"}, one
+// JSON line for the summary and one per histogram that has counts, and as
+// the STATS console command.
+
+const metrics_hist_t *stats_hist(u8 index, const char **kind, const char **name); // NULL past the last
+bool stats_json(unsigned int line, char *json, size_t len); // avp_cmd_set_metrics() renderer
+
+#endif // ! STATS_H
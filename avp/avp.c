@@ -12,6 +12,7 @@
 
 /* TROPIC01 integration */
 #include "avp_tropic.h"
+#include "avp_keys.h"
 
 /*============================================================================
  * Constants
@@ -31,7 +32,7 @@
  * Helper Functions
  *============================================================================*/
 
-static void hex_encode(const uint8_t *data, size_t len, char *out)
+static AVP_HOT void hex_encode(const uint8_t *data, size_t len, char *out)
 {
     static const char hex[] = "0123456789abcdef";
     for (size_t i = 0; i < len; i++) {
@@ -41,28 +42,41 @@ static void hex_encode(const uint8_t *data, size_t len, char *out)
     out[len * 2] = '\0';
 }
 
-static int hex_decode(const char *hex, uint8_t *out, size_t max_len)
+static AVP_HOT int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static AVP_HOT int hex_decode(const char *hex, uint8_t *out, size_t max_len)
 {
     size_t len = strlen(hex);
     if (len % 2 != 0 || len / 2 > max_len) {
         return -1;
     }
 
+    /* Table-free nibble decode, sscanf() per byte dominated HW_SIGN_UPDATE */
     for (size_t i = 0; i < len / 2; i++) {
-        unsigned int byte;
-        if (sscanf(&hex[i * 2], "%2x", &byte) != 1) {
+        int hi = hex_nibble(hex[i * 2]);
+        int lo = hex_nibble(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
             return -1;
         }
-        out[i] = (uint8_t)byte;
+        out[i] = (uint8_t)((hi << 4) | lo);
     }
     return len / 2;
 }
 
-static void generate_session_id(avp_ctx_t *ctx, char *out)
+static bool generate_session_id(avp_ctx_t *ctx, char *out)
 {
     uint8_t random[16];
-    ctx->random_bytes(random, sizeof(random));
+    if (!ctx->random_bytes(random, sizeof(random))) {
+        return false;
+    }
     hex_encode(random, sizeof(random), out);
+    return true;
 }
 
 static int find_secret_by_name(avp_ctx_t *ctx, const char *name)
@@ -76,6 +90,33 @@ static int find_secret_by_name(avp_ctx_t *ctx, const char *name)
     return -1;
 }
 
+/*
+ * Signing key by name. Neither an empty name nor the attestation key's own
+ * name selects slot 0: it only signs HW_CHALLENGE (avp_tropic_attest()).
+ */
+static int find_key_by_name(avp_ctx_t *ctx, const char *name, avp_resp_t *resp)
+{
+    if (name[0] == '\0') {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, "Missing key_name", sizeof(resp->error_msg) - 1);
+        return -1;
+    }
+
+    int slot = avp_keys_find(&ctx->keys, name);
+    if (slot == AVP_KEY_SLOT_ATTEST) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, "Attestation key cannot sign data", sizeof(resp->error_msg) - 1);
+        return -1;
+    }
+    if (slot < 0) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_KEY_NOT_FOUND;
+    }
+    return slot;
+}
+
 static int find_free_slot(avp_ctx_t *ctx)
 {
     for (int i = 0; i < AVP_MAX_SECRETS; i++) {
@@ -106,45 +147,76 @@ const char *avp_error_str(avp_ret_t err)
         case AVP_ERR_PIN_INVALID:       return "PIN_INVALID";
         case AVP_ERR_PIN_LOCKED:        return "PIN_LOCKED";
         case AVP_ERR_INTERNAL:          return "INTERNAL_ERROR";
+        case AVP_ERR_KEY_NOT_FOUND:     return "KEY_NOT_FOUND";
         default:                        return "UNKNOWN_ERROR";
     }
 }
 
+const char *avp_op_str(avp_op_t op)
+{
+    switch (op) {
+        case AVP_OP_DISCOVER:           return "DISCOVER";
+        case AVP_OP_AUTHENTICATE:       return "AUTHENTICATE";
+        case AVP_OP_STORE:              return "STORE";
+        case AVP_OP_RETRIEVE:           return "RETRIEVE";
+        case AVP_OP_DELETE:             return "DELETE";
+        case AVP_OP_LIST:               return "LIST";
+        case AVP_OP_ROTATE:             return "ROTATE";
+        case AVP_OP_HW_CHALLENGE:       return "HW_CHALLENGE";
+        case AVP_OP_HW_SIGN:            return "HW_SIGN";
+        case AVP_OP_HW_ATTEST:          return "HW_ATTEST";
+        case AVP_OP_HW_SIGN_INIT:       return "HW_SIGN_INIT";
+        case AVP_OP_HW_SIGN_UPDATE:     return "HW_SIGN_UPDATE";
+        case AVP_OP_HW_SIGN_FINAL:      return "HW_SIGN_FINAL";
+        case AVP_OP_HW_KEYGEN:          return "HW_KEYGEN";
+        case AVP_OP_HW_KEYLIST:         return "HW_KEYLIST";
+        case AVP_OP_GET_RANDOM:         return "GET_RANDOM";
+        case AVP_OP_METRICS:            return "METRICS";
+        case AVP_OP_CLOCK:              return "CLOCK";
+        default:                        return "UNKNOWN";
+    }
+}
+
 /*============================================================================
  * JSON Parsing (minimal implementation)
  *============================================================================*/
 
-static const char *json_find_string(const char *json, const char *key, char *out, size_t max_len)
+/* 1 = copied, 0 = key absent, -1 = value does not fit out (or is unterminated) */
+static AVP_HOT int json_find_string(const char *json, const char *key, char *out, size_t max_len)
 {
     char search[64];
     snprintf(search, sizeof(search), "\"%s\"", key);
 
     const char *pos = strstr(json, search);
-    if (!pos) return NULL;
+    if (!pos) return 0;
 
     /* Find the colon */
     pos = strchr(pos, ':');
-    if (!pos) return NULL;
+    if (!pos) return 0;
     pos++;
 
     /* Skip whitespace */
     while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') pos++;
 
     /* Check for string start */
-    if (*pos != '"') return NULL;
+    if (*pos != '"') return 0;
     pos++;
 
-    /* Copy until end quote */
+    /* Copy until end quote, never hand back a silently shortened value */
     size_t i = 0;
-    while (*pos && *pos != '"' && i < max_len - 1) {
+    while (*pos != '"') {
+        if (*pos == '\0' || i >= max_len - 1) {
+            out[0] = '\0';
+            return -1;
+        }
         out[i++] = *pos++;
     }
     out[i] = '\0';
 
-    return out;
+    return 1;
 }
 
-static int json_find_int(const char *json, const char *key, uint32_t *out)
+static AVP_HOT int json_find_int(const char *json, const char *key, uint32_t *out)
 {
     char search[64];
     snprintf(search, sizeof(search), "\"%s\"", key);
@@ -163,14 +235,14 @@ static int json_find_int(const char *json, const char *key, uint32_t *out)
     return 0;
 }
 
-avp_ret_t avp_parse_cmd(const char *json, avp_cmd_t *cmd)
+AVP_HOT avp_ret_t avp_parse_cmd(const char *json, avp_cmd_t *cmd)
 {
     memset(cmd, 0, sizeof(*cmd));
     cmd->ttl = AVP_DEFAULT_TTL;
 
     /* Parse operation */
     char op_str[32];
-    if (!json_find_string(json, "op", op_str, sizeof(op_str))) {
+    if (json_find_string(json, "op", op_str, sizeof(op_str)) <= 0) {
         return AVP_ERR_PARSE;
     }
 
@@ -194,26 +266,53 @@ avp_ret_t avp_parse_cmd(const char *json, avp_cmd_t *cmd)
         cmd->op = AVP_OP_HW_SIGN;
     } else if (strcmp(op_str, "HW_ATTEST") == 0) {
         cmd->op = AVP_OP_HW_ATTEST;
+    } else if (strcmp(op_str, "HW_SIGN_INIT") == 0) {
+        cmd->op = AVP_OP_HW_SIGN_INIT;
+    } else if (strcmp(op_str, "HW_SIGN_UPDATE") == 0) {
+        cmd->op = AVP_OP_HW_SIGN_UPDATE;
+    } else if (strcmp(op_str, "HW_SIGN_FINAL") == 0) {
+        cmd->op = AVP_OP_HW_SIGN_FINAL;
+    } else if (strcmp(op_str, "HW_KEYGEN") == 0) {
+        cmd->op = AVP_OP_HW_KEYGEN;
+    } else if (strcmp(op_str, "HW_KEYLIST") == 0) {
+        cmd->op = AVP_OP_HW_KEYLIST;
+    } else if (strcmp(op_str, "GET_RANDOM") == 0) {
+        cmd->op = AVP_OP_GET_RANDOM;
+    } else if (strcmp(op_str, "METRICS") == 0) {
+        cmd->op = AVP_OP_METRICS;
+    } else if (strcmp(op_str, "CLOCK") == 0) {
+        cmd->op = AVP_OP_CLOCK;
     } else {
         return AVP_ERR_INVALID_OP;
     }
 
-    /* Parse optional fields */
-    json_find_string(json, "session_id", cmd->session_id, sizeof(cmd->session_id));
-    json_find_string(json, "workspace", cmd->workspace, sizeof(cmd->workspace));
-    json_find_string(json, "name", cmd->name, sizeof(cmd->name));
-    json_find_string(json, "value", cmd->value, sizeof(cmd->value));
-    json_find_string(json, "auth_method", cmd->auth_method, sizeof(cmd->auth_method));
-    json_find_string(json, "pin", cmd->pin, sizeof(cmd->pin));
-    json_find_string(json, "key_name", cmd->key_name, sizeof(cmd->key_name));
+    /* Parse optional fields, an oversized value is an error, not a prefix */
+    if (json_find_string(json, "session_id", cmd->session_id, sizeof(cmd->session_id)) < 0 ||
+        json_find_string(json, "workspace", cmd->workspace, sizeof(cmd->workspace)) < 0 ||
+        json_find_string(json, "name", cmd->name, sizeof(cmd->name)) < 0 ||
+        json_find_string(json, "value", cmd->value, sizeof(cmd->value)) < 0 ||
+        json_find_string(json, "auth_method", cmd->auth_method, sizeof(cmd->auth_method)) < 0 ||
+        json_find_string(json, "pin", cmd->pin, sizeof(cmd->pin)) < 0 ||
+        json_find_string(json, "key_name", cmd->key_name, sizeof(cmd->key_name)) < 0 ||
+        json_find_string(json, "curve", cmd->curve, sizeof(cmd->curve)) < 0 ||
+        json_find_string(json, "profile", cmd->profile, sizeof(cmd->profile)) < 0) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+    json_find_int(json, "offset", &cmd->offset);
+    json_find_int(json, "length", &cmd->length);
     json_find_int(json, "ttl", &cmd->ttl);
     json_find_int(json, "requested_ttl", &cmd->ttl);
 
     /* Parse data field (hex encoded for HW_SIGN) */
-    char data_hex[512];
-    if (json_find_string(json, "data", data_hex, sizeof(data_hex))) {
+    char data_hex[sizeof(cmd->data) * 2 + 1];
+    int found = json_find_string(json, "data", data_hex, sizeof(data_hex));
+    if (found < 0) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+    if (found > 0) {
         int len = hex_decode(data_hex, cmd->data, sizeof(cmd->data));
-        if (len > 0) cmd->data_len = len;
+        if (len < 0) return AVP_ERR_INVALID_PARAM;
+        cmd->data_len = len;
     }
 
     return AVP_OK;
@@ -223,7 +322,40 @@ avp_ret_t avp_parse_cmd(const char *json, avp_cmd_t *cmd)
  * JSON Response Formatting
  *============================================================================*/
 
-avp_ret_t avp_format_resp(const avp_resp_t *resp, char *json, size_t len)
+static AVP_HOT int format_keylist(const avp_resp_t *resp, char *json, size_t len)
+{
+    const avp_key_index_t *idx = resp->hw_keylist.index;
+    char entry[192];
+    bool first = true;
+    int n, m;
+
+    n = snprintf(json, len, "{\"ok\":true,\"keys\":[");
+    for (uint32_t i = resp->hw_keylist.offset; i < AVP_MAX_KEYS; i++) {
+        const avp_key_meta_t *key = &idx->slots[i];
+
+        if (!key->in_use) {
+            continue;
+        }
+
+        m = snprintf(entry, sizeof(entry),
+            "%s{\"name\":\"%s\",\"slot\":%u,\"curve\":\"%s\","
+            "\"created_at\":%u,\"uses\":%u}",
+            first ? "" : ",", key->name, (unsigned)i,
+            avp_curve_str((avp_curve_t)key->curve),
+            key->created_at, key->sign_count);
+
+        /* Out of space: close the list and tell the host where to continue */
+        if (n + m + 16 >= (int)len) {
+            return n + snprintf(json + n, len - n, "],\"next\":%u}", (unsigned)i);
+        }
+        memcpy(json + n, entry, m + 1);
+        n += m;
+        first = false;
+    }
+    return n + snprintf(json + n, len - n, "]}");
+}
+
+AVP_HOT avp_ret_t avp_format_resp(const avp_resp_t *resp, char *json, size_t len)
 {
     int n;
 
@@ -286,10 +418,37 @@ avp_ret_t avp_format_resp(const avp_resp_t *resp, char *json, size_t len)
                 resp->hw_challenge.verified ? "true" : "false",
                 resp->hw_challenge.model,
                 resp->hw_challenge.serial);
+        } else if (resp->hw_sign.signature[0] && resp->hw_sign.digest[0]) {
+            n = snprintf(json, len,
+                "{\"ok\":true,\"signature\":\"%s\",\"digest\":\"%s\"}",
+                resp->hw_sign.signature,
+                resp->hw_sign.digest);
         } else if (resp->hw_sign.signature[0]) {
             n = snprintf(json, len,
                 "{\"ok\":true,\"signature\":\"%s\"}",
                 resp->hw_sign.signature);
+        } else if (resp->hw_sign.bytes > 0) {
+            n = snprintf(json, len,
+                "{\"ok\":true,\"bytes\":%u}",
+                resp->hw_sign.bytes);
+        } else if (resp->hw_keygen.key_name[0]) {
+            n = snprintf(json, len,
+                "{\"ok\":true,"
+                "\"key_name\":\"%s\","
+                "\"slot\":%u,"
+                "\"curve\":\"%s\","
+                "\"public_key\":\"%s\"}",
+                resp->hw_keygen.key_name,
+                resp->hw_keygen.slot,
+                avp_curve_str((avp_curve_t)resp->hw_keygen.curve),
+                resp->hw_keygen.public_key);
+        } else if (resp->hw_keylist.index) {
+            n = format_keylist(resp, json, len);
+        } else if (resp->get_random.random[0]) {
+            n = snprintf(json, len,
+                "{\"ok\":true,\"random\":\"%s\",\"remaining\":%u}",
+                resp->get_random.random,
+                resp->get_random.remaining);
         } else {
             n = snprintf(json, len, "{\"ok\":true}");
         }
@@ -313,10 +472,10 @@ avp_ret_t avp_op_discover(avp_ctx_t *ctx, avp_resp_t *resp)
     strncpy(resp->discover.manufacturer, AVP_MANUFACTURER, sizeof(resp->discover.manufacturer) - 1);
     strncpy(resp->discover.model, AVP_MODEL, sizeof(resp->discover.model) - 1);
 
-    /* Get actual serial from TROPIC01 */
+    /* Get actual serial from TROPIC01 (cached identity) */
     char serial[32] = "NC00000001";
     char fw_version[16] = {0};
-    avp_tropic_get_info(ctx, serial, fw_version);
+    avp_ret_t info_ret = avp_tropic_get_info(ctx, serial, fw_version);
     strncpy(resp->discover.serial, serial, sizeof(resp->discover.serial) - 1);
 
     resp->discover.supports_hw_sign = true;
@@ -324,6 +483,12 @@ avp_ret_t avp_op_discover(avp_ctx_t *ctx, avp_resp_t *resp)
     resp->discover.max_secrets = AVP_MAX_SECRETS;
     resp->discover.max_secret_size = 256;
 
+    /* Response never changes once the real identity is known, render it once */
+    if (info_ret == AVP_OK &&
+        avp_format_resp(resp, ctx->discover_json, sizeof(ctx->discover_json)) == AVP_OK) {
+        ctx->discover_len = (uint16_t)strlen(ctx->discover_json);
+    }
+
     return AVP_OK;
 }
 
@@ -350,8 +515,14 @@ avp_ret_t avp_op_authenticate(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *
     ctx->session.pin_attempts = 0;
 
     /* Create new session */
+    if (!generate_session_id(ctx, ctx->session.session_id)) {
+        avp_session_invalidate(ctx);
+        resp->ok = false;
+        resp->error_code = AVP_ERR_HARDWARE;
+        strncpy(resp->error_msg, "Entropy source failed", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_HARDWARE;
+    }
     ctx->session.active = true;
-    generate_session_id(ctx, ctx->session.session_id);
     strncpy(ctx->session.workspace, cmd->workspace[0] ? cmd->workspace : "default",
             sizeof(ctx->session.workspace) - 1);
     ctx->session.created_at = ctx->get_time();
@@ -517,7 +688,12 @@ avp_ret_t avp_op_hw_challenge(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *
 
     /* Generate challenge and get attestation signature */
     uint8_t challenge[32];
-    ctx->random_bytes(challenge, sizeof(challenge));
+    if (!ctx->random_bytes(challenge, sizeof(challenge))) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_HARDWARE;
+        strncpy(resp->error_msg, "Entropy source failed", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_HARDWARE;
+    }
 
     uint8_t response_sig[64];
     size_t sig_len = sizeof(response_sig);
@@ -546,19 +722,25 @@ avp_ret_t avp_op_hw_sign(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
         return AVP_ERR_NOT_AUTHENTICATED;
     }
 
-    /* Find key slot (0-31) - use first slot by default if not specified */
-    uint8_t key_slot = 0;
+    /* Find key slot (0-31) by name */
+    int key_slot = find_key_by_name(ctx, cmd->key_name, resp);
+    if (key_slot < 0) {
+        return resp->error_code;
+    }
 
-    /* Sign data with TROPIC01 ECDSA */
+    /* Sign data with TROPIC01 ECDSA / EdDSA */
     uint8_t signature[64];
     size_t sig_len = sizeof(signature);
-    avp_ret_t sign_ret = avp_tropic_sign(ctx, key_slot, cmd->data, cmd->data_len,
+    avp_ret_t sign_ret = avp_tropic_sign(ctx, (uint8_t)key_slot,
+                                          (avp_curve_t)ctx->keys.slots[key_slot].curve,
+                                          cmd->data, cmd->data_len,
                                           signature, &sig_len);
     if (sign_ret != AVP_OK) {
         resp->ok = false;
         resp->error_code = sign_ret;
         return sign_ret;
     }
+    avp_keys_touch(&ctx->keys, key_slot, ctx->get_time());
 
     /* Encode signature as hex */
     hex_encode(signature, sig_len, resp->hw_sign.signature);
@@ -592,13 +774,305 @@ avp_ret_t avp_op_hw_attest(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *res
     return AVP_OK;
 }
 
+/*
+ * A stream only continues in the session that opened it: a re-AUTHENTICATE
+ * drops it, and a command carrying another session ID cannot feed or finish
+ * it. Checked after avp_session_valid().
+ */
+static bool sign_stream_owned(avp_ctx_t *ctx, const avp_cmd_t *cmd)
+{
+    avp_sign_stream_t *stream = &ctx->sign_stream;
+
+    if (!stream->active) {
+        return false;
+    }
+    if (strcmp(stream->session_id, ctx->session.session_id) != 0) {
+        memset(stream, 0, sizeof(*stream));
+        return false;
+    }
+    return strcmp(cmd->session_id, stream->session_id) == 0;
+}
+
+avp_ret_t avp_op_hw_sign_init(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    avp_sign_stream_t *stream = &ctx->sign_stream;
+
+    /* Validate session */
+    if (!avp_session_valid(ctx)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_NOT_AUTHENTICATED;
+        return AVP_ERR_NOT_AUTHENTICATED;
+    }
+
+    int key_slot = find_key_by_name(ctx, cmd->key_name, resp);
+    if (key_slot < 0) {
+        return resp->error_code;
+    }
+
+    /* Ed25519 signs the message itself, not a digest */
+    if (ctx->keys.slots[key_slot].curve != AVP_CURVE_P256) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, "Streaming needs a P256 key", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    /* A new INIT silently drops any unfinished stream */
+    memset(stream, 0, sizeof(*stream));
+    stream->key_slot = (uint8_t)key_slot;
+    memcpy(stream->session_id, ctx->session.session_id, sizeof(stream->session_id));
+    avp_sha256_init(&stream->sha);
+    stream->active = true;
+
+    resp->ok = true;
+    return AVP_OK;
+}
+
+avp_ret_t avp_op_hw_sign_update(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    avp_sign_stream_t *stream = &ctx->sign_stream;
+
+    /* Validate session */
+    if (!avp_session_valid(ctx)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_NOT_AUTHENTICATED;
+        return AVP_ERR_NOT_AUTHENTICATED;
+    }
+
+    if (!sign_stream_owned(ctx, cmd) || cmd->data_len == 0) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, cmd->data_len == 0 ? "Missing data" : "No HW_SIGN_INIT",
+                sizeof(resp->error_msg) - 1);
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    avp_sha256_update(&stream->sha, cmd->data, cmd->data_len);
+
+    resp->ok = true;
+    resp->hw_sign.bytes = (uint32_t)stream->sha.total;
+    return AVP_OK;
+}
+
+avp_ret_t avp_op_hw_sign_final(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    avp_sign_stream_t *stream = &ctx->sign_stream;
+    uint8_t digest[AVP_SHA256_DIGEST_LEN];
+
+    /* Validate session */
+    if (!avp_session_valid(ctx)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_NOT_AUTHENTICATED;
+        return AVP_ERR_NOT_AUTHENTICATED;
+    }
+
+    if (!sign_stream_owned(ctx, cmd)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, "No HW_SIGN_INIT", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    avp_sha256_final(&stream->sha, digest);
+    stream->active = false;
+
+    /* Sign digest with TROPIC01 ECDSA, key selected at HW_SIGN_INIT */
+    uint8_t signature[64];
+    size_t sig_len = sizeof(signature);
+    avp_ret_t sign_ret = avp_tropic_sign_digest(ctx, stream->key_slot, digest,
+                                                 signature, &sig_len);
+    if (sign_ret != AVP_OK) {
+        resp->ok = false;
+        resp->error_code = sign_ret;
+        return sign_ret;
+    }
+    avp_keys_touch(&ctx->keys, stream->key_slot, ctx->get_time());
+
+    /* Encode signature and digest as hex */
+    hex_encode(signature, sig_len, resp->hw_sign.signature);
+    hex_encode(digest, sizeof(digest), resp->hw_sign.digest);
+
+    resp->ok = true;
+    return AVP_OK;
+}
+
+avp_ret_t avp_op_hw_keygen(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    avp_curve_t curve;
+
+    /* Validate session */
+    if (!avp_session_valid(ctx)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_NOT_AUTHENTICATED;
+        return AVP_ERR_NOT_AUTHENTICATED;
+    }
+
+    if (cmd->key_name[0] == '\0' || !avp_curve_parse(cmd->curve, &curve)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    int old_slot = avp_keys_find(&ctx->keys, cmd->key_name);
+    if (old_slot == AVP_KEY_SLOT_ATTEST) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        strncpy(resp->error_msg, "Attestation key cannot be replaced", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    uint8_t pubkey[64];
+    size_t pubkey_len = avp_curve_pubkey_len(curve);
+
+    /* Fast path: bind the name to a pre-generated spare key */
+    int key_slot = avp_keys_pool_take(&ctx->keys, curve, pubkey);
+    if (key_slot >= 0) {
+        ctx->keys.pool.hits++;
+        /* Rotated key's old slot is free again, the pool refill overwrites it */
+        if (old_slot >= 0) {
+            avp_keys_release(&ctx->keys, old_slot);
+        }
+    } else {
+        /* Pool empty: existing name rotates in place, otherwise take a free slot */
+        ctx->keys.pool.misses++;
+        key_slot = (old_slot >= 0) ? old_slot : avp_keys_alloc(&ctx->keys);
+        if (key_slot < 0) {
+            resp->ok = false;
+            resp->error_code = AVP_ERR_CAPACITY;
+            return AVP_ERR_CAPACITY;
+        }
+
+        pubkey_len = sizeof(pubkey);
+        avp_ret_t gen_ret = avp_tropic_key_generate(ctx, (uint8_t)key_slot, curve, pubkey, &pubkey_len);
+        if (gen_ret != AVP_OK) {
+            resp->ok = false;
+            resp->error_code = gen_ret;
+            return gen_ret;
+        }
+    }
+
+    /* A stream bound to the old key must not be signed with the new one */
+    if (ctx->sign_stream.active && old_slot >= 0 && ctx->sign_stream.key_slot == old_slot) {
+        ctx->sign_stream.active = false;
+    }
+    avp_keys_bind(&ctx->keys, key_slot, cmd->key_name, curve, ctx->get_time());
+
+    resp->ok = true;
+    strncpy(resp->hw_keygen.key_name, cmd->key_name, sizeof(resp->hw_keygen.key_name) - 1);
+    resp->hw_keygen.slot = (uint8_t)key_slot;
+    resp->hw_keygen.curve = (uint8_t)curve;
+    hex_encode(pubkey, pubkey_len, resp->hw_keygen.public_key);
+
+    return AVP_OK;
+}
+
+avp_ret_t avp_op_hw_keylist(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    /* Validate session */
+    if (!avp_session_valid(ctx)) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_NOT_AUTHENTICATED;
+        return AVP_ERR_NOT_AUTHENTICATED;
+    }
+
+    resp->ok = true;
+    resp->hw_keylist.index = &ctx->keys;
+    resp->hw_keylist.offset = cmd->offset;
+    return AVP_OK;
+}
+
+/* Next GET_RANDOM chunk straight from the entropy pool */
+static avp_ret_t random_chunk(avp_ctx_t *ctx, avp_resp_t *resp)
+{
+    uint8_t buf[AVP_RANDOM_CHUNK];
+    uint32_t n = (ctx->random_remaining < sizeof(buf)) ? ctx->random_remaining : sizeof(buf);
+
+    if (!ctx->random_bytes(buf, n)) {
+        ctx->random_remaining = 0;
+        resp->ok = false;
+        resp->error_code = AVP_ERR_HARDWARE;
+        strncpy(resp->error_msg, "Entropy source failed", sizeof(resp->error_msg) - 1);
+        return AVP_ERR_HARDWARE;
+    }
+    ctx->random_remaining -= n;
+
+    resp->ok = true;
+    hex_encode(buf, n, resp->get_random.random);
+    resp->get_random.remaining = ctx->random_remaining;
+    memset(buf, 0, n);
+    return AVP_OK;
+}
+
+avp_ret_t avp_op_get_random(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
+{
+    if (cmd->length == 0 || cmd->length > AVP_MAX_RANDOM_LEN) {
+        resp->ok = false;
+        resp->error_code = AVP_ERR_INVALID_PARAM;
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    ctx->random_remaining = cmd->length;
+    return random_chunk(ctx, resp);
+}
+
+/*============================================================================
+ * Background Work
+ *============================================================================*/
+
+avp_ret_t avp_key_pool_refill(avp_ctx_t *ctx)
+{
+    avp_curve_t curve;
+    uint8_t pubkey[64];
+    size_t pubkey_len = sizeof(pubkey);
+
+    int slot = avp_keys_pool_want(&ctx->keys, &curve);
+    if (slot < 0) {
+        return AVP_ERR_CAPACITY;
+    }
+
+    avp_ret_t ret = avp_tropic_key_generate(ctx, (uint8_t)slot, curve, pubkey, &pubkey_len);
+    if (ret != AVP_OK) {
+        return ret;
+    }
+
+    avp_keys_pool_put(&ctx->keys, slot, curve, pubkey);
+    return AVP_OK;
+}
+
+avp_ret_t avp_key_slots_scan(avp_ctx_t *ctx)
+{
+    avp_ret_t result = AVP_OK;
+    avp_curve_t curve;
+    uint8_t pubkey[64];
+    size_t pubkey_len;
+
+    for (int slot = 0; slot < AVP_MAX_KEYS; slot++) {
+        const avp_key_meta_t *key = &ctx->keys.slots[slot];
+
+        if (slot == AVP_KEY_SLOT_ATTEST || key->in_use || key->pooled ||
+            avp_keys_is_free(&ctx->keys, slot)) {
+            continue;
+        }
+
+        /* A key we have no record of stays untouched */
+        pubkey_len = sizeof(pubkey);
+        avp_ret_t ret = avp_tropic_key_read(ctx, (uint8_t)slot, &curve, pubkey, &pubkey_len);
+        if (ret == AVP_ERR_KEY_NOT_FOUND) {
+            avp_keys_set_free(&ctx->keys, slot);
+        } else if (ret != AVP_OK) {
+            result = ret;
+        }
+    }
+    return result;
+}
+
 /*============================================================================
  * Main API
  *============================================================================*/
 
 avp_ret_t avp_init(avp_ctx_t *ctx, void *tropic,
                    uint32_t (*get_time)(void),
-                   void (*rng)(uint8_t *, size_t))
+                   bool (*rng)(uint8_t *, size_t))
 {
     if (!ctx || !get_time || !rng) {
         return AVP_ERR_INVALID_PARAM;
@@ -608,6 +1082,7 @@ avp_ret_t avp_init(avp_ctx_t *ctx, void *tropic,
     ctx->tropic_handle = tropic;
     ctx->get_time = get_time;
     ctx->random_bytes = rng;
+    avp_keys_init(&ctx->keys);
 
     return AVP_OK;
 }
@@ -635,63 +1110,176 @@ void avp_session_invalidate(avp_ctx_t *ctx)
     memset(ctx->session.session_id, 0, sizeof(ctx->session.session_id));
 }
 
+static uint32_t avp_cycles(const avp_ctx_t *ctx)
+{
+    return ctx->cycles ? ctx->cycles() : 0;
+}
+
 avp_ret_t avp_process(avp_ctx_t *ctx, const char *json_in,
                       char *json_out, size_t out_len)
 {
-    avp_cmd_t cmd;
-    avp_resp_t resp;
+    avp_cmd_t *cmd;
+    avp_resp_t *resp;
     avp_ret_t ret;
+    uint32_t start;
+    uint32_t parsed;
+    uint32_t done;
+
+    /* Any new command ends an unfinished multi-line response */
+    ctx->random_remaining = 0;
+    ctx->metrics_line = 0;
 
-    memset(&resp, 0, sizeof(resp));
+    /* Command and response live in the caller's per-request work area */
+    if (ctx->work == NULL) {
+        return AVP_ERR_INTERNAL;
+    }
+    cmd = &ctx->work->cmd;
+    resp = &ctx->work->resp;
 
     /* Parse input JSON */
-    ret = avp_parse_cmd(json_in, &cmd);
+    start = avp_cycles(ctx);
+    ret = avp_parse_cmd(json_in, cmd);
+    parsed = avp_cycles(ctx);
+
+    memset(&ctx->timing, 0, sizeof(ctx->timing));
+    ctx->timing.op = (ret == AVP_OK) ? cmd->op : AVP_OP_UNKNOWN;
+    ctx->timing.parse = parsed - start;
+    done = parsed;
+
+    /* DISCOVER is served from the pre-rendered response (no SPI traffic) */
+    if (ret == AVP_OK && cmd->op == AVP_OP_DISCOVER && ctx->discover_len > 0) {
+        if (ctx->discover_len >= out_len) {
+            return AVP_ERR_INTERNAL;
+        }
+        memcpy(json_out, ctx->discover_json, ctx->discover_len + 1);
+        ctx->timing.format = avp_cycles(ctx) - parsed;
+        return AVP_OK;
+    }
+
+    /* METRICS lines are rendered by the firmware, the rest by avp_process_next() */
+    if (ret == AVP_OK && cmd->op == AVP_OP_METRICS && ctx->metrics != NULL) {
+        if (!ctx->metrics(0, json_out, out_len)) {
+            return AVP_ERR_INTERNAL;
+        }
+        ctx->metrics_line = 1;
+        ctx->timing.format = avp_cycles(ctx) - parsed;
+        return AVP_OK;
+    }
+
+    memset(resp, 0, sizeof(*resp));
+
     if (ret != AVP_OK) {
-        resp.ok = false;
-        resp.error_code = ret;
+        resp->ok = false;
+        resp->error_code = ret;
+        goto format_response;
+    }
+
+    /* CLOCK is answered by the firmware, errors are formatted here */
+    if (cmd->op == AVP_OP_CLOCK && ctx->clock != NULL) {
+        ret = ctx->clock(cmd->profile, json_out, out_len);
+        done = avp_cycles(ctx);
+        ctx->timing.exec = done - parsed;
+        if (ret == AVP_OK) {
+            return AVP_OK;
+        }
+        resp->ok = false;
+        resp->error_code = ret;
         goto format_response;
     }
 
     /* Execute operation */
-    switch (cmd.op) {
+    switch (cmd->op) {
         case AVP_OP_DISCOVER:
-            ret = avp_op_discover(ctx, &resp);
+            ret = avp_op_discover(ctx, resp);
             break;
         case AVP_OP_AUTHENTICATE:
-            ret = avp_op_authenticate(ctx, &cmd, &resp);
+            ret = avp_op_authenticate(ctx, cmd, resp);
             break;
         case AVP_OP_STORE:
-            ret = avp_op_store(ctx, &cmd, &resp);
+            ret = avp_op_store(ctx, cmd, resp);
             break;
         case AVP_OP_RETRIEVE:
-            ret = avp_op_retrieve(ctx, &cmd, &resp);
+            ret = avp_op_retrieve(ctx, cmd, resp);
             break;
         case AVP_OP_DELETE:
-            ret = avp_op_delete(ctx, &cmd, &resp);
+            ret = avp_op_delete(ctx, cmd, resp);
             break;
         case AVP_OP_LIST:
-            ret = avp_op_list(ctx, &cmd, &resp);
+            ret = avp_op_list(ctx, cmd, resp);
             break;
         case AVP_OP_ROTATE:
-            ret = avp_op_rotate(ctx, &cmd, &resp);
+            ret = avp_op_rotate(ctx, cmd, resp);
             break;
         case AVP_OP_HW_CHALLENGE:
-            ret = avp_op_hw_challenge(ctx, &cmd, &resp);
+            ret = avp_op_hw_challenge(ctx, cmd, resp);
             break;
         case AVP_OP_HW_SIGN:
-            ret = avp_op_hw_sign(ctx, &cmd, &resp);
+            ret = avp_op_hw_sign(ctx, cmd, resp);
             break;
         case AVP_OP_HW_ATTEST:
-            ret = avp_op_hw_attest(ctx, &cmd, &resp);
+            ret = avp_op_hw_attest(ctx, cmd, resp);
+            break;
+        case AVP_OP_HW_SIGN_INIT:
+            ret = avp_op_hw_sign_init(ctx, cmd, resp);
+            break;
+        case AVP_OP_HW_SIGN_UPDATE:
+            ret = avp_op_hw_sign_update(ctx, cmd, resp);
+            break;
+        case AVP_OP_HW_SIGN_FINAL:
+            ret = avp_op_hw_sign_final(ctx, cmd, resp);
+            break;
+        case AVP_OP_HW_KEYGEN:
+            ret = avp_op_hw_keygen(ctx, cmd, resp);
+            break;
+        case AVP_OP_HW_KEYLIST:
+            ret = avp_op_hw_keylist(ctx, cmd, resp);
+            break;
+        case AVP_OP_GET_RANDOM:
+            ret = avp_op_get_random(ctx, cmd, resp);
             break;
         default:
-            resp.ok = false;
-            resp.error_code = AVP_ERR_INVALID_OP;
+            resp->ok = false;
+            resp->error_code = AVP_ERR_INVALID_OP;
             ret = AVP_ERR_INVALID_OP;
             break;
     }
+    done = avp_cycles(ctx);
+    ctx->timing.exec = done - parsed;
 
 format_response:
     /* Format output JSON */
-    return avp_format_resp(&resp, json_out, out_len);
+    ret = avp_format_resp(resp, json_out, out_len);
+    ctx->timing.format = avp_cycles(ctx) - done;
+    return ret;
+}
+
+bool avp_process_next(avp_ctx_t *ctx, char *json_out, size_t out_len)
+{
+    avp_resp_t *resp;
+
+    if (ctx->metrics_line > 0) {
+        if (ctx->metrics(ctx->metrics_line, json_out, out_len)) {
+            ctx->metrics_line++;
+            return true;
+        }
+        ctx->metrics_line = 0;
+        return false;
+    }
+
+    if (ctx->random_remaining == 0) {
+        return false;
+    }
+
+    if (ctx->work == NULL) {
+        ctx->random_remaining = 0;
+        return false;
+    }
+    resp = &ctx->work->resp;
+    memset(resp, 0, sizeof(*resp));
+    random_chunk(ctx, resp);
+    if (avp_format_resp(resp, json_out, out_len) != AVP_OK) {
+        ctx->random_remaining = 0;
+        return false;
+    }
+    return true;
 }
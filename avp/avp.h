@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "avp_sha256.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +25,15 @@ extern "C" {
  * Configuration
  *============================================================================*/
 
+/** Hot path placement: the firmware's PROFILE=perf build runs these from SRAM */
+#ifndef AVP_HOT
+#if defined(PROFILE_PERF) && (PROFILE_PERF == 1)
+#define AVP_HOT                 __attribute__((section(".RamFunc")))
+#else
+#define AVP_HOT
+#endif
+#endif
+
 /** Maximum length of AVP command/response JSON */
 #define AVP_MAX_JSON_LEN        1024
 
@@ -42,6 +52,30 @@ extern "C" {
 /** Session ID length */
 #define AVP_SESSION_ID_LEN      32
 
+/** Number of TROPIC01 ECC key slots tracked by the key index */
+#define AVP_MAX_KEYS            32
+
+/** Key name hash buckets (power of two) */
+#define AVP_KEY_BUCKETS         32
+
+/** ECC slot of the device attestation key */
+#define AVP_KEY_SLOT_ATTEST     0
+
+/** Maximum pre-generated spare keys (all curves together) */
+#define AVP_KEY_POOL_MAX        8
+
+/** Spare P256 keys kept ready by default */
+#define AVP_KEY_POOL_DEFAULT    2
+
+/** Maximum bytes per GET_RANDOM request */
+#define AVP_MAX_RANDOM_LEN      65536
+
+/** Random bytes per GET_RANDOM response line (hex encoded, fits AVP_MAX_JSON_LEN) */
+#define AVP_RANDOM_CHUNK        448
+
+/** Maximum length of the pre-rendered DISCOVER response */
+#define AVP_DISCOVER_JSON_LEN   384
+
 /*============================================================================
  * Return Codes
  *============================================================================*/
@@ -60,6 +94,7 @@ typedef enum {
     AVP_ERR_PIN_INVALID,        /**< Wrong PIN */
     AVP_ERR_PIN_LOCKED,         /**< Too many failed attempts */
     AVP_ERR_INTERNAL,           /**< Internal error */
+    AVP_ERR_KEY_NOT_FOUND,      /**< Signing key does not exist */
 } avp_ret_t;
 
 /*============================================================================
@@ -78,8 +113,23 @@ typedef enum {
     AVP_OP_HW_CHALLENGE,
     AVP_OP_HW_SIGN,
     AVP_OP_HW_ATTEST,
+    AVP_OP_HW_SIGN_INIT,
+    AVP_OP_HW_SIGN_UPDATE,
+    AVP_OP_HW_SIGN_FINAL,
+    AVP_OP_HW_KEYGEN,
+    AVP_OP_HW_KEYLIST,
+    AVP_OP_GET_RANDOM,
+    AVP_OP_METRICS,
+    AVP_OP_CLOCK,
+    AVP_OP_COUNT                /**< Number of op codes */
 } avp_op_t;
 
+/** ECC key curve */
+typedef enum {
+    AVP_CURVE_P256 = 0,
+    AVP_CURVE_ED25519,
+} avp_curve_t;
+
 /*============================================================================
  * Data Structures
  *============================================================================*/
@@ -103,6 +153,69 @@ typedef struct {
     uint8_t pin_attempts;                          /**< Failed PIN attempts */
 } avp_session_t;
 
+/** ECC key metadata, indexed by TROPIC01 ECC slot */
+typedef struct {
+    char name[AVP_MAX_NAME_LEN];        /**< Key name */
+    uint8_t curve;                      /**< avp_curve_t */
+    bool in_use;                        /**< Slot holds a named key */
+    bool pooled;                        /**< Slot holds a spare pre-generated key */
+    int8_t next;                        /**< Next slot in hash bucket, -1 = end */
+    uint32_t created_at;                /**< Key generation timestamp */
+    uint32_t last_used;                 /**< Last signature timestamp */
+    uint32_t sign_count;                /**< Signatures made with this key */
+} avp_key_meta_t;
+
+/** Pre-generated spare key */
+typedef struct {
+    uint8_t slot;                       /**< ECC slot */
+    uint8_t curve;                      /**< avp_curve_t */
+    uint8_t pubkey[64];                 /**< Public key read at generation */
+} avp_spare_key_t;
+
+/** Spare key pool, refilled in the background */
+typedef struct {
+    avp_spare_key_t keys[AVP_KEY_POOL_MAX]; /**< Ready keys */
+    uint8_t count;                      /**< Ready keys, all curves */
+    uint8_t target[2];                  /**< Ready keys wanted per avp_curve_t */
+    uint32_t hits;                      /**< HW_KEYGEN served from the pool */
+    uint32_t misses;                    /**< HW_KEYGEN generated inline */
+} avp_key_pool_t;
+
+/** Key name index: slot table plus name hash buckets */
+typedef struct {
+    avp_key_meta_t slots[AVP_MAX_KEYS]; /**< Metadata by ECC slot */
+    int8_t buckets[AVP_KEY_BUCKETS];    /**< First slot per bucket, -1 = empty */
+    uint8_t count;                      /**< Named keys */
+    uint32_t free;                      /**< Slots read back empty or released, bit per slot */
+    uint32_t dirty;                     /**< Slots named, released or pooled since the last save */
+    uint32_t touched;                   /**< Slots signed with since the last save */
+    avp_key_pool_t pool;                /**< Spare keys */
+} avp_key_index_t;
+
+/** Streaming HW_SIGN state (HW_SIGN_INIT/UPDATE/FINAL) */
+typedef struct {
+    bool active;                        /**< Stream started */
+    uint8_t key_slot;                   /**< Key selected at HW_SIGN_INIT */
+    char session_id[AVP_SESSION_ID_LEN + 1]; /**< Session that sent HW_SIGN_INIT */
+    avp_sha256_t sha;                   /**< Running message hash */
+} avp_sign_stream_t;
+
+/** Stage cycle counts of the last avp_process() */
+typedef struct {
+    avp_op_t op;                /**< Operation, AVP_OP_UNKNOWN when parsing failed */
+    uint32_t parse;             /**< JSON request to command */
+    uint32_t exec;              /**< Operation handler, SE exchanges included */
+    uint32_t format;            /**< Command result to JSON response */
+} avp_timing_t;
+
+/** Renders METRICS response line n, false when there is no such line */
+typedef bool (*avp_metrics_t)(unsigned int line, char *json, size_t len);
+
+/** Applies the CLOCK profile ("" = query only) and renders the response */
+typedef avp_ret_t (*avp_clock_t)(const char *profile, char *json, size_t len);
+
+struct avp_work;
+
 /** AVP context */
 typedef struct {
     avp_session_t session;                          /**< Current session */
@@ -110,7 +223,18 @@ typedef struct {
     uint8_t secret_count;                          /**< Number of stored secrets */
     void *tropic_handle;                           /**< TROPIC01 device handle */
     uint32_t (*get_time)(void);                    /**< Get current timestamp */
-    void (*random_bytes)(uint8_t *, size_t);       /**< Random number generator */
+    bool (*random_bytes)(uint8_t *, size_t);       /**< Random number generator, false on failure */
+    char discover_json[AVP_DISCOVER_JSON_LEN];     /**< Pre-rendered DISCOVER response */
+    uint16_t discover_len;                         /**< discover_json length, 0 = not rendered */
+    avp_sign_stream_t sign_stream;                 /**< Streaming HW_SIGN state */
+    avp_key_index_t keys;                          /**< ECC key name index */
+    uint32_t random_remaining;                     /**< GET_RANDOM bytes still to send */
+    uint32_t (*cycles)(void);                      /**< Cycle counter for timing, NULL = none */
+    avp_timing_t timing;                           /**< Stage timing of the last request */
+    avp_metrics_t metrics;                         /**< METRICS renderer, NULL = op not supported */
+    unsigned int metrics_line;                     /**< Next METRICS line, 0 = none pending */
+    avp_clock_t clock;                             /**< CLOCK handler, NULL = op not supported */
+    struct avp_work *work;                         /**< Per-request work area, set by the caller */
 } avp_ctx_t;
 
 /** Command structure (parsed from JSON) */
@@ -123,8 +247,12 @@ typedef struct {
     char auth_method[16];                   /**< "pin" */
     char pin[16];                           /**< PIN value */
     uint32_t ttl;                           /**< Session TTL */
-    char key_name[AVP_MAX_NAME_LEN];        /**< Key name for HW_SIGN */
-    uint8_t data[256];                      /**< Data for HW_SIGN */
+    char key_name[AVP_MAX_NAME_LEN];        /**< Key name for HW_SIGN / HW_KEYGEN */
+    char curve[16];                         /**< "P256" or "Ed25519" (HW_KEYGEN) */
+    uint32_t offset;                        /**< First entry to list (HW_KEYLIST) */
+    uint32_t length;                        /**< Bytes wanted (GET_RANDOM) */
+    char profile[8];                        /**< Clock profile (CLOCK), empty = query */
+    uint8_t data[256];                      /**< Data for HW_SIGN / HW_SIGN_UPDATE chunk */
     size_t data_len;                        /**< Data length */
 } avp_cmd_t;
 
@@ -168,23 +296,57 @@ typedef struct {
     /* HW_CHALLENGE response */
     struct {
         char challenge[64];
-        char response_sig[128];
+        char response_sig[129];
         bool verified;
         char model[32];
         char serial[32];
     } hw_challenge;
 
-    /* HW_SIGN response */
+    /* HW_SIGN / HW_SIGN_UPDATE / HW_SIGN_FINAL response */
     struct {
-        char signature[128];
+        char signature[129];
+        char digest[AVP_SHA256_DIGEST_LEN * 2 + 1];    /**< FINAL only */
+        uint32_t bytes;                                 /**< UPDATE: bytes hashed so far */
     } hw_sign;
 
+    /* HW_KEYGEN response */
+    struct {
+        char key_name[AVP_MAX_NAME_LEN];
+        uint8_t slot;
+        uint8_t curve;
+        char public_key[129];
+    } hw_keygen;
+
+    /* HW_KEYLIST response (entries rendered straight from the index) */
+    struct {
+        const avp_key_index_t *index;
+        uint32_t offset;
+    } hw_keylist;
+
+    /* GET_RANDOM response (one line per chunk) */
+    struct {
+        char random[AVP_RANDOM_CHUNK * 2 + 1];
+        uint32_t remaining;
+    } get_random;
+
     /* HW_ATTEST response */
     struct {
         char attestation[512];
     } hw_attest;
 } avp_resp_t;
 
+/**
+ * Per-request work area (about 6 KB)
+ *
+ * The caller points ctx->work at it before avp_process() and keeps it
+ * until the last avp_process_next() line, so it can be reused between
+ * requests (scratch arena) instead of sitting on the stack.
+ */
+typedef struct avp_work {
+    avp_cmd_t cmd;                          /**< Parsed request */
+    avp_resp_t resp;                        /**< Response being rendered */
+} avp_work_t;
+
 /*============================================================================
  * API Functions
  *============================================================================*/
@@ -195,16 +357,18 @@ typedef struct {
  * @param ctx       AVP context to initialize
  * @param tropic    TROPIC01 device handle
  * @param get_time  Function to get current timestamp
- * @param rng       Function to generate random bytes
+ * @param rng       Function to generate random bytes (false on failure)
  * @return AVP_OK on success
  */
 avp_ret_t avp_init(avp_ctx_t *ctx, void *tropic,
                    uint32_t (*get_time)(void),
-                   void (*rng)(uint8_t *, size_t));
+                   bool (*rng)(uint8_t *, size_t));
 
 /**
  * @brief Process an AVP JSON command
  *
+ * Needs ctx->work, returns AVP_ERR_INTERNAL without it.
+ *
  * @param ctx       AVP context
  * @param json_in   Input JSON command string
  * @param json_out  Output buffer for JSON response
@@ -214,6 +378,41 @@ avp_ret_t avp_init(avp_ctx_t *ctx, void *tropic,
 avp_ret_t avp_process(avp_ctx_t *ctx, const char *json_in,
                       char *json_out, size_t out_len);
 
+/**
+ * @brief Render the next line of a multi-line response (GET_RANDOM, METRICS)
+ *
+ * Call after avp_process() until it returns false.
+ *
+ * @param ctx       AVP context
+ * @param json_out  Output buffer for JSON response
+ * @param out_len   Size of output buffer
+ * @return true when a line was rendered
+ */
+bool avp_process_next(avp_ctx_t *ctx, char *json_out, size_t out_len);
+
+/**
+ * @brief Generate one spare key if the pool is below target
+ *
+ * Called from the main loop when the device is idle.
+ *
+ * @param ctx       AVP context
+ * @return AVP_OK when a key was added, AVP_ERR_CAPACITY when there is
+ *         nothing to do, other codes on TROPIC01 failure
+ */
+avp_ret_t avp_key_pool_refill(avp_ctx_t *ctx);
+
+/**
+ * @brief Find the ECC slots that hold no key
+ *
+ * Until a slot is read back empty it may hold a key the firmware does not
+ * know about (created by the host or before a reset), so it is never handed
+ * out or erased. Called after avp_tropic_init() and again while it fails.
+ *
+ * @param ctx       AVP context
+ * @return AVP_OK when every unknown slot was read
+ */
+avp_ret_t avp_key_slots_scan(avp_ctx_t *ctx);
+
 /**
  * @brief Check if current session is valid
  *
@@ -293,6 +492,36 @@ avp_ret_t avp_op_hw_sign(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp)
  */
 avp_ret_t avp_op_hw_attest(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
 
+/**
+ * @brief Execute HW_KEYGEN operation (generate or rotate a named key)
+ */
+avp_ret_t avp_op_hw_keygen(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
+/**
+ * @brief Execute HW_KEYLIST operation
+ */
+avp_ret_t avp_op_hw_keylist(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
+/**
+ * @brief Execute GET_RANDOM operation (first chunk, rest via avp_process_next)
+ */
+avp_ret_t avp_op_get_random(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
+/**
+ * @brief Execute HW_SIGN_INIT operation (start streaming hash-then-sign)
+ */
+avp_ret_t avp_op_hw_sign_init(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
+/**
+ * @brief Execute HW_SIGN_UPDATE operation (hash one data chunk)
+ */
+avp_ret_t avp_op_hw_sign_update(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
+/**
+ * @brief Execute HW_SIGN_FINAL operation (sign the digest in TROPIC01)
+ */
+avp_ret_t avp_op_hw_sign_final(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *resp);
+
 /*============================================================================
  * Error Strings
  *============================================================================*/
@@ -302,6 +531,11 @@ avp_ret_t avp_op_hw_attest(avp_ctx_t *ctx, const avp_cmd_t *cmd, avp_resp_t *res
  */
 const char *avp_error_str(avp_ret_t err);
 
+/**
+ * @brief Get operation name as used in the "op" field
+ */
+const char *avp_op_str(avp_op_t op);
+
 #ifdef __cplusplus
 }
 #endif
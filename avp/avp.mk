@@ -9,7 +9,12 @@ AVP_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
 
 AVP_SRC := \
 	$(AVP_DIR)avp.c \
-	$(AVP_DIR)avp_cmd.c
+	$(AVP_DIR)avp_cmd.c \
+	$(AVP_DIR)avp_der.c \
+	$(AVP_DIR)avp_drbg.c \
+	$(AVP_DIR)avp_entropy.c \
+	$(AVP_DIR)avp_keys.c \
+	$(AVP_DIR)avp_sha256.c
 
 AVP_INC := \
 	-I$(AVP_DIR)
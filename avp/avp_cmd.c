@@ -10,15 +10,180 @@
 #include "avp.h"
 #include "avp_hw.h"
 #include "avp_tropic.h"
+#include "avp_keys.h"
 #include "os.h"
+#include "time.h"
+#include "metrics.h"
+#include "scratch.h"
+#include "nvm.h"
 #include <string.h>
 
+#if NVM_KEY_NAME_LEN != AVP_MAX_NAME_LEN
+#error "nvm_key_t name must hold a key name"
+#endif
+
+/* Background work starts once the host has been quiet for a while */
+#define AVP_IDLE_QUIET_US       (200 * TIMER_MS)
+#define AVP_IDLE_NEXT_US        (10 * TIMER_MS)
+#define AVP_IDLE_CHECK_US       (100 * TIMER_MS)
+#define AVP_IDLE_BACKOFF_US     (5000 * TIMER_MS)
+
+/* TROPIC01 TRNG output mixed into the entropy pool this often */
+#define AVP_IDLE_TRNG_US        (60000 * TIMER_MS)
+
+/* Sign counters alone are written to flash at most this often */
+#define AVP_IDLE_KEYS_SAVE_US   (600000 * TIMER_MS)
+
 /*============================================================================
  * Static Variables
  *============================================================================*/
 
 static avp_ctx_t avp_ctx;
-static char avp_response[AVP_MAX_JSON_LEN];
+static uint64_t avp_last_cmd;
+static uint64_t avp_idle_next;
+static uint64_t avp_trng_next;
+static bool avp_slots_known;
+static uint64_t avp_keys_save_next;
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+/* One response line to the port the request came from */
+static void avp_cmd_reply(avp_cmd_out_t out, const char *text)
+{
+    if (out == NULL) {
+        OS_PRINTF("%s\r\n", text);
+        return;
+    }
+    out(text);
+    out("\r\n");
+}
+
+/* Second, independent noise source for the next entropy pool reseed */
+static void avp_cmd_mix_tropic(void)
+{
+    uint8_t trng[32];
+
+    if (avp_tropic_random(&avp_ctx, trng, sizeof(trng)) == AVP_OK) {
+        avp_hw_entropy_mix(trng, sizeof(trng));
+    }
+    memset(trng, 0, sizeof(trng));
+    avp_trng_next = timer_get_time() + AVP_IDLE_TRNG_US;
+}
+
+/* Flash record of one key slot, as the index has it now */
+static void avp_cmd_key_record(int slot, nvm_key_t *rec)
+{
+    const avp_key_index_t *idx = &avp_ctx.keys;
+    const avp_key_meta_t *key = &idx->slots[slot];
+
+    memset(rec, 0, sizeof(*rec));
+    rec->slot = (uint8_t)slot;
+    rec->state = NVM_KEY_FREE;
+
+    if (key->in_use) {
+        rec->state = NVM_KEY_NAMED;
+        rec->curve = key->curve;
+        rec->created_at = key->created_at;
+        rec->last_used = key->last_used;
+        rec->sign_count = key->sign_count;
+        memcpy(rec->name, key->name, sizeof(rec->name));
+    } else if (key->pooled) {
+        rec->state = NVM_KEY_POOLED;
+    }
+}
+
+/* Full page: start over with every slot whose state is known */
+static bool avp_cmd_keys_rewrite(void)
+{
+    const avp_key_index_t *idx = &avp_ctx.keys;
+    nvm_key_t rec;
+
+    if (!nvm_key_erase()) {
+        return false;
+    }
+    for (int slot = 0; slot < AVP_MAX_KEYS; slot++) {
+        if (slot == AVP_KEY_SLOT_ATTEST) {
+            continue;
+        }
+        if (idx->slots[slot].in_use || idx->slots[slot].pooled || avp_keys_is_free(idx, slot)) {
+            avp_cmd_key_record(slot, &rec);
+            if (!nvm_key_save(&rec)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Changed key slots to flash, false leaves them flagged for a retry */
+static bool avp_cmd_keys_save(void)
+{
+    avp_key_index_t *idx = &avp_ctx.keys;
+    uint32_t mask = (idx->dirty | idx->touched) & ~(1u << AVP_KEY_SLOT_ATTEST);
+    nvm_key_t rec;
+    bool ok = true;
+
+    for (int slot = 0; slot < AVP_MAX_KEYS && ok; slot++) {
+        if (mask & (1u << slot)) {
+            avp_cmd_key_record(slot, &rec);
+            ok = nvm_key_save(&rec);
+        }
+    }
+    if (!ok) {
+        ok = avp_cmd_keys_rewrite();
+    }
+    if (ok) {
+        idx->dirty = 0;
+        idx->touched = 0;
+    }
+    avp_keys_save_next = timer_get_time() + AVP_IDLE_KEYS_SAVE_US;
+    return ok;
+}
+
+/* Key index from flash, spare keys get their public key back from TROPIC01 */
+static void avp_cmd_keys_load(void)
+{
+    avp_key_index_t *idx = &avp_ctx.keys;
+    avp_curve_t curve;
+    uint8_t pubkey[64];
+    size_t pubkey_len;
+    avp_ret_t ret;
+
+    for (int slot = 0; slot < AVP_MAX_KEYS; slot++) {
+        const nvm_key_t *rec = nvm_key_find((uint8_t)slot);
+
+        if (rec == NULL || slot == AVP_KEY_SLOT_ATTEST) {
+            continue;
+        }
+
+        switch (rec->state) {
+            case NVM_KEY_NAMED:
+                avp_keys_bind(idx, slot, rec->name, (avp_curve_t)rec->curve, rec->created_at);
+                idx->slots[slot].last_used = rec->last_used;
+                idx->slots[slot].sign_count = rec->sign_count;
+                break;
+            case NVM_KEY_POOLED:
+                pubkey_len = sizeof(pubkey);
+                ret = avp_tropic_key_read(&avp_ctx, (uint8_t)slot, &curve, pubkey, &pubkey_len);
+                if (ret == AVP_OK && idx->pool.count < AVP_KEY_POOL_MAX) {
+                    avp_keys_pool_put(idx, slot, curve, pubkey);
+                } else if (ret == AVP_ERR_KEY_NOT_FOUND) {
+                    avp_keys_set_free(idx, slot);
+                }
+                /* Unreadable: left unknown, avp_key_slots_scan() never erases it */
+                break;
+            default:
+                avp_keys_set_free(idx, slot);
+                break;
+        }
+    }
+
+    /* Flash already has all of it */
+    idx->dirty = 0;
+    idx->touched = 0;
+}
 
 /*============================================================================
  * Public API
@@ -31,6 +196,7 @@ void avp_cmd_init(void)
 
     /* Initialize AVP context */
     avp_init(&avp_ctx, NULL, avp_hw_get_time, avp_hw_random_bytes);
+    avp_ctx.cycles = metrics_cycles;
 
     /* Initialize TROPIC01 secure element */
     avp_ret_t tropic_ret = avp_tropic_init(&avp_ctx);
@@ -38,6 +204,14 @@ void avp_cmd_init(void)
         OS_PRINTF("# WARNING: TROPIC01 init failed (%d)\r\n", tropic_ret);
     }
 
+    avp_cmd_mix_tropic();
+
+    /* Named keys survive a reset, the rest of the slots are read back */
+    avp_cmd_keys_load();
+
+    /* No key slot is handed out before it has been read back empty */
+    avp_slots_known = (avp_key_slots_scan(&avp_ctx) == AVP_OK);
+
     OS_PRINTF("# AVP Protocol v%s initialized\r\n", "0.1.0");
     OS_PRINTF("# NexusClaw ready\r\n");
 }
@@ -53,18 +227,133 @@ bool avp_cmd_is_avp(const char *data)
     return (*data == '{');
 }
 
-void avp_cmd_process(const char *data)
+void avp_cmd_process(const char *data, avp_cmd_out_t out)
 {
+    uint32_t start = metrics_cycles();
+    char *response;
     avp_ret_t ret;
 
+    /* Work area and response line come from the request scratch arena */
+    avp_ctx.work = scratch_alloc(sizeof(avp_work_t));
+    response = scratch_alloc(AVP_MAX_JSON_LEN);
+    if ((avp_ctx.work == NULL) || (response == NULL)) {
+        avp_ctx.work = NULL;
+        scratch_reset();
+        avp_cmd_reply(out, "{\"ok\":false,\"error\":\"INTERNAL_ERROR\"}");
+        return;
+    }
+
     /* Process the command */
-    ret = avp_process(&avp_ctx, data, avp_response, sizeof(avp_response));
+    ret = avp_process(&avp_ctx, data, response, AVP_MAX_JSON_LEN);
+
+    /* A key name is in flash before the host learns about it */
+    if (avp_ctx.keys.dirty != 0) {
+        avp_cmd_keys_save();
+    }
+    avp_last_cmd = timer_get_time();
+
+    metrics_stage(METRICS_PARSE, avp_ctx.timing.parse);
+    if (avp_ctx.timing.exec != 0) {
+        metrics_stage(METRICS_EXEC, avp_ctx.timing.exec);
+    }
+    metrics_stage(METRICS_FORMAT, avp_ctx.timing.format);
 
     if (ret != AVP_OK) {
-        OS_PRINTF("{\"ok\":false,\"error\":\"INTERNAL_ERROR\"}\r\n");
+        avp_cmd_reply(out, "{\"ok\":false,\"error\":\"INTERNAL_ERROR\"}");
+    } else {
+        /* Output the response */
+        avp_cmd_reply(out, response);
+
+        /* Remaining lines of a multi-line response (GET_RANDOM, METRICS) */
+        while (avp_process_next(&avp_ctx, response, AVP_MAX_JSON_LEN)) {
+            avp_cmd_reply(out, response);
+        }
+
+        /* Whole request until the response is queued, per op */
+        metrics_op((uint8_t)avp_ctx.timing.op, metrics_cycles() - start);
+    }
+
+    /* Request answered, the arena goes to the next one */
+    avp_ctx.work = NULL;
+    scratch_reset();
+}
+
+void avp_cmd_set_metrics(bool (*render)(unsigned int line, char *json, size_t len))
+{
+    avp_ctx.metrics = render;
+}
+
+void avp_cmd_set_clock(avp_clock_t handler)
+{
+    avp_ctx.clock = handler;
+}
+
+void avp_cmd_idle(void)
+{
+    uint64_t now = timer_get_time();
+
+    /* RAM only, cheap enough for every pass */
+    avp_hw_entropy_task();
+
+    if (now < avp_idle_next || now - avp_last_cmd < AVP_IDLE_QUIET_US) {
+        return;
+    }
+
+    /* One TROPIC01 job per call */
+    if (now >= avp_trng_next) {
+        avp_cmd_mix_tropic();
+        return;
+    }
+
+    /* Spare keys and released slots right away, sign counters lazily */
+    if (avp_ctx.keys.dirty != 0 || (avp_ctx.keys.touched != 0 && now >= avp_keys_save_next)) {
+        avp_idle_next = avp_cmd_keys_save() ? now : now + AVP_IDLE_BACKOFF_US;
+        return;
+    }
+
+    if (!avp_slots_known) {
+        avp_slots_known = (avp_key_slots_scan(&avp_ctx) == AVP_OK);
+        avp_idle_next = timer_get_time() + (avp_slots_known ? AVP_IDLE_NEXT_US : AVP_IDLE_BACKOFF_US);
         return;
     }
 
-    /* Output the response */
-    OS_PRINTF("%s\r\n", avp_response);
+    /* One key per call, keeps the main loop responsive */
+    switch (avp_key_pool_refill(&avp_ctx)) {
+        case AVP_OK:
+            avp_idle_next = timer_get_time() + AVP_IDLE_NEXT_US;
+            break;
+        case AVP_ERR_CAPACITY:
+            avp_idle_next = now + AVP_IDLE_CHECK_US;
+            break;
+        default:
+            /* TROPIC01 not available, don't hammer it */
+            avp_idle_next = timer_get_time() + AVP_IDLE_BACKOFF_US;
+            break;
+    }
+}
+
+void avp_cmd_key_pool_status(uint8_t ready[2], uint8_t target[2],
+                             uint32_t *hits, uint32_t *misses)
+{
+    const avp_key_index_t *idx = &avp_ctx.keys;
+
+    ready[AVP_CURVE_P256] = avp_keys_pool_ready(idx, AVP_CURVE_P256);
+    ready[AVP_CURVE_ED25519] = avp_keys_pool_ready(idx, AVP_CURVE_ED25519);
+    target[AVP_CURVE_P256] = idx->pool.target[AVP_CURVE_P256];
+    target[AVP_CURVE_ED25519] = idx->pool.target[AVP_CURVE_ED25519];
+    *hits = idx->pool.hits;
+    *misses = idx->pool.misses;
+}
+
+bool avp_cmd_key_pool_set(uint8_t p256, uint8_t ed25519)
+{
+    if (p256 + ed25519 > AVP_KEY_POOL_MAX) {
+        return false;
+    }
+
+    /* Clear first so the per-curve limit check cannot trip halfway */
+    avp_keys_pool_set_target(&avp_ctx.keys, AVP_CURVE_ED25519, 0);
+    avp_keys_pool_set_target(&avp_ctx.keys, AVP_CURVE_P256, p256);
+    avp_keys_pool_set_target(&avp_ctx.keys, AVP_CURVE_ED25519, ed25519);
+    return true;
 }
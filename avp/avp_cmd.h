@@ -13,6 +13,9 @@
 #define AVP_CMD_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "avp.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,15 +38,67 @@ void avp_cmd_init(void);
  */
 bool avp_cmd_is_avp(const char *data);
 
+/**
+ * @brief Response output, one text chunk per call
+ */
+typedef void (*avp_cmd_out_t)(const char *text);
+
 /**
  * @brief Process an AVP command and send response
  *
- * Parses the JSON command, executes the operation, and prints
- * the JSON response to stdout (USB CDC).
+ * Parses the JSON command, executes the operation, and writes
+ * the JSON response lines to out (stdout when NULL).
  *
  * @param data JSON command string
+ * @param out  Response output, NULL for stdout (console)
+ */
+void avp_cmd_process(const char *data, avp_cmd_out_t out);
+
+/**
+ * @brief Enable the METRICS op
+ *
+ * The response has one JSON line per call of render, line 0 first,
+ * until it returns false.
+ *
+ * @param render    Renders line n into json, NULL disables the op
+ */
+void avp_cmd_set_metrics(bool (*render)(unsigned int line, char *json, size_t len));
+
+/**
+ * @brief Enable the CLOCK op
+ *
+ * @param handler   Applies the profile and renders the response, NULL disables the op
+ */
+void avp_cmd_set_clock(avp_clock_t handler);
+
+/**
+ * @brief Run background work (entropy pool, spare key generation)
+ *
+ * Call from the main loop when the SPI link is free. Feeds the entropy
+ * pool on every call. TROPIC01 work waits until the host has been quiet
+ * for a while, then does at most one job (TRNG read or one spare key).
+ */
+void avp_cmd_idle(void);
+
+/**
+ * @brief Get spare key pool status
+ *
+ * @param ready     Output: ready keys per curve (P256, Ed25519)
+ * @param target    Output: wanted keys per curve
+ * @param hits      Output: key creations served from the pool
+ * @param misses    Output: key creations generated inline
+ */
+void avp_cmd_key_pool_status(uint8_t ready[2], uint8_t target[2],
+                             uint32_t *hits, uint32_t *misses);
+
+/**
+ * @brief Set number of spare keys kept ready
+ *
+ * @param p256      Spare P256 keys
+ * @param ed25519   Spare Ed25519 keys
+ * @return false when the total exceeds AVP_KEY_POOL_MAX
  */
-void avp_cmd_process(const char *data);
+bool avp_cmd_key_pool_set(uint8_t p256, uint8_t ed25519);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,135 @@
+/**
+ * @file avp_der.c
+ * @brief Minimal ASN.1 DER walker for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_der.h"
+#include <string.h>
+
+/* Nesting limit for attribute search (X.509 names are ~6 levels deep) */
+#define AVP_DER_MAX_DEPTH   8
+
+/*============================================================================
+ * TLV Decoding
+ *============================================================================*/
+
+bool avp_der_next(const uint8_t **pos, const uint8_t *end, avp_der_tlv_t *tlv)
+{
+    const uint8_t *p = *pos;
+    size_t len;
+
+    if (p + 2 > end) {
+        return false;
+    }
+
+    tlv->tag = *p++;
+    if ((tlv->tag & 0x1F) == 0x1F) {
+        /* High tag numbers never appear in the fields we look at */
+        return false;
+    }
+
+    len = *p++;
+    if (len & 0x80) {
+        size_t n = len & 0x7F;
+
+        /* Up to 2 length octets, a TROPIC01 certificate is well below 64 KB */
+        if (n == 0 || n > 2 || p + n > end) {
+            return false;
+        }
+        len = 0;
+        while (n--) {
+            len = (len << 8) | *p++;
+        }
+    }
+
+    if (len > (size_t)(end - p)) {
+        return false;
+    }
+
+    tlv->val = p;
+    tlv->len = len;
+    *pos = p + len;
+    return true;
+}
+
+bool avp_der_enter(const avp_der_tlv_t *parent, avp_der_tlv_t *child)
+{
+    const uint8_t *p = parent->val;
+
+    if (!(parent->tag & AVP_DER_CONSTRUCTED)) {
+        return false;
+    }
+    return avp_der_next(&p, parent->val + parent->len, child);
+}
+
+/*============================================================================
+ * Certificate Helpers
+ *============================================================================*/
+
+bool avp_der_cert_serial(const uint8_t *cert, size_t cert_len, avp_der_tlv_t *serial)
+{
+    const uint8_t *p = cert;
+    avp_der_tlv_t certificate, tbs;
+
+    /* Certificate ::= SEQUENCE { tbsCertificate, ... } */
+    if (!avp_der_next(&p, cert + cert_len, &certificate) ||
+        certificate.tag != AVP_DER_SEQUENCE) {
+        return false;
+    }
+
+    /* TBSCertificate ::= SEQUENCE { [0] version OPTIONAL, serialNumber, ... } */
+    if (!avp_der_enter(&certificate, &tbs) || tbs.tag != AVP_DER_SEQUENCE) {
+        return false;
+    }
+
+    p = tbs.val;
+    if (!avp_der_next(&p, tbs.val + tbs.len, serial)) {
+        return false;
+    }
+    if (serial->tag == AVP_DER_CONTEXT_0) {
+        if (!avp_der_next(&p, tbs.val + tbs.len, serial)) {
+            return false;
+        }
+    }
+
+    return (serial->tag == AVP_DER_INTEGER);
+}
+
+static bool der_find_attr(const uint8_t *p, const uint8_t *end,
+                          const uint8_t *oid, size_t oid_len,
+                          avp_der_tlv_t *value, int depth)
+{
+    avp_der_tlv_t tlv;
+
+    if (depth > AVP_DER_MAX_DEPTH) {
+        return false;
+    }
+
+    while (p < end) {
+        if (!avp_der_next(&p, end, &tlv)) {
+            return false;
+        }
+
+        if (tlv.tag == AVP_DER_OID && tlv.len == oid_len &&
+            memcmp(tlv.val, oid, oid_len) == 0) {
+            /* AttributeTypeAndValue: value follows the OID */
+            return avp_der_next(&p, end, value);
+        }
+
+        if ((tlv.tag & AVP_DER_CONSTRUCTED) &&
+            der_find_attr(tlv.val, tlv.val + tlv.len, oid, oid_len, value, depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool avp_der_find_attr(const uint8_t *data, size_t len,
+                       const uint8_t *oid, size_t oid_len,
+                       avp_der_tlv_t *value)
+{
+    return der_find_attr(data, data + len, oid, oid_len, value, 0);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file avp_der.h
+ * @brief Minimal ASN.1 DER walker for NexusClaw
+ *
+ * Just enough DER decoding to pull identity fields out of the TROPIC01
+ * device certificate without a full X.509 parser.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_DER_H
+#define AVP_DER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*============================================================================
+ * Tags
+ *============================================================================*/
+
+#define AVP_DER_INTEGER             0x02
+#define AVP_DER_OID                 0x06
+#define AVP_DER_UTF8_STRING         0x0C
+#define AVP_DER_PRINTABLE_STRING    0x13
+#define AVP_DER_SEQUENCE            0x30
+#define AVP_DER_CONTEXT_0           0xA0
+
+/** Constructed bit of the identifier octet */
+#define AVP_DER_CONSTRUCTED         0x20
+
+/*============================================================================
+ * Types
+ *============================================================================*/
+
+/** One decoded TLV element */
+typedef struct {
+    uint8_t tag;                /**< Identifier octet (low tag numbers only) */
+    const uint8_t *val;         /**< Start of contents */
+    size_t len;                 /**< Length of contents */
+} avp_der_tlv_t;
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+/**
+ * @brief Decode the TLV at *pos and advance past it
+ *
+ * @param pos   In: start of element, Out: first byte after element
+ * @param end   End of enclosing buffer
+ * @param tlv   Output: decoded element
+ * @return true on success, false on truncated or unsupported encoding
+ */
+bool avp_der_next(const uint8_t **pos, const uint8_t *end, avp_der_tlv_t *tlv);
+
+/**
+ * @brief Enter a constructed element, return its first child
+ *
+ * @param parent    Constructed element
+ * @param child     Output: first child element
+ * @return true on success
+ */
+bool avp_der_enter(const avp_der_tlv_t *parent, avp_der_tlv_t *child);
+
+/**
+ * @brief Get serialNumber INTEGER of an X.509 certificate
+ *
+ * @param cert      DER encoded certificate
+ * @param cert_len  Certificate length
+ * @param serial    Output: serialNumber element
+ * @return true on success
+ */
+bool avp_der_cert_serial(const uint8_t *cert, size_t cert_len, avp_der_tlv_t *serial);
+
+/**
+ * @brief Find a string attribute value by OID (depth-first search)
+ *
+ * Matches the SEQUENCE { OID, string } pattern used by X.500 names.
+ *
+ * @param data      DER data to search
+ * @param len       Data length
+ * @param oid       OID contents (without tag and length)
+ * @param oid_len   OID contents length
+ * @param value     Output: string element following the OID
+ * @return true when found
+ */
+bool avp_der_find_attr(const uint8_t *data, size_t len,
+                       const uint8_t *oid, size_t oid_len,
+                       avp_der_tlv_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_DER_H */
@@ -0,0 +1,126 @@
+/**
+ * @file avp_drbg.c
+ * @brief HMAC_DRBG (SHA-256) for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_drbg.h"
+#include <string.h>
+
+/*============================================================================
+ * HMAC-SHA-256
+ *============================================================================*/
+
+/* Hash both key pads once, every HMAC afterwards starts from a copy */
+static void drbg_set_key(avp_drbg_t *drbg, const uint8_t key[AVP_SHA256_DIGEST_LEN])
+{
+    uint8_t pad[AVP_SHA256_BLOCK_LEN];
+    int i;
+
+    memset(pad, 0x36, sizeof(pad));
+    for (i = 0; i < AVP_SHA256_DIGEST_LEN; i++) {
+        pad[i] ^= key[i];
+    }
+    avp_sha256_init(&drbg->inner);
+    avp_sha256_update(&drbg->inner, pad, sizeof(pad));
+
+    memset(pad, 0x5c, sizeof(pad));
+    for (i = 0; i < AVP_SHA256_DIGEST_LEN; i++) {
+        pad[i] ^= key[i];
+    }
+    avp_sha256_init(&drbg->outer);
+    avp_sha256_update(&drbg->outer, pad, sizeof(pad));
+
+    memset(pad, 0, sizeof(pad));
+}
+
+/* HMAC(K, V [|| sep || data]) */
+static void drbg_hmac(const avp_drbg_t *drbg, const uint8_t *sep,
+                      const uint8_t *data, size_t len,
+                      uint8_t out[AVP_SHA256_DIGEST_LEN])
+{
+    avp_sha256_t sha = drbg->inner;
+    uint8_t tmp[AVP_SHA256_DIGEST_LEN];
+
+    avp_sha256_update(&sha, drbg->v, sizeof(drbg->v));
+    if (sep) {
+        avp_sha256_update(&sha, sep, 1);
+    }
+    if (len) {
+        avp_sha256_update(&sha, data, len);
+    }
+    avp_sha256_final(&sha, tmp);
+
+    sha = drbg->outer;
+    avp_sha256_update(&sha, tmp, sizeof(tmp));
+    avp_sha256_final(&sha, out);
+}
+
+/* HMAC_DRBG_Update (SP 800-90A 10.1.2.2) */
+static void drbg_update(avp_drbg_t *drbg, const uint8_t *data, size_t len)
+{
+    uint8_t key[AVP_SHA256_DIGEST_LEN];
+    uint8_t sep;
+
+    for (sep = 0x00; sep <= 0x01; sep++) {
+        drbg_hmac(drbg, &sep, data, len, key);
+        drbg_set_key(drbg, key);
+        drbg_hmac(drbg, NULL, NULL, 0, drbg->v);
+
+        if (len == 0) {
+            break;
+        }
+    }
+    memset(key, 0, sizeof(key));
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+void avp_drbg_seed(avp_drbg_t *drbg, const uint8_t *seed, size_t len)
+{
+    if (!drbg->seeded) {
+        uint8_t key[AVP_SHA256_DIGEST_LEN];
+
+        memset(key, 0x00, sizeof(key));
+        memset(drbg->v, 0x01, sizeof(drbg->v));
+        drbg_set_key(drbg, key);
+        drbg->seeded = true;
+    }
+
+    drbg_update(drbg, seed, len);
+    drbg->reseed_counter = 1;
+}
+
+bool avp_drbg_generate(avp_drbg_t *drbg, uint8_t *out, size_t len)
+{
+    if (!drbg->seeded || drbg->reseed_counter > AVP_DRBG_RESEED_INTERVAL ||
+        len > AVP_DRBG_MAX_REQUEST) {
+        return false;
+    }
+
+    /* Whole blocks straight into the caller's buffer */
+    while (len >= AVP_SHA256_DIGEST_LEN) {
+        drbg_hmac(drbg, NULL, NULL, 0, drbg->v);
+        memcpy(out, drbg->v, AVP_SHA256_DIGEST_LEN);
+        out += AVP_SHA256_DIGEST_LEN;
+        len -= AVP_SHA256_DIGEST_LEN;
+    }
+    if (len) {
+        drbg_hmac(drbg, NULL, NULL, 0, drbg->v);
+        memcpy(out, drbg->v, len);
+    }
+
+    /* Backtracking resistance: output so far cannot be recomputed from the new state */
+    drbg_update(drbg, NULL, 0);
+    drbg->reseed_counter++;
+    return true;
+}
+
+void avp_drbg_clear(avp_drbg_t *drbg)
+{
+    memset(drbg, 0, sizeof(*drbg));
+}
@@ -0,0 +1,69 @@
+/**
+ * @file avp_drbg.h
+ * @brief HMAC_DRBG (SHA-256) for NexusClaw
+ *
+ * Deterministic random bit generator after NIST SP 800-90A, seeded from
+ * the conditioned entropy pool. Request path output costs two SHA-256
+ * compressions per 32 bytes; the HMAC key pads are hashed only when the
+ * key changes.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_DRBG_H
+#define AVP_DRBG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "avp_sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Generate calls allowed before a reseed is required */
+#define AVP_DRBG_RESEED_INTERVAL    4096
+
+/** Maximum bytes per generate call (SP 800-90A: 2^19 bits) */
+#define AVP_DRBG_MAX_REQUEST        (64 * 1024)
+
+/** DRBG state */
+typedef struct {
+    uint8_t v[AVP_SHA256_DIGEST_LEN];       /**< Chaining value V */
+    avp_sha256_t inner;                     /**< SHA-256 state after K ^ ipad */
+    avp_sha256_t outer;                     /**< SHA-256 state after K ^ opad */
+    uint32_t reseed_counter;                /**< Generate calls since last seed */
+    bool seeded;                            /**< Instantiated */
+} avp_drbg_t;
+
+/**
+ * @brief Instantiate (first call) or reseed the generator
+ *
+ * @param drbg      DRBG state
+ * @param seed      Seed material (conditioned entropy, optional nonce)
+ * @param len       Seed length
+ */
+void avp_drbg_seed(avp_drbg_t *drbg, const uint8_t *seed, size_t len);
+
+/**
+ * @brief Generate random bytes
+ *
+ * @param drbg      DRBG state
+ * @param out       Output buffer
+ * @param len       Bytes wanted (at most AVP_DRBG_MAX_REQUEST)
+ * @return false when not seeded or a reseed is due
+ */
+bool avp_drbg_generate(avp_drbg_t *drbg, uint8_t *out, size_t len);
+
+/**
+ * @brief Wipe the generator state
+ */
+void avp_drbg_clear(avp_drbg_t *drbg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_DRBG_H */
@@ -0,0 +1,189 @@
+/**
+ * @file avp_entropy.c
+ * @brief Entropy pool for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_entropy.h"
+#include <string.h>
+
+/*============================================================================
+ * Batch Handling
+ *============================================================================*/
+
+static void batch_reset(avp_entropy_t *pool)
+{
+    avp_sha256_init(&pool->acc);
+    pool->acc_bytes = 0;
+    pool->acc_extra = false;
+    pool->batch_bad = false;
+}
+
+/* Discard the batch, stop serving after repeated failures */
+static void batch_fail(avp_entropy_t *pool)
+{
+    batch_reset(pool);
+
+    /* Restart the tests so a stuck source keeps failing */
+    pool->rct_count = 0;
+    pool->apt_seen = 0;
+
+    if (pool->fail_run < 0xFF) {
+        pool->fail_run++;
+    }
+    if (pool->fail_run >= AVP_ENTROPY_FAIL_LIMIT) {
+        pool->health = AVP_ENTROPY_FAILED;
+        avp_drbg_clear(&pool->drbg);
+    } else if (pool->health != AVP_ENTROPY_STARTING) {
+        pool->health = AVP_ENTROPY_DEGRADED;
+    }
+}
+
+/*============================================================================
+ * Health Tests
+ *============================================================================*/
+
+static void health_rct(avp_entropy_t *pool, uint32_t word)
+{
+    if (pool->rct_count > 0 && word == pool->rct_last) {
+        if (++pool->rct_count == AVP_ENTROPY_RCT_CUTOFF) {
+            pool->rct_failures++;
+            pool->batch_bad = true;
+        }
+        return;
+    }
+    pool->rct_last = word;
+    pool->rct_count = 1;
+}
+
+static void health_apt(avp_entropy_t *pool, uint8_t b)
+{
+    if (pool->apt_seen == 0) {
+        pool->apt_ref = b;
+        pool->apt_count = 1;
+    } else if (b == pool->apt_ref) {
+        if (++pool->apt_count == AVP_ENTROPY_APT_CUTOFF) {
+            pool->apt_failures++;
+            pool->batch_bad = true;
+        }
+    }
+
+    if (++pool->apt_seen == AVP_ENTROPY_APT_WINDOW) {
+        pool->apt_seen = 0;
+    }
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+void avp_entropy_init(avp_entropy_t *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    batch_reset(pool);
+    pool->health = AVP_ENTROPY_STARTING;
+}
+
+size_t avp_entropy_add_samples(avp_entropy_t *pool, const uint32_t *words, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n && pool->acc_bytes < AVP_ENTROPY_SEED_BYTES; i++) {
+        uint32_t w = words[i];
+
+        health_rct(pool, w);
+        health_apt(pool, (uint8_t)w);
+        health_apt(pool, (uint8_t)(w >> 8));
+        health_apt(pool, (uint8_t)(w >> 16));
+        health_apt(pool, (uint8_t)(w >> 24));
+
+        if (pool->batch_bad) {
+            batch_fail(pool);
+            continue;
+        }
+
+        avp_sha256_update(&pool->acc, (const uint8_t *)&w, sizeof(w));
+        pool->acc_bytes += sizeof(w);
+    }
+    return i;
+}
+
+void avp_entropy_add_input(avp_entropy_t *pool, const uint8_t *data, size_t len)
+{
+    avp_sha256_update(&pool->acc, data, len);
+    pool->acc_extra = true;
+    pool->mixes++;
+}
+
+void avp_entropy_source_error(avp_entropy_t *pool)
+{
+    pool->source_errors++;
+    batch_fail(pool);
+}
+
+bool avp_entropy_batch_full(const avp_entropy_t *pool)
+{
+    return pool->acc_bytes >= AVP_ENTROPY_SEED_BYTES;
+}
+
+bool avp_entropy_reseed_due(const avp_entropy_t *pool)
+{
+    /* An idle generator keeps its seed, no need to burn CPU on reseeds */
+    return avp_entropy_batch_full(pool) &&
+           (!pool->drbg.seeded || pool->drbg.reseed_counter > 1);
+}
+
+bool avp_entropy_reseed(avp_entropy_t *pool)
+{
+    uint8_t seed[AVP_SHA256_DIGEST_LEN];
+
+    if (!avp_entropy_batch_full(pool) || pool->batch_bad) {
+        return false;
+    }
+
+    avp_sha256_final(&pool->acc, seed);
+    avp_drbg_seed(&pool->drbg, seed, sizeof(seed));
+    memset(seed, 0, sizeof(seed));
+
+    batch_reset(pool);
+    pool->reseeds++;
+    pool->fail_run = 0;
+    pool->health = AVP_ENTROPY_OK;
+    return true;
+}
+
+bool avp_entropy_read(avp_entropy_t *pool, uint8_t *out, size_t len)
+{
+    if (pool->health == AVP_ENTROPY_FAILED) {
+        return false;
+    }
+
+    while (len > 0) {
+        size_t n = (len > AVP_DRBG_MAX_REQUEST) ? AVP_DRBG_MAX_REQUEST : len;
+
+        if (!avp_drbg_generate(&pool->drbg, out, n)) {
+            return false;
+        }
+        pool->bytes_out += n;
+        out += n;
+        len -= n;
+    }
+    return true;
+}
+
+uint8_t avp_entropy_fill(const avp_entropy_t *pool)
+{
+    return (uint8_t)((pool->acc_bytes * 100u) / AVP_ENTROPY_SEED_BYTES);
+}
+
+const char *avp_entropy_health_str(avp_entropy_health_t health)
+{
+    switch (health) {
+        case AVP_ENTROPY_OK:        return "ok";
+        case AVP_ENTROPY_DEGRADED:  return "degraded";
+        case AVP_ENTROPY_FAILED:    return "failed";
+        default:                    return "starting";
+    }
+}
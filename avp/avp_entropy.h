@@ -0,0 +1,149 @@
+/**
+ * @file avp_entropy.h
+ * @brief Entropy pool for NexusClaw
+ *
+ * Raw words from the RNG peripheral are health tested (SP 800-90B
+ * repetition count and adaptive proportion tests), conditioned with
+ * SHA-256 and used to reseed an HMAC_DRBG. TROPIC01 TRNG output is mixed
+ * into the next reseed as additional input. Requests are served from the
+ * DRBG only, so they never wait for the noise source.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_ENTROPY_H
+#define AVP_ENTROPY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "avp_drbg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Health test parameters assume at least 4 bits of min-entropy per raw
+ * byte, false positive rate 2^-20 (SP 800-90B 4.4).
+ */
+
+/** Repetition count test: identical consecutive 32-bit words that fail */
+#define AVP_ENTROPY_RCT_CUTOFF      3
+
+/** Adaptive proportion test window (bytes) and cutoff */
+#define AVP_ENTROPY_APT_WINDOW      512
+#define AVP_ENTROPY_APT_CUTOFF      62
+
+/** Raw bytes conditioned per reseed (512 bits of entropy at the assumed rate) */
+#define AVP_ENTROPY_SEED_BYTES      128
+
+/** Consecutive failed batches before the pool stops serving */
+#define AVP_ENTROPY_FAIL_LIMIT      3
+
+/** Pool health */
+typedef enum {
+    AVP_ENTROPY_STARTING = 0,       /**< Not seeded yet */
+    AVP_ENTROPY_OK,                 /**< Seeded, last batch passed */
+    AVP_ENTROPY_DEGRADED,           /**< Last batch failed, still serving */
+    AVP_ENTROPY_FAILED,             /**< Repeated failures, not serving */
+} avp_entropy_health_t;
+
+/** Entropy pool state */
+typedef struct {
+    avp_drbg_t drbg;                /**< Output generator */
+    avp_sha256_t acc;               /**< Conditioning hash of the current batch */
+    uint16_t acc_bytes;             /**< Raw bytes in the current batch */
+    bool acc_extra;                 /**< Additional input mixed into the batch */
+
+    uint32_t rct_last;              /**< RCT: last word */
+    uint8_t rct_count;              /**< RCT: repetitions of last word */
+    uint8_t apt_ref;                /**< APT: reference byte */
+    uint16_t apt_seen;              /**< APT: bytes in window */
+    uint16_t apt_count;             /**< APT: matches of reference byte */
+    bool batch_bad;                 /**< Health test failed in current batch */
+
+    uint8_t health;                 /**< avp_entropy_health_t */
+    uint8_t fail_run;               /**< Consecutive failed batches */
+
+    uint32_t reseeds;               /**< DRBG reseeds */
+    uint32_t rct_failures;          /**< Repetition count test failures */
+    uint32_t apt_failures;          /**< Adaptive proportion test failures */
+    uint32_t source_errors;         /**< Noise source errors (seed/clock) */
+    uint32_t mixes;                 /**< Additional input blocks mixed in */
+    uint32_t bytes_out;             /**< Random bytes served */
+} avp_entropy_t;
+
+/**
+ * @brief Reset the pool (unseeded)
+ */
+void avp_entropy_init(avp_entropy_t *pool);
+
+/**
+ * @brief Feed raw noise source words
+ *
+ * Words are health tested and conditioned into the current batch. Words
+ * beyond a full batch are not consumed.
+ *
+ * @param pool      Entropy pool
+ * @param words     Raw samples
+ * @param n         Number of words
+ * @return Words consumed
+ */
+size_t avp_entropy_add_samples(avp_entropy_t *pool, const uint32_t *words, size_t n);
+
+/**
+ * @brief Mix additional input (e.g. TROPIC01 TRNG) into the next reseed
+ *
+ * Not credited as entropy and not health tested.
+ */
+void avp_entropy_add_input(avp_entropy_t *pool, const uint8_t *data, size_t len);
+
+/**
+ * @brief Record a noise source error, the current batch is discarded
+ */
+void avp_entropy_source_error(avp_entropy_t *pool);
+
+/**
+ * @brief Check if the current batch is complete
+ */
+bool avp_entropy_batch_full(const avp_entropy_t *pool);
+
+/**
+ * @brief Check if a reseed should be done now
+ *
+ * True when the batch is complete and the DRBG is unseeded or has
+ * produced output since the last reseed.
+ */
+bool avp_entropy_reseed_due(const avp_entropy_t *pool);
+
+/**
+ * @brief Reseed the DRBG from the current batch
+ *
+ * @return false when the batch is incomplete or failed health tests
+ */
+bool avp_entropy_reseed(avp_entropy_t *pool);
+
+/**
+ * @brief Get random bytes from the DRBG
+ *
+ * @return false when the pool is unseeded or failed
+ */
+bool avp_entropy_read(avp_entropy_t *pool, uint8_t *out, size_t len);
+
+/**
+ * @brief Current batch fill level in percent
+ */
+uint8_t avp_entropy_fill(const avp_entropy_t *pool);
+
+/**
+ * @brief Health as string ("starting", "ok", "degraded", "failed")
+ */
+const char *avp_entropy_health_str(avp_entropy_health_t health);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_ENTROPY_H */
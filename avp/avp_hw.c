@@ -7,6 +7,9 @@
  */
 
 #include "avp_hw.h"
+#include "avp_entropy.h"
+#include "hardware.h"
+#include "irq.h"
 #include "stm32u5xx_hal.h"
 #include "time.h"
 
@@ -14,9 +17,93 @@
  * Hardware RNG
  *============================================================================*/
 
+/* Raw words buffered by the RNG interrupt (power of two) */
+#define RNG_RING_WORDS      64
+
+/* Longest wait for the first seed after boot */
+#define RNG_SEED_WAIT_US    (10 * TIMER_MS)
+
 static RNG_HandleTypeDef hrng;
 static uint8_t rng_initialized = 0;
 
+static volatile uint32_t rng_ring[RNG_RING_WORDS];
+static volatile uint16_t rng_head;          // written by ISR
+static volatile uint16_t rng_tail;          // written by task
+static volatile bool rng_running;
+static volatile uint32_t rng_errors;
+static uint32_t rng_errors_seen;
+
+static avp_entropy_t entropy;
+
+void RNG_IRQHandler(void)
+{
+    HAL_RNG_IRQHandler(&hrng);
+}
+
+void HAL_RNG_ReadyDataCallback(RNG_HandleTypeDef *h, uint32_t random32bit)
+{
+    uint16_t head = rng_head;
+
+    rng_ring[head & (RNG_RING_WORDS - 1)] = random32bit;
+    rng_head = ++head;
+
+    /* Keep the peripheral busy until the ring is full */
+    if ((uint16_t)(head - rng_tail) < RNG_RING_WORDS) {
+        if (HAL_RNG_GenerateRandomNumber_IT(h) == HAL_OK) {
+            return;
+        }
+    }
+    rng_running = false;
+}
+
+void HAL_RNG_ErrorCallback(RNG_HandleTypeDef *h)
+{
+    (void)h;
+    rng_errors++;
+    rng_running = false;
+}
+
+static void rng_start(void)
+{
+    rng_running = true;
+    if (HAL_RNG_GenerateRandomNumber_IT(&hrng) != HAL_OK) {
+        rng_running = false;
+    }
+}
+
+/* Move raw words into the pool, reseed when a batch is complete */
+static void rng_service(void)
+{
+    uint16_t tail = rng_tail;
+
+    if (rng_errors != rng_errors_seen) {
+        /* Seed or clock error: drop the batch, reset the peripheral */
+        rng_errors_seen = rng_errors;
+        avp_entropy_source_error(&entropy);
+        HAL_RNG_DeInit(&hrng);
+        HAL_RNG_Init(&hrng);
+    }
+
+    while (tail != rng_head) {
+        uint32_t word = rng_ring[tail & (RNG_RING_WORDS - 1)];
+
+        if (avp_entropy_add_samples(&entropy, &word, 1) == 0) {
+            break;
+        }
+        tail++;
+    }
+    rng_tail = tail;
+
+    if (avp_entropy_reseed_due(&entropy)) {
+        avp_entropy_reseed(&entropy);
+    }
+
+    /* Stopped by a full ring or an error, tail moved or the pool wants more */
+    if (!rng_running && (uint16_t)(rng_head - tail) < RNG_RING_WORDS) {
+        rng_start();
+    }
+}
+
 void avp_hw_init(void)
 {
     if (rng_initialized) {
@@ -31,54 +118,60 @@ void avp_hw_init(void)
     hrng.Init.ClockErrorDetection = RNG_CED_ENABLE;
 
     if (HAL_RNG_Init(&hrng) != HAL_OK) {
-        /* RNG init failed - fall back to pseudo-random */
+        /* No entropy source: random requests fail */
         rng_initialized = 0;
         return;
     }
 
+    avp_entropy_init(&entropy);
+    irq_enable(RNG_IRQn, RNG_ISR_PRIO);
+    rng_start();
+
     rng_initialized = 1;
 }
 
-void avp_hw_random_bytes(uint8_t *buf, size_t len)
+bool avp_hw_random_bytes(uint8_t *buf, size_t len)
 {
-    uint32_t random_word;
-    size_t i;
-
     if (!rng_initialized) {
-        /* Fallback: use timer-based pseudo-random (not secure!) */
-        uint32_t seed = timer_get_time();
-        for (i = 0; i < len; i++) {
-            seed = seed * 1103515245 + 12345;
-            buf[i] = (uint8_t)(seed >> 16);
-        }
-        return;
+        return false;
     }
 
-    /* Generate random bytes using hardware RNG */
-    for (i = 0; i < len; ) {
-        if (HAL_RNG_GenerateRandomNumber(&hrng, &random_word) == HAL_OK) {
-            /* Copy up to 4 bytes from each random word */
-            size_t remaining = len - i;
-            size_t copy_len = (remaining >= 4) ? 4 : remaining;
-
-            for (size_t j = 0; j < copy_len; j++) {
-                buf[i + j] = (uint8_t)(random_word >> (j * 8));
-            }
-            i += copy_len;
-        } else {
-            /* RNG error - use timer fallback for remaining bytes */
-            uint32_t seed = timer_get_time();
-            while (i < len) {
-                seed = seed * 1103515245 + 12345;
-                buf[i++] = (uint8_t)(seed >> 16);
-            }
-            break;
+    rng_service();
+
+    /* Only right after boot: the first batch takes a few hundred microseconds */
+    if (!entropy.drbg.seeded && entropy.health != AVP_ENTROPY_FAILED) {
+        uint64_t until = timer_get_time() + RNG_SEED_WAIT_US;
+
+        while (!entropy.drbg.seeded && timer_get_time() < until) {
+            rng_service();
         }
     }
+
+    return avp_entropy_read(&entropy, buf, len);
+}
+
+void avp_hw_entropy_task(void)
+{
+    if (rng_initialized) {
+        rng_service();
+    }
+}
+
+void avp_hw_entropy_mix(const uint8_t *data, size_t len)
+{
+    if (rng_initialized) {
+        avp_entropy_add_input(&entropy, data, len);
+    }
+}
+
+const avp_entropy_t *avp_hw_entropy(uint16_t *ring_level)
+{
+    *ring_level = (uint16_t)(rng_head - rng_tail);
+    return &entropy;
 }
 
 uint32_t avp_hw_get_time(void)
 {
-    /* Convert milliseconds to seconds */
-    return timer_get_time() / 1000;
+    /* Timer counts microseconds */
+    return (uint32_t)(timer_get_time() / (1000 * TIMER_MS));
 }
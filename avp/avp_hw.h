@@ -13,7 +13,9 @@
 #define AVP_HW_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include "avp_entropy.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,12 +27,36 @@ extern "C" {
 void avp_hw_init(void);
 
 /**
- * @brief Generate random bytes using hardware RNG
+ * @brief Generate random bytes from the entropy pool DRBG
+ *
+ * The RNG peripheral refills the pool from its interrupt, so this does
+ * not wait for the noise source except for the first seed after boot.
  *
  * @param buf  Output buffer
  * @param len  Number of bytes to generate
+ * @return false when no healthy entropy source is available
+ */
+bool avp_hw_random_bytes(uint8_t *buf, size_t len);
+
+/**
+ * @brief Feed buffered RNG words into the pool, reseed when due
+ *
+ * Call from the main loop.
+ */
+void avp_hw_entropy_task(void);
+
+/**
+ * @brief Mix additional input (TROPIC01 TRNG) into the next reseed
+ */
+void avp_hw_entropy_mix(const uint8_t *data, size_t len);
+
+/**
+ * @brief Get entropy pool state for status reporting
+ *
+ * @param ring_level   Output: raw RNG words buffered by the interrupt
+ * @return Entropy pool
  */
-void avp_hw_random_bytes(uint8_t *buf, size_t len);
+const avp_entropy_t *avp_hw_entropy(uint16_t *ring_level);
 
 /**
  * @brief Get current timestamp in seconds
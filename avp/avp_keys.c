@@ -0,0 +1,232 @@
+/**
+ * @file avp_keys.c
+ * @brief ECC key name index for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_keys.h"
+#include <string.h>
+
+/*============================================================================
+ * Name Hashing
+ *============================================================================*/
+
+/* FNV-1a, folded to the bucket count */
+static uint32_t key_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h & (AVP_KEY_BUCKETS - 1);
+}
+
+static void key_unlink(avp_key_index_t *idx, int slot)
+{
+    int8_t *link = &idx->buckets[key_hash(idx->slots[slot].name)];
+
+    while (*link >= 0) {
+        if (*link == slot) {
+            *link = idx->slots[slot].next;
+            return;
+        }
+        link = &idx->slots[*link].next;
+    }
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+void avp_keys_init(avp_key_index_t *idx)
+{
+    memset(idx, 0, sizeof(*idx));
+    memset(idx->buckets, -1, sizeof(idx->buckets));
+
+    avp_keys_bind(idx, AVP_KEY_SLOT_ATTEST, AVP_KEY_NAME_ATTEST, AVP_CURVE_P256, 0);
+    idx->pool.target[AVP_CURVE_P256] = AVP_KEY_POOL_DEFAULT;
+}
+
+int avp_keys_find(const avp_key_index_t *idx, const char *name)
+{
+    int slot = idx->buckets[key_hash(name)];
+
+    while (slot >= 0) {
+        if (strcmp(idx->slots[slot].name, name) == 0) {
+            return slot;
+        }
+        slot = idx->slots[slot].next;
+    }
+    return -1;
+}
+
+int avp_keys_alloc(const avp_key_index_t *idx)
+{
+    for (int i = 0; i < AVP_MAX_KEYS; i++) {
+        if (avp_keys_is_free(idx, i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void avp_keys_set_free(avp_key_index_t *idx, int slot)
+{
+    if (slot != AVP_KEY_SLOT_ATTEST && !idx->slots[slot].in_use && !idx->slots[slot].pooled) {
+        idx->free |= 1u << slot;
+    }
+}
+
+bool avp_keys_is_free(const avp_key_index_t *idx, int slot)
+{
+    return (idx->free & (1u << slot)) != 0;
+}
+
+void avp_keys_bind(avp_key_index_t *idx, int slot, const char *name,
+                   avp_curve_t curve, uint32_t now)
+{
+    avp_key_meta_t *key = &idx->slots[slot];
+    uint32_t bucket;
+
+    if (key->in_use) {
+        key_unlink(idx, slot);
+    } else {
+        idx->count++;
+    }
+
+    idx->free &= ~(1u << slot);
+    idx->dirty |= 1u << slot;
+    memset(key, 0, sizeof(*key));
+    strncpy(key->name, name, sizeof(key->name) - 1);
+    key->curve = (uint8_t)curve;
+    key->created_at = now;
+    key->in_use = true;
+
+    bucket = key_hash(key->name);
+    key->next = idx->buckets[bucket];
+    idx->buckets[bucket] = (int8_t)slot;
+}
+
+void avp_keys_release(avp_key_index_t *idx, int slot)
+{
+    if (!idx->slots[slot].in_use) {
+        return;
+    }
+    key_unlink(idx, slot);
+    memset(&idx->slots[slot], 0, sizeof(idx->slots[slot]));
+    idx->count--;
+    idx->dirty |= 1u << slot;
+    avp_keys_set_free(idx, slot);
+}
+
+void avp_keys_touch(avp_key_index_t *idx, int slot, uint32_t now)
+{
+    idx->slots[slot].sign_count++;
+    idx->slots[slot].last_used = now;
+    idx->touched |= 1u << slot;
+}
+
+/*============================================================================
+ * Spare Key Pool
+ *============================================================================*/
+
+bool avp_keys_pool_set_target(avp_key_index_t *idx, avp_curve_t curve, uint8_t target)
+{
+    int other = idx->pool.target[curve == AVP_CURVE_P256 ? AVP_CURVE_ED25519 : AVP_CURVE_P256];
+
+    if (other + target > AVP_KEY_POOL_MAX) {
+        return false;
+    }
+    /* Spare keys above the new target are simply used up first */
+    idx->pool.target[curve] = target;
+    return true;
+}
+
+uint8_t avp_keys_pool_ready(const avp_key_index_t *idx, avp_curve_t curve)
+{
+    uint8_t n = 0;
+
+    for (int i = 0; i < idx->pool.count; i++) {
+        if (idx->pool.keys[i].curve == curve) {
+            n++;
+        }
+    }
+    return n;
+}
+
+int avp_keys_pool_take(avp_key_index_t *idx, avp_curve_t curve, uint8_t *pubkey)
+{
+    avp_key_pool_t *pool = &idx->pool;
+
+    /* Oldest first, the pool is short so the shift is cheap */
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->keys[i].curve == curve) {
+            int slot = pool->keys[i].slot;
+
+            memcpy(pubkey, pool->keys[i].pubkey, avp_curve_pubkey_len(curve));
+            memmove(&pool->keys[i], &pool->keys[i + 1],
+                    (pool->count - i - 1) * sizeof(pool->keys[0]));
+            pool->count--;
+            idx->slots[slot].pooled = false;
+            idx->dirty |= 1u << slot;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+int avp_keys_pool_want(const avp_key_index_t *idx, avp_curve_t *curve)
+{
+    if (idx->pool.count >= AVP_KEY_POOL_MAX) {
+        return -1;
+    }
+
+    if (avp_keys_pool_ready(idx, AVP_CURVE_P256) < idx->pool.target[AVP_CURVE_P256]) {
+        *curve = AVP_CURVE_P256;
+    } else if (avp_keys_pool_ready(idx, AVP_CURVE_ED25519) < idx->pool.target[AVP_CURVE_ED25519]) {
+        *curve = AVP_CURVE_ED25519;
+    } else {
+        return -1;
+    }
+    return avp_keys_alloc(idx);
+}
+
+void avp_keys_pool_put(avp_key_index_t *idx, int slot, avp_curve_t curve,
+                       const uint8_t *pubkey)
+{
+    avp_spare_key_t *key = &idx->pool.keys[idx->pool.count++];
+
+    key->slot = (uint8_t)slot;
+    key->curve = (uint8_t)curve;
+    memcpy(key->pubkey, pubkey, avp_curve_pubkey_len(curve));
+    idx->slots[slot].pooled = true;
+    idx->free &= ~(1u << slot);
+    idx->dirty |= 1u << slot;
+}
+
+size_t avp_curve_pubkey_len(avp_curve_t curve)
+{
+    return (curve == AVP_CURVE_ED25519) ? 32 : 64;
+}
+
+const char *avp_curve_str(avp_curve_t curve)
+{
+    return (curve == AVP_CURVE_ED25519) ? "Ed25519" : "P256";
+}
+
+bool avp_curve_parse(const char *str, avp_curve_t *curve)
+{
+    if (str[0] == '\0' || strcmp(str, "P256") == 0) {
+        *curve = AVP_CURVE_P256;
+        return true;
+    }
+    if (strcmp(str, "Ed25519") == 0) {
+        *curve = AVP_CURVE_ED25519;
+        return true;
+    }
+    return false;
+}
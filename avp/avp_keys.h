@@ -0,0 +1,147 @@
+/**
+ * @file avp_keys.h
+ * @brief ECC key name index for NexusClaw
+ *
+ * Maps key names to TROPIC01 ECC slots 0-31 with curve, creation time and
+ * usage counters. Lookup by name is a hash bucket walk, O(1) on average.
+ * Slot 0 is the device attestation key and is always registered.
+ *
+ * Unnamed slots can hold spare keys generated ahead of time, so creating
+ * a key is just binding a name to a ready slot. A slot is only handed out
+ * once it is known to be free, see avp_keys_set_free().
+ *
+ * The index itself is RAM only; changed slots are flagged in dirty and
+ * touched for the firmware to persist (avp_cmd.c, flash page in nvm.h).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_KEYS_H
+#define AVP_KEYS_H
+
+#include "avp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Name of the pre-registered attestation key (slot 0) */
+#define AVP_KEY_NAME_ATTEST     "attestation"
+
+/**
+ * @brief Reset index, register attestation key in slot 0
+ *
+ * No slot is free afterwards until avp_keys_set_free() says so.
+ */
+void avp_keys_init(avp_key_index_t *idx);
+
+/**
+ * @brief Find key slot by name
+ *
+ * @return ECC slot, or -1 when not found
+ */
+int avp_keys_find(const avp_key_index_t *idx, const char *name);
+
+/**
+ * @brief Find a free ECC slot for a new key
+ *
+ * @return ECC slot (never the attestation slot), or -1 when full
+ */
+int avp_keys_alloc(const avp_key_index_t *idx);
+
+/**
+ * @brief Mark an unnamed, unpooled slot free (TROPIC01 reports no key in it)
+ */
+void avp_keys_set_free(avp_key_index_t *idx, int slot);
+
+/**
+ * @brief Check whether a slot is known to be free
+ */
+bool avp_keys_is_free(const avp_key_index_t *idx, int slot);
+
+/**
+ * @brief Register a key name for a slot (replaces previous metadata)
+ *
+ * @param idx       Key index
+ * @param slot      ECC slot
+ * @param name      Key name
+ * @param curve     Key curve
+ * @param now       Creation timestamp
+ */
+void avp_keys_bind(avp_key_index_t *idx, int slot, const char *name,
+                   avp_curve_t curve, uint32_t now);
+
+/**
+ * @brief Account one signature made with a slot
+ */
+void avp_keys_touch(avp_key_index_t *idx, int slot, uint32_t now);
+
+/**
+ * @brief Drop the name of a slot, the slot becomes free (its key is ours to erase)
+ */
+void avp_keys_release(avp_key_index_t *idx, int slot);
+
+/*============================================================================
+ * Spare Key Pool
+ *============================================================================*/
+
+/**
+ * @brief Set number of spare keys kept ready for a curve
+ *
+ * @return false when the total would exceed AVP_KEY_POOL_MAX
+ */
+bool avp_keys_pool_set_target(avp_key_index_t *idx, avp_curve_t curve, uint8_t target);
+
+/**
+ * @brief Number of ready spare keys for a curve
+ */
+uint8_t avp_keys_pool_ready(const avp_key_index_t *idx, avp_curve_t curve);
+
+/**
+ * @brief Claim a ready spare key
+ *
+ * @param idx       Key index
+ * @param curve     Wanted curve
+ * @param pubkey    Output: public key (64 bytes buffer)
+ * @return ECC slot, or -1 when none is ready
+ */
+int avp_keys_pool_take(avp_key_index_t *idx, avp_curve_t curve, uint8_t *pubkey);
+
+/**
+ * @brief Pick a slot and curve for the next spare key
+ *
+ * @param idx       Key index
+ * @param curve     Output: curve to generate
+ * @return ECC slot, or -1 when the pool is at target or no slot is free
+ */
+int avp_keys_pool_want(const avp_key_index_t *idx, avp_curve_t *curve);
+
+/**
+ * @brief Add a freshly generated key to the pool
+ */
+void avp_keys_pool_put(avp_key_index_t *idx, int slot, avp_curve_t curve,
+                       const uint8_t *pubkey);
+
+/**
+ * @brief Public key length for a curve
+ */
+size_t avp_curve_pubkey_len(avp_curve_t curve);
+
+/**
+ * @brief Curve name as used in JSON ("P256", "Ed25519")
+ */
+const char *avp_curve_str(avp_curve_t curve);
+
+/**
+ * @brief Parse curve name, empty string selects P256
+ *
+ * @return true on success
+ */
+bool avp_curve_parse(const char *str, avp_curve_t *curve);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_KEYS_H */
@@ -0,0 +1,344 @@
+/**
+ * @file avp_l2.c
+ * @brief Non-blocking TROPIC01 L2 transport for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_l2.h"
+#include "spi.h"
+#include "time.h"
+#include "metrics.h"
+#include <string.h>
+
+/*============================================================================
+ * Static Variables
+ *============================================================================*/
+
+static struct {
+    volatile avp_l2_state_t state;
+    avp_l2_done_t done;
+    avp_l2_yield_t yield;
+    avp_l2_request_hook_t request_hook;
+    bool in_yield;
+    bool external;                      /* libtropic holds CS, avp_l2_external() */
+    bool single;                        /* one poll only, report AVP_L2_EMPTY */
+    uint8_t type;                       /* METRICS_SPI_* */
+    uint32_t start;                     /* cycles, exchange started */
+    volatile bool ready_event;          /* GPO fired since last poll */
+    bool ready_live;                    /* GPO has fired at least once */
+    uint8_t no_resp;
+    uint64_t poll_at;                   /* us */
+    uint64_t deadline;                  /* us */
+    size_t frame_len;
+    uint8_t hdr_tx[3];                  /* Get_Response + 2 dummy bytes */
+    uint8_t tx[AVP_L2_FRAME_MAX];       /* request frame */
+    uint8_t rx[1 + AVP_L2_FRAME_MAX];   /* CHIP_STATUS + response frame */
+} l2;
+
+static avp_l2_stats_t l2_stats;
+
+/*============================================================================
+ * State Machine
+ *============================================================================*/
+
+static void l2_fail(avp_l2_state_t err)
+{
+    l2_stats.spi_errors++;
+    spi1_cs(SPI_CS_IDLE);
+    l2.state = err;
+}
+
+/* SPI ISR: data and CRC length once CHIP_STATUS, STATUS and LEN are in */
+static RAMFUNC size_t l2_chain(const uint8_t *rx)
+{
+    if (!(rx[0] & AVP_L2_CHIP_READY) || rx[1] == l2.no_resp) {
+        return 0;
+    }
+    return (size_t)rx[2] + 2;
+}
+
+static void l2_poll(void)
+{
+    /*
+     * CHIP_STATUS, STATUS and LEN come back in a 3 byte transfer, a pending
+     * response is read on by the SPI driver under the same CS
+     */
+    l2.ready_event = false;
+    spi1_flush();
+    spi1_cs(SPI_CS_ACTIVE);
+    if (!spi1_data_transfer_chain(l2.rx, l2.hdr_tx, sizeof(l2.hdr_tx), l2_chain)) {
+        l2_fail(AVP_L2_ERR_SPI);
+        return;
+    }
+    l2.state = AVP_L2_HEADER;
+}
+
+/* Next poll, the ready line cuts the wait short */
+static uint64_t l2_next_poll(uint64_t now)
+{
+    return now + (l2.ready_live ? AVP_L2_IRQ_POLL_US : AVP_L2_POLL_US);
+}
+
+static void l2_response(void)
+{
+    spi1_cs(SPI_CS_IDLE);
+
+    if (!avp_l2_count_response(&l2.rx[1], l2.frame_len)) {
+        l2.state = AVP_L2_ERR_CRC;
+        return;
+    }
+    l2.state = AVP_L2_DONE;
+}
+
+static void l2_header(void)
+{
+    uint8_t chip_status = l2.rx[0];
+    uint8_t status = l2.rx[1];
+    uint8_t len = l2.rx[2];
+    uint64_t now;
+
+    if (!(chip_status & AVP_L2_CHIP_READY) || status == l2.no_resp) {
+        spi1_cs(SPI_CS_IDLE);
+        if (l2.single) {
+            l2.state = AVP_L2_EMPTY;
+            return;
+        }
+
+        l2_stats.polls++;
+        now = timer_get_time();
+        if (now >= l2.deadline) {
+            l2_stats.timeouts++;
+            l2.state = AVP_L2_ERR_TIMEOUT;
+            return;
+        }
+        l2.poll_at = l2_next_poll(now);
+        l2.state = AVP_L2_WAIT;
+        return;
+    }
+
+    /* Data and CRC were chained from the SPI ISR */
+    if (spi1_chained() != (size_t)len + 2) {
+        l2_fail(AVP_L2_ERR_SPI);
+        return;
+    }
+    l2.frame_len = 2 + len + 2;
+    l2_response();
+}
+
+static void l2_finish(void)
+{
+    avp_l2_state_t result = l2.state;
+    avp_l2_done_t done = l2.done;
+    bool has_frame = (result == AVP_L2_DONE || result == AVP_L2_ERR_CRC);
+
+    metrics_spi(l2.type, metrics_cycles() - l2.start);
+
+    /* Idle before the callback, it may start the next exchange */
+    l2.state = AVP_L2_IDLE;
+    l2.done = NULL;
+
+    if (done != NULL) {
+        done(result, has_frame ? &l2.rx[1] : NULL, has_frame ? l2.frame_len : 0);
+    }
+}
+
+static bool l2_start(uint8_t no_resp, uint32_t timeout_ms, avp_l2_done_t done)
+{
+    if (avp_l2_busy()) {
+        return false;
+    }
+
+    l2.done = done;
+    l2.no_resp = no_resp;
+    l2.single = (timeout_ms == 0);
+    l2.type = l2.single ? METRICS_SPI_POLL : METRICS_SPI_READ;
+    l2.start = metrics_cycles();
+    l2.deadline = timer_get_time() + (uint64_t)timeout_ms * TIMER_MS;
+    return true;
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+void avp_l2_init(avp_l2_yield_t yield)
+{
+    memset(&l2, 0, sizeof(l2));
+    memset(&l2_stats, 0, sizeof(l2_stats));
+    l2.yield = yield;
+    l2.hdr_tx[0] = AVP_L2_GET_RESP;
+}
+
+void avp_l2_set_request_hook(avp_l2_request_hook_t hook)
+{
+    l2.request_hook = hook;
+}
+
+bool avp_l2_request(const uint8_t *req, size_t len, uint32_t timeout_ms, avp_l2_done_t done)
+{
+    if (len == 0 || len > sizeof(l2.tx)) {
+        return false;
+    }
+    if (l2.request_hook != NULL && !avp_l2_busy()) {
+        l2.request_hook();  /* before the exchange timing starts */
+    }
+    if (!l2_start(AVP_L2_NO_RESP, timeout_ms, done)) {
+        return false;
+    }
+
+    /* The request needs a response, never treat it as a single poll */
+    l2.single = false;
+    l2.type = METRICS_SPI_REQUEST;
+    l2.ready_event = false;
+    l2.hdr_tx[0] = AVP_L2_GET_RESP;
+    memcpy(l2.tx, req, len);
+
+    spi1_flush();
+    spi1_cs(SPI_CS_ACTIVE);
+    if (!spi1_data_transfer_start(l2.rx, l2.tx, len)) {
+        l2_fail(AVP_L2_ERR_SPI);
+        return true;    /* reported through the callback */
+    }
+    l2.state = AVP_L2_SEND;
+    return true;
+}
+
+bool avp_l2_read(uint8_t get_resp, uint8_t no_resp, uint32_t timeout_ms, avp_l2_done_t done)
+{
+    if (!l2_start(no_resp, timeout_ms, done)) {
+        return false;
+    }
+
+    l2.hdr_tx[0] = get_resp;
+    l2_poll();
+    return true;
+}
+
+avp_l2_state_t avp_l2_step(void)
+{
+    switch (l2.state) {
+        case AVP_L2_SEND:
+            if (spi1_transfer_done()) {
+                /* Give the chip a moment before the first poll */
+                spi1_cs(SPI_CS_IDLE);
+                l2.poll_at = l2_next_poll(timer_get_time());
+                l2.state = AVP_L2_WAIT;
+            }
+            break;
+
+        case AVP_L2_WAIT:
+            if (l2.ready_event || timer_get_time() >= l2.poll_at) {
+                l2_poll();
+            }
+            break;
+
+        case AVP_L2_HEADER:
+            if (spi1_transfer_done()) {
+                l2_header();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (l2.state >= AVP_L2_DONE) {
+        l2_finish();
+    }
+    return l2.state;
+}
+
+bool avp_l2_busy(void)
+{
+    return (l2.state != AVP_L2_IDLE) || l2.external;
+}
+
+void avp_l2_external(bool active)
+{
+    if (active && l2.request_hook != NULL && !avp_l2_busy()) {
+        l2.request_hook();
+    }
+    l2.external = active;
+}
+
+void avp_l2_yield(void)
+{
+    if (l2.yield == NULL || l2.in_yield) {
+        return;
+    }
+
+    l2.in_yield = true;
+    l2.yield();
+    l2.in_yield = false;
+}
+
+void avp_l2_ready_irq(void)
+{
+    l2_stats.ready_irqs++;
+    l2.ready_event = true;
+    l2.ready_live = true;
+}
+
+bool avp_l2_ready_pending(void)
+{
+    return l2.ready_event;
+}
+
+bool avp_l2_ready_live(void)
+{
+    return l2.ready_live;
+}
+
+bool avp_l2_wait_ready(uint32_t timeout_ms)
+{
+    uint64_t until = timer_get_time() + (uint64_t)timeout_ms * TIMER_MS;
+
+    while (!l2.ready_event && timer_get_time() < until) {
+        avp_l2_yield();
+    }
+    if (!l2.ready_event) {
+        return false;
+    }
+    /* A stale event costs one extra poll at most */
+    l2.ready_event = false;
+    return true;
+}
+
+const avp_l2_stats_t *avp_l2_get_stats(void)
+{
+    return &l2_stats;
+}
+
+bool avp_l2_count_response(const uint8_t *frame, size_t len)
+{
+    size_t data_len = len - 2;
+    uint16_t crc = (uint16_t)(frame[data_len] | (frame[data_len + 1] << 8));
+
+    if (avp_l2_crc16(frame, data_len) != crc) {
+        l2_stats.crc_errors++;
+        return false;
+    }
+    l2_stats.frames++;
+    return true;
+}
+
+/*============================================================================
+ * CRC
+ *============================================================================*/
+
+uint16_t avp_l2_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0;
+    size_t i;
+    int bit;
+
+    for (i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
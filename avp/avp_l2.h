@@ -0,0 +1,217 @@
+/**
+ * @file avp_l2.h
+ * @brief Non-blocking TROPIC01 L2 transport for NexusClaw
+ *
+ * Resumable state machine for one L2 exchange: request send, readiness
+ * polling and response read. Every SPI phase runs on DMA and the machine
+ * is advanced by avp_l2_step() from the main loop, so USB and queued
+ * requests keep moving while the secure element is busy. A pending
+ * response is read in the same poll: the SPI interrupt chains the data and
+ * CRC transfer as soon as the LEN byte is in.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_L2_H
+#define AVP_L2_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*============================================================================
+ * Constants
+ *============================================================================*/
+
+#define AVP_L2_GET_RESP         0xAA    /**< Get_Response request ID */
+#define AVP_L2_NO_RESP          0xFF    /**< STATUS when no response is pending */
+#define AVP_L2_CHIP_READY       0x01    /**< CHIP_STATUS ready bit */
+
+#define AVP_L2_DATA_MAX         255     /**< Max L2 frame data length */
+#define AVP_L2_FRAME_MAX        (2 + AVP_L2_DATA_MAX + 2)  /**< STATUS, LEN, data, CRC */
+
+#define AVP_L2_POLL_US          1000    /**< Interval between readiness polls */
+#define AVP_L2_IRQ_POLL_US      20000   /**< Poll interval once the ready line is known to work */
+
+/*============================================================================
+ * Types
+ *============================================================================*/
+
+/** Exchange state */
+typedef enum {
+    AVP_L2_IDLE = 0,            /**< No exchange in progress */
+    AVP_L2_SEND,                /**< Request on the wire */
+    AVP_L2_WAIT,                /**< Waiting for next readiness poll */
+    AVP_L2_HEADER,              /**< Get_Response, CHIP_STATUS/STATUS/LEN, data and CRC on the wire */
+    AVP_L2_DONE,                /**< Response received, CRC ok */
+    AVP_L2_EMPTY,               /**< No response pending (single poll only) */
+    AVP_L2_ERR_CRC,             /**< Response received, CRC mismatch */
+    AVP_L2_ERR_TIMEOUT,         /**< Chip did not answer in time */
+    AVP_L2_ERR_SPI              /**< SPI/DMA failure or invalid length */
+} avp_l2_state_t;
+
+/**
+ * @brief Exchange completion callback, called from avp_l2_step()
+ *
+ * @param result    Final state (AVP_L2_DONE .. AVP_L2_ERR_SPI)
+ * @param frame     Raw response frame: STATUS, LEN, data, CRC (NULL if none)
+ * @param len       Frame length
+ */
+typedef void (*avp_l2_done_t)(avp_l2_state_t result, const uint8_t *frame, size_t len);
+
+/** Background work run while a blocking caller waits for the chip */
+typedef void (*avp_l2_yield_t)(void);
+
+/** Runs before a request frame goes out, no SPI transfer in flight */
+typedef void (*avp_l2_request_hook_t)(void);
+
+/** Link counters */
+typedef struct {
+    uint32_t frames;            /**< Responses received */
+    uint32_t crc_errors;        /**< Responses with CRC mismatch */
+    uint32_t timeouts;          /**< Exchanges that timed out */
+    uint32_t polls;             /**< Readiness polls with no response */
+    uint32_t ready_irqs;        /**< Ready line (GPO) interrupts */
+    uint32_t spi_errors;        /**< SPI/DMA failures, invalid response lengths */
+} avp_l2_stats_t;
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+/**
+ * @brief Initialize transport
+ *
+ * @param yield Background work for avp_l2_yield() (NULL for none)
+ */
+void avp_l2_init(avp_l2_yield_t yield);
+
+/**
+ * @brief Set the request hook (clock boost for SE command bursts)
+ *
+ * @param hook Called from avp_l2_request() and avp_l2_external() on an
+ *             idle link (NULL for none)
+ */
+void avp_l2_set_request_hook(avp_l2_request_hook_t hook);
+
+/**
+ * @brief Start a request/response exchange
+ *
+ * Sends the request frame, then polls until the chip has a response or
+ * the timeout expires.
+ *
+ * @param req           Request frame: REQ_ID, LEN, data, CRC
+ * @param len           Request frame length
+ * @param timeout_ms    Response timeout
+ * @param done          Completion callback
+ * @return true when started, false when the link is busy
+ */
+bool avp_l2_request(const uint8_t *req, size_t len, uint32_t timeout_ms, avp_l2_done_t done);
+
+/**
+ * @brief Start a response-only read
+ *
+ * @param get_resp      Byte sent to request the response
+ * @param no_resp       STATUS value meaning no response is pending
+ * @param timeout_ms    Poll until timeout, 0 for a single poll
+ * @param done          Completion callback
+ * @return true when started, false when the link is busy
+ */
+bool avp_l2_read(uint8_t get_resp, uint8_t no_resp, uint32_t timeout_ms, avp_l2_done_t done);
+
+/**
+ * @brief Advance the exchange, never blocks
+ *
+ * @return Current state (AVP_L2_IDLE once the callback has run)
+ */
+avp_l2_state_t avp_l2_step(void);
+
+/**
+ * @brief Check if an exchange is in progress, ours or libtropic's
+ */
+bool avp_l2_busy(void);
+
+/**
+ * @brief Mark a libtropic frame on the wire (CS held by avp_lt_port.c)
+ *
+ * Starting one runs the request hook like avp_l2_request(). While it is
+ * active the link reads busy, so nothing else starts an exchange or
+ * changes the clock under it.
+ *
+ * @param active    true at CS low, false at CS high
+ */
+void avp_l2_external(bool active);
+
+/**
+ * @brief Run background work while a blocking caller waits
+ *
+ * Used by the libtropic port between SPI phases. Not re-entrant: nested
+ * calls return immediately.
+ */
+void avp_l2_yield(void);
+
+/**
+ * @brief Signal that the chip has a response ready (GPO interrupt)
+ *
+ * ISR safe. A waiting exchange polls on the next avp_l2_step() instead of
+ * at the next poll interval. Once the line has fired, the poll interval
+ * is stretched to AVP_L2_IRQ_POLL_US as a fallback only.
+ */
+void avp_l2_ready_irq(void);
+
+/**
+ * @brief Check if the ready line fired since the last poll
+ */
+bool avp_l2_ready_pending(void);
+
+/**
+ * @brief Check if the ready line has been seen working
+ */
+bool avp_l2_ready_live(void);
+
+/**
+ * @brief Wait for the ready line or a timeout, running background work
+ *
+ * The event is consumed.
+ *
+ * @param timeout_ms    Longest wait
+ * @return true when the line fired
+ */
+bool avp_l2_wait_ready(uint32_t timeout_ms);
+
+/**
+ * @brief Get link counters
+ */
+const avp_l2_stats_t *avp_l2_get_stats(void);
+
+/**
+ * @brief Check the CRC of a response frame read by libtropic and count it
+ *
+ * Keeps the link counters (frames, crc_errors) complete for traffic that
+ * does not go through this transport, see avp_lt_port.c.
+ *
+ * @param frame     Raw response frame: STATUS, LEN, data, CRC
+ * @param len       Frame length
+ * @return true when the CRC matches
+ */
+bool avp_l2_count_response(const uint8_t *frame, size_t len);
+
+/**
+ * @brief TROPIC01 L2 CRC16 (poly 0x8005, init 0, no reflection)
+ *
+ * @param data  Data to checksum
+ * @param len   Data length
+ * @return CRC, low byte is transmitted first
+ */
+uint16_t avp_l2_crc16(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_L2_H */
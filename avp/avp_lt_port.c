@@ -0,0 +1,151 @@
+/**
+ * @file avp_lt_port.c
+ * @brief libtropic HAL port for NexusClaw
+ *
+ * SPI runs on DMA; while a transfer is in flight or libtropic waits for
+ * the chip, avp_l2_yield() keeps USB, LED and watchdog serviced so a long
+ * secure element command does not stall the device. With LT_USE_INT_PIN
+ * libtropic waits on the GPO interrupt instead of polling.
+ *
+ * libtropic checks response CRCs itself and does not tell the port. The
+ * port checks every response it reads once more and feeds the result into
+ * the avp_l2 link counters, which avp_spi_tune_check() watches.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_l2.h"
+#include "avp_hw.h"
+#include "spi.h"
+#include "time.h"
+
+/* libtropic SDK */
+#include "libtropic_common.h"
+#include "libtropic_port.h"
+
+/* Response read under the current CS, bytes of s2->buff clocked so far */
+static struct {
+    bool get_resp;
+    size_t end;
+} lt_read;
+
+/* CHIP_STATUS, then STATUS, LEN, data and CRC as read by lt_l1_read() */
+static void lt_read_count(const uint8_t *buff)
+{
+    if (!lt_read.get_resp || lt_read.end < 3 ||
+        !(buff[0] & AVP_L2_CHIP_READY) || buff[1] == AVP_L2_NO_RESP) {
+        return;
+    }
+    /* Cut short (length error), libtropic reports it on its own */
+    if (lt_read.end < 3 + (size_t)buff[2] + 2) {
+        return;
+    }
+    avp_l2_count_response(buff + 1, (size_t)buff[2] + 4);
+}
+
+/*============================================================================
+ * libtropic Port
+ *============================================================================*/
+
+lt_ret_t lt_port_init(lt_l2_state_t *s2)
+{
+    (void)s2;
+
+    /* SPI1 is owned and initialized by the application */
+    return LT_OK;
+}
+
+lt_ret_t lt_port_deinit(lt_l2_state_t *s2)
+{
+    (void)s2;
+    return LT_OK;
+}
+
+lt_ret_t lt_port_spi_csn_low(lt_l2_state_t *s2)
+{
+    (void)s2;
+    lt_read.get_resp = false;
+    lt_read.end = 0;
+
+    /* Clock boost (CLOCK=AUTO) before the frame, held until CS goes high */
+    avp_l2_external(true);
+    spi1_cs(SPI_CS_ACTIVE);
+    return LT_OK;
+}
+
+lt_ret_t lt_port_spi_csn_high(lt_l2_state_t *s2)
+{
+    spi1_cs(SPI_CS_IDLE);
+    avp_l2_external(false);
+    lt_read_count(s2->buff);
+    lt_read.get_resp = false;
+    return LT_OK;
+}
+
+lt_ret_t lt_port_spi_transfer(lt_l2_state_t *s2, uint8_t offset, uint16_t tx_data_length,
+                              uint32_t timeout_ms)
+{
+    uint64_t deadline;
+
+    if ((size_t)offset + tx_data_length > LT_L1_LEN_MAX) {
+        return LT_L1_DATA_LEN_ERROR;
+    }
+
+    /* A read starts with the Get_Response ID, overwritten by CHIP_STATUS */
+    if (offset == 0) {
+        lt_read.get_resp = (s2->buff[0] == AVP_L2_GET_RESP);
+    }
+
+    /* In-place transfer, TX always runs ahead of RX on the same buffer */
+    if (!spi1_data_transfer_start(s2->buff + offset, s2->buff + offset, tx_data_length)) {
+        return LT_L1_SPI_ERROR;
+    }
+
+    deadline = timer_get_time() + (uint64_t)timeout_ms * TIMER_MS;
+    while (!spi1_transfer_done()) {
+        if (timer_get_time() >= deadline) {
+            /* DMA must not keep writing into s2->buff after we return */
+            spi1_abort();
+            spi1_cs(SPI_CS_IDLE);
+            avp_l2_external(false);
+            return LT_L1_SPI_ERROR;
+        }
+        avp_l2_yield();
+    }
+    if ((size_t)offset + tx_data_length > lt_read.end) {
+        lt_read.end = (size_t)offset + tx_data_length;
+    }
+    return LT_OK;
+}
+
+lt_ret_t lt_port_delay(lt_l2_state_t *s2, uint32_t ms)
+{
+    uint64_t until = timer_get_time() + (uint64_t)ms * TIMER_MS;
+
+    (void)s2;
+    while (timer_get_time() < until) {
+        avp_l2_yield();
+    }
+    return LT_OK;
+}
+
+#ifdef LT_USE_INT_PIN
+lt_ret_t lt_port_delay_on_int(lt_l2_state_t *s2, uint32_t ms)
+{
+    (void)s2;
+
+    /* Woken by the GPO interrupt, no SPI polling while the chip computes */
+    avp_l2_wait_ready(ms);
+    return LT_OK;
+}
+#endif
+
+lt_ret_t lt_port_random_bytes(lt_l2_state_t *s2, void *buff, size_t count)
+{
+    (void)s2;
+    if (!avp_hw_random_bytes((uint8_t *)buff, count)) {
+        return LT_FAIL;
+    }
+    return LT_OK;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file avp_sha256.c
+ * @brief Streaming SHA-256 for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_sha256.h"
+#include <string.h>
+
+/*============================================================================
+ * Compression Function
+ *============================================================================*/
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Single instruction on Cortex-M (ROR), and folded into EOR as a shifted operand */
+#define ROR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define S0(x)       (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x)       (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define G0(x)       (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define G1(x)       (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+/* Ch and Maj in their 3-operation forms */
+#define CH(e, f, g)     ((g) ^ ((e) & ((f) ^ (g))))
+#define MAJ(a, b, c)    (((a) & (b)) | ((c) & ((a) | (b))))
+
+/* Message schedule kept in a 16 word ring, computed just in time */
+#define W(i)        w[(i) & 15]
+#define SCHED(i)    (W(i) += G1(W((i) - 2)) + W((i) - 7) + G0(W((i) - 15)))
+
+/*
+ * One round without register shuffling: the caller rotates the variable
+ * names instead, so every round is the same few instructions.
+ */
+#define ROUND(a, b, c, d, e, f, g, h, i, wi) do {       \
+        uint32_t t1 = h + S1(e) + CH(e, f, g) + K[i] + (wi); \
+        d += t1;                                        \
+        h = t1 + S0(a) + MAJ(a, b, c);                  \
+    } while (0)
+
+#define ROUND8(i, wexp) do {                            \
+        ROUND(a, b, c, d, e, f, g, h, (i) + 0, wexp((i) + 0)); \
+        ROUND(h, a, b, c, d, e, f, g, (i) + 1, wexp((i) + 1)); \
+        ROUND(g, h, a, b, c, d, e, f, (i) + 2, wexp((i) + 2)); \
+        ROUND(f, g, h, a, b, c, d, e, (i) + 3, wexp((i) + 3)); \
+        ROUND(e, f, g, h, a, b, c, d, (i) + 4, wexp((i) + 4)); \
+        ROUND(d, e, f, g, h, a, b, c, (i) + 5, wexp((i) + 5)); \
+        ROUND(c, d, e, f, g, h, a, b, (i) + 6, wexp((i) + 6)); \
+        ROUND(b, c, d, e, f, g, h, a, (i) + 7, wexp((i) + 7)); \
+    } while (0)
+
+static inline uint32_t load_be32(const uint8_t *p)
+{
+    uint32_t v;
+
+    /* Unaligned LDR + REV on Cortex-M33 */
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    return __builtin_bswap32(v);
+#else
+    return v;
+#endif
+}
+
+static inline void store_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    uint32_t w[16];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    while (blocks--) {
+        for (i = 0; i < 16; i++) {
+            w[i] = load_be32(data + i * 4);
+        }
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        ROUND8(0, W);
+        ROUND8(8, W);
+        ROUND8(16, SCHED);
+        ROUND8(24, SCHED);
+        ROUND8(32, SCHED);
+        ROUND8(40, SCHED);
+        ROUND8(48, SCHED);
+        ROUND8(56, SCHED);
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+        data += AVP_SHA256_BLOCK_LEN;
+    }
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+void avp_sha256_init(avp_sha256_t *ctx)
+{
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->total = 0;
+}
+
+void avp_sha256_update(avp_sha256_t *ctx, const uint8_t *data, size_t len)
+{
+    size_t used = (size_t)(ctx->total & (AVP_SHA256_BLOCK_LEN - 1));
+    size_t blocks;
+
+    ctx->total += len;
+
+    /* Complete a pending partial block first */
+    if (used) {
+        size_t fill = AVP_SHA256_BLOCK_LEN - used;
+
+        if (len < fill) {
+            memcpy(ctx->block + used, data, len);
+            return;
+        }
+        memcpy(ctx->block + used, data, fill);
+        sha256_blocks(ctx->state, ctx->block, 1);
+        data += fill;
+        len -= fill;
+    }
+
+    /* Whole blocks straight from the caller's buffer, no copy */
+    blocks = len / AVP_SHA256_BLOCK_LEN;
+    if (blocks) {
+        sha256_blocks(ctx->state, data, blocks);
+        data += blocks * AVP_SHA256_BLOCK_LEN;
+        len -= blocks * AVP_SHA256_BLOCK_LEN;
+    }
+
+    if (len) {
+        memcpy(ctx->block, data, len);
+    }
+}
+
+void avp_sha256_final(avp_sha256_t *ctx, uint8_t digest[AVP_SHA256_DIGEST_LEN])
+{
+    size_t used = (size_t)(ctx->total & (AVP_SHA256_BLOCK_LEN - 1));
+    uint64_t bits = ctx->total << 3;
+    int i;
+
+    ctx->block[used++] = 0x80;
+    if (used > AVP_SHA256_BLOCK_LEN - 8) {
+        memset(ctx->block + used, 0, AVP_SHA256_BLOCK_LEN - used);
+        sha256_blocks(ctx->state, ctx->block, 1);
+        used = 0;
+    }
+    memset(ctx->block + used, 0, AVP_SHA256_BLOCK_LEN - 8 - used);
+
+    store_be32(ctx->block + 56, (uint32_t)(bits >> 32));
+    store_be32(ctx->block + 60, (uint32_t)bits);
+    sha256_blocks(ctx->state, ctx->block, 1);
+
+    for (i = 0; i < 8; i++) {
+        store_be32(digest + i * 4, ctx->state[i]);
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+}
@@ -0,0 +1,59 @@
+/**
+ * @file avp_sha256.h
+ * @brief Streaming SHA-256 for NexusClaw
+ *
+ * Used to hash payloads larger than one AVP line before they are signed
+ * by TROPIC01. Portable C, written so GCC maps it well onto Cortex-M33
+ * (REV for loads, ROR folded into EOR, fully unrolled rounds).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_SHA256_H
+#define AVP_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AVP_SHA256_BLOCK_LEN    64
+#define AVP_SHA256_DIGEST_LEN   32
+
+/** Hash state */
+typedef struct {
+    uint32_t state[8];                      /**< Chaining value */
+    uint64_t total;                         /**< Bytes hashed so far */
+    uint8_t block[AVP_SHA256_BLOCK_LEN];    /**< Partial block */
+} avp_sha256_t;
+
+/**
+ * @brief Start a new hash
+ */
+void avp_sha256_init(avp_sha256_t *ctx);
+
+/**
+ * @brief Hash more data
+ *
+ * @param ctx   Hash state
+ * @param data  Data to hash
+ * @param len   Data length
+ */
+void avp_sha256_update(avp_sha256_t *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Finish the hash
+ *
+ * @param ctx       Hash state (must be re-initialized before reuse)
+ * @param digest    Output: 32 byte digest
+ */
+void avp_sha256_final(avp_sha256_t *ctx, uint8_t digest[AVP_SHA256_DIGEST_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_SHA256_H */
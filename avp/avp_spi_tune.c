@@ -0,0 +1,222 @@
+/**
+ * @file avp_spi_tune.c
+ * @brief TROPIC01 SPI clock calibration for NexusClaw
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include "avp_spi_tune.h"
+#include "avp_l2.h"
+#include "spi.h"
+#include "nvm.h"
+#include "os.h"
+#include <string.h>
+
+/* Get_Info_Req for the CHIP_ID object: fixed 128 byte answer */
+#define TUNE_GET_INFO_REQ       0x01
+#define TUNE_OBJ_CHIP_ID        0x01
+#define TUNE_TIMEOUT_MS         50
+#define TUNE_REF_ATTEMPTS       3
+
+#define TUNE_DIV_MAX            256
+
+/* Candidate prescalers, slowest first */
+static const uint16_t tune_divs[] = {AVP_SPI_TUNE_SAFE_DIV, 16, 8, 4, 2};
+#define TUNE_STEPS              (sizeof(tune_divs) / sizeof(tune_divs[0]))
+
+/*============================================================================
+ * Static Variables
+ *============================================================================*/
+
+static avp_spi_tune_t tune;
+
+static struct {
+    volatile avp_l2_state_t result;
+    uint8_t frame[AVP_L2_FRAME_MAX];
+    size_t len;
+} probe;
+
+static uint8_t reference[AVP_L2_FRAME_MAX];
+static size_t reference_len;
+
+/* Runtime check window start */
+static uint32_t window_frames;
+static uint32_t window_crc;
+
+/*============================================================================
+ * Probe Exchange
+ *============================================================================*/
+
+static void probe_done(avp_l2_state_t result, const uint8_t *frame, size_t len)
+{
+    if (frame != NULL && len <= sizeof(probe.frame)) {
+        memcpy(probe.frame, frame, len);
+        probe.len = len;
+    } else {
+        probe.len = 0;
+    }
+    probe.result = result;
+}
+
+/* One Get_Info exchange, blocking */
+static avp_l2_state_t probe_exchange(void)
+{
+    uint8_t req[6] = {TUNE_GET_INFO_REQ, 2, TUNE_OBJ_CHIP_ID, 0};
+    uint16_t crc = avp_l2_crc16(req, 4);
+
+    req[4] = (uint8_t)crc;
+    req[5] = (uint8_t)(crc >> 8);
+
+    probe.result = AVP_L2_IDLE;
+    if (!avp_l2_request(req, sizeof(req), TUNE_TIMEOUT_MS, probe_done)) {
+        return AVP_L2_ERR_SPI;
+    }
+    while (probe.result == AVP_L2_IDLE) {
+        avp_l2_step();
+        avp_l2_yield();
+    }
+    return probe.result;
+}
+
+/* All rounds must return the reference response */
+static bool probe_rounds(void)
+{
+    int i;
+
+    for (i = 0; i < AVP_SPI_TUNE_ROUNDS; i++) {
+        if (probe_exchange() != AVP_L2_DONE ||
+            probe.len != reference_len ||
+            memcmp(probe.frame, reference, reference_len) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tune_apply(uint16_t prescaler, uint8_t slew)
+{
+    spi1_set_prescaler(prescaler);
+    spi1_set_slew(slew);
+}
+
+static void window_reset(void)
+{
+    const avp_l2_stats_t *stats = avp_l2_get_stats();
+
+    window_frames = stats->frames;
+    window_crc = stats->crc_errors;
+}
+
+/*============================================================================
+ * API Functions
+ *============================================================================*/
+
+bool avp_spi_tune_calibrate(void)
+{
+    uint8_t slews[TUNE_STEPS];
+    nvm_cfg_t cfg;
+    int best = -1;
+    int pick;
+    size_t i;
+    uint8_t slew;
+    bool ok = false;
+
+    /* Reference response at a rate every board handles */
+    tune_apply(AVP_SPI_TUNE_SAFE_DIV, SPI_SLEW_LOW);
+    for (i = 0; i < TUNE_REF_ATTEMPTS && !ok; i++) {
+        ok = (probe_exchange() == AVP_L2_DONE && probe.len > 0);
+    }
+    if (!ok) {
+        window_reset();
+        return false;
+    }
+    memcpy(reference, probe.frame, probe.len);
+    reference_len = probe.len;
+
+    /* Stop at the first rate no slew setting can carry */
+    for (i = 0; i < TUNE_STEPS; i++) {
+        spi1_set_prescaler(tune_divs[i]);
+        for (slew = SPI_SLEW_LOW; slew <= SPI_SLEW_VERY_HIGH; slew++) {
+            spi1_set_slew(slew);
+            if (probe_rounds()) {
+                break;
+            }
+        }
+        if (slew > SPI_SLEW_VERY_HIGH) {
+            break;
+        }
+        slews[i] = slew;
+        best = (int)i;
+    }
+
+    if (best < 0) {
+        /* Reference came back once but the link is not stable at all */
+        tune_apply(TUNE_DIV_MAX, SPI_SLEW_LOW);
+        window_reset();
+        return false;
+    }
+
+    /* One step of margin below the fastest passing rate */
+    pick = (best > 0) ? best - 1 : 0;
+    tune.prescaler = tune_divs[pick];
+    tune.slew = slews[pick];
+    tune_apply(tune.prescaler, tune.slew);
+
+    memset(&cfg, 0, sizeof(cfg));
+    nvm_cfg_load(&cfg);
+    cfg.spi_prescaler = tune.prescaler;
+    cfg.spi_slew = tune.slew;
+    tune.saved = nvm_cfg_save(&cfg);
+
+    window_reset();
+    return true;
+}
+
+void avp_spi_tune_boot(void)
+{
+    nvm_cfg_t cfg;
+
+    if (nvm_cfg_load(&cfg) && cfg.spi_prescaler != 0 &&
+        spi1_set_prescaler(cfg.spi_prescaler) && spi1_set_slew(cfg.spi_slew)) {
+        tune.prescaler = cfg.spi_prescaler;
+        tune.slew = cfg.spi_slew;
+        tune.saved = true;
+        window_reset();
+        OS_PRINTF("# SPI CLKDIV: %u (saved)\r\n", tune.prescaler);
+        return;
+    }
+
+    if (avp_spi_tune_calibrate()) {
+        OS_PRINTF("# SPI CLKDIV: %u (calibrated)\r\n", tune.prescaler);
+    } else {
+        OS_PRINTF("# SPI CLKDIV: %lu (no response)\r\n", spi1_get_prescaler());
+    }
+}
+
+void avp_spi_tune_check(void)
+{
+    const avp_l2_stats_t *stats = avp_l2_get_stats();
+    uint32_t crc = stats->crc_errors - window_crc;
+    uint32_t seen = (stats->frames - window_frames) + crc;
+    uint32_t prescaler;
+
+    if (crc >= AVP_SPI_TUNE_CRC_LIMIT) {
+        /* Never touch the clock with a transfer on the wire */
+        if (avp_l2_busy() || spi1_cs_state() == SPI_CS_ACTIVE) {
+            return;
+        }
+        prescaler = spi1_get_prescaler();
+        if (prescaler < TUNE_DIV_MAX && spi1_set_prescaler(prescaler * 2)) {
+            tune.fallbacks++;
+        }
+        window_reset();
+    } else if (seen >= AVP_SPI_TUNE_WINDOW) {
+        window_reset();
+    }
+}
+
+const avp_spi_tune_t *avp_spi_tune_get(void)
+{
+    return &tune;
+}
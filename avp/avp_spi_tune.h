@@ -0,0 +1,78 @@
+/**
+ * @file avp_spi_tune.h
+ * @brief TROPIC01 SPI clock calibration for NexusClaw
+ *
+ * Finds the fastest SPI clock the TROPIC01 link carries reliably on this
+ * board: the prescaler is stepped down from a safe rate, at each step the
+ * pin slew rate is raised until a burst of CRC-checked L2 exchanges
+ * returns the reference response, and one step of margin is kept below
+ * the fastest passing rate. The result is kept in flash and applied at
+ * boot. Repeated CRC errors at runtime halve the clock until next boot.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#ifndef AVP_SPI_TUNE_H
+#define AVP_SPI_TUNE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Prescaler used before calibration and to take the reference response */
+#define AVP_SPI_TUNE_SAFE_DIV       32
+
+/** Exchanges that must all pass at one setting */
+#define AVP_SPI_TUNE_ROUNDS         16
+
+/** Runtime check: CRC errors within a window of exchanges that slow the clock */
+#define AVP_SPI_TUNE_WINDOW         32
+#define AVP_SPI_TUNE_CRC_LIMIT      2
+
+/** Calibration state */
+typedef struct {
+    uint16_t prescaler;         /**< Calibrated prescaler, 0 if none */
+    uint8_t slew;               /**< Calibrated pin slew rate (SPI_SLEW_xxx) */
+    bool saved;                 /**< Loaded from or stored to flash */
+    uint32_t fallbacks;         /**< Runtime slow downs after CRC errors */
+} avp_spi_tune_t;
+
+/**
+ * @brief Apply the stored setting, calibrate and store if there is none
+ *
+ * Call once after avp_l2_init(), before the TROPIC01 session is opened.
+ */
+void avp_spi_tune_boot(void);
+
+/**
+ * @brief Calibrate the link now and store the result
+ *
+ * Blocking (well under a second), background services keep running
+ * through avp_l2_yield(). The link must be idle.
+ *
+ * @return false when the chip did not answer, the clock is left at a
+ *         safe rate and nothing is stored
+ */
+bool avp_spi_tune_calibrate(void);
+
+/**
+ * @brief Watch link CRC errors, slow the clock down when they pile up
+ *
+ * Call from the main loop.
+ */
+void avp_spi_tune_check(void);
+
+/**
+ * @brief Get calibration state
+ */
+const avp_spi_tune_t *avp_spi_tune_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AVP_SPI_TUNE_H */
@@ -2,12 +2,18 @@
  * @file avp_tropic.c
  * @brief libtropic integration for AVP on NexusClaw
  *
+ * Written against the libtropic v2.0.0 API (submodule libtropic/), the same
+ * release as the port layer in avp_lt_port.c.
+ *
  * SPDX-License-Identifier: Apache-2.0
  * Copyright (c) 2025 AVP Protocol Contributors
  */
 
 #include "avp_tropic.h"
+#include "avp_der.h"
+#include "avp_keys.h"
 #include <string.h>
+#include <stdio.h>
 
 /* libtropic SDK */
 #include "libtropic.h"
@@ -19,6 +25,21 @@
 static lt_handle_t lt_handle;
 static bool lt_initialized = false;
 
+/* Device identity, read from TROPIC01 once and served from RAM afterwards */
+static struct {
+    bool valid;
+    char serial[32];
+    char fw_version[16];
+} lt_identity;
+
+/* Buffer per certificate of the TROPIC01 certificate store */
+#define TROPIC_CERT_MAX     700
+
+/* X.520 serialNumber attribute (2.5.4.5) */
+static const uint8_t OID_SERIAL_NUMBER[] = { 0x55, 0x04, 0x05 };
+
+static void tropic_identity_load(void);
+
 /*============================================================================
  * libtropic Initialization
  *============================================================================*/
@@ -41,6 +62,9 @@ avp_ret_t avp_tropic_init(avp_ctx_t *ctx)
     ctx->tropic_handle = &lt_handle;
     lt_initialized = true;
 
+    /* Read certificate and firmware version now, keeps SPI off the request path */
+    tropic_identity_load();
+
     return AVP_OK;
 }
 
@@ -49,6 +73,7 @@ void avp_tropic_deinit(avp_ctx_t *ctx)
     if (lt_initialized) {
         lt_deinit(&lt_handle);
         lt_initialized = false;
+        lt_identity.valid = false;
         ctx->tropic_handle = NULL;
     }
 }
@@ -99,8 +124,11 @@ avp_ret_t avp_tropic_store(avp_ctx_t *ctx, uint8_t slot, const uint8_t *data, si
         return AVP_ERR_CAPACITY;
     }
 
-    /* Write data to TROPIC01 r_mem slot */
-    ret = lt_r_mem_data_write(&lt_handle, slot, data, len);
+    /* R_Mem_Data_Write refuses an occupied slot, erase first (update) */
+    ret = lt_r_mem_data_erase(&lt_handle, slot);
+    if (ret == LT_OK) {
+        ret = lt_r_mem_data_write(&lt_handle, slot, data, (uint16_t)len);
+    }
     if (ret != LT_OK) {
         return AVP_ERR_HARDWARE;
     }
@@ -111,7 +139,7 @@ avp_ret_t avp_tropic_store(avp_ctx_t *ctx, uint8_t slot, const uint8_t *data, si
 avp_ret_t avp_tropic_retrieve(avp_ctx_t *ctx, uint8_t slot, uint8_t *data, size_t *len)
 {
     lt_ret_t ret;
-    uint16_t read_len;
+    uint16_t read_len = 0;
 
     if (!lt_initialized || !ctx->tropic_handle) {
         return AVP_ERR_HARDWARE;
@@ -121,12 +149,10 @@ avp_ret_t avp_tropic_retrieve(avp_ctx_t *ctx, uint8_t slot, uint8_t *data, size_
         return AVP_ERR_INVALID_PARAM;
     }
 
-    read_len = (uint16_t)*len;
-
     /* Read data from TROPIC01 r_mem slot */
-    ret = lt_r_mem_data_read(&lt_handle, slot, data, &read_len);
+    ret = lt_r_mem_data_read(&lt_handle, slot, data, (uint16_t)*len, &read_len);
     if (ret != LT_OK) {
-        if (ret == LT_L3_INVALID_SLOT) {
+        if (ret == LT_L3_R_MEM_DATA_READ_SLOT_EMPTY) {
             return AVP_ERR_SECRET_NOT_FOUND;
         }
         return AVP_ERR_HARDWARE;
@@ -148,9 +174,7 @@ avp_ret_t avp_tropic_erase(avp_ctx_t *ctx, uint8_t slot)
         return AVP_ERR_INVALID_PARAM;
     }
 
-    /* Erase slot by writing zeros */
-    uint8_t zeros[256] = {0};
-    ret = lt_r_mem_data_write(&lt_handle, slot, zeros, sizeof(zeros));
+    ret = lt_r_mem_data_erase(&lt_handle, slot);
     if (ret != LT_OK) {
         return AVP_ERR_HARDWARE;
     }
@@ -162,7 +186,76 @@ avp_ret_t avp_tropic_erase(avp_ctx_t *ctx, uint8_t slot)
  * Cryptographic Operations
  *============================================================================*/
 
-avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot,
+avp_ret_t avp_tropic_key_generate(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t curve,
+                                  uint8_t *pubkey, size_t *pubkey_len)
+{
+    lt_ret_t ret;
+    lt_ecc_curve_type_t rd_curve;
+    lt_ecc_key_origin_t origin;
+    size_t len = (curve == AVP_CURVE_ED25519) ? 32 : 64;
+
+    if (!lt_initialized || !ctx->tropic_handle) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    /* Never touch the attestation key */
+    if (key_slot == AVP_KEY_SLOT_ATTEST || key_slot > AVP_SLOT_KEYS_END) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    if (*pubkey_len < len) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    /* ECC_Key_Generate fails on an occupied slot, erase first (rotation) */
+    lt_ecc_key_erase(&lt_handle, (lt_ecc_slot_t)key_slot);
+
+    ret = lt_ecc_key_generate(&lt_handle, (lt_ecc_slot_t)key_slot,
+                              (curve == AVP_CURVE_ED25519) ? TR01_CURVE_ED25519 : TR01_CURVE_P256);
+    if (ret != LT_OK) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    ret = lt_ecc_key_read(&lt_handle, (lt_ecc_slot_t)key_slot, pubkey, (uint8_t)len,
+                          &rd_curve, &origin);
+    if (ret != LT_OK) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    *pubkey_len = len;
+    return AVP_OK;
+}
+
+avp_ret_t avp_tropic_key_read(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t *curve,
+                              uint8_t *pubkey, size_t *pubkey_len)
+{
+    lt_ret_t ret;
+    lt_ecc_curve_type_t rd_curve;
+    lt_ecc_key_origin_t origin;
+
+    if (!lt_initialized || !ctx->tropic_handle) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    if (key_slot > AVP_SLOT_KEYS_END || *pubkey_len < 64) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    ret = lt_ecc_key_read(&lt_handle, (lt_ecc_slot_t)key_slot, pubkey, (uint8_t)*pubkey_len,
+                          &rd_curve, &origin);
+    if (ret == LT_L3_ECC_INVALID_KEY) {
+        return AVP_ERR_KEY_NOT_FOUND;
+    }
+    if (ret != LT_OK) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    *curve = (rd_curve == TR01_CURVE_ED25519) ? AVP_CURVE_ED25519 : AVP_CURVE_P256;
+    *pubkey_len = avp_curve_pubkey_len(*curve);
+    return AVP_OK;
+}
+
+avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t curve,
                           const uint8_t *data, size_t data_len,
                           uint8_t *signature, size_t *sig_len)
 {
@@ -172,7 +265,8 @@ avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot,
         return AVP_ERR_HARDWARE;
     }
 
-    if (key_slot > AVP_SLOT_KEYS_END) {
+    /* The attestation key only signs challenges, see avp_tropic_attest() */
+    if (key_slot == AVP_KEY_SLOT_ATTEST || key_slot > AVP_SLOT_KEYS_END) {
         return AVP_ERR_INVALID_PARAM;
     }
 
@@ -180,13 +274,51 @@ avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot,
         return AVP_ERR_INVALID_PARAM;
     }
 
-    /* Sign with ECDSA P-256 */
-    ret = lt_ecc_ecdsa_sign(&lt_handle, key_slot, data, data_len,
-                            signature, (uint16_t *)sig_len);
+    if (curve == AVP_CURVE_ED25519) {
+        /* Sign with EdDSA Ed25519 */
+        ret = lt_ecc_eddsa_sign(&lt_handle, (lt_ecc_slot_t)key_slot, data, (uint16_t)data_len,
+                                signature);
+    } else {
+        /* Sign with ECDSA P-256, libtropic hashes the message with SHA-256 */
+        ret = lt_ecc_ecdsa_sign(&lt_handle, (lt_ecc_slot_t)key_slot, data, (uint32_t)data_len,
+                                signature);
+    }
     if (ret != LT_OK) {
         return AVP_ERR_CRYPTO;
     }
 
+    *sig_len = 64;
+    return AVP_OK;
+}
+
+avp_ret_t avp_tropic_sign_digest(avp_ctx_t *ctx, uint8_t key_slot,
+                                 const uint8_t digest[AVP_SHA256_DIGEST_LEN],
+                                 uint8_t *signature, size_t *sig_len)
+{
+    lt_ret_t ret;
+
+    if (!lt_initialized || !ctx->tropic_handle) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    /* The attestation key only signs challenges, see avp_tropic_attest() */
+    if (key_slot == AVP_KEY_SLOT_ATTEST || key_slot > AVP_SLOT_KEYS_END) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    if (*sig_len < 64) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    /* libtropic has no call taking a precomputed hash: the digest is signed
+     * as a 32 byte message, i.e. the signature covers SHA-256(digest) */
+    ret = lt_ecc_ecdsa_sign(&lt_handle, (lt_ecc_slot_t)key_slot, digest,
+                            AVP_SHA256_DIGEST_LEN, signature);
+    if (ret != LT_OK) {
+        return AVP_ERR_CRYPTO;
+    }
+
+    *sig_len = 64;
     return AVP_OK;
 }
 
@@ -194,34 +326,99 @@ avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot,
  * Device Information
  *============================================================================*/
 
-avp_ret_t avp_tropic_get_info(avp_ctx_t *ctx, char *serial, char *fw_version)
+static void hex_encode_upper(const uint8_t *data, size_t len, char *out, size_t out_len)
 {
-    lt_ret_t ret;
-    uint8_t x509_cert[512];
-    uint16_t cert_len = sizeof(x509_cert);
+    static const char hex[] = "0123456789ABCDEF";
+    size_t i;
+
+    for (i = 0; i < len && (i * 2 + 2) < out_len; i++) {
+        out[i * 2] = hex[data[i] >> 4];
+        out[i * 2 + 1] = hex[data[i] & 0x0F];
+    }
+    out[i * 2] = '\0';
+}
+
+static bool tropic_parse_serial(const uint8_t *cert, size_t cert_len, char *serial, size_t len)
+{
+    avp_der_tlv_t tlv;
+
+    /* Prefer the subject serialNumber attribute, it is the printable chip serial */
+    if (avp_der_find_attr(cert, cert_len, OID_SERIAL_NUMBER, sizeof(OID_SERIAL_NUMBER), &tlv) &&
+        (tlv.tag == AVP_DER_PRINTABLE_STRING || tlv.tag == AVP_DER_UTF8_STRING) &&
+        tlv.len > 0 && tlv.len < len) {
+        memcpy(serial, tlv.val, tlv.len);
+        serial[tlv.len] = '\0';
+        return true;
+    }
 
+    /* Otherwise fall back to the certificate serialNumber INTEGER */
+    if (avp_der_cert_serial(cert, cert_len, &tlv) && tlv.len > 0) {
+        /* Skip the sign padding octet */
+        if (tlv.len > 1 && tlv.val[0] == 0x00) {
+            tlv.val++;
+            tlv.len--;
+        }
+        hex_encode_upper(tlv.val, tlv.len, serial, len);
+        return true;
+    }
+
+    return false;
+}
+
+static void tropic_identity_load(void)
+{
+    /* Static: about 2.8K, too much for the request path stack */
+    static uint8_t certs[LT_NUM_CERTIFICATES][TROPIC_CERT_MAX];
+    struct lt_cert_store_t store;
+    uint8_t fw_ver[TR01_L2_GET_INFO_RISCV_FW_SIZE];
+
+    if (lt_identity.valid) {
+        return;
+    }
+
+    /* The whole store is read at once, only the device certificate is used */
+    for (int i = 0; i < LT_NUM_CERTIFICATES; i++) {
+        store.certs[i] = certs[i];
+        store.buf_len[i] = sizeof(certs[i]);
+    }
+
+    /* Device certificate carries the serial */
+    if (lt_get_info_cert_store(&lt_handle, &store) != LT_OK ||
+        !tropic_parse_serial(store.certs[LT_CERT_KIND_DEVICE], store.cert_len[LT_CERT_KIND_DEVICE],
+                             lt_identity.serial, sizeof(lt_identity.serial))) {
+        return;
+    }
+
+    /* RISC-V firmware version, little endian: [3].[2].[1].[0] */
+    if (lt_get_info_riscv_fw_ver(&lt_handle, fw_ver) != LT_OK) {
+        return;
+    }
+    snprintf(lt_identity.fw_version, sizeof(lt_identity.fw_version), "%u.%u.%u.%u",
+             fw_ver[3], fw_ver[2], fw_ver[1], fw_ver[0]);
+
+    lt_identity.valid = true;
+}
+
+avp_ret_t avp_tropic_get_info(avp_ctx_t *ctx, char *serial, char *fw_version)
+{
     if (!lt_initialized || !ctx->tropic_handle) {
         /* Return placeholder info if not initialized */
         if (serial) strncpy(serial, "NC00000001", 31);
         if (fw_version) strncpy(fw_version, "1.0.0", 15);
-        return AVP_OK;
+        return AVP_ERR_HARDWARE;
     }
 
-    /* Get device certificate which contains serial info */
-    ret = lt_get_info_cert(&lt_handle, x509_cert, &cert_len);
-    if (ret == LT_OK) {
-        /* Parse serial from certificate - simplified */
-        if (serial) {
-            /* For now, use a placeholder - real implementation would parse X.509 */
-            strncpy(serial, "NC00000001", 31);
-        }
-    } else {
+    /* Only touches SPI when the read at init failed */
+    tropic_identity_load();
+
+    if (!lt_identity.valid) {
         if (serial) strncpy(serial, "UNKNOWN", 31);
+        if (fw_version) strncpy(fw_version, "UNKNOWN", 15);
+        return AVP_ERR_HARDWARE;
     }
 
-    if (fw_version) {
-        strncpy(fw_version, "1.0.0", 15);
-    }
+    if (serial) strncpy(serial, lt_identity.serial, 31);
+    if (fw_version) strncpy(fw_version, lt_identity.fw_version, 15);
 
     return AVP_OK;
 }
@@ -244,11 +441,37 @@ avp_ret_t avp_tropic_attest(avp_ctx_t *ctx, const uint8_t *challenge,
     }
 
     /* Sign challenge with device attestation key (slot 0) */
-    ret = lt_ecc_ecdsa_sign(&lt_handle, 0, challenge, 32,
-                            response, (uint16_t *)resp_len);
+    ret = lt_ecc_ecdsa_sign(&lt_handle, (lt_ecc_slot_t)AVP_KEY_SLOT_ATTEST, challenge, 32,
+                            response);
     if (ret != LT_OK) {
         return AVP_ERR_CRYPTO;
     }
 
+    *resp_len = 64;
+
+    return AVP_OK;
+}
+
+/*============================================================================
+ * Random Number Generator
+ *============================================================================*/
+
+avp_ret_t avp_tropic_random(avp_ctx_t *ctx, uint8_t *buf, size_t len)
+{
+    lt_ret_t ret;
+
+    if (!lt_initialized || !ctx->tropic_handle) {
+        return AVP_ERR_HARDWARE;
+    }
+
+    if (len > 255) {
+        return AVP_ERR_INVALID_PARAM;
+    }
+
+    ret = lt_random_value_get(&lt_handle, buf, (uint16_t)len);
+    if (ret != LT_OK) {
+        return AVP_ERR_HARDWARE;
+    }
+
     return AVP_OK;
 }
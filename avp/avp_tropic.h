@@ -92,27 +92,77 @@ avp_ret_t avp_tropic_retrieve(avp_ctx_t *ctx, uint8_t slot, uint8_t *data, size_
 avp_ret_t avp_tropic_erase(avp_ctx_t *ctx, uint8_t slot);
 
 /**
- * @brief Sign data with TROPIC01 ECC key
+ * @brief Generate (or replace) an ECC key in TROPIC01
+ *
+ * @param ctx           AVP context
+ * @param key_slot      Key slot index (1-31, slot 0 is the attestation key)
+ * @param curve         Key curve
+ * @param pubkey        Output: public key (64 bytes P-256 X||Y, 32 bytes Ed25519)
+ * @param pubkey_len    Input: buffer size, Output: public key length
+ * @return AVP_OK on success
+ */
+avp_ret_t avp_tropic_key_generate(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t curve,
+                                  uint8_t *pubkey, size_t *pubkey_len);
+
+/**
+ * @brief Read the public key of an ECC slot
  *
  * @param ctx           AVP context
  * @param key_slot      Key slot index (0-31)
+ * @param curve         Output: key curve
+ * @param pubkey        Output: public key (64 bytes P-256 X||Y, 32 bytes Ed25519)
+ * @param pubkey_len    Input: buffer size, Output: public key length
+ * @return AVP_OK on success, AVP_ERR_KEY_NOT_FOUND when the slot is empty
+ */
+avp_ret_t avp_tropic_key_read(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t *curve,
+                              uint8_t *pubkey, size_t *pubkey_len);
+
+/**
+ * @brief Sign data with TROPIC01 ECC key
+ *
+ * @param ctx           AVP context
+ * @param key_slot      Key slot index (1-31, never the attestation key)
+ * @param curve         Curve of the key in key_slot (ECDSA or EdDSA)
  * @param data          Data to sign (or hash)
  * @param data_len      Data length
  * @param signature     Output signature buffer (64 bytes for P-256/Ed25519)
  * @param sig_len       Input: buffer size, Output: signature length
  * @return AVP_OK on success
  */
-avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot,
+avp_ret_t avp_tropic_sign(avp_ctx_t *ctx, uint8_t key_slot, avp_curve_t curve,
                           const uint8_t *data, size_t data_len,
                           uint8_t *signature, size_t *sig_len);
 
+/**
+ * @brief Sign a SHA-256 digest with TROPIC01 ECDSA key
+ *
+ * For payloads hashed on the device in chunks. libtropic only signs
+ * messages, so the 32 byte digest is the signed message: the signature
+ * verifies over the digest bytes, not over the original payload.
+ * P-256 keys only, EdDSA signs the message itself.
+ *
+ * @param ctx           AVP context
+ * @param key_slot      Key slot index (1-31, never the attestation key)
+ * @param digest        SHA-256 of the message
+ * @param signature     Output signature buffer (64 bytes, R || S)
+ * @param sig_len       Input: buffer size, Output: signature length
+ * @return AVP_OK on success
+ */
+avp_ret_t avp_tropic_sign_digest(avp_ctx_t *ctx, uint8_t key_slot,
+                                 const uint8_t digest[AVP_SHA256_DIGEST_LEN],
+                                 uint8_t *signature, size_t *sig_len);
+
 /**
  * @brief Get TROPIC01 device information
  *
+ * Identity is read from the chip once (at init, or on first use if that
+ * failed) and served from RAM afterwards. Placeholders are filled in when
+ * the chip is not available.
+ *
  * @param ctx           AVP context
  * @param serial        Output: Serial number string (32 bytes max)
  * @param fw_version    Output: Firmware version string (16 bytes max)
- * @return AVP_OK on success
+ * @return AVP_OK when the identity comes from TROPIC01
  */
 avp_ret_t avp_tropic_get_info(avp_ctx_t *ctx, char *serial, char *fw_version);
 
@@ -128,6 +178,16 @@ avp_ret_t avp_tropic_get_info(avp_ctx_t *ctx, char *serial, char *fw_version);
 avp_ret_t avp_tropic_attest(avp_ctx_t *ctx, const uint8_t *challenge,
                             uint8_t *response, size_t *resp_len);
 
+/**
+ * @brief Read random bytes from the TROPIC01 TRNG
+ *
+ * @param ctx           AVP context
+ * @param buf           Output buffer
+ * @param len           Number of bytes (255 max)
+ * @return AVP_OK on success
+ */
+avp_ret_t avp_tropic_random(avp_ctx_t *ctx, uint8_t *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
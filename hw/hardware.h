@@ -22,6 +22,8 @@
 #define UART1_ISR_PRIO          DEF_PRIO
 #define USB_ISR_PRIO            DEF_PRIO
 #define SPI_ISR_PRIO            DEF_PRIO
+#define RNG_ISR_PRIO            DEF_PRIO
+#define EXTI_ISR_PRIO           DEF_PRIO
 
 #endif // ! HARDWARE_H
 
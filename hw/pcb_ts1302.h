@@ -5,7 +5,7 @@
 
 #define	HW_HSE_ENABLED 1 // HSE crystal 8MHz assembled 
 
-#define SYSCLK                  48000000
+#define SYSCLK                  48000000 // at boot, sys_set_profile() changes it
 #define HCLK                    SYSCLK
 #define PCLK1                   (HCLK/2)
 #define APB1CLK                 (PCLK1/1)
@@ -53,4 +53,11 @@ typedef uint64_t            u64;
 	#define KB 1024
 #endif
 
+// make PROFILE=perf: hot paths run from SRAM (.RamFunc, copied with .data at startup)
+#if defined(PROFILE_PERF) && (PROFILE_PERF == 1)
+	#define RAMFUNC         __attribute__((section(".RamFunc")))
+#else
+	#define RAMFUNC
+#endif
+
 #endif // ! TYPE_H
@@ -52,7 +52,7 @@ int is_number(const char *str, int limit)
     return (i);
 }
 
-static int _hex_to_bin(char ch)
+static RAMFUNC int _hex_to_bin(char ch)
 {
     if ((ch >= '0') && (ch <= '9'))
         return (ch -'0');
@@ -64,12 +64,12 @@ static int _hex_to_bin(char ch)
     return (-1);
 }
 
-bool is_hex(char ch)
+RAMFUNC bool is_hex(char ch)
 {
 	return ((_hex_to_bin(ch) >= 0) ? true : false);
 }
 
-static bool _get_hex(u8 *dest, const char *src)
+static RAMFUNC bool _get_hex(u8 *dest, const char *src)
 {   // read one byte of HEX value
     int tmp;
     u8 result = 0;
@@ -87,7 +87,7 @@ static bool _get_hex(u8 *dest, const char *src)
     return (true);
 }
 
-int hex_to_bin(u8 *dest, const char *src, int limit)
+RAMFUNC int hex_to_bin(u8 *dest, const char *src, int limit)
 {
 	int i;
 
@@ -147,12 +147,21 @@ void dma_init_spi_tx(void)
     __HAL_LINKDMA(&hspi1, hdmatx, handle_GPDMA1_Channel7);
 }
 
-void GPDMA1_Channel6_IRQHandler(void)
+RAMFUNC void dma_spi_tx_fixed_source(bool fixed)
+{   // fixed == the same byte is sent repeatedly (dummy bytes while reading)
+    // node registers are loaded by the channel at transfer start
+    if (fixed)
+        Node_tx.LinkRegisters[NODE_CTR1_DEFAULT_OFFSET] &= ~DMA_CTR1_SINC;
+    else
+        Node_tx.LinkRegisters[NODE_CTR1_DEFAULT_OFFSET] |= DMA_CTR1_SINC;
+}
+
+RAMFUNC void GPDMA1_Channel6_IRQHandler(void)
 {
     HAL_DMA_IRQHandler(&handle_GPDMA1_Channel6);
 }
 
-void GPDMA1_Channel7_IRQHandler(void)
+RAMFUNC void GPDMA1_Channel7_IRQHandler(void)
 {
     HAL_DMA_IRQHandler(&handle_GPDMA1_Channel7);
 }
@@ -13,6 +13,7 @@ void dma_spi_rx_start(char *dest, size_t len);
 void dma_spi_tx_start(char *src, size_t len);
 bool dma_spi_rx_done(void);
 bool dma_spi_tx_done(void);
+void dma_spi_tx_fixed_source(bool fixed);
 
 #endif // ! DMA_H
 
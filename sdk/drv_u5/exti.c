@@ -0,0 +1,70 @@
+#include "common.h"
+#include "hardware.h"
+#include "exti.h"
+#include "irq.h"
+
+// one callback per EXTI line, line == pin number on any port
+static exti_cb_t _exti_cb[16];
+
+bool exti_rising_init(gpio_port_t *port, u8 pin, exti_cb_t cb)
+{
+    u32 index = ((u32)port - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+    u32 shift = (pin & 3) * 8;
+    u32 mask = (1UL << pin);
+
+    if ((pin > 15) || (cb == NULL))
+        return (false);
+
+    _exti_cb[pin] = cb;
+
+    // route port to the line, rising edge, clear stale pending flag
+    EXTI->EXTICR[pin >> 2] = (EXTI->EXTICR[pin >> 2] & ~(0xFFUL << shift)) | (index << shift);
+    EXTI->RTSR1 |= mask;
+    EXTI->FTSR1 &= ~mask;
+    EXTI->RPR1 = mask;
+    EXTI->IMR1 |= mask;
+
+    irq_enable((IRQn_Type)(EXTI0_IRQn + pin), EXTI_ISR_PRIO);
+    return (true);
+}
+
+void exti_disable(u8 pin)
+{
+    if (pin > 15)
+        return;
+
+    EXTI->IMR1 &= ~(1UL << pin);
+    NVIC_DisableIRQ((IRQn_Type)(EXTI0_IRQn + pin));
+    _exti_cb[pin] = NULL;
+}
+
+static void _exti_irq(u8 pin)
+{
+    u32 mask = (1UL << pin);
+
+    if (EXTI->RPR1 & mask)
+    {
+        EXTI->RPR1 = mask;
+        if (_exti_cb[pin] != NULL)
+            _exti_cb[pin]();
+    }
+}
+
+#define _EXTI_IRQ_HANDLER(n) void EXTI##n##_IRQHandler(void) { _exti_irq(n); }
+
+_EXTI_IRQ_HANDLER(0)
+_EXTI_IRQ_HANDLER(1)
+_EXTI_IRQ_HANDLER(2)
+_EXTI_IRQ_HANDLER(3)
+_EXTI_IRQ_HANDLER(4)
+_EXTI_IRQ_HANDLER(5)
+_EXTI_IRQ_HANDLER(6)
+_EXTI_IRQ_HANDLER(7)
+_EXTI_IRQ_HANDLER(8)
+_EXTI_IRQ_HANDLER(9)
+_EXTI_IRQ_HANDLER(10)
+_EXTI_IRQ_HANDLER(11)
+_EXTI_IRQ_HANDLER(12)
+_EXTI_IRQ_HANDLER(13)
+_EXTI_IRQ_HANDLER(14)
+_EXTI_IRQ_HANDLER(15)
@@ -0,0 +1,13 @@
+#ifndef EXTI_H
+#define EXTI_H
+
+#include "type.h"
+#include "gpio.h"
+
+// Called from interrupt on the selected edge
+typedef void (*exti_cb_t)(void);
+
+bool exti_rising_init(gpio_port_t *port, u8 pin, exti_cb_t cb);
+void exti_disable(u8 pin);
+
+#endif // ! EXTI_H
@@ -0,0 +1,64 @@
+#include "mem.h"
+
+// linker script symbols, only their addresses count
+extern u32 _estack;
+extern u32 _sstack;
+extern u32 _mem_data_app, _mem_data_avp, _mem_data_usb, _mem_data_sdk, _mem_ramfunc, _edata;
+extern u32 _mem_bss_app, _mem_bss_avp, _mem_bss_usb, _mem_bss_sdk, _ebss;
+
+#define _ADDR(sym)  ((u32)&(sym))
+
+void mem_init(void)
+{
+    u32 *p = &_sstack;
+    u32 *top = (u32 *)(__get_MSP() - MEM_PAINT_GUARD);
+
+    while (p < top)
+        *p++ = MEM_PAINT;
+
+    // overflow faults before it reaches the heap, the watchdog resets
+    __set_MSPLIM(_ADDR(_sstack));
+}
+
+u32 mem_stack_size(void)
+{
+    return (_ADDR(_estack) - _ADDR(_sstack));
+}
+
+u32 mem_stack_used(void)
+{
+    return (_ADDR(_estack) - __get_MSP());
+}
+
+u32 mem_stack_peak(void)
+{
+    const u32 *p = &_sstack;
+    const u32 *top = &_estack;
+
+    while ((p < top) && (*p == MEM_PAINT))
+        p++;
+    return (_ADDR(_estack) - (u32)p);
+}
+
+u32 mem_ramfunc_size(void)
+{
+    return (_ADDR(_edata) - _ADDR(_mem_ramfunc));
+}
+
+bool mem_module(u8 index, mem_module_t *module)
+{
+    // module sections are laid out in this order in .data and .bss
+    static const char *name[MEM_MODULES] = {"avp", "usb", "app", "sdk"};
+    const u32 data[MEM_MODULES + 1] = {_ADDR(_mem_data_avp), _ADDR(_mem_data_usb),
+        _ADDR(_mem_data_app), _ADDR(_mem_data_sdk), _ADDR(_mem_ramfunc)};
+    const u32 bss[MEM_MODULES + 1] = {_ADDR(_mem_bss_avp), _ADDR(_mem_bss_usb),
+        _ADDR(_mem_bss_app), _ADDR(_mem_bss_sdk), _ADDR(_ebss)};
+
+    if (index >= MEM_MODULES)
+        return (false);
+
+    module->name = name[index];
+    module->data = data[index + 1] - data[index];
+    module->bss = bss[index + 1] - bss[index];
+    return (true);
+}
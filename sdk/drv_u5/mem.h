@@ -0,0 +1,34 @@
+#ifndef MEM_H
+#define	MEM_H
+
+#include "common.h"
+
+// RAM budget
+//
+// The stack runs from the top of RAM down to _sstack, above the newlib heap
+// that starts at the end of .bss (_end, malloc'ed stdio buffers). It is
+// painted at boot and the high water mark is found by scanning for the
+// first overwritten word; MSPLIM stops an overflow with a fault instead of
+// a silent heap or .bss corruption. Static RAM is split per module by the linker
+// script (STM32U535xx.ld), LTO builds count everything as "sdk".
+
+#define MEM_PAINT           (0xA5A5A5A5UL)
+#define MEM_PAINT_GUARD     (256)   // [B] left unpainted below the SP of mem_init()
+
+#define MEM_MODULES         4       // avp, usb, app, sdk (HAL, drivers, C library)
+
+typedef struct {
+    const char *name;
+    u32 data;               // [B] .data, initialized
+    u32 bss;                // [B] .bss, zeroed
+} mem_module_t;
+
+void mem_init(void);                // first thing in main()
+u32  mem_stack_size(void);          // [B] _estack - _sstack
+u32  mem_stack_used(void);          // [B] now
+u32  mem_stack_peak(void);          // [B] high water mark since boot
+u32  mem_ramfunc_size(void);        // [B] code copied to SRAM (PROFILE=perf)
+bool mem_module(u8 index, mem_module_t *module); // false past the last
+
+
+#endif // ! MEM_H
@@ -0,0 +1,191 @@
+#include "common.h"
+#include "hardware.h"
+#include "nvm.h"
+
+#include "log.h"
+LOG_DEF("NVM");
+
+#include <stm32u5xx_hal_flash.h>
+#include <stm32u5xx_hal_flash_ex.h>
+
+#define NVM_RECORDS (NVM_PAGE_SIZE / sizeof(nvm_cfg_t))
+#define NVM_KEYS    (NVM_PAGE_SIZE / sizeof(nvm_key_t))
+
+static const nvm_cfg_t *_nvm_record(u32 index)
+{
+    return ((const nvm_cfg_t *)(NVM_PAGE_ADDR + index * sizeof(nvm_cfg_t)));
+}
+
+static u32 _nvm_check(const nvm_cfg_t *cfg)
+{
+    const u32 *w = (const u32 *)cfg;
+
+    return (~(w[0] ^ w[1] ^ w[2]));
+}
+
+static bool _nvm_erased(const nvm_cfg_t *cfg)
+{
+    const u32 *w = (const u32 *)cfg;
+
+    return ((w[0] & w[1] & w[2] & w[3]) == 0xFFFFFFFFUL);
+}
+
+static bool _nvm_erase(u32 page)
+{
+    FLASH_EraseInitTypeDef erase;
+    u32 page_error;
+
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = NVM_PAGE_BANK;
+    erase.Page = page;
+    erase.NbPages = 1;
+    if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK)
+    {
+        LOG_ERROR("page %lu erase failed", page);
+        return (false);
+    }
+    return (true);
+}
+
+bool nvm_cfg_load(nvm_cfg_t *cfg)
+{
+    const nvm_cfg_t *rec;
+    bool found = false;
+    u32 i;
+
+    // records are appended, the last valid one wins
+    for (i = 0; i < NVM_RECORDS; i++)
+    {
+        rec = _nvm_record(i);
+        if (_nvm_erased(rec))
+            break;
+
+        if ((rec->magic == NVM_MAGIC) && (rec->check == _nvm_check(rec)))
+        {
+            *cfg = *rec;
+            found = true;
+        }
+    }
+    return (found);
+}
+
+bool nvm_cfg_save(const nvm_cfg_t *cfg)
+{
+    nvm_cfg_t rec __attribute__((aligned(4)));
+    u32 i;
+    bool ok = false;
+
+    rec = *cfg;
+    rec.magic = NVM_MAGIC;
+    rec.check = _nvm_check(&rec);
+
+    for (i = 0; i < NVM_RECORDS; i++)
+    {
+        if (_nvm_erased(_nvm_record(i)))
+            break;
+    }
+
+    HAL_FLASH_Unlock();
+
+    if (i == NVM_RECORDS)
+    {   // page full, start over
+        if (!_nvm_erase(NVM_PAGE_NUM))
+            goto done;
+        i = 0;
+    }
+
+    // bank 2 only holds settings, code keeps running from bank 1
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_QUADWORD,
+                          NVM_PAGE_ADDR + i * sizeof(nvm_cfg_t), (u32)&rec) != HAL_OK)
+    {
+        LOG_ERROR("program failed");
+        goto done;
+    }
+    ok = true;
+
+done:
+    HAL_FLASH_Lock();
+    return (ok);
+}
+
+static const nvm_key_t *_nvm_key(u32 index)
+{
+    return ((const nvm_key_t *)(NVM_KEYS_ADDR + index * sizeof(nvm_key_t)));
+}
+
+static u32 _nvm_key_check(const nvm_key_t *key)
+{
+    const u32 *w = (const u32 *)key;
+    u32 check = 0;
+    u32 i;
+
+    for (i = 0; i < (sizeof(*key) / sizeof(u32)) - 1; i++)
+        check ^= w[i];
+    return (~check);
+}
+
+const nvm_key_t *nvm_key_find(u8 slot)
+{
+    const nvm_key_t *rec;
+    const nvm_key_t *found = NULL;
+    u32 i;
+
+    for (i = 0; i < NVM_KEYS; i++)
+    {
+        rec = _nvm_key(i);
+        if (rec->magic == 0xFFFFFFFFUL)
+            break;
+
+        if ((rec->magic == NVM_KEY_MAGIC) && (rec->slot == slot) &&
+            (rec->check == _nvm_key_check(rec)))
+            found = rec;
+    }
+    return (found);
+}
+
+bool nvm_key_save(const nvm_key_t *key)
+{
+    nvm_key_t rec __attribute__((aligned(4)));
+    u32 addr;
+    u32 i;
+    bool ok = true;
+
+    rec = *key;
+    rec.magic = NVM_KEY_MAGIC;
+    rec.check = _nvm_key_check(&rec);
+
+    for (i = 0; i < NVM_KEYS; i++)
+    {
+        if (_nvm_key(i)->magic == 0xFFFFFFFFUL)
+            break;
+    }
+    if (i == NVM_KEYS)
+        return (false);
+
+    HAL_FLASH_Unlock();
+
+    // a torn record fails its check and is skipped by nvm_key_find()
+    addr = (u32)_nvm_key(i);
+    for (i = 0; i < sizeof(rec); i += 16)
+    {
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_QUADWORD, addr + i, (u32)&rec + i) != HAL_OK)
+        {
+            LOG_ERROR("key program failed");
+            ok = false;
+            break;
+        }
+    }
+
+    HAL_FLASH_Lock();
+    return (ok);
+}
+
+bool nvm_key_erase(void)
+{
+    bool ok;
+
+    HAL_FLASH_Unlock();
+    ok = _nvm_erase(NVM_KEYS_PAGE_NUM);
+    HAL_FLASH_Lock();
+    return (ok);
+}
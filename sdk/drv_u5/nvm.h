@@ -0,0 +1,61 @@
+#ifndef NVM_H
+#define NVM_H
+
+#include "type.h"
+
+// Device settings kept in the last flash page (bank 2, page 31), outside
+// the FLASH region of the linker script. Each save appends one record,
+// the page is erased only when it is full.
+
+#define NVM_PAGE_ADDR   (0x0807E000UL)
+#define NVM_PAGE_SIZE   (0x2000UL)
+#define NVM_PAGE_BANK   FLASH_BANK_2
+#define NVM_PAGE_NUM    (31)
+
+#define NVM_MAGIC       (0x4E564D31UL) // "NVM1"
+
+typedef struct {
+    u32 magic;          // NVM_MAGIC, erased record reads 0xFFFFFFFF
+    u16 spi_prescaler;  // calibrated SPI1 prescaler, 0 == not calibrated
+    u8  spi_slew;       // SPI pin slew rate (SPI_SLEW_xxx)
+    u8  reserved0;
+    u32 reserved1;
+    u32 check;          // ~(magic ^ word1 ^ word2)
+} nvm_cfg_t;            // one flash quad-word
+
+bool nvm_cfg_load(nvm_cfg_t *cfg);
+bool nvm_cfg_save(const nvm_cfg_t *cfg);
+
+// ECC key index (avp_keys) in the page below the settings, same append
+// scheme: one record per slot change, the last valid record of a slot wins.
+// A full page is not erased here, the owner rewrites its live slots.
+
+#define NVM_KEYS_ADDR       (0x0807C000UL)
+#define NVM_KEYS_PAGE_NUM   (30)
+
+#define NVM_KEY_MAGIC       (0x4B455931UL) // "KEY1"
+#define NVM_KEY_NAME_LEN    (64)
+
+#define NVM_KEY_FREE        (0)     // released by the firmware, may be erased
+#define NVM_KEY_NAMED       (1)
+#define NVM_KEY_POOLED      (2)     // spare key, public key is read back at boot
+
+typedef struct {
+    u32  magic;         // NVM_KEY_MAGIC
+    u8   slot;          // ECC slot
+    u8   state;         // NVM_KEY_xxx
+    u8   curve;         // avp_curve_t
+    u8   reserved0;
+    u32  created_at;
+    u32  last_used;
+    u32  sign_count;
+    char name[NVM_KEY_NAME_LEN];
+    u32  reserved1[2];
+    u32  check;         // ~(xor of all words before)
+} nvm_key_t;            // six flash quad-words
+
+const nvm_key_t *nvm_key_find(u8 slot);     // NULL when the slot has no record
+bool nvm_key_save(const nvm_key_t *key);    // false when the page is full
+bool nvm_key_erase(void);
+
+#endif // ! NVM_H
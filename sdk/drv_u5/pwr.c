@@ -0,0 +1,146 @@
+#include "common.h"
+#include "hardware.h"
+#include "pwr.h"
+#include "sys.h"
+
+#include "stm32u5xx_ll_rcc.h"
+#include "stm32u5xx_ll_bus.h"
+#include "stm32u5xx_ll_pwr.h"
+
+#define _LSI_HZ         (32000UL)
+#define _STOP_MIN       (2*TIMER_MS)    // shorter waits use WFI, the PLL restart costs more
+#define _STOP_MAX       (1000*TIMER_MS) // well inside the watchdog timeout, LPTIM1 wraps at 2 s
+
+static bool _pwr_on = false;
+static pwr_stats_t _stats;
+static timer_time_t _wake = 0;          // last Stop exit, 0 == first byte seen
+
+void LPTIM1_IRQHandler(void)
+{   // wake up only
+    LPTIM1->ICR = LPTIM_ICR_CC1CF;
+}
+
+static u16 _lptim_count(void)
+{   // counter runs on LSI, read until two reads agree
+    u16 cnt;
+
+    do
+    {
+        cnt = (u16)LPTIM1->CNT;
+    }
+    while (cnt != (u16)LPTIM1->CNT);
+    return (cnt);
+}
+
+static u32 _lptim_us(u16 ticks)
+{
+    return ((u32)(((u64)ticks * 1000000UL) / _LSI_HZ));
+}
+
+void pwr_init(void)
+{
+    LL_RCC_LSI_Enable();
+    while (LL_RCC_LSI_IsReady() != 1)
+        ;
+
+    // LPTIM1 counts LSI through Stop, free running over 16 bits
+    LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM1_CLKSOURCE_LSI);
+    LL_APB3_GRP1_EnableClock(LL_APB3_GRP1_PERIPH_LPTIM1);
+    LPTIM1->CFGR = 0; // internal clock, no prescaler
+    LPTIM1->CR = LPTIM_CR_ENABLE;
+    LPTIM1->DIER = LPTIM_DIER_CC1IE;
+    while (! (LPTIM1->ISR & LPTIM_ISR_DIEROK))
+        ;
+    LPTIM1->ARR = 0xFFFF;
+    while (! (LPTIM1->ISR & LPTIM_ISR_ARROK))
+        ;
+    LPTIM1->ICR = LPTIM_ICR_DIEROKCF | LPTIM_ICR_ARROKCF;
+    LPTIM1->CR = LPTIM_CR_ENABLE | LPTIM_CR_CNTSTRT;
+
+    // NVIC line is enabled only around Stop, compare matches while awake stay silent
+    NVIC_SetPriority(LPTIM1_IRQn, DEF_PRIO);
+
+    // wake up on HSI16, the PLL restarts from it
+    LL_RCC_SetClkAfterWakeFromStop(LL_RCC_STOP_WAKEUPCLOCK_HSI);
+#if (MAIN_DEBUG == 1)
+    DBGMCU->CR |= DBGMCU_CR_DBG_STOP; // debugger stays attached
+#endif // MAIN_DEBUG
+
+    memset(&_stats, 0, sizeof(_stats));
+    _pwr_on = true;
+}
+
+bool pwr_stop(timer_time_t until)
+{
+    timer_time_t now = timer_get_time();
+    timer_time_t delay = _STOP_MAX;
+    u16 start;
+    u16 wake;
+    u16 done;
+    u32 resume;
+
+    if (! _pwr_on)
+        return (false);
+
+    if (until != 0)
+    {
+        if (until < (now + _STOP_MIN))
+            return (false);
+        if ((until - now) < delay)
+            delay = until - now;
+    }
+
+    // compare match at the deadline, counter keeps running through Stop
+    start = _lptim_count();
+    LPTIM1->CCR1 = (u16)(start + (delay * _LSI_HZ) / 1000000UL);
+    while (! (LPTIM1->ISR & LPTIM_ISR_CMP1OK))
+        ;
+    LPTIM1->ICR = LPTIM_ICR_CMP1OKCF | LPTIM_ICR_CC1CF;
+    NVIC_ClearPendingIRQ(LPTIM1_IRQn);
+    NVIC_EnableIRQ(LPTIM1_IRQn);
+
+    timer_pause();
+    LL_PWR_SetPowerMode(LL_PWR_STOP1_MODE);
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __WFI();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    wake = _lptim_count();
+    sys_clock_resume();
+    done = _lptim_count();
+
+    NVIC_DisableIRQ(LPTIM1_IRQn);
+    timer_resume(_lptim_us((u16)(done - start)));
+
+    resume = _lptim_us((u16)(done - wake));
+    _stats.stops++;
+    _stats.stop_time += _lptim_us((u16)(wake - start));
+    _stats.resume_time = resume;
+    if (resume > _stats.resume_max)
+        _stats.resume_max = resume;
+    _wake = timer_get_time() - resume;
+    return (true);
+}
+
+void pwr_rx_mark(void)
+{
+    u32 elapsed;
+
+    if (_wake == 0)
+        return;
+
+    elapsed = (u32)(timer_get_time() - _wake);
+    _wake = 0;
+    _stats.first_byte_time = elapsed;
+    if (elapsed > _stats.first_byte_max)
+        _stats.first_byte_max = elapsed;
+}
+
+const pwr_stats_t *pwr_get_stats(void)
+{
+    return (&_stats);
+}
+
+void pwr_stats_reset(void)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,28 @@
+#ifndef PWR_H
+#define PWR_H
+
+#include "type.h"
+#include "time.h"
+
+// Stop 1 low power mode
+//
+// Core, flash and the PLL stop, RAM and registers are kept. Any enabled
+// interrupt (USB resume, EXTI lines) or the LPTIM1 deadline (LSI clock)
+// wakes it; the PLL restarts and the time asleep is added to the timebase.
+
+typedef struct {
+    u32 stops;
+    u64 stop_time;          // [us] total in Stop mode
+    u32 resume_time;        // [us] last wake to PLL running (LSI resolution)
+    u32 resume_max;
+    u32 first_byte_time;    // [us] last wake to the first byte from the host
+    u32 first_byte_max;
+} pwr_stats_t;
+
+void pwr_init(void);
+bool pwr_stop(timer_time_t until);     // interrupts masked; until 0 == no deadline, false when too close to sleep
+void pwr_rx_mark(void);                // host data arrived, ends the wake-to-first-byte measurement
+const pwr_stats_t *pwr_get_stats(void);
+void pwr_stats_reset(void);
+
+#endif // ! PWR_H
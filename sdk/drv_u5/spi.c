@@ -6,9 +6,7 @@
 #include "dma.h"
 #include "irq.h"
 #include "sys.h"
-
-#include "log.h"
-LOG_DEF("SPI");
+#include "sched.h"
 
 #include <stm32u5xx_ll_bus.h>
 #include <stm32u5xx_ll_rcc.h>
@@ -22,8 +20,21 @@ LOG_DEF("SPI");
 #define PRESCALER_APB2_MAX 16
 #define PRESCALER_SPI_MAX 256
 
+// prescalers (CLKDIV, calibration) are given for the boot clock, a faster
+// SYSCLK gets a larger divider so SCK never goes above that rate
+#define _SPI1_REF_CLK (48000000UL)
+
+static u32 _spi1_div = 32; // at _SPI1_REF_CLK, spi1_init() value
 static bool _spi1_cs_state = SPI_CS_IDLE; // true == active == LOW
-static volatile bool _spi_transfer_done = false;
+static volatile bool _spi_transfer_done = true;
+
+static u8 _spi1_dummy_tx = 0x00;            // sent while reading chained bytes
+static spi_chain_t _spi1_chain = NULL;      // called from ISR after first part
+static u8 *_spi1_chain_rx;
+static size_t _spi1_chain_len;
+static volatile size_t _spi1_chained;
+static volatile u32 _spi1_error = 0;        // HAL error code latched in the ISR
+static volatile u32 _spi1_errors = 0;       // since the last spi1_error_take()
 
 SPI_HandleTypeDef hspi1;
 
@@ -54,7 +65,7 @@ static void _spi1_pin_init(void)
     HW_SPI_SW_CS_UP;
 }
 
-u32 spi1_get_prescaler(void)
+static u32 _spi1_get_mbr(void)
 {
     switch (SPI1->CFG1 & SPI_CFG1_MBR)
     {
@@ -72,7 +83,7 @@ u32 spi1_get_prescaler(void)
     return (0); // impossible value
 }
 
-bool spi1_set_prescaler(u32 value)
+static bool _spi1_set_mbr(u32 value)
 {
     u32 prescaler;
 
@@ -93,6 +104,73 @@ bool spi1_set_prescaler(u32 value)
     return (true);
 }
 
+static void _spi1_apply(void)
+{   // kernel clock is SYSCLK
+    u32 div = 2;
+
+    while ((div < PRESCALER_SPI_MAX) && (((u64)SystemCoreClock * _spi1_div) > ((u64)div * _SPI1_REF_CLK)))
+        div <<= 1;
+    _spi1_set_mbr(div);
+}
+
+u32 spi1_get_prescaler(void)
+{
+    return (_spi1_div);
+}
+
+bool spi1_set_prescaler(u32 value)
+{
+    if ((value < 2) || (value > PRESCALER_SPI_MAX) || ((value & (value - 1)) != 0))
+        return (false);
+
+    _spi1_div = value;
+    _spi1_apply();
+    return (true);
+}
+
+void spi1_clock_update(void)
+{
+    _spi1_apply();
+}
+
+u32 spi1_get_frequency(void)
+{
+    return (SystemCoreClock / _spi1_get_mbr()); // [Hz]
+}
+
+u8 spi1_get_slew(void)
+{
+    switch (LL_GPIO_GetPinSpeed(GPIOA, LL_GPIO_PIN_5))
+    {
+    case LL_GPIO_SPEED_FREQ_MEDIUM: return (SPI_SLEW_MEDIUM);
+    case LL_GPIO_SPEED_FREQ_HIGH: return (SPI_SLEW_HIGH);
+    case LL_GPIO_SPEED_FREQ_VERY_HIGH: return (SPI_SLEW_VERY_HIGH);
+    default:
+        break;
+    }
+    return (SPI_SLEW_LOW);
+}
+
+bool spi1_set_slew(u8 slew)
+{
+    u32 speed;
+
+    switch (slew)
+    {
+    case SPI_SLEW_LOW:       speed = LL_GPIO_SPEED_FREQ_LOW;       break;
+    case SPI_SLEW_MEDIUM:    speed = LL_GPIO_SPEED_FREQ_MEDIUM;    break;
+    case SPI_SLEW_HIGH:      speed = LL_GPIO_SPEED_FREQ_HIGH;      break;
+    case SPI_SLEW_VERY_HIGH: speed = LL_GPIO_SPEED_FREQ_VERY_HIGH; break;
+    default:
+        return (false);
+    }
+    // SCK, MISO, MOSI together, faster edges are needed above a few MHz
+    LL_GPIO_SetPinSpeed(GPIOA, LL_GPIO_PIN_5, speed);
+    LL_GPIO_SetPinSpeed(GPIOA, LL_GPIO_PIN_6, speed);
+    LL_GPIO_SetPinSpeed(GPIOA, LL_GPIO_PIN_7, speed);
+    return (true);
+}
+
 void spi1_init(void)
 {
     SPI_AutonomousModeConfTypeDef HAL_SPI_AutonomousMode_Cfg_Struct = {0};
@@ -135,18 +213,81 @@ void spi1_init(void)
     dma_init_spi_tx();
 }
 
+static bool _spi1_start(u8 *rx, u8 *tx, size_t len)
+{
+    if (HAL_SPI_TransmitReceive_DMA(&hspi1, (u8*)tx, (u8 *)rx, len) != HAL_OK)
+    {
+        _spi1_chain = NULL;
+        _spi_transfer_done = true;
+        return (false);
+    }
+    return (true);
+}
+
+bool spi1_data_transfer_start(u8 *rx, u8 *tx, size_t len)
+{   // non-blocking, poll spi1_transfer_done() for completion
+    _spi_transfer_done = false;
+    _spi1_chain = NULL;
+    dma_spi_tx_fixed_source(false);
+
+    return (_spi1_start(rx, tx, len));
+}
+
+bool spi1_data_transfer_chain(u8 *rx, u8 *tx, size_t len, spi_chain_t next)
+{   // as spi1_data_transfer_start(), then next() tells from the received bytes
+    // how many more to read into rx + len, started directly from the ISR with
+    // dummy TX so the frame is clocked without a main loop round trip
+    _spi_transfer_done = false;
+    _spi1_chain = next;
+    _spi1_chain_rx = rx;
+    _spi1_chain_len = len;
+    _spi1_chained = 0;
+    dma_spi_tx_fixed_source(false);
+
+    return (_spi1_start(rx, tx, len));
+}
+
+size_t spi1_chained(void)
+{   // bytes read by the chained part of the last spi1_data_transfer_chain()
+    return (_spi1_chained);
+}
+
+bool spi1_transfer_done(void)
+{
+    return (_spi_transfer_done);
+}
+
 void spi1_data_transfer(u8 *rx, u8 *tx, size_t len)
 {   // 
-    _spi_transfer_done = false;
-   
-    // non-blocking function
-    HAL_SPI_TransmitReceive_DMA(&hspi1, (u8*)tx, (u8 *)rx, len);
-    
+    if (! spi1_data_transfer_start(rx, tx, len))
+        return;
+
     // make it blocking, wait until done
     while (_spi_transfer_done == false)
         ;
 }
 
+u32 spi1_error_take(u32 *code)
+{
+    u32 primask = __get_PRIMASK();
+    u32 errors;
+
+    __disable_irq();
+    errors = _spi1_errors;
+    *code = _spi1_error;
+    _spi1_errors = 0;
+    __set_PRIMASK(primask);
+    return (errors);
+}
+
+void spi1_abort(void)
+{   // stop DMA and SPI before the caller's buffer goes out of scope
+    HAL_SPI_Abort(&hspi1);
+    _spi1_chain = NULL;
+    _spi1_chained = 0;
+    _spi_transfer_done = true;
+}
+
 void spi1_flush(void)
 {
     while (SPI1->SR & SPI_SR_RXP)
@@ -183,7 +324,7 @@ void spi1_cs(bool state)
     }
 }
 
-void SPI1_IRQHandler(void)
+RAMFUNC void SPI1_IRQHandler(void)
 {
     HAL_SPI_IRQHandler(&hspi1);
 }
@@ -201,11 +342,43 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef* hspi)
     }
 }
 
-void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+RAMFUNC void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
 {
+    spi_chain_t next = _spi1_chain;
+    size_t len;
+
     if (hspi->Instance == SPI1) 
     {
+        if (next != NULL)
+        {   // CS stays active, rest of the frame follows right away
+            _spi1_chain = NULL;
+            len = next(_spi1_chain_rx);
+            if (len > 0)
+            {
+                dma_spi_tx_fixed_source(true);
+                if (HAL_SPI_TransmitReceive_DMA(&hspi1, &_spi1_dummy_tx,
+                                                _spi1_chain_rx + _spi1_chain_len, len) == HAL_OK)
+                {
+                    _spi1_chained = len;
+                    return;
+                }
+            }
+        }
+        _spi_transfer_done = true;
+        sched_event(SCHED_EV_SPI);
+    }
+}
+
+RAMFUNC void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi->Instance == SPI1) 
+    {   // don't leave anybody waiting, received data are not valid
+        _spi1_chain = NULL;
+        _spi1_chained = 0;
         _spi_transfer_done = true;
+        _spi1_error = hspi->ErrorCode; // logged by spi1_error_take() caller, printf is not ISR safe
+        _spi1_errors++;
+        sched_event(SCHED_EV_SPI);
     }
 }
 #endif // SPI1_ON
@@ -16,14 +16,33 @@
 #define SPI_CS_ACTIVE true
 #define SPI_CS_IDLE   false
 
+// GPIO output speed of the SPI pins
+#define SPI_SLEW_LOW        0
+#define SPI_SLEW_MEDIUM     1
+#define SPI_SLEW_HIGH       2
+#define SPI_SLEW_VERY_HIGH  3
+
+// Called from ISR when the first part of a chained transfer is received,
+// returns number of bytes to read next (0 == done)
+typedef size_t (*spi_chain_t)(const u8 *rx);
+
 #if SPI1_ON 
 
   void spi1_init (void);
-  u32 spi1_get_prescaler(void);
-  u32 spi1_get_frequency(void);
+  u32 spi1_get_prescaler(void);     // at 48 MHz SYSCLK, scaled up on faster clocks
+  u32 spi1_get_frequency(void);     // [Hz] SCK now
   bool spi1_set_frequency(u32 freq);
   bool spi1_set_prescaler(u32 value);
+  void spi1_clock_update(void);     // after a SYSCLK change, between transfers
+  u8 spi1_get_slew(void);
+  bool spi1_set_slew(u8 slew);
   void spi1_data_transfer(u8 *rx, u8 *tx, size_t len);
+  bool spi1_data_transfer_start(u8 *rx, u8 *tx, size_t len);
+  bool spi1_data_transfer_chain(u8 *rx, u8 *tx, size_t len, spi_chain_t next);
+  size_t spi1_chained(void);
+  bool spi1_transfer_done(void);
+  void spi1_abort(void);            // transfer in flight stopped, CS left to the caller
+  u32 spi1_error_take(u32 *code);   // transfer errors since the last call, code: last HAL error
   void spi1_flush(void);
   u8 spi1_transfer(u8 c);
   bool spi1_cs_state(void);
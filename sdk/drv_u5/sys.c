@@ -1,4 +1,6 @@
 #include "sys.h"
+#include "time.h"
+#include "spi.h"
 
 #include "stm32u5xx_ll_rcc.h"
 #include "stm32u5xx_ll_bus.h"
@@ -18,6 +20,23 @@
   #define NVIC_PRIORITYGROUP_4         ((uint32_t)0x00000003)
 #endif // ! NVIC_PRIORITYGROUP_0
 
+typedef struct {
+    u32 hclk;       // [Hz]
+    u32 pll_n;
+    u32 pll_r;
+    u32 vos;
+    u32 latency;
+} _profile_t;
+
+// PLL1 input 4 MHz (HSE 8 MHz / 2 or HSI 16 MHz / 4), VCO 384 / 320 MHz
+static const _profile_t _profile[SYS_PROFILES] = {
+    { 48000000, 96, 8, LL_PWR_REGU_VOLTAGE_SCALE3, LL_FLASH_LATENCY_3}, // SYS_PROFILE_LOW
+    {160000000, 80, 2, LL_PWR_REGU_VOLTAGE_SCALE1, LL_FLASH_LATENCY_4}, // SYS_PROFILE_PERF
+};
+
+static u8 _prof = SYS_PROFILE_LOW;
+static sys_clock_stats_t _clock_stats;
+
 void sys_init(void)
 {
     // Configure Flash prefetch
@@ -32,16 +51,9 @@ void sys_init(void)
 }
 
 
-void sys_clock_config(void)
+// oscillators and PLL, at boot and after Stop mode (which turns them off)
+static void _sys_pll_start(void)
 {
-    LL_FLASH_SetLatency(LL_FLASH_LATENCY_3);
-    while(LL_FLASH_GetLatency()!= LL_FLASH_LATENCY_3)
-        ;
-
-    LL_PWR_SetRegulVoltageScaling(LL_PWR_REGU_VOLTAGE_SCALE3);
-    while (LL_PWR_IsActiveFlag_VOS() == 0)
-        ;
-
 #if (HW_HSE_ENABLED == 1)
     LL_RCC_HSE_Enable();
 
@@ -61,15 +73,14 @@ void sys_clock_config(void)
     // Wait till HSI48 is ready
     while(LL_RCC_HSI48_IsReady() != 1)
         ;
-    LL_PWR_EnableBkUpAccess();
 
 #if (HW_HSE_ENABLED == 1)
-    LL_RCC_PLL1_ConfigDomain_SYS(LL_RCC_PLL1SOURCE_HSE, 2, 96, 8);
+    LL_RCC_PLL1_ConfigDomain_SYS(LL_RCC_PLL1SOURCE_HSE, 2, _profile[_prof].pll_n, _profile[_prof].pll_r);
 #else // (HW_HSE_ENABLED == 1)
-    LL_RCC_PLL1_ConfigDomain_SYS(LL_RCC_PLL1SOURCE_HSI, 4, 96, 8);
+    LL_RCC_PLL1_ConfigDomain_SYS(LL_RCC_PLL1SOURCE_HSI, 4, _profile[_prof].pll_n, _profile[_prof].pll_r);
 #endif // (HW_HSE_ENABLED != 1)
     LL_RCC_PLL1_EnableDomain_SYS();
-    LL_RCC_SetPll1EPodPrescaler(LL_RCC_PLL1MBOOST_DIV_1);
+    LL_RCC_SetPll1EPodPrescaler(LL_RCC_PLL1MBOOST_DIV_1); // booster clock 8 or 16 MHz
     LL_RCC_PLL1_SetVCOInputRange(LL_RCC_PLLINPUTRANGE_4_8);
     LL_RCC_PLL1_Enable();
 
@@ -82,12 +93,45 @@ void sys_clock_config(void)
     // Wait till System clock is ready
     while(LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_PLL1)
         ;
+}
+
+static void _sys_latency(u32 latency)
+{
+    LL_FLASH_SetLatency(latency);
+    while(LL_FLASH_GetLatency() != latency)
+        ;
+}
+
+static void _sys_voltage(u32 vos)
+{   // range 1 and 2 need the EPOD booster, it is enabled after VOS is ready
+    if (vos == LL_PWR_REGU_VOLTAGE_SCALE3)
+        LL_PWR_DisableEPODBooster();
+
+    LL_PWR_SetRegulVoltageScaling(vos);
+    while (LL_PWR_IsActiveFlag_VOS() == 0)
+        ;
+
+    if (vos != LL_PWR_REGU_VOLTAGE_SCALE3)
+    {
+        LL_PWR_EnableEPODBooster();
+        while (LL_PWR_IsActiveFlag_BOOST() == 0)
+            ;
+    }
+}
+
+void sys_clock_config(void)
+{
+    _sys_latency(_profile[_prof].latency);
+    _sys_voltage(_profile[_prof].vos);
+
+    _sys_pll_start();
+    LL_PWR_EnableBkUpAccess();
 
     LL_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_1);
     LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_1);
     LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_1);
     LL_RCC_SetAPB3Prescaler(LL_RCC_APB3_DIV_1);
-    LL_SetSystemCoreClock(48000000);
+    LL_SetSystemCoreClock(_profile[_prof].hclk);
 
     LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_CRS);
     LL_APB1_GRP1_ForceReset(LL_APB1_GRP1_PERIPH_CRS);
@@ -99,10 +143,103 @@ void sys_clock_config(void)
     LL_CRS_SetFreqErrorLimit(34);
     LL_CRS_SetHSI48SmoothTrimming(32);
 
-    LL_ICACHE_SetMode(LL_ICACHE_1WAY);
+#if (PROFILE_PERF == 1)
+    LL_ICACHE_SetMode(LL_ICACHE_2WAYS); // fewer conflict misses between USBX, HAL and app code
+#else
+    LL_ICACHE_SetMode(LL_ICACHE_1WAY);  // direct mapped, lower power
+#endif
+    LL_ICACHE_EnableHitMonitor();
+    LL_ICACHE_EnableMissMonitor();
     LL_ICACHE_Enable();
 }
 
+void sys_clock_resume(void)
+{   // Stop mode exit runs on HSI16, prescalers, flash latency, voltage range and CRS are kept
+    if (_profile[_prof].vos != LL_PWR_REGU_VOLTAGE_SCALE3)
+    {
+        while (LL_PWR_IsActiveFlag_BOOST() == 0)
+            ;
+    }
+    _sys_pll_start();
+}
+
+bool sys_set_profile(u8 profile)
+{
+    const _profile_t *p;
+    timer_time_t start;
+    u32 primask;
+    u32 elapsed;
+    bool up;
+
+    if (profile >= SYS_PROFILES)
+        return (false);
+    if (profile == _prof)
+        return (true);
+    if (! spi1_transfer_done())
+        return (false); // SCK must not change within a frame
+
+    p = &_profile[profile];
+    up = (p->hclk > _profile[_prof].hclk);
+    if (up)
+    {   // voltage and wait states first when going up
+        _sys_voltage(p->vos);
+        _sys_latency(p->latency);
+    }
+
+    // SYSCLK detours through HSI16 while the PLL relocks (USB needs HCLK
+    // above 14.2 MHz), the timers follow each step so time keeps counting
+    primask = __get_PRIMASK();
+    __disable_irq();
+    start = timer_get_time();
+
+    LL_RCC_HSI_Enable();
+    while (LL_RCC_HSI_IsReady() != 1)
+        ;
+    LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_HSI);
+    while (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_HSI)
+        ;
+    timer_set_clock(HSI_VALUE);
+
+    LL_RCC_PLL1_Disable();
+    while (LL_RCC_PLL1_IsReady() != 0)
+        ;
+    _prof = profile;
+    _sys_pll_start();
+    LL_SetSystemCoreClock(p->hclk);
+    timer_set_clock(p->hclk);
+
+    elapsed = (u32)(timer_get_time() - start);
+    __set_PRIMASK(primask);
+
+    if (! up)
+    {   // and last when going down
+        _sys_latency(p->latency);
+        _sys_voltage(p->vos);
+    }
+    spi1_clock_update();
+
+    _clock_stats.switches++;
+    _clock_stats.switch_time = elapsed;
+    if (elapsed > _clock_stats.switch_max)
+        _clock_stats.switch_max = elapsed;
+    return (true);
+}
+
+u8 sys_get_profile(void)
+{
+    return (_prof);
+}
+
+u32 sys_profile_hclk(u8 profile)
+{
+    return ((profile < SYS_PROFILES) ? _profile[profile].hclk : 0); // [Hz]
+}
+
+const sys_clock_stats_t *sys_clock_stats(void)
+{
+    return (&_clock_stats);
+}
+
 void sys_usb_clock_config(void)
 {
     LL_RCC_SetUSBClockSource(LL_RCC_USB_CLKSOURCE_HSI48);
@@ -118,6 +255,17 @@ u32 sys_flash_size(void)
     return (LL_GetFlashSize());
 }
 
+void sys_icache_stats(u32 *hits, u32 *misses)
+{   // miss monitor saturates at 0xFFFF
+    *hits = LL_ICACHE_GetHitMonitor();
+    *misses = LL_ICACHE_GetMissMonitor();
+}
+
+void sys_icache_reset(void)
+{
+    LL_ICACHE_ResetMonitors(LL_ICACHE_MONITOR_ALL);
+}
+
 // ST HAL overlay
 void HAL_Delay(uint32_t delay)
 {
@@ -125,6 +273,6 @@ void HAL_Delay(uint32_t delay)
 }
 
 u32 HAL_GetTick(void)
-{
-	return (os_timer_get_time());
+{   // HAL timeouts count milliseconds
+	return ((u32)(os_timer_get_time() / OS_TIMER_MS));
 }
@@ -3,15 +3,29 @@
 
 #include "common.h"
 
-#define SYS_HCLK_MIN 40000000
-#define SYS_HCLK_MAX 80000000
+// clock and voltage profiles, SYSCLK == HCLK == PCLKx
+#define SYS_PROFILE_LOW     0   // 48 MHz, voltage range 3 (boot)
+#define SYS_PROFILE_PERF    1   // 160 MHz, voltage range 1, EPOD booster
+#define SYS_PROFILES        2
+
+typedef struct {
+    u32 switches;
+    u32 switch_time;        // [us] last switch, interrupts masked part
+    u32 switch_max;         // [us]
+} sys_clock_stats_t;
 
 void sys_init(void);
 void sys_clock_config(void);
+void sys_clock_resume(void); // after Stop mode
 void sys_usb_clock_config(void);
 u32  sys_get_hclk(void); // [Hz]
-bool sys_set_hclk(u32 freq); // [Hz]
+bool sys_set_profile(u8 profile); // false while an SPI transfer runs
+u8   sys_get_profile(void);
+u32  sys_profile_hclk(u8 profile); // [Hz]
+const sys_clock_stats_t *sys_clock_stats(void);
 u32  sys_flash_size(void);
+void sys_icache_stats(u32 *hits, u32 *misses); // since boot or sys_icache_reset(), flash fetches only
+void sys_icache_reset(void);
 
 
 #endif // ! SYS_H
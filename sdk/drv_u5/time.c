@@ -2,18 +2,23 @@
 #include "hardware.h"
 #include "time.h"
 
-static u64 timer_ms = 0;
-
+#if TIMER3_ON
+static bool _timer3_on = false;
+#endif
 
 #if TIMER2_ON 
 
+// TIM2 counts microseconds in 32 bits, the overflow interrupt (every
+// 71 minutes) extends it to 64 bits; no periodic tick
+static volatile u32 _timer_hi = 0;
+static timer_time_t _timer_skip = 0; // time in Stop mode, TIM2 has no clock there
+
 void TIM2_IRQHandler(void)
 {
-    // Check whether update interrupt is pending
     if (TIM2->SR & TIM_SR_UIF)
-    {   // Clear the update interrupt flag
-        TIM2->SR &= ~(TIM_SR_UIF);
-        timer_ms++;
+    {   // Clear the update interrupt flag (rc_w0, other flags untouched)
+        TIM2->SR = ~TIM_SR_UIF;
+        _timer_hi++;
     }
 }
 
@@ -26,67 +31,107 @@ void timer_init(void)
     RCC->APB1RSTR1 |= RCC_APB1RSTR1_TIM2RST;
     RCC->APB1RSTR1 &= ~RCC_APB1RSTR1_TIM2RST;
 
-    // Set the Autoreload value
-    TIM2->ARR = 1000;
+    // free running, full 32 bit range
+    TIM2->ARR = 0xFFFFFFFFUL;
 
     // Set the Prescaler value
     TIM2->PSC = (TIM2CLK/1000000)-1; // [us]
 
-    TIM2->CR1 = TIM_CR1_CEN; // Counter enable
+    // Generate an update event to reload the Prescaler value immediatly
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->SR = 0;
 
-    TIM2->DIER |= TIM_DIER_UIE; // Enable update interrupt
+    TIM2->DIER |= TIM_DIER_UIE; // overflow only
 
     NVIC_SetPriority(TIM2_IRQn, 0);
     NVIC_EnableIRQ(TIM2_IRQn);
 
-    // Generate an update event to reload the Prescaler value immediatly
-    TIM2->EGR = TIM_EGR_UG;    //1
-}
+    TIM2->CR1 = TIM_CR1_CEN; // Counter enable
 
-static inline timer_time_t _get_timer_time(void)
-{
-    u32 t;
+#if TIMER3_ON
+    timer3_init();
+#endif
+}
 
-    t = TIM2->CNT;
-    if (t < 100)
-    {   // there is small probability there is pending IRQ
-        if (TIM2->SR & TIM_SR_UIF)
-            t += 1000; // fix missing IRQ, which will execute later
+timer_time_t timer_get_time(void)
+{   // lock-free, safe from any context including IRQ and masked IRQ
+    u32 hi;
+    u32 lo;
+    bool wrap;
+
+    do
+    {
+        hi = _timer_hi;
+        lo = TIM2->CNT;
+        wrap = (TIM2->SR & TIM_SR_UIF) ? true : false; // overflow not counted yet
     }
-    return (timer_ms * (u64)1000 + t);
+    while (hi != _timer_hi); // overflow IRQ ran in between
+
+    if (wrap && (lo < 0x80000000UL))
+        hi++; // counter already wrapped, IRQ pending or masked
+
+    return ((((timer_time_t)hi << 32) | lo) + _timer_skip);
 }
 
-timer_time_t timer_get_time(void)
+void timer_pause(void)
 {
-    timer_time_t t;
-
-    __disable_irq();
-    t = _get_timer_time();
-    __enable_irq();
+    TIM2->CR1 &= ~TIM_CR1_CEN;
+}
 
-    return (t);
+void timer_resume(timer_time_t skipped)
+{   // interrupts masked by the caller, nobody reads the time half updated
+    _timer_skip += skipped;
+    TIM2->CR1 |= TIM_CR1_CEN;
 }
 
 timer_time_t timer_get_time_irq(void)
-{   // may be called from IRQ (or when already disabled IRQ)
-    // be sure no any timer IRQ appears here
-    TIM2_IRQHandler(); // force update ms timer
-    return (_get_timer_time());
+{
+    return (timer_get_time());
 }
-#endif // TIMER2_ON 
 
-void time_delay_ms(u32 tm)
+// PSC loads on an update event only, which also clears the counter:
+// the count is put back and URS keeps the forced update from looking
+// like an overflow (no UIF, no interrupt)
+static void _timer_set_psc(TIM_TypeDef *tim, u32 clock)
 {
-    tm *= TIMER_MS;
+    u32 cr1 = tim->CR1;
+    u32 cnt = tim->CNT;
+
+    tim->PSC = (clock / 1000000UL) - 1; // [us]
+    tim->CR1 = cr1 | TIM_CR1_URS;
+    tim->EGR = TIM_EGR_UG;
+    tim->CNT = cnt;
+    tim->CR1 = cr1; // one pulse TIM3 stays armed
+}
 
-    timer_time_t time = timer_get_time();
-    
-    while ((timer_time_t)(timer_get_time() - time) < tm)
-        ;
+void timer_set_clock(u32 clock)
+{   // interrupts masked by the caller
+    _timer_set_psc(TIM2, clock);
+#if TIMER3_ON
+    if (_timer3_on)
+        _timer_set_psc(TIM3, clock);
+#endif
+}
+#endif // TIMER2_ON 
+
+void time_delay_ms(u32 tm)
+{   // sleeps until TIM3 wakes it, interrupts keep being served
+    timer_time_t until = timer_get_time() + (timer_time_t)tm * TIMER_MS;
+
+    while (timer_get_time() < until)
+    {
+#if TIMER3_ON
+        if (_timer3_on)
+        {
+            timer_wakeup(until);
+            __WFI();
+        }
+#endif
+    }
 }
 
 void time_delay_us (u32 tm)
-{   // 
+{   // short, spin
     tm *= TIMER_US;
 
     timer_time_t time = timer_get_time();
@@ -95,6 +140,12 @@ void time_delay_us (u32 tm)
         ;
 }
 
+#if TIMER3_ON
+void TIM3_IRQHandler(void)
+{   // wake up only, whoever sleeps checks the time
+    TIM3->SR = ~TIM_SR_UIF;
+}
+
 void timer3_init(void)
 {
     // enable clock
@@ -105,7 +156,7 @@ void timer3_init(void)
     RCC->APB1RSTR1 &= ~RCC_APB1RSTR1_TIM3RST;
 
     // Set the Autoreload value
-    TIM3->ARR = UINT16_MAX;
+    TIM3->ARR = TIMER3_MAX;
 
     // Set the Prescaler value
     TIM3->PSC = (TIM3CLK/1000000)-1; // [us]
@@ -115,5 +166,26 @@ void timer3_init(void)
 
     // Generate an update event to reload the Prescaler value immediatly
     TIM3->EGR = TIM_EGR_UG;
+    TIM3->SR = 0;
+
+    TIM3->DIER |= TIM_DIER_UIE;
+    NVIC_SetPriority(TIM3_IRQn, 0);
+    NVIC_EnableIRQ(TIM3_IRQn);
+    _timer3_on = true;
 }
 
+void timer_wakeup(timer_time_t when)
+{   // one pulse: update interrupt at 'when', or after TIMER3_MAX if later
+    timer_time_t now = timer_get_time();
+    u32 delay = 1;
+
+    if (when > now)
+        delay = ((when - now) > TIMER3_MAX) ? TIMER3_MAX : (u32)(when - now);
+
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+    TIM3->CNT = 0;
+    TIM3->ARR = delay;
+    TIM3->SR = ~TIM_SR_UIF;
+    TIM3->CR1 |= TIM_CR1_CEN;
+}
+#endif // TIMER3_ON
@@ -7,16 +7,22 @@
 #define TIMER_US	1UL
 
 #define	TIMER2_ON 1
-#define	TIMER3_ON 0
+#define	TIMER3_ON 1
 #define	TIMER5_ON 0
 
 typedef u64 timer_time_t;
 
 void timer_init(void);
-timer_time_t timer_get_time(void);
-timer_time_t timer_get_time_irq(void);
+timer_time_t timer_get_time(void);     // [us] 64 bit, lock-free, safe from IRQ
+timer_time_t timer_get_time_irq(void); // same as timer_get_time()
+void timer_pause(void);                 // before Stop mode
+void timer_resume(timer_time_t skipped); // [us] time the counter was stopped
+void timer_set_clock(u32 clock);        // [Hz] new TIM2/TIM3 clock after a SYSCLK change, interrupts masked
+
+#define TIMER3_MAX  (UINT16_MAX)        // [us] longest one pulse
 
 void timer3_init(void);
+void timer_wakeup(timer_time_t when);   // TIM3 interrupt (wakes WFI) at when, at most TIMER3_MAX ahead
 static inline void timer3_run(void) { TIM3->CR1 |= TIM_CR1_CEN; }
 static inline void timer3_stop(void)  { TIM3->CR1 &= ~TIM_CR1_CEN; }
 static inline void timer3_reset(void) { TIM3->CNT = 0; }
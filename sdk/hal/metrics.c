@@ -0,0 +1,82 @@
+#include "common.h"
+#include "hardware.h"
+#include "metrics.h"
+
+static metrics_hist_t _stage[METRICS_STAGES];
+static metrics_hist_t _op[METRICS_OPS];
+static metrics_hist_t _spi[METRICS_SPI_TYPES];
+
+static void _add(metrics_hist_t *hist, u32 cycles)
+{
+    u32 us = cycles / (SystemCoreClock / 1000000UL);
+    u8 bucket = 0;
+
+    if (us > 0)
+        bucket = (u8)(32 - __builtin_clz(us));
+    if (bucket >= METRICS_BUCKETS)
+        bucket = METRICS_BUCKETS - 1;
+
+    hist->count++;
+    hist->total += us;
+    if (us > hist->max)
+        hist->max = us;
+    hist->bucket[bucket]++;
+}
+
+void metrics_init(void)
+{
+    DCB->DEMCR |= DCB_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    metrics_reset();
+}
+
+u32 metrics_cycles(void)
+{
+    return (DWT->CYCCNT);
+}
+
+void metrics_stage(u8 stage, u32 cycles)
+{
+    if (stage < METRICS_STAGES)
+        _add(&_stage[stage], cycles);
+}
+
+void metrics_op(u8 op, u32 cycles)
+{
+    if (op < METRICS_OPS)
+        _add(&_op[op], cycles);
+}
+
+void metrics_spi(u8 type, u32 cycles)
+{
+    if (type < METRICS_SPI_TYPES)
+        _add(&_spi[type], cycles);
+}
+
+const metrics_hist_t *metrics_get_stage(u8 stage)
+{
+    return ((stage < METRICS_STAGES) ? &_stage[stage] : NULL);
+}
+
+const metrics_hist_t *metrics_get_op(u8 op)
+{
+    return ((op < METRICS_OPS) ? &_op[op] : NULL);
+}
+
+const metrics_hist_t *metrics_get_spi(u8 type)
+{
+    return ((type < METRICS_SPI_TYPES) ? &_spi[type] : NULL);
+}
+
+u32 metrics_bucket_us(u8 bucket)
+{
+    return ((bucket == 0) ? 0 : (1UL << (bucket - 1)));
+}
+
+void metrics_reset(void)
+{
+    memset(_stage, 0, sizeof(_stage));
+    memset(_op, 0, sizeof(_op));
+    memset(_spi, 0, sizeof(_spi));
+}
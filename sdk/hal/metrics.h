@@ -0,0 +1,49 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "type.h"
+
+// Latency histograms on the DWT cycle counter
+//
+// Request stages, AVP ops and SPI transaction types each keep a fixed
+// histogram: bucket 0 counts runs under 1 us, bucket n runs from 2^(n-1)
+// to 2^n - 1 us, the last bucket everything longer. Recording is a few
+// instructions, cheap enough for every request. Main context only.
+
+#define METRICS_BUCKETS     (16)
+
+// request stages
+#define METRICS_RX          (0)     // USB packet in to line complete
+#define METRICS_PARSE       (1)     // JSON request to command
+#define METRICS_EXEC        (2)     // op handler, SE exchanges included
+#define METRICS_FORMAT      (3)     // command result to JSON response
+#define METRICS_DRAIN       (4)     // response flushed to transmit queue empty
+#define METRICS_STAGES      (5)
+
+// TROPIC01 L2 transactions
+#define METRICS_SPI_REQUEST (0)     // request sent to response read
+#define METRICS_SPI_READ    (1)     // response read, polled until ready
+#define METRICS_SPI_POLL    (2)     // single poll (auto read)
+#define METRICS_SPI_TYPES   (3)
+
+#define METRICS_OPS         (24)    // AVP op codes
+
+typedef struct {
+    u32 count;
+    u32 max;                // [us]
+    u64 total;              // [us]
+    u32 bucket[METRICS_BUCKETS];
+} metrics_hist_t;
+
+void metrics_init(void);
+u32  metrics_cycles(void);                  // free running, wraps after 2^32 cycles
+void metrics_stage(u8 stage, u32 cycles);   // cycles: duration, metrics_cycles() difference
+void metrics_op(u8 op, u32 cycles);
+void metrics_spi(u8 type, u32 cycles);
+const metrics_hist_t *metrics_get_stage(u8 stage);
+const metrics_hist_t *metrics_get_op(u8 op);
+const metrics_hist_t *metrics_get_spi(u8 type);
+u32  metrics_bucket_us(u8 bucket);          // lower bound of the bucket
+void metrics_reset(void);
+
+#endif // ! METRICS_H
@@ -10,6 +10,7 @@
 #define OS_PLATFORM_NAME        PLATFORM_NAME
 
 void tty_put_text(char *text);
+void tty_flush(bool wait);
 #define OS_PUTTEXT(x) tty_put_text(x)
 #define OS_PRINTF(...)  printf(__VA_ARGS__)
 #define OS_ERROR(msg)  OS_PUTTEXT("ERROR: " msg NL)
@@ -34,7 +35,7 @@ __inline static bool ret_true(void) {return (true);}
 #define OS_SEMAPHORE_TAKE(x) ret_true()
 #define OS_SEMAPHORE_GIVE(x)
 #define OS_TASK_YIELD()
-#define OS_FLUSH() fflush(stdout);
+#define OS_FLUSH() { fflush(stdout); tty_flush(false); }
 
 #endif // ! OS_MAIN_H
 
@@ -0,0 +1,291 @@
+#include "common.h"
+#include "hardware.h"
+#include "sched.h"
+
+typedef struct {
+    sched_task_pfunc_t run;
+    u32 events;             // subscribed events
+    timer_time_t period;
+    timer_time_t due;       // 0 == no timer
+    bool ready;
+    bool running;
+    sched_stats_t stats;
+} _task_t;
+
+static _task_t _task[SCHED_TASKS_MAX];
+static u8 _tasks = 0;
+
+static sched_task_pfunc_t _idle[SCHED_IDLE_MAX];
+static u8 _idles = 0;
+static sched_stats_t _idle_stats = {"idle", SCHED_NONE, 0, 0, 0};
+static sched_sleep_pfunc_t _deep_sleep = NULL;
+
+static volatile u32 _events = 0;
+static u8 _prio = SCHED_NONE;       // running task, SCHED_NONE == scheduler or idle hooks
+static timer_time_t _nested = 0;    // time of tasks run from sched_yield() of the current one
+static timer_time_t _sleep = 0;
+static timer_time_t _start = 0;
+static bool _in_yield = false;
+
+static void _account(sched_stats_t *stats, timer_time_t elapsed)
+{
+    stats->runs++;
+    stats->time_total += elapsed;
+    if (elapsed > stats->time_max)
+        stats->time_max = (u32)elapsed;
+}
+
+// posted events and expired timers make tasks ready
+static void _update(void)
+{
+    timer_time_t now = timer_get_time();
+    _task_t *t;
+    u32 events;
+    u8 i;
+
+    __disable_irq();
+    events = _events;
+    _events = 0;
+    __enable_irq();
+
+    for (i = 0; i < _tasks; i++)
+    {
+        t = &_task[i];
+        if (t->events & events)
+            t->ready = true;
+
+        if ((t->due == 0) || (now < t->due))
+            continue;
+
+        t->ready = true;
+        if (t->period == 0)
+            t->due = 0;
+        else if ((t->due += t->period) <= now)
+            t->due = now + t->period; // late, no burst of catch up runs
+    }
+}
+
+// highest priority ready task above prio limit
+static _task_t *_pick(u8 limit)
+{
+    _task_t *best = NULL;
+    u8 i;
+
+    for (i = 0; i < _tasks; i++)
+    {
+        if ((! _task[i].ready) || _task[i].running || (_task[i].stats.prio >= limit))
+            continue;
+        if ((best == NULL) || (_task[i].stats.prio < best->stats.prio))
+            best = &_task[i];
+    }
+    return (best);
+}
+
+// earliest task timer, 0 == none
+static timer_time_t _next_due(void)
+{
+    timer_time_t next = 0;
+    u8 i;
+
+    for (i = 0; i < _tasks; i++)
+    {
+        if ((_task[i].due != 0) && ((next == 0) || (_task[i].due < next)))
+            next = _task[i].due;
+    }
+    return (next);
+}
+
+static void _run(sched_task_pfunc_t run, sched_stats_t *stats)
+{
+    timer_time_t nested = _nested;
+    timer_time_t start;
+    timer_time_t elapsed;
+    u8 prio = _prio;
+
+    _prio = stats->prio;
+    _nested = 0;
+    start = timer_get_time();
+
+    run();
+
+    elapsed = timer_get_time() - start;
+    _account(stats, elapsed - _nested);
+    _nested = nested + elapsed;
+    _prio = prio;
+}
+
+static void _run_task(_task_t *t)
+{
+    t->ready = false; // events posted while running make it ready again
+    t->running = true;
+    _run(t->run, &t->stats);
+    t->running = false;
+}
+
+u8 sched_task_add(const char *name, sched_task_pfunc_t run, u8 prio, u32 events)
+{
+    _task_t *t;
+
+    if ((_tasks >= SCHED_TASKS_MAX) || (run == NULL) || (prio == SCHED_NONE))
+        return (SCHED_NONE);
+
+    t = &_task[_tasks];
+    memset(t, 0, sizeof(_task_t));
+    t->run = run;
+    t->events = events;
+    t->stats.name = name;
+    t->stats.prio = prio;
+    return (_tasks++);
+}
+
+void sched_timer(u8 id, timer_time_t period)
+{
+    if (id >= _tasks)
+        return;
+
+    _task[id].period = period;
+    _task[id].due = (period != 0) ? (timer_get_time() + period) : 0;
+}
+
+void sched_at(u8 id, timer_time_t delay)
+{
+    if (id >= _tasks)
+        return;
+
+    _task[id].period = 0;
+    _task[id].due = timer_get_time() + delay;
+}
+
+void sched_post(u8 id)
+{
+    if (id < _tasks)
+        _task[id].ready = true;
+}
+
+RAMFUNC void sched_event(u32 events)
+{   // ISR safe
+    u32 primask = __get_PRIMASK();
+
+    __disable_irq();
+    _events |= events;
+    __set_PRIMASK(primask);
+}
+
+bool sched_idle_add(sched_task_pfunc_t idle)
+{
+    if ((_idles >= SCHED_IDLE_MAX) || (idle == NULL))
+        return (false);
+
+    _idle[_idles++] = idle;
+    return (true);
+}
+
+void sched_sleep_set(sched_sleep_pfunc_t sleep)
+{
+    _deep_sleep = sleep;
+}
+
+void sched_run(void)
+{
+    timer_time_t start;
+    timer_time_t next;
+    _task_t *t;
+    u8 i;
+
+    _start = timer_get_time();
+
+    while (1)
+    {
+        _update();
+        if ((t = _pick(SCHED_NONE)) != NULL)
+        {
+            _run_task(t);
+            continue;
+        }
+
+        for (i = 0; i < _idles; i++)
+        {
+            _run(_idle[i], &_idle_stats);
+        }
+
+        _update();
+        if (_pick(SCHED_NONE) != NULL)
+            continue;
+
+        // no tick, TIM3 wakes us for the next task timer; an event posted
+        // after the check still wakes WFI (PRIMASK only masks the handler)
+        start = timer_get_time();
+        next = _next_due();
+        __disable_irq();
+        if ((_events == 0) && ((_deep_sleep == NULL) || (! _deep_sleep(next))))
+        {
+            if (next != 0)
+                timer_wakeup(next);
+            __WFI();
+        }
+        __enable_irq();
+        _sleep += timer_get_time() - start;
+    }
+}
+
+void sched_yield(void)
+{
+    _task_t *t;
+    u8 limit;
+
+    if (_in_yield)
+        return;
+    _in_yield = true;
+
+    // service tasks only, request handlers wait for the caller to finish
+    limit = (_prio > SCHED_PRIO_SERVICE) ? (SCHED_PRIO_SERVICE + 1) : _prio;
+    _update();
+    while ((t = _pick(limit)) != NULL)
+    {
+        _run_task(t);
+        _update();
+    }
+
+    _in_yield = false;
+}
+
+u8 sched_task_count(void)
+{
+    return (_tasks);
+}
+
+const sched_stats_t *sched_get_stats(u8 id)
+{
+    if (id < _tasks)
+        return (&_task[id].stats);
+    if (id == _tasks)
+        return (&_idle_stats);
+    return (NULL);
+}
+
+timer_time_t sched_sleep_time(void)
+{
+    return (_sleep);
+}
+
+timer_time_t sched_elapsed(void)
+{
+    return (timer_get_time() - _start);
+}
+
+void sched_stats_reset(void)
+{
+    u8 i;
+
+    for (i = 0; i < _tasks; i++)
+    {
+        _task[i].stats.runs = 0;
+        _task[i].stats.time_max = 0;
+        _task[i].stats.time_total = 0;
+    }
+    _idle_stats.runs = 0;
+    _idle_stats.time_max = 0;
+    _idle_stats.time_total = 0;
+    _sleep = 0;
+    _start = timer_get_time();
+}
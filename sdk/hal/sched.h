@@ -0,0 +1,64 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "type.h"
+#include "time.h"
+
+// Cooperative run-to-completion scheduler
+//
+// A task is a function that does the work at hand and returns. It becomes
+// ready when one of its events is posted (ISR safe), its timer expires or
+// sched_post() names it; the highest priority ready task runs first (0 is
+// highest). With nothing ready the idle hooks run (spare key refill etc.),
+// then the core sleeps until the next interrupt or task timer (no tick),
+// in WFI or in whatever the sleep hook chooses (Stop mode).
+//
+// A task that must wait (SE exchange, full USB queue) calls sched_yield(),
+// which runs the ready service tasks (prio <= SCHED_PRIO_SERVICE) above it,
+// never request handlers, so nothing is re-entered.
+
+#define SCHED_TASKS_MAX     (8)
+#define SCHED_IDLE_MAX      (4)
+
+#define SCHED_PRIO_IO       (0)     // USB, network frames
+#define SCHED_PRIO_SERVICE  (1)     // LED, watchdog
+#define SCHED_PRIO_LINK     (2)     // SE link state machine
+#define SCHED_PRIO_REQUEST  (3)     // host requests
+#define SCHED_PRIO_POLL     (4)     // SPI auto read
+
+// events posted from interrupts
+#define SCHED_EV_USB        (1UL << 0)
+#define SCHED_EV_SPI        (1UL << 1)  // SPI DMA transfer done or failed
+#define SCHED_EV_GPO        (1UL << 2)  // SE response ready line
+#define SCHED_EV_UART       (1UL << 3)  // console UART byte received
+
+#define SCHED_NONE          (0xFF)
+
+typedef void (*sched_task_pfunc_t)(void);
+typedef bool (*sched_sleep_pfunc_t)(timer_time_t next); // interrupts masked, next 0 == no timer; false: WFI instead
+
+typedef struct {
+    const char *name;
+    u8 prio;
+    u32 runs;
+    u32 time_max;           // [us] longest run
+    u64 time_total;         // [us] own time, tasks run from its sched_yield() excluded
+} sched_stats_t;
+
+u8   sched_task_add(const char *name, sched_task_pfunc_t run, u8 prio, u32 events); // SCHED_NONE when full
+void sched_timer(u8 id, timer_time_t period);  // periodic, 0 stops
+void sched_at(u8 id, timer_time_t delay);      // once, replaces the periodic timer
+void sched_post(u8 id);                        // ready now, main context only
+void sched_event(u32 events);                  // ISR safe
+bool sched_idle_add(sched_task_pfunc_t idle);
+void sched_sleep_set(sched_sleep_pfunc_t sleep);
+void sched_run(void);                          // never returns
+void sched_yield(void);
+
+u8   sched_task_count(void);
+const sched_stats_t *sched_get_stats(u8 id);   // id == sched_task_count(): idle hooks
+timer_time_t sched_sleep_time(void);           // [us] spent in WFI or the sleep hook
+timer_time_t sched_elapsed(void);              // [us] since sched_run() or sched_stats_reset()
+void sched_stats_reset(void);
+
+#endif // ! SCHED_H
@@ -0,0 +1,40 @@
+#include "common.h"
+#include "scratch.h"
+
+static u64 _arena[SCRATCH_SIZE / sizeof(u64)];
+static u32 _used = 0;
+static u32 _peak = 0;
+static u32 _failures = 0;
+
+void *scratch_alloc(size_t size)
+{
+    u32 len = (size + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+    void *p;
+
+    if ((size == 0) || (len > (SCRATCH_SIZE - _used)))
+    {
+        _failures++;
+        return (NULL);
+    }
+
+    p = &((u8 *)_arena)[_used];
+    _used += len;
+    if (_used > _peak)
+        _peak = _used;
+    return (p);
+}
+
+void scratch_reset(void)
+{
+    _used = 0;
+}
+
+u32 scratch_peak(void)
+{
+    return (_peak);
+}
+
+u32 scratch_failures(void)
+{
+    return (_failures);
+}
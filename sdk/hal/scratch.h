@@ -0,0 +1,23 @@
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include "type.h"
+
+// Per-request scratch arena
+//
+// One bump-pointer region shared by the request paths that never run at
+// the same time: AVP JSON (work area and response line) and the binary
+// bridge (reply). Requests run one after another in the rx task and are
+// not re-entered from sched_yield(), so each path takes what it needs and
+// resets the arena when its request is answered. Nothing kept between
+// requests (partial input, chained APDUs) may live here.
+
+#define SCRATCH_SIZE        (8*1024)
+#define SCRATCH_ALIGN       (8)
+
+void *scratch_alloc(size_t size);   // SCRATCH_ALIGN aligned, NULL when the arena is full
+void  scratch_reset(void);          // end of request, frees everything
+u32   scratch_peak(void);           // [B] high water mark since boot
+u32   scratch_failures(void);       // allocations refused since boot
+
+#endif // ! SCRATCH_H
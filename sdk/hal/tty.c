@@ -1,13 +1,15 @@
 #include "common.h"
 #include "tty.h"
 #include "usb_device.h"
+#include "metrics.h"
 
 #ifndef TTY_ON_UART
     #warning "No TTY uart defined"
 #endif // ! TTY_ON_UART
 
 
-tty_parse_callback_t _rx_callback = NULL;
+static tty_parse_callback_t _rx_callback = NULL;
+static tty_raw_callback_t _raw_callback = NULL; // USB RX bypasses line parser
 
 typedef struct {
     char data[TTY_BUF_SIZE];
@@ -24,41 +26,46 @@ typedef struct {
   #error "too small buffer"
 #endif // 
 
-static char _usb_stream_buffer[USB_TTY_BUFFER_SIZE];
-static size_t _usb_stream_wr_ptr = 0;
-static size_t _usb_stream_rd_ptr = 0;
+// USB reads land directly in packet slots, no copy in the RX path. When
+// all slots are full no read is armed and the host is held off with NAK.
+#define USB_TTY_PACKETS (USB_TTY_BUFFER_SIZE / USB_CDC_RX_PACKET)
 
-static void _usb_send_data(u8 *data, u16 len)
-{
-#define USB_RETRY_NUM (100)
-
-    int limit;
-
-    if (! usb_device_connected())
-        return;
-
-    limit = USB_RETRY_NUM;
-    while (usb_cdc_tx(data, len) == USB_RESULT_BUSY)
-    {
-        if (--limit == 0)
-            return;
-        OS_DELAY(1);
-    }
-    limit = 10;
-    while (usb_cdc_tx_busy())
+typedef struct {
+    u8 packet[USB_TTY_PACKETS][USB_CDC_RX_PACKET] __attribute__((aligned(4)));
+    u8 packet_len[USB_TTY_PACKETS];
+    u32 packet_time[USB_TTY_PACKETS]; // [cycles] received
+    volatile u16 wr;        // free running slot counters
+    volatile u16 rd;
+    u16 high_water;         // max slots filled
+    size_t pos;             // read position in the rd slot
+    tty_buf_t line;
+    u32 line_time;          // [cycles] first packet of the collected line
+    tty_parse_callback_t parse;
+} tty_usb_t;
+
+// console, AVP port and vendor interface, each with its own line framing
+static tty_usb_t _usb[USB_CDC_PORTS];
+
+static RAMFUNC void _usb_send_data(u8 port, const u8 *data, size_t len)
+{   // queued, sent from usb_device_task()
+    u16 n;
+
+    while (len > 0)
     {
-        if (--limit == 0)
-            return;
-        OS_DELAY(1);
+        n = (len > 0xFFFF) ? 0xFFFF : (u16)len;
+        if (usb_cdc_tx(port, data, n) != n)
+            return; // not connected or host not reading
+        data += n;
+        len -= n;
     }
 }
 
-int _write (int fd, const void *buf, size_t count)
-{   // gcc stdout
+__attribute__((used)) int _write (int fd, const void *buf, size_t count)
+{   // gcc stdout, referenced from newlib only (kept for LTO)
     char *ptr = (char *)buf;
     size_t n = count;
 
-    _usb_send_data((u8 *)buf, count);
+    _usb_send_data(USB_CDC_CONSOLE, (u8 *)buf, count);
 
     while (n--)
     {
@@ -68,47 +75,70 @@ int _write (int fd, const void *buf, size_t count)
     return (count - n);
 }
 
-int _read (int fd, const void *buf, size_t count)
+__attribute__((used)) int _read (int fd, const void *buf, size_t count)
 {   // gcc stdin
     return (0);
 }
 
-static void _usb_rx_handler(u8 *buf, u32 len)
+static bool _usb_rx_empty(tty_usb_t *usb)
 {
-    u32 i;
+    return (usb->rd == usb->wr);
+}
 
-    size_t wr_ptr = _usb_stream_wr_ptr;
+static RAMFUNC u8 *_usb_rx_buffer(u8 port)
+{   // next free slot for the USB read, NULL == full
+    tty_usb_t *usb = &_usb[port];
 
-    for (i=0; i<len; i++)
-    {
-        if (++wr_ptr >= USB_TTY_BUFFER_SIZE)
-            wr_ptr=0;
+    if ((u16)(usb->wr - usb->rd) >= USB_TTY_PACKETS)
+        return (NULL);
 
-        if (wr_ptr == _usb_stream_rd_ptr)
-        {
-            OS_ERROR("USB RX overflow !");
-            return;
-        }
-        _usb_stream_buffer[wr_ptr] = buf[i];
-    }
-    _usb_stream_wr_ptr = wr_ptr;
+    return (usb->packet[usb->wr % USB_TTY_PACKETS]);
+}
+
+static RAMFUNC void _usb_rx_handler(u8 port, u8 *buf, u32 len)
+{   // buf is the slot given by _usb_rx_buffer(), already filled
+    tty_usb_t *usb = &_usb[port];
+
+    usb->packet_len[usb->wr % USB_TTY_PACKETS] = (u8)len;
+    usb->packet_time[usb->wr % USB_TTY_PACKETS] = metrics_cycles();
+    usb->wr++;
+    if ((u16)(usb->wr - usb->rd) > usb->high_water)
+        usb->high_water = usb->wr - usb->rd;
 }
 
-int _usb_getchar(void)
+static RAMFUNC void _usb_rx_consume(tty_usb_t *usb, size_t len)
 {
-    size_t rd_ptr = _usb_stream_rd_ptr;
+    usb->pos += len;
+    if (usb->pos >= usb->packet_len[usb->rd % USB_TTY_PACKETS])
+    {   // slot done, give it back to USB
+        usb->pos = 0;
+        usb->rd++;
+    }
+}
+
+static RAMFUNC size_t _usb_raw_feed(tty_usb_t *usb)
+{   // pass rest of the oldest packet at once
+    u16 slot = usb->rd % USB_TTY_PACKETS;
+    size_t len;
 
-    if (rd_ptr == _usb_stream_wr_ptr)
-        return (-1);
+    len = _raw_callback(&usb->packet[slot][usb->pos],
+                        usb->packet_len[slot] - usb->pos);
+    if (len > 0)
+        _usb_rx_consume(usb, len);
+    return (len);
+}
 
-    if (++rd_ptr >= USB_TTY_BUFFER_SIZE)
-        rd_ptr=0;
+static RAMFUNC char *_find_eol(char *data, size_t len)
+{   // first '\r' or '\n', NULL if none
+    char *cr = memchr(data, '\r', len);
+    char *lf = memchr(data, '\n', len);
 
-    _usb_stream_rd_ptr = rd_ptr;
-    return (_usb_stream_buffer[rd_ptr]);
+    if ((cr == NULL) || ((lf != NULL) && (lf < cr)))
+        return (lf);
+    return (cr);
 }
 
-void _rx_feed(tty_buf_t *buf, char ch)
+static RAMFUNC void _rx_feed(tty_buf_t *buf, char ch, tty_parse_callback_t callback)
 {
     if ((ch == '\r') || (ch == '\n'))
     {
@@ -127,8 +157,8 @@ void _rx_feed(tty_buf_t *buf, char ch)
     {
         if (buf->len>0)
         {
-            if (_rx_callback != NULL)
-                _rx_callback(buf->data);
+            if (callback != NULL)
+                callback(buf->data);
 
             buf->len = 0;
         }
@@ -137,35 +167,109 @@ void _rx_feed(tty_buf_t *buf, char ch)
         buf->len++;
 }
 
-void tty_rx_task(void)
+static RAMFUNC void _usb_parse(tty_usb_t *usb, char *line, u32 start)
+{
+    metrics_stage(METRICS_RX, metrics_cycles() - start);
+    usb->parse(line);
+}
+
+static RAMFUNC void _usb_line_feed(tty_usb_t *usb)
+{   // frame lines in the oldest packet, complete lines parsed in place
+    u16 slot = usb->rd % USB_TTY_PACKETS;
+    char *data = (char *)&usb->packet[slot][usb->pos];
+    size_t len = usb->packet_len[slot] - usb->pos;
+    char *eol = _find_eol(data, len);
+    size_t seg = (eol != NULL) ? (size_t)(eol - data) : len;
+    tty_buf_t *buf = &usb->line;
+    size_t n;
+
+    if (memchr(data, '\b', seg) != NULL)
+    {   // interactive editing, go char by char
+        if (eol != NULL)
+            seg++;
+        for (n = 0; n < seg; n++)
+        {
+            _rx_feed(buf, data[n], usb->parse);
+        }
+        _usb_rx_consume(usb, seg);
+        return;
+    }
+
+    if ((eol != NULL) && (buf->len == 0))
+    {   // whole line in this packet, no copy; slot stays ours until consumed
+        *eol = '\0';
+        if ((seg > 0) && (usb->parse != NULL))
+            _usb_parse(usb, data, usb->packet_time[slot]);
+        _usb_rx_consume(usb, seg + 1);
+        return;
+    }
+
+    // line continues in next packet, collect it
+    if (buf->len == 0)
+        usb->line_time = usb->packet_time[slot];
+    n = (TTY_BUF_SIZE - 1) - buf->len;
+    if (seg < n)
+        n = seg;
+    memcpy(&buf->data[buf->len], data, n);
+    buf->len += n;
+
+    if (eol != NULL)
+    {
+        buf->data[buf->len] = '\0';
+        if ((buf->len > 0) && (usb->parse != NULL))
+            _usb_parse(usb, buf->data, usb->line_time);
+        buf->len = 0;
+        seg++;
+    }
+    _usb_rx_consume(usb, seg);
+}
+
+RAMFUNC void tty_rx_task(void)
 {
-    static tty_buf_t usb_rx_buf;
     static tty_buf_t uart_rx_buf;
 
+    tty_usb_t *usb = &_usb[USB_CDC_CONSOLE];
+    u8 port;
     int ch;
 
     // process USB RX data
-    while ((ch = _usb_getchar()) >= 0)
+    while (! _usb_rx_empty(usb))
+    {
+        if (_raw_callback != NULL)
+        {
+            if ((_usb_raw_feed(usb) == 0) && (_raw_callback != NULL))
+                break;
+            continue;
+        }
+        _usb_line_feed(usb);
+    }
+
+    // AVP port and vendor interface, JSON lines only
+    for (port = USB_CDC_AVP; port < USB_CDC_PORTS; port++)
     {
-        _rx_feed(&usb_rx_buf, ch);
+        usb = &_usb[port];
+        while (! _usb_rx_empty(usb))
+        {
+            _usb_line_feed(usb);
+        }
     }
 
     // process UART RX data
     while ((ch = TTY_UART_GETCHAR()) >= 0)
     {
-        _rx_feed(&uart_rx_buf, ch);
+        _rx_feed(&uart_rx_buf, ch, _rx_callback);
     }
 }
 
 void tty_put_binary(u8 *data, size_t len)
 {
-    _usb_send_data(data, len);
+    _usb_send_data(USB_CDC_CONSOLE, data, len);
     // NOTE: we dont send binary data to UART in this function
 }
 
 void tty_put_text(char *text)
 {
-    _usb_send_data((u8 *)text, strlen(text));
+    _usb_send_data(USB_CDC_CONSOLE, (u8 *)text, strlen(text));
 
     while (*text != '\0')
     {
@@ -174,11 +278,79 @@ void tty_put_text(char *text)
     }
 }
 
+static bool _usb_tx_busy(void)
+{
+    u8 port;
+
+    for (port = 0; port < USB_CDC_PORTS; port++)
+    {
+        if (usb_cdc_tx_busy(port))
+            return (true);
+    }
+    return (false);
+}
+
+void tty_flush(bool wait)
+{
+#define TTY_FLUSH_TIMEOUT (100*TIMER_MS)
+
+    os_timer_t until = timer_get_time() + TTY_FLUSH_TIMEOUT;
+    u8 port;
+
+    for (port = 0; port < USB_CDC_PORTS; port++)
+    {
+        usb_cdc_tx_flush(port);
+    }
+    if (! wait)
+        return;
+
+    // main loop not running (reset etc.), push the queues out here
+    while (_usb_tx_busy() && (timer_get_time() < until))
+    {
+        usb_device_task();
+        for (port = 0; port < USB_CDC_PORTS; port++)
+        {
+            usb_cdc_tx_flush(port);
+        }
+    }
+}
+
+void tty_avp_put_text(const char *text)
+{
+    _usb_send_data(USB_CDC_AVP, (const u8 *)text, strlen(text));
+}
+
+void tty_vendor_put_text(const char *text)
+{
+    _usb_send_data(USB_VENDOR_AVP, (const u8 *)text, strlen(text));
+}
+
+void tty_set_raw(tty_raw_callback_t callback)
+{   // NULL returns to line mode
+    _raw_callback = callback;
+}
+
 bool tty_init(tty_parse_callback_t callback)
 {
     TTY_UART_INIT(115200);
     _rx_callback = callback;
-    usb_cdc_rx_init(_usb_rx_handler);
+    _usb[USB_CDC_CONSOLE].parse = callback;
+    usb_cdc_rx_init(_usb_rx_buffer, _usb_rx_handler);
     return (true);
 }
 
+void tty_avp_init(tty_parse_callback_t callback)
+{
+    _usb[USB_CDC_AVP].parse = callback;
+}
+
+u16 tty_rx_high_water(u8 port)
+{
+    return ((port < USB_CDC_PORTS) ? _usb[port].high_water : 0);
+}
+
+void tty_vendor_init(tty_parse_callback_t callback)
+{
+    _usb[USB_VENDOR_AVP].parse = callback;
+}
+
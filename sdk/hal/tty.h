@@ -24,11 +24,22 @@
 #endif
 
 typedef void (*tty_parse_callback_t) (char *data);
+// returns number of bytes consumed, rest goes to line parser after raw mode ends
+typedef size_t (*tty_raw_callback_t) (const u8 *data, size_t len);
 
 bool tty_init(tty_parse_callback_t callback);
+void tty_set_raw(tty_raw_callback_t callback);
 void tty_put_binary(u8 *data, size_t len);
 void tty_put_text(char *text);
+void tty_flush(bool wait); // send partial USB packet, wait == until sent
+// second USB port carrying AVP JSON only, lines framed as on the console
+void tty_avp_init(tty_parse_callback_t callback);
+void tty_avp_put_text(const char *text);
+// vendor bulk interface (libusb, WinUSB), same framing as the AVP port
+void tty_vendor_init(tty_parse_callback_t callback);
+void tty_vendor_put_text(const char *text);
 void tty_rx_task(void);
+u16  tty_rx_high_water(u8 port); // max USB packets waiting to be parsed
 
 #endif // ! TTY_H
 
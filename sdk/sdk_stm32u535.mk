@@ -53,8 +53,12 @@ C_SOURCES =  \
   $(STM32_HAL)/Src/stm32u5xx_hal_cortex.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_dma.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_dma_ex.c \
+  $(STM32_HAL)/Src/stm32u5xx_hal_flash.c \
+  $(STM32_HAL)/Src/stm32u5xx_hal_flash_ex.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_pcd.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_pcd_ex.c \
+  $(STM32_HAL)/Src/stm32u5xx_hal_rng.c \
+  $(STM32_HAL)/Src/stm32u5xx_hal_rng_ex.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_spi.c \
   $(STM32_HAL)/Src/stm32u5xx_hal_spi_ex.c \
   \
@@ -143,7 +147,22 @@ C_SOURCES =  \
   $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_cdc_acm_write_with_callback.c \
   $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_cdc_acm_read_run.c \
   $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_cdc_acm_tasks_run.c \
-  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_cdc_acm_write_run.c
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_cdc_acm_write_run.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_activate.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_control_abort.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_control_request.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_deactivate.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_entry.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_hardware_error.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_icc_insert.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_icc_remove.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_initialize.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_notify_task_run.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_response.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_runner_task_run.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_tasks_run.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_time_extension.c \
+  $(STM32_USB)/common/usbx_device_classes/src/ux_device_class_ccid_uninitialize.c
 
 ASM_SOURCES =  \
   $(DIR_SYS)/src/startup_stm32u535xx.s
@@ -0,0 +1,175 @@
+/**
+ * @file cdc_bench.c
+ * @brief USB CDC console throughput benchmark against a NexusClaw board
+ *
+ * Build and run on a Linux or macOS host:
+ *   cc -O2 tools/cdc_bench.c -o cdc_bench
+ *   ./cdc_bench [/dev/ttyACM0] [KiB]
+ *
+ * RX (host to device): streams KiB of '#' remark lines, which the console
+ * parses and drops, followed by VER; timed until the final OK.
+ * TX (device to host): one GET_RANDOM of AVP_MAX_RANDOM_LEN bytes, timed
+ * until the chunk with "remaining":0; counts every byte received.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) 2025 AVP Protocol Contributors
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_LEN        64
+#define RANDOM_LEN      65536
+#define TIMEOUT_S       30.0
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int port_open(const char *dev)
+{
+    struct termios tio;
+    int fd = open(dev, O_RDWR | O_NOCTTY);
+
+    if (fd < 0) {
+        perror(dev);
+        return -1;
+    }
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read until the text contains marker, returns bytes received or -1 */
+static long read_until(int fd, const char *marker)
+{
+    char buf[256 + 4096];
+    size_t keep = strlen(marker) - 1;   /* marker may be split across reads */
+    size_t carry = 0;
+    double deadline = now_s() + TIMEOUT_S;
+    long total = 0;
+    ssize_t n;
+
+    while (now_s() < deadline) {
+        n = read(fd, buf + carry, sizeof(buf) - carry - 1);
+        if (n <= 0) {
+            continue;
+        }
+        total += n;
+        n += (ssize_t)carry;
+        buf[n] = '\0';
+        if (strstr(buf, marker) != NULL) {
+            return total;
+        }
+        carry = ((size_t)n < keep) ? (size_t)n : keep;
+        memmove(buf, buf + n - carry, carry);
+    }
+    return -1;
+}
+
+static int bench_rx(int fd, long kib)
+{
+    char line[LINE_LEN + 1];
+    long bytes = kib * 1024;
+    long sent = 0;
+    double t0, dt;
+
+    memset(line, 'x', LINE_LEN);
+    line[0] = '#';
+    line[LINE_LEN - 1] = '\n';
+    line[LINE_LEN] = '\0';
+
+    t0 = now_s();
+    while (sent < bytes) {
+        if (write_all(fd, line, LINE_LEN) != 0) {
+            perror("write");
+            return 1;
+        }
+        sent += LINE_LEN;
+    }
+    write_all(fd, "VER\n", 4);
+    if (read_until(fd, "OK") < 0) {
+        printf("RX: timeout\n");
+        return 1;
+    }
+    dt = now_s() - t0;
+    printf("RX: %ld bytes in %.3f s, %.0f bytes/s\n", sent, dt, sent / dt);
+    return 0;
+}
+
+static int bench_tx(int fd)
+{
+    char rq[64];
+    long bytes;
+    double t0, dt;
+
+    snprintf(rq, sizeof(rq), "{\"op\":\"GET_RANDOM\",\"length\":%d}\n", RANDOM_LEN);
+
+    t0 = now_s();
+    write_all(fd, rq, strlen(rq));
+    bytes = read_until(fd, "\"remaining\":0}");
+    if (bytes < 0) {
+        printf("TX: timeout\n");
+        return 1;
+    }
+    dt = now_s() - t0;
+    printf("TX: %ld bytes in %.3f s, %.0f bytes/s\n", bytes, dt, bytes / dt);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dev = (argc > 1) ? argv[1] : "/dev/ttyACM0";
+    long kib = (argc > 2) ? atol(argv[2]) : 256;
+    int fd;
+    int fail;
+
+    if (kib <= 0) {
+        kib = 256;
+    }
+    if ((fd = port_open(dev)) < 0) {
+        return 1;
+    }
+
+    /* Sync on a known state first */
+    write_all(fd, "\nVER\n", 5);
+    if (read_until(fd, "OK") < 0) {
+        printf("%s: no answer\n", dev);
+        close(fd);
+        return 1;
+    }
+
+    fail = bench_rx(fd, kib);
+    fail |= bench_tx(fd);
+
+    close(fd);
+    return fail;
+}
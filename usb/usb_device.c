@@ -10,26 +10,72 @@
 
 #include "main.h"
 #include "sys.h"
+#include "time.h"
+
+#include <string.h>
 #include "log.h"
 #include "irq.h"
+#include "sched.h"
+#include "pwr.h"
+#include "metrics.h"
 
 #include "ux_api.h"
 #include "ux_dcd_stm32.h"
+#include "ux_device_stack.h"
+#include "ux_system.h"
 
 #include "ux_device_descriptors.h"
 #include "ux_device_cdc_acm.h"
+#include "ux_device_vendor.h"
+#include "ux_device_ccid.h"
+#if (USB_ECM == 1)
+#include "ux_device_ecm.h"
+#endif
 
 LOG_DEF("USB");
 
 PCD_HandleTypeDef hpcd_usb_drd_fs;
 
-#define USB_MEM_POOL_SIZE      (8*1024)
+#define USB_MEM_POOL_SIZE      (12*1024) // CCID takes about 3 KiB of it
+
+// Packet memory: buffer descriptor table (8 bytes per channel) then buffers
+#define USB_PMA_SIZE           (2048)
+#define USB_PMA_BTABLE_SIZE    (8*8)
+
+static u16 _pma_next = USB_PMA_BTABLE_SIZE;
+
+#if (USB_ECM == 1)
+#define USB_ACM_FUNCTIONS      (1) // AVP port is the CDC-ECM function
+#else
+#define USB_ACM_FUNCTIONS      (USB_CDC_ACM_PORTS)
+#endif
+
+// CDC transmit queue, free running indexes
+#define USB_CDC_TX_PACKET      (64)
+#define USB_CDC_TX_CHUNK       (512)            // max bytes in one write
+#define USB_CDC_TX_TIMEOUT     (100*TIMER_MS)   // full queue, host not reading
+
+typedef struct {
+    u8 queue[USB_CDC_TX_QUEUE] __attribute__((aligned(4)));
+    u16 wr;
+    u16 rd;
+    u16 len;                    // bytes of the write in progress, 0 == idle
+    u16 wr_seen;                // wr at previous task pass
+    bool flush;
+    bool draining;              // flushed response on its way to the host
+    u32 drain_start;            // [cycles] flush requested
+    usb_cdc_tx_stats_t stats;
+} _cdc_tx_t;
+
+static _cdc_tx_t _tx[USB_CDC_PORTS]; // own queue per port, console never stalls AVP
+static bool _in_task = false;
+static volatile bool _suspended = false;
+static usb_cdc_rx_pfunc_t _rx_handler = NULL;
 
 static u32 usb_mem_pool_buffer[USB_MEM_POOL_SIZE/sizeof(u32)];
 
-static ULONG cdc_acm_interface_number;
-static ULONG cdc_acm_configuration_number;
-static UX_SLAVE_CLASS_CDC_ACM_PARAMETER cdc_acm_parameter;
+static UX_SLAVE_CLASS_CDC_ACM_PARAMETER cdc_acm_parameter[USB_CDC_ACM_PORTS];
+static UX_DEVICE_CLASS_CCID_PARAMETER ccid_parameter;
 static UINT usbd_change_function(ULONG Device_State);
 
 void HAL_PCD_MspInit(PCD_HandleTypeDef* hpcd)
@@ -52,7 +98,7 @@ static void _usb_drd_fs_pcd_init(void)
     hpcd_usb_drd_fs.Init.lpm_enable = DISABLE;
     hpcd_usb_drd_fs.Init.battery_charging_enable = DISABLE;
     hpcd_usb_drd_fs.Init.vbus_sensing_enable = DISABLE;
-    hpcd_usb_drd_fs.Init.bulk_doublebuffer_enable = DISABLE;
+    hpcd_usb_drd_fs.Init.bulk_doublebuffer_enable = ENABLE;
     hpcd_usb_drd_fs.Init.iso_singlebuffer_enable = DISABLE;
 
     if (HAL_PCD_Init(&hpcd_usb_drd_fs) != HAL_OK)
@@ -71,6 +117,7 @@ static bool _usb_cdc_init(void)
     ULONG language_id_framework_length;
     u8 *string_framework;
     u8 *language_id_framework;
+    u8 port;
 
     // Initialize USBX Memory
     if (ux_system_initialize((u8 *)usb_mem_pool_buffer, sizeof(usb_mem_pool_buffer), UX_NULL, 0) != UX_SUCCESS)
@@ -104,23 +151,55 @@ static bool _usb_cdc_init(void)
         return false;
     }
 
-    // Initialize the cdc acm class parameters for the device
-    cdc_acm_parameter.ux_slave_class_cdc_acm_instance_activate   = ux_device_cdc_acm_activate;
-    cdc_acm_parameter.ux_slave_class_cdc_acm_instance_deactivate = ux_device_cdc_acm_deactivate;
-    cdc_acm_parameter.ux_slave_class_cdc_acm_parameter_change    = ux_device_cdc_acm_parameterchange;
+    // One cdc acm class instance per port, console first
+    for (port = 0; port < USB_ACM_FUNCTIONS; port++)
+    {
+        ux_device_cdc_acm_params(port, &cdc_acm_parameter[port]);
+
+        if (ux_device_stack_class_register(_ux_system_slave_class_cdc_acm_name,
+                                         ux_device_class_cdc_acm_entry,
+                                         USBD_Get_Configuration_Number(CLASS_TYPE_CDC_ACM, 0),
+                                         USBD_Get_CDC_ACM_Interface_Number(port),
+                                         &cdc_acm_parameter[port]) != UX_SUCCESS)
+        {
+            return false;
+        }
+    }
 
-    // Get cdc acm configuration number
-    cdc_acm_configuration_number = USBD_Get_Configuration_Number(CLASS_TYPE_CDC_ACM, 0);
+#if (USB_ECM == 1)
+    // Network adapter in place of the AVP port, frames go to the IP stack
+    if (ux_device_stack_class_register(_ux_system_slave_class_ecm_name,
+                                       ux_device_ecm_entry,
+                                       USBD_Get_Configuration_Number(CLASS_TYPE_CDC_ECM, 0),
+                                       USBD_Get_Interface_Number(CLASS_TYPE_CDC_ECM, 0),
+                                       UX_NULL) != UX_SUCCESS)
+    {
+        return false;
+    }
+#endif
+
+    // Vendor bulk interface last, WinUSB binds to it through MS OS 2.0 descriptors
+    if (ux_device_stack_class_register(_ux_system_slave_class_vendor_name,
+                                       ux_device_vendor_entry,
+                                       USBD_Get_Configuration_Number(CLASS_TYPE_VENDOR, 0),
+                                       USBD_Get_Interface_Number(CLASS_TYPE_VENDOR, 0),
+                                       UX_NULL) != UX_SUCCESS)
+    {
+        return false;
+    }
 
-    // Find cdc acm interface number 
-    cdc_acm_interface_number = USBD_Get_Interface_Number(CLASS_TYPE_CDC_ACM, 0);
+    if (_ux_device_stack_microsoft_extension_register(USBD_MS_VENDOR_CODE, ux_device_vendor_request) != UX_SUCCESS)
+    {
+        return false;
+    }
 
-    // Initialize the device cdc acm class
-    if (ux_device_stack_class_register(_ux_system_slave_class_cdc_acm_name,
-                                     ux_device_class_cdc_acm_entry,
-                                     cdc_acm_configuration_number,
-                                     cdc_acm_interface_number,
-                                     &cdc_acm_parameter) != UX_SUCCESS)
+    // CCID smart card, pcscd shares it between host processes
+    ux_device_ccid_params(&ccid_parameter);
+    if (ux_device_stack_class_register(_ux_system_device_class_ccid_name,
+                                       ux_device_class_ccid_entry,
+                                       USBD_Get_Configuration_Number(CLASS_TYPE_CCID, 0),
+                                       USBD_Get_Interface_Number(CLASS_TYPE_CCID, 0),
+                                       &ccid_parameter) != UX_SUCCESS)
     {
         return false;
     }
@@ -129,6 +208,31 @@ static bool _usb_cdc_init(void)
 }
 
 
+static u16 _pma_alloc(u16 size)
+{
+    u16 addr = _pma_next;
+
+    _pma_next += (size + 3) & ~3;
+    if (_pma_next > USB_PMA_SIZE)
+    {
+        Error_Handler();
+    }
+    return (addr);
+}
+
+static void _pma_single(u8 ep_addr, u16 size)
+{
+    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, ep_addr, PCD_SNG_BUF, _pma_alloc(size));
+}
+
+static void _pma_double(u8 ep_addr, u16 size)
+{   // USB fills/sends one buffer while the other is handled by software
+    u32 addr0 = _pma_alloc(size);
+    u32 addr1 = _pma_alloc(size);
+
+    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, ep_addr, PCD_DBL_BUF, (addr1 << 16) | addr0);
+}
+
 void usb_device_init(void)
 {
     _usb_drd_fs_pcd_init();
@@ -137,11 +241,25 @@ void usb_device_init(void)
     {
         LOG_ERROR("CDC init failed");
     }
-    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, 0x00, PCD_SNG_BUF, 0x14);  // 0x00 = EP0 OUT
-    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, 0x80, PCD_SNG_BUF, 0x54);  // 0x80 = EP0 IN
-    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, 0x81, PCD_SNG_BUF, 0x94);  // 0x81 = EP1 IN
-    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, 0x01, PCD_SNG_BUF, 0xD4);  // 0x01 = EP1 OUT
-    HAL_PCDEx_PMAConfig(&hpcd_usb_drd_fs, 0x82, PCD_SNG_BUF, 0x114); // 0x82 = EP2 IN
+    _pma_next = USB_PMA_BTABLE_SIZE;
+    _pma_single(0x00, USBD_MAX_EP0_SIZE);
+    _pma_single(0x80, USBD_MAX_EP0_SIZE);
+    _pma_double(USBD_CDCACM_EPIN_ADDR, USBD_CDCACM_EPIN_FS_MPS);
+    _pma_double(USBD_CDCACM_EPOUT_ADDR, USBD_CDCACM_EPOUT_FS_MPS);
+    _pma_single(USBD_CDCACM_EPINCMD_ADDR, USBD_CDCACM_EPINCMD_FS_MPS);
+#if (USB_ECM == 1)
+    _pma_single(USBD_ECM_EPIN_ADDR, USBD_ECM_EP_FS_MPS);            // endpoints of the
+    _pma_single(USBD_ECM_EPOUT_ADDR, USBD_ECM_EP_FS_MPS);           // AVP port
+    _pma_single(USBD_ECM_EPINCMD_ADDR, USBD_ECM_EPINCMD_FS_MPS);
+#else
+    _pma_single(USBD_CDCACM2_EPIN_ADDR, USBD_CDCACM_EPIN_FS_MPS);   // EP4 both directions,
+    _pma_single(USBD_CDCACM2_EPOUT_ADDR, USBD_CDCACM_EPOUT_FS_MPS); // EP5 went to CCID
+    _pma_single(USBD_CDCACM2_EPINCMD_ADDR, USBD_CDCACM_EPINCMD_FS_MPS);
+#endif
+    _pma_single(USBD_CCID_EPIN_ADDR, USBD_CCID_EP_FS_MPS);
+    _pma_single(USBD_CCID_EPOUT_ADDR, USBD_CCID_EP_FS_MPS);
+    _pma_single(USBD_VENDOR_EPIN_ADDR, USBD_VENDOR_EP_FS_MPS);  // last free endpoint
+    _pma_single(USBD_VENDOR_EPOUT_ADDR, USBD_VENDOR_EP_FS_MPS); // number, both directions
 
     // Initialize and link controller HAL driver
     if (ux_dcd_stm32_initialize((ULONG)USB_DRD_FS, (ULONG)&hpcd_usb_drd_fs) != UX_SUCCESS)
@@ -152,36 +270,279 @@ void usb_device_init(void)
     HAL_PCD_Start(&hpcd_usb_drd_fs);
 }
 
-void usb_device_task(void)
+static RAMFUNC bool _port_connected(u8 port)
 {
+    if (port == USB_VENDOR_AVP)
+        return (ux_device_vendor_connected());
+
+    return (ux_device_cdc_acm_connected(port));
+}
+
+static RAMFUNC bool _port_tx_run(u8 port, u8 *data, u16 len)
+{
+    if (port == USB_VENDOR_AVP)
+        return (ux_device_vendor_tx_run(data, len));
+
+    return (ux_device_cdc_acm_tx_run(port, data, len));
+}
+
+static RAMFUNC void _cdc_tx_task(u8 port)
+{
+    _cdc_tx_t *tx = &_tx[port];
+    u16 queued;
+    u16 rd;
+    u16 len;
+
+    if (! _port_connected(port))
+    {   // nobody to read it
+        tx->rd = tx->wr;
+        tx->len = 0;
+        tx->flush = false;
+        tx->draining = false;
+        return;
+    }
+
+    if (tx->len == 0)
+    {
+        queued = tx->wr - tx->rd;
+        if (queued == 0)
+        {
+            tx->flush = false;
+            if (tx->draining)
+            {   // all taken by the host
+                metrics_stage(METRICS_DRAIN, metrics_cycles() - tx->drain_start);
+                tx->draining = false;
+            }
+            return;
+        }
+
+        rd = tx->rd % USB_CDC_TX_QUEUE;
+        len = USB_CDC_TX_QUEUE - rd; // contiguous part
+        if (len > queued)
+            len = queued;
+        if (len > USB_CDC_TX_CHUNK)
+            len = USB_CDC_TX_CHUNK;
+
+        if (len >= USB_CDC_TX_PACKET)
+        {   // full packets now, the rest waits for more data
+            len -= len % USB_CDC_TX_PACKET;
+        }
+        else if ((len == queued) && (! tx->flush) && (tx->wr != tx->wr_seen))
+        {   // short packet only after the producer went quiet for one pass
+            tx->wr_seen = tx->wr;
+            return;
+        }
+        tx->len = len;
+    }
+
+    if (_port_tx_run(port, &tx->queue[tx->rd % USB_CDC_TX_QUEUE], tx->len))
+    {
+        tx->rd += tx->len;
+        tx->len = 0;
+    }
+}
+
+RAMFUNC void usb_device_task(void)
+{
+    u8 port;
+
+    if (_in_task)
+        return; // printed from USB callback, data get queued
+
+    _in_task = true;
     ux_device_stack_tasks_run();
     ux_device_cdc_acm_task();
+    ux_device_vendor_task();
+#if (USB_ECM == 1)
+    ux_device_ecm_task();
+#endif
+    for (port = 0; port < USB_CDC_PORTS; port++)
+    {
+        _cdc_tx_task(port);
+    }
+    _in_task = false;
 }
 
+bool usb_device_busy(void)
+{   // queued data and held back short packets go out on the next passes
+    u8 port;
 
-bool usb_cdc_rx_init(usb_cdc_rx_pfunc_t rx_handler)
+    for (port = 0; port < USB_CDC_PORTS; port++)
+    {
+        if ((_tx[port].wr != _tx[port].rd) || (_tx[port].len != 0))
+            return (true);
+    }
+#if (USB_ECM == 1)
+    if (ux_device_ecm_tx_busy())
+        return (true);
+#endif
+    return (ux_device_ccid_busy());
+}
+
+
+static RAMFUNC void _usb_rx(u8 port, u8 *buf, u32 len)
 {
-	ux_device_cdc_acm_rx_init(rx_handler);
+    pwr_rx_mark(); // first byte after a Stop exit
+    _rx_handler(port, buf, len);
+}
+
+bool usb_cdc_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler)
+{
+	_rx_handler = rx_handler;
+	ux_device_cdc_acm_rx_init(get_buffer, (rx_handler != NULL) ? _usb_rx : NULL);
+	ux_device_vendor_rx_init(get_buffer, (rx_handler != NULL) ? _usb_rx : NULL);
 	return (true);
 }
 
+void usb_device_pool(u32 *size, u32 *free, u32 *min_free)
+{   // USBX byte pool, class instances and transfer buffers
+    UX_MEMORY_BYTE_POOL *pool = _ux_system->ux_system_memory_byte_pool[UX_MEMORY_BYTE_POOL_REGULAR];
+
+    *size = pool->ux_byte_pool_size;
+    *free = pool->ux_byte_pool_available;
+    *min_free = pool->ux_byte_pool_min_free; // UX_ENABLE_MEMORY_STATISTICS
+}
+
+bool usb_device_suspended(void)
+{
+    return (_suspended);
+}
+
 bool usb_device_connected(void)
 {
-    return (ux_device_cdc_acm_connected());
+    return (ux_device_cdc_acm_connected(USB_CDC_CONSOLE));
+}
+
+bool usb_cdc_connected(u8 port)
+{
+    return (_port_connected(port));
+}
+
+RAMFUNC u16 usb_cdc_tx(u8 port, const u8 *data, u16 len)
+{
+    _cdc_tx_t *tx = &_tx[port];
+    os_timer_t until = 0;
+    bool waited = false;
+    u16 done = 0;
+    u16 rd = tx->rd;
+    u16 wr;
+    u16 n;
+
+    if (! _port_connected(port))
+        return (0);
+
+    while (done < len)
+    {
+        n = USB_CDC_TX_QUEUE - (u16)(tx->wr - tx->rd);
+        if (n == 0)
+        {   // queue full, push data out while waiting for space
+            if (! waited)
+                tx->stats.full_waits++;
+            waited = true;
+
+            if (rd != tx->rd)
+            {
+                rd = tx->rd;
+                until = 0;
+            }
+            if (until == 0)
+                until = timer_get_time() + USB_CDC_TX_TIMEOUT;
+
+            if (_in_task || (timer_get_time() > until))
+            {
+                tx->stats.dropped += len - done;
+                break;
+            }
+            usb_device_task();
+            continue;
+        }
+
+        wr = tx->wr % USB_CDC_TX_QUEUE;
+        if (n > USB_CDC_TX_QUEUE - wr)
+            n = USB_CDC_TX_QUEUE - wr;
+        if (n > len - done)
+            n = len - done;
+
+        memcpy(&tx->queue[wr], &data[done], n);
+        tx->wr += n;
+        done += n;
+
+        if ((u16)(tx->wr - tx->rd) > tx->stats.high_water)
+            tx->stats.high_water = tx->wr - tx->rd;
+    }
+    sched_event(SCHED_EV_USB);
+    return (done);
+}
+
+void usb_cdc_tx_flush(u8 port)
+{
+    _cdc_tx_t *tx = &_tx[port];
+
+    tx->flush = true;
+    if ((! tx->draining) && (tx->wr != tx->rd))
+    {
+        tx->draining = true;
+        tx->drain_start = metrics_cycles();
+    }
+    sched_event(SCHED_EV_USB);
+}
+
+bool usb_cdc_tx_busy(u8 port)
+{
+    return (_tx[port].wr != _tx[port].rd);
+}
+
+const usb_cdc_tx_stats_t *usb_cdc_tx_stats(u8 port)
+{
+    return (&_tx[port].stats);
+}
+
+void usb_ccid_init(usb_ccid_apdu_pfunc_t handler)
+{
+    ux_device_ccid_apdu_init(handler);
+}
+
+bool usb_ccid_connected(void)
+{
+    return (ux_device_ccid_connected());
+}
+
+void usb_ccid_task(void)
+{
+    ux_device_ccid_apdu_task();
+    if (ux_device_ccid_busy())
+        sched_event(SCHED_EV_USB); // response or time extension to send
+}
+
+#if (USB_ECM == 1)
+void usb_ecm_init(usb_ecm_rx_buf_pfunc_t get_buffer, usb_ecm_rx_pfunc_t rx_handler)
+{
+    ux_device_ecm_rx_init(get_buffer, rx_handler);
+}
+
+bool usb_ecm_connected(void)
+{
+    return (ux_device_ecm_connected());
+}
+
+bool usb_ecm_tx(u8 *frame, u16 len)
+{
+    if (! ux_device_ecm_tx(frame, len))
+        return (false);
+    sched_event(SCHED_EV_USB);
+    return (true);
 }
 
-usb_result_e usb_cdc_tx(u8* data, u16 len)
+bool usb_ecm_tx_busy(void)
 {
-      if (ux_device_cdc_acm_tx(data, len))
-            return (USB_RESULT_OK);
-    
-      return (USB_RESULT_BUSY);
+    return (ux_device_ecm_tx_busy());
 }
 
-bool usb_cdc_tx_busy(void)
+void usb_ecm_mac(u8 *mac)
 {
-    return (false);
+    ux_device_mac_address(mac, 0);
 }
+#endif
 
 /**
   * @brief  usbd_change_function
@@ -202,15 +563,13 @@ static UINT usbd_change_function(ULONG device_state)
         break;
 
     case UX_DCD_STM32_DEVICE_CONNECTED:
-        break;
-
     case UX_DCD_STM32_DEVICE_DISCONNECTED:
+    case UX_DCD_STM32_DEVICE_RESUMED:
+        _suspended = false;
         break;
 
     case UX_DCD_STM32_DEVICE_SUSPENDED:
-        break;
-
-    case UX_DCD_STM32_DEVICE_RESUMED:
+        _suspended = true; // bus idle 3 ms, the host sleeps or the port is off
         break;
 
     case UX_DCD_STM32_SOF_RECEIVED:
@@ -223,7 +582,7 @@ static UINT usbd_change_function(ULONG device_state)
     return status;
 }
 
-ALIGN_TYPE _ux_utility_interrupt_disable(VOID)
+RAMFUNC ALIGN_TYPE _ux_utility_interrupt_disable(VOID)
 {
   UINT interrupt_save;
   interrupt_save = __get_PRIMASK();
@@ -231,15 +590,15 @@ ALIGN_TYPE _ux_utility_interrupt_disable(VOID)
   return interrupt_save;
 }
 
-void _ux_utility_interrupt_restore(ALIGN_TYPE flags)
+RAMFUNC void _ux_utility_interrupt_restore(ALIGN_TYPE flags)
 {
   __set_PRIMASK(flags);
 }
 
-void USB_IRQHandler(void)
+RAMFUNC void USB_IRQHandler(void)
 {
-    // printf("I\n");
     HAL_PCD_IRQHandler(&hpcd_usb_drd_fs);
+    sched_event(SCHED_EV_USB); // transfers complete in usb_device_task()
 }
 
 
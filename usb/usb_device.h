@@ -15,20 +15,78 @@
 
 #include "type.h"
 
-typedef void (*usb_cdc_rx_pfunc_t)(uint8_t* pbuf, u32 len);
-
+// Composite device with two CDC ACM functions: text console (debug, HEX
+// SPI, binary bridge, logs) and a port carrying AVP JSON only. A vendor
+// bulk interface (WinUSB on Windows, libusb anywhere, no driver needed)
+// carries AVP JSON too and shares the queue and RX plumbing of the ports.
 typedef enum {
-    USB_RESULT_OK = 0,
-    USB_RESULT_BUSY = 0xFF,
-} usb_result_e;
+    USB_CDC_CONSOLE = 0,
+    USB_CDC_AVP,
+    USB_VENDOR_AVP,
+    USB_CDC_PORTS
+} usb_cdc_port_e;
+
+#define USB_CDC_ACM_PORTS (USB_VENDOR_AVP) // ports that are CDC ACM functions
+
+// Received data are read straight from packet memory into buffers given
+// by the application, USB_CDC_RX_PACKET bytes each. No buffer == NAK.
+#define USB_CDC_RX_PACKET (64)
+
+typedef u8 *(*usb_cdc_rx_buf_pfunc_t)(u8 port);
+typedef void (*usb_cdc_rx_pfunc_t)(u8 port, uint8_t* pbuf, u32 len);
+
+// Transmitted data are queued without waiting for the host. The queue is
+// sent from usb_device_task() in full packets, a short packet goes out
+// once the producer is quiet or after usb_cdc_tx_flush().
+#define USB_CDC_TX_QUEUE (4*1024) // power of two
+
+typedef struct {
+    u16 high_water;     // max bytes queued
+    u32 full_waits;     // writes that found the queue full
+    u32 dropped;        // bytes lost, host stopped reading
+} usb_cdc_tx_stats_t;
 
 void usb_device_init(void);
 void usb_device_task(void);
-bool usb_device_connected(void);
+bool usb_device_busy(void);      // usb_device_task() has work without waiting for an interrupt
+bool usb_device_suspended(void); // host suspended the bus, Stop mode is allowed
+void usb_device_pool(u32 *size, u32 *free, u32 *min_free); // [B] USBX memory pool, min_free since boot
+bool usb_device_connected(void); // console port
+
+bool         usb_cdc_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler);
+bool         usb_cdc_connected(u8 port);
+u16          usb_cdc_tx(u8 port, const u8 *data, u16 len); // returns bytes queued
+void         usb_cdc_tx_flush(u8 port);
+bool         usb_cdc_tx_busy(u8 port);
+const usb_cdc_tx_stats_t *usb_cdc_tx_stats(u8 port);
+
+// CCID smart card function: one slot, a virtual card that is always present
+// and takes short and extended APDUs. The handler runs from usb_ccid_task()
+// in the main loop, never from the USB task, the host gets time extensions
+// while it is busy. Returns the response length including SW1 SW2.
+#define USB_CCID_APDU_MAX (7 + 1024 + 2)  // extended APDU, 1 KiB of data
+#define USB_CCID_RESP_MAX (4*1024)
+
+typedef u16 (*usb_ccid_apdu_pfunc_t)(const u8 *apdu, u16 len, u8 *resp, u16 resp_max);
+
+void         usb_ccid_init(usb_ccid_apdu_pfunc_t handler);
+bool         usb_ccid_connected(void);
+void         usb_ccid_task(void);
+
+// CDC-ECM network function (make USB_ECM=1) in place of the AVP CDC port,
+// the host sees a USB Ethernet adapter. Whole frames go in and out, the
+// IP stack is in the application. Frames are received straight into
+// buffers given by the application, no buffer == NAK.
+#define USB_ECM_FRAME_MAX (1536) // 1514 byte frame plus host padding, whole packets
+
+typedef u8 *(*usb_ecm_rx_buf_pfunc_t)(void);
+typedef void (*usb_ecm_rx_pfunc_t)(u8 *frame, u16 len);
 
-bool         usb_cdc_rx_init(usb_cdc_rx_pfunc_t rx_handler);
-usb_result_e usb_cdc_tx(u8 *data, u16 len);
-bool         usb_cdc_tx_busy(void);
+void         usb_ecm_init(usb_ecm_rx_buf_pfunc_t get_buffer, usb_ecm_rx_pfunc_t rx_handler);
+bool         usb_ecm_connected(void); // host brought the link up
+bool         usb_ecm_tx(u8 *frame, u16 len); // false == previous frame still going out
+bool         usb_ecm_tx_busy(void);
+void         usb_ecm_mac(u8 *mac); // device side MAC address
 
 #ifdef __cplusplus
 }
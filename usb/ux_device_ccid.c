@@ -0,0 +1,375 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_ccid.c
+  * @author  Tropicsquare
+  * @brief   CCID smart card interface, one slot with a virtual card that
+  *          takes extended APDUs (pcscd, PC/SC on Windows and macOS)
+  ******************************************************************************
+  */
+
+#include "type.h"
+#include "usb_device.h"
+#include "ux_device_ccid.h"
+#include "ux_device_descriptors.h"
+#include "time.h"
+#include "log.h"
+
+#include <string.h>
+
+LOG_DEF("CCID");
+
+#define CCID_HDR                (UX_DEVICE_CLASS_CCID_MESSAGE_HEADER_LENGTH)
+#define CCID_DATA_MAX           (USBD_CCID_MAX_MESSAGE - CCID_HDR)  // abData of one message
+#define CCID_WTX_PERIOD         (500*TIMER_MS)  // well inside the host read timeout
+
+// APDU exchange, the USBX runner (USB task) and ux_device_ccid_apdu_task()
+// (main loop) hand it over through the state
+typedef enum {
+    CCID_IDLE = 0,
+    CCID_RX,                    // command chained over several XfrBlocks
+    CCID_QUEUED,                // complete, waiting for the main loop
+    CCID_BUSY,                  // handler running
+    CCID_DONE,                  // response ready
+    CCID_TX,                    // response chained, host asks for the rest
+} _ccid_state_e;
+
+typedef struct {
+    UX_DEVICE_CLASS_CCID *instance;
+    u8 state;
+    bool waiting;               // XfrBlock handle waits for the response
+    u8 seq;                     // bSeq of the XfrBlock waiting
+    bool overflow;
+    u16 apdu_len;
+    u16 resp_len;
+    u16 resp_off;
+    timer_time_t wtx_time;
+    usb_ccid_apdu_pfunc_t handler;
+} _ccid_t;
+
+static _ccid_t _ccid;
+
+static u8 _apdu[USB_CCID_APDU_MAX];
+static u8 _resp[USB_CCID_RESP_MAX];
+
+// T=1, direct convention, historical bytes "NexusClaw", TCK
+static const u8 _atr[] = {
+    0x3B, 0x89, 0x80, 0x01, 'N', 'e', 'x', 'u', 's', 'C', 'l', 'a', 'w', 0x64
+};
+
+// T=1 protocol data of the Parameters response: Fi/Di, LRC, guard time,
+// BWI 4 / CWI 5, clock stop not supported, IFSC 254, NAD 0
+static const u8 _t1_params[] = {0x11, 0x10, 0x00, 0x45, 0x00, 0xFE, 0x00};
+
+static ULONG _clock = USBD_CCID_CLOCK_KHZ;
+static ULONG _data_rate = USBD_CCID_DATA_RATE;
+
+void ux_device_ccid_apdu_init(usb_ccid_apdu_pfunc_t handler)
+{
+    _ccid.handler = handler;
+}
+
+static void _ccid_icc_status(ULONG slot, u8 status)
+{
+    _ccid.instance->ux_device_class_ccid_slots[slot].ux_device_class_ccid_slot_icc_status = status;
+}
+
+static void _ccid_data_block(UX_DEVICE_CLASS_CCID_MESSAGES *io_msg, u16 len, u8 chain)
+{
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+
+    UX_DEVICE_CLASS_CCID_MESSAGE_LENGTH_SET(rsp, len);
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_CHAIN_PARAMETER] = chain;
+    io_msg->ux_device_class_ccid_messages_rdr_to_pc_length = CCID_HDR + len;
+}
+
+// Command failed, bError is the offset of the offending field or an error code
+static UINT _ccid_fail(UX_DEVICE_CLASS_CCID_MESSAGES *io_msg, u8 error)
+{
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_STATUS] |= UX_DEVICE_CLASS_CCID_SLOT_STATUS_CMD_FAILED;
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_ERROR] = error;
+    _ccid_data_block(io_msg, 0, 0);
+    return (UX_STATE_NEXT);
+}
+
+// Next part of the response, responses longer than one message are chained
+static UINT _ccid_resp_chunk(UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+    u16 n = _ccid.resp_len - _ccid.resp_off;
+    u8 chain;
+
+    if (n > CCID_DATA_MAX)
+        n = CCID_DATA_MAX;
+
+    if (_ccid.resp_off == 0)
+        chain = (n == _ccid.resp_len) ? UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_BEGIN_END
+                                      : UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_BEGIN_CONTINUE;
+    else
+        chain = (_ccid.resp_off + n == _ccid.resp_len) ? UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_CONTINUE_END
+                                                       : UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_CONTINUE;
+
+    memcpy(&rsp[CCID_HDR], &_resp[_ccid.resp_off], n);
+    _ccid.resp_off += n;
+    _ccid.state = (_ccid.resp_off < _ccid.resp_len) ? CCID_TX : CCID_IDLE;
+
+    _ccid_data_block(io_msg, n, chain);
+    return (UX_STATE_NEXT);
+}
+
+// XfrBlock in progress: answer once the main loop is done, keep the host
+// waiting with time extensions meanwhile
+static UINT _ccid_xfr_wait(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    UX_SLAVE_TRANSFER *transfer = &_ccid.instance->ux_device_class_ccid_endpoint_in->ux_slave_endpoint_transfer_request;
+    timer_time_t now;
+
+    // time extension shares the bulk IN transfer with the response
+    if (transfer->ux_slave_transfer_request_status == UX_TRANSFER_STATUS_PENDING)
+        return (UX_STATE_WAIT);
+
+    if (_ccid.state == CCID_DONE)
+    {
+        _ccid.waiting = false;
+        _ccid.resp_off = 0;
+        return (_ccid_resp_chunk(io_msg));
+    }
+
+    now = timer_get_time();
+    if (now > _ccid.wtx_time)
+    {
+        _ccid.wtx_time = now + CCID_WTX_PERIOD;
+        ux_device_class_ccid_time_extension(_ccid.instance, slot, 1);
+    }
+    return (UX_STATE_WAIT);
+}
+
+/**
+  * @brief  _ccid_xfr_block
+  *         PC_to_RDR_XfrBlock handle, extended APDU level exchange: the
+  *         command may come in several messages (wLevelParameter), the
+  *         response goes out the same way.
+  * @retval UX_STATE_NEXT (response ready) or UX_STATE_WAIT
+  */
+static UINT _ccid_xfr_block(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    u8 *cmd = io_msg->ux_device_class_ccid_messages_pc_to_rdr;
+    ULONG len;
+    u16 level;
+
+    // handle is run again until it stops waiting, a new bSeq is a new
+    // command (host aborted the previous one)
+    if (_ccid.waiting && (cmd[UX_DEVICE_CLASS_CCID_OFFSET_SEQ] == _ccid.seq))
+        return (_ccid_xfr_wait(slot, io_msg));
+    _ccid.waiting = false;
+
+    len = UX_DEVICE_CLASS_CCID_MESSAGE_LENGTH_GET(cmd);
+    level = _ux_utility_short_get(&cmd[UX_DEVICE_CLASS_CCID_OFFSET_LEVEL_PARAMETER]);
+
+    switch (level)
+    {
+    case UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_EMPTY_DATA:
+        if (_ccid.state != CCID_TX)
+            return (_ccid_fail(io_msg, UX_DEVICE_CLASS_CCID_OFFSET_LEVEL_PARAMETER));
+        return (_ccid_resp_chunk(io_msg));
+
+    case UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_BEGIN_END:
+    case UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_BEGIN_CONTINUE:
+        if (_ccid.state == CCID_BUSY)
+            return (_ccid_fail(io_msg, UX_DEVICE_CLASS_CCID_CMD_SLOT_BUSY)); // aborted command still runs
+        _ccid.state = CCID_RX;
+        _ccid.apdu_len = 0;
+        _ccid.overflow = false;
+        break;
+
+    case UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_CONTINUE_END:
+    case UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_CONTINUE:
+        if (_ccid.state != CCID_RX)
+            return (_ccid_fail(io_msg, UX_DEVICE_CLASS_CCID_OFFSET_LEVEL_PARAMETER));
+        break;
+
+    default:
+        return (_ccid_fail(io_msg, UX_DEVICE_CLASS_CCID_OFFSET_LEVEL_PARAMETER));
+    }
+
+    if (len > (ULONG)(sizeof(_apdu) - _ccid.apdu_len))
+        _ccid.overflow = true;
+    else
+    {
+        memcpy(&_apdu[_ccid.apdu_len], &cmd[CCID_HDR], len);
+        _ccid.apdu_len += len;
+    }
+
+    if ((level == UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_BEGIN_CONTINUE) ||
+        (level == UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_CONTINUE))
+    {   // empty answer, host sends the next part
+        _ccid_data_block(io_msg, 0, UX_DEVICE_CLASS_CCID_LEVEL_PARAMETER_EMPTY_DATA);
+        return (UX_STATE_NEXT);
+    }
+
+    if (_ccid.overflow)
+    {   // SW 6700 wrong length
+        _resp[0] = 0x67;
+        _resp[1] = 0x00;
+        _ccid.resp_len = 2;
+        _ccid.state = CCID_DONE;
+    }
+    else
+        _ccid.state = CCID_QUEUED;
+
+    _ccid.waiting = true;
+    _ccid.seq = cmd[UX_DEVICE_CLASS_CCID_OFFSET_SEQ];
+    _ccid.wtx_time = timer_get_time() + CCID_WTX_PERIOD;
+    return (_ccid_xfr_wait(slot, io_msg));
+}
+
+static UINT _ccid_icc_power_on(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+
+    if (_ccid.state != CCID_BUSY)
+        _ccid.state = CCID_IDLE;
+
+    // the class leaves slot status to the application in standalone mode
+    _ccid_icc_status(slot, UX_DEVICE_CLASS_CCID_ICC_ACTIVE);
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_STATUS] = UX_DEVICE_CLASS_CCID_SLOT_STATUS(UX_DEVICE_CLASS_CCID_ICC_ACTIVE, 0);
+
+    memcpy(&rsp[CCID_HDR], _atr, sizeof(_atr));
+    _ccid_data_block(io_msg, sizeof(_atr), 0);
+    return (UX_STATE_NEXT);
+}
+
+static UINT _ccid_icc_power_off(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+
+    _ccid_icc_status(slot, UX_DEVICE_CLASS_CCID_ICC_INACTIVE);
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_STATUS] = UX_DEVICE_CLASS_CCID_SLOT_STATUS(UX_DEVICE_CLASS_CCID_ICC_INACTIVE, 0);
+    return (UX_STATE_NEXT);
+}
+
+static UINT _ccid_get_slot_status(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    UX_PARAMETER_NOT_USED(slot);
+    UX_PARAMETER_NOT_USED(io_msg);
+    return (UX_STATE_NEXT); // header filled by the class
+}
+
+// Get/Set/ResetParameters: T=1 only, parameters are fixed
+static UINT _ccid_parameters(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    u8 *cmd = io_msg->ux_device_class_ccid_messages_pc_to_rdr;
+    u8 *rsp = io_msg->ux_device_class_ccid_messages_rdr_to_pc;
+
+    UX_PARAMETER_NOT_USED(slot);
+
+    if ((cmd[UX_DEVICE_CLASS_CCID_OFFSET_MESSAGE_TYPE] == UX_DEVICE_CLASS_CCID_PC_TO_RDR_SET_PARAMETERS) &&
+        (cmd[UX_DEVICE_CLASS_CCID_OFFSET_SET_PARAMETERS_PROTOCOL_NUM] != UX_DEVICE_CLASS_CCID_PROTOCOL_T_1))
+    {
+        rsp[UX_DEVICE_CLASS_CCID_OFFSET_STATUS] |= UX_DEVICE_CLASS_CCID_SLOT_STATUS_CMD_FAILED;
+        rsp[UX_DEVICE_CLASS_CCID_OFFSET_ERROR] = UX_DEVICE_CLASS_CCID_OFFSET_SET_PARAMETERS_PROTOCOL_NUM;
+    }
+
+    rsp[UX_DEVICE_CLASS_CCID_OFFSET_PARAMETERS_PROTOCOL_NUM] = UX_DEVICE_CLASS_CCID_PROTOCOL_T_1;
+    memcpy(&rsp[CCID_HDR], _t1_params, sizeof(_t1_params));
+    UX_DEVICE_CLASS_CCID_MESSAGE_LENGTH_SET(rsp, sizeof(_t1_params));
+    io_msg->ux_device_class_ccid_messages_rdr_to_pc_length = CCID_HDR + sizeof(_t1_params);
+    return (UX_STATE_NEXT);
+}
+
+static UINT _ccid_abort(ULONG slot, UX_DEVICE_CLASS_CCID_MESSAGES *io_msg)
+{
+    UX_PARAMETER_NOT_USED(slot);
+    UX_PARAMETER_NOT_USED(io_msg);
+
+    // a running handler can not be stopped, its response is dropped
+    _ccid.waiting = false;
+    if (_ccid.state != CCID_BUSY)
+        _ccid.state = CCID_IDLE;
+    return (UX_STATE_NEXT);
+}
+
+static UX_DEVICE_CLASS_CCID_HANDLES _ccid_handles = {
+    .ux_device_class_ccid_handles_icc_power_on      = _ccid_icc_power_on,
+    .ux_device_class_ccid_handles_icc_power_off     = _ccid_icc_power_off,
+    .ux_device_class_ccid_handles_get_slot_status   = _ccid_get_slot_status,
+    .ux_device_class_ccid_handles_xfr_block         = _ccid_xfr_block,
+    .ux_device_class_ccid_handles_get_parameters    = _ccid_parameters,
+    .ux_device_class_ccid_handles_reset_parameters  = _ccid_parameters,
+    .ux_device_class_ccid_handles_set_parameters    = _ccid_parameters,
+    .ux_device_class_ccid_handles_abort             = _ccid_abort,
+};
+
+/**
+  * @brief  ux_device_ccid_activate
+  *         Host selected the configuration, the card is always present.
+  * @param  ccid_instance: Pointer to the ccid class instance.
+  * @retval none
+  */
+static void ux_device_ccid_activate(void *ccid_instance)
+{
+    _ccid.instance = (UX_DEVICE_CLASS_CCID *)ccid_instance;
+    _ccid.waiting = false;
+    if (_ccid.state != CCID_BUSY)
+        _ccid.state = CCID_IDLE;
+
+    ux_device_class_ccid_icc_insert(_ccid.instance, 0, UX_FALSE);
+    LOG_DEBUG("ux_device_ccid_activate");
+}
+
+static void ux_device_ccid_deactivate(void *ccid_instance)
+{
+    UX_PARAMETER_NOT_USED(ccid_instance);
+    _ccid.instance = UX_NULL;
+}
+
+void ux_device_ccid_params(UX_DEVICE_CLASS_CCID_PARAMETER *param)
+{
+    param->ux_device_class_ccid_instance_activate   = ux_device_ccid_activate;
+    param->ux_device_class_ccid_instance_deactivate = ux_device_ccid_deactivate;
+    param->ux_device_class_ccid_handles             = &_ccid_handles;
+    param->ux_device_class_ccid_clocks              = &_clock;
+    param->ux_device_class_ccid_data_rates          = &_data_rate;
+    param->ux_device_class_ccid_max_transfer_length = USBD_CCID_MAX_MESSAGE;
+    param->ux_device_class_ccid_max_n_slots         = 1;
+    param->ux_device_class_ccid_max_n_busy_slots    = 1;
+    param->ux_device_class_ccid_n_clocks            = 1;
+    param->ux_device_class_ccid_n_data_rates        = 1;
+}
+
+bool ux_device_ccid_connected(void)
+{
+    if (_ccid.instance == UX_NULL)
+        return (false);
+
+    return (_ux_system_slave->ux_system_slave_device.ux_slave_device_state == UX_DEVICE_CONFIGURED);
+}
+
+// Runs the APDU handler outside of the USB task, so the handler may take
+// its time and keep USB running (avp_l2_yield()), the XfrBlock handle sends
+// time extensions meanwhile.
+bool ux_device_ccid_busy(void)
+{   // host waits for a response, time extensions are due
+    return (_ccid.waiting);
+}
+
+void ux_device_ccid_apdu_task(void)
+{
+    if (_ccid.state != CCID_QUEUED)
+        return;
+
+    _ccid.state = CCID_BUSY;
+    if (_ccid.handler != NULL)
+        _ccid.resp_len = _ccid.handler(_apdu, _ccid.apdu_len, _resp, sizeof(_resp));
+    else
+        _ccid.resp_len = 0;
+
+    if (_ccid.resp_len < 2)
+    {   // SW 6F00 no precise diagnosis
+        _resp[0] = 0x6F;
+        _resp[1] = 0x00;
+        _ccid.resp_len = 2;
+    }
+    _ccid.state = _ccid.waiting ? CCID_DONE : CCID_IDLE; // dropped when aborted
+}
@@ -0,0 +1,30 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_ccid.h
+  * @author  Tropicsquare
+  * @brief   CCID smart card interface header file
+  ******************************************************************************
+  */
+
+#ifndef UX_DEVICE_CCID_H
+#define UX_DEVICE_CCID_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+#include "ux_device_class_ccid.h"
+
+void ux_device_ccid_params(UX_DEVICE_CLASS_CCID_PARAMETER *param);
+void ux_device_ccid_apdu_init(usb_ccid_apdu_pfunc_t handler);
+bool ux_device_ccid_connected(void);
+bool ux_device_ccid_busy(void);
+
+void ux_device_ccid_apdu_task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ! UX_DEVICE_CCID_H
@@ -13,32 +13,33 @@
 
 LOG_DEF("CDC");
 
-UX_SLAVE_CLASS_CDC_ACM  *cdc_acm;
-
-#define USB_HS_READ_LENGTH (512)
-#define ACM_RX_BUFFER_SIZE USB_HS_READ_LENGTH
-static u8 acm_rx_buffer[ACM_RX_BUFFER_SIZE];
+// one class instance per port, console first (interfaces 0/1), AVP (2/3)
+static UX_SLAVE_CLASS_CDC_ACM *cdc_acm[USB_CDC_ACM_PORTS];
 
 UX_SLAVE_CLASS_CDC_ACM_LINE_CODING_PARAMETER CDC_VCP_LineCoding;
 
+static usb_cdc_rx_buf_pfunc_t _rx_get_buffer = NULL;
 static usb_cdc_rx_pfunc_t _rx_handler = NULL;
+static u8 *_rx_pending[USB_CDC_ACM_PORTS]; // buffer of the read in progress (zero copy)
 
-void ux_device_cdc_acm_rx_init(usb_cdc_rx_pfunc_t rx_handler)
+void ux_device_cdc_acm_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler)
 {
+	_rx_get_buffer = get_buffer;
 	_rx_handler = rx_handler;
 }
 
 /**
   * @brief  ux_device_cdc_acm_activate
   *         This function is called when insertion of a CDC ACM device.
+  * @param  port: USB_CDC_xxx port of the instance
   * @param  cdc_acm_instance: Pointer to the cdc acm class instance.
   * @retval none
   */
-void ux_device_cdc_acm_activate(void *cdc_acm_instance)
+static void ux_device_cdc_acm_activate(u8 port, void *cdc_acm_instance)
 {
-    cdc_acm = (UX_SLAVE_CLASS_CDC_ACM*)cdc_acm_instance;
+    cdc_acm[port] = (UX_SLAVE_CLASS_CDC_ACM*)cdc_acm_instance;
     
-    LOG_DEBUG("ux_device_cdc_acm_activate()");
+    LOG_DEBUG("ux_device_cdc_acm_activate(%u)", port);
     
     CDC_VCP_LineCoding.ux_slave_class_cdc_acm_parameter_baudrate = 115200;
     CDC_VCP_LineCoding.ux_slave_class_cdc_acm_parameter_data_bit = 8;
@@ -46,7 +47,7 @@ void ux_device_cdc_acm_activate(void *cdc_acm_instance)
     CDC_VCP_LineCoding.ux_slave_class_cdc_acm_parameter_stop_bit = 0; // stop bits-1 
 
     // Set device class_cdc_acm with default parameters
-    if (ux_device_class_cdc_acm_ioctl(cdc_acm, UX_SLAVE_CLASS_CDC_ACM_IOCTL_SET_LINE_CODING, &CDC_VCP_LineCoding) != UX_SUCCESS)
+    if (ux_device_class_cdc_acm_ioctl(cdc_acm[port], UX_SLAVE_CLASS_CDC_ACM_IOCTL_SET_LINE_CODING, &CDC_VCP_LineCoding) != UX_SUCCESS)
     {
         LOG_ERROR("IOCTL failed");
     }
@@ -55,13 +56,35 @@ void ux_device_cdc_acm_activate(void *cdc_acm_instance)
 /**
   * @brief  ux_device_cdc_acm_deactivate
   *         This function is called when extraction of a CDC ACM device.
-  * @param  cdc_acm_instance: Pointer to the cdc acm class instance.
+  * @param  port: USB_CDC_xxx port of the instance
   * @retval none
   */
-void ux_device_cdc_acm_deactivate(void *cdc_acm_instance)
+static void ux_device_cdc_acm_deactivate(u8 port)
+{
+    cdc_acm[port] = UX_NULL;
+    _rx_pending[port] = NULL; // transfer aborted, buffer not filled
+}
+
+static void _console_activate(void *cdc_acm_instance)
+{
+    ux_device_cdc_acm_activate(USB_CDC_CONSOLE, cdc_acm_instance);
+}
+
+static void _console_deactivate(void *cdc_acm_instance)
+{
+    UX_PARAMETER_NOT_USED(cdc_acm_instance);
+    ux_device_cdc_acm_deactivate(USB_CDC_CONSOLE);
+}
+
+static void _avp_activate(void *cdc_acm_instance)
+{
+    ux_device_cdc_acm_activate(USB_CDC_AVP, cdc_acm_instance);
+}
+
+static void _avp_deactivate(void *cdc_acm_instance)
 {
     UX_PARAMETER_NOT_USED(cdc_acm_instance);
-    cdc_acm = UX_NULL;
+    ux_device_cdc_acm_deactivate(USB_CDC_AVP);
 }
 
 /**
@@ -70,14 +93,21 @@ void ux_device_cdc_acm_deactivate(void *cdc_acm_instance)
   * @param  cdc_acm_instance: Pointer to the cdc acm class instance.
   * @retval none
   */
-void ux_device_cdc_acm_parameterchange(void *cdc_acm_instance)
+static void ux_device_cdc_acm_parameterchange(void *cdc_acm_instance)
 {
     UX_PARAMETER_NOT_USED(cdc_acm_instance);
 }
 
-bool ux_device_cdc_acm_connected(void)
+void ux_device_cdc_acm_params(u8 port, UX_SLAVE_CLASS_CDC_ACM_PARAMETER *param)
 {
-    if (cdc_acm == UX_NULL)
+    param->ux_slave_class_cdc_acm_instance_activate   = (port == USB_CDC_AVP) ? _avp_activate : _console_activate;
+    param->ux_slave_class_cdc_acm_instance_deactivate = (port == USB_CDC_AVP) ? _avp_deactivate : _console_deactivate;
+    param->ux_slave_class_cdc_acm_parameter_change    = ux_device_cdc_acm_parameterchange;
+}
+
+RAMFUNC bool ux_device_cdc_acm_connected(u8 port)
+{
+    if (cdc_acm[port] == UX_NULL)
         return (false);
 
    if (_ux_system_slave->ux_system_slave_device.ux_slave_device_state == UX_DEVICE_CONFIGURED)
@@ -86,58 +116,78 @@ bool ux_device_cdc_acm_connected(void)
    return (false);
 }
 
-void tty_debug (const ascii *buf, size_t count);
-
-bool ux_device_cdc_acm_tx(u8* data, u16 len)
+// One step of the bulk IN write, data must stay in place until it returns
+// true (sent, or failed and dropped).
+RAMFUNC bool ux_device_cdc_acm_tx_run(u8 port, u8* data, u16 len)
 {
-    UX_SLAVE_CLASS_CDC_ACM *ctx = cdc_acm;
+    UX_SLAVE_CLASS_CDC_ACM *ctx = cdc_acm[port];
     ULONG actual_length;
+    UINT status;
 
     if (ctx == UX_NULL)
-        return (false);
+        return (true);
 
-    if (ux_device_class_cdc_acm_write_run(ctx, (UCHAR *)data, len, &actual_length) != UX_STATE_NEXT)
-        return (false);
-    
-    if (actual_length != len)
-        return (false);
+    status = ux_device_class_cdc_acm_write_run(ctx, (UCHAR *)data, len, &actual_length);
 
-    return (true);
+    if (status <= UX_STATE_ERROR)
+        return (true);
+
+    return ((status == UX_STATE_NEXT) ? true : false);
 }
 
-void ux_device_cdc_acm_task(void)
+static RAMFUNC void _rx_task(u8 port)
 {
     ULONG actual_length;
-    UX_SLAVE_DEVICE *device;
-    ULONG read_length;
-    UX_SLAVE_CLASS_CDC_ACM *ctx = cdc_acm;
-
-    device = &_ux_system_slave->ux_system_slave_device;
+    UX_SLAVE_CLASS_CDC_ACM *ctx = cdc_acm[port];
+    UINT status;
 
     if (ctx == UX_NULL)
         return;
 
-    if (device->ux_slave_device_state != UX_DEVICE_CONFIGURED)
-        return;
+    // take all packets already received, not just one per pass
+    while (1)
+    {
+        if (_rx_pending[port] == NULL)
+        {   // packet goes from PMA straight to the application buffer,
+            // without free buffer the endpoint is not armed and host gets NAK
+            if ((_rx_pending[port] = _rx_get_buffer(port)) == NULL)
+                return;
+        }
 
-    read_length = (_ux_system_slave->ux_system_slave_speed == UX_HIGH_SPEED_DEVICE) ? USB_HS_READ_LENGTH : 64;
+        status = ux_device_class_cdc_acm_read_run(ctx, (UCHAR *)_rx_pending[port], USB_CDC_RX_PACKET, &actual_length);
+
+        if (status <= UX_STATE_ERROR)
+        {
+            _rx_pending[port] = NULL;
+            return;
+        }
+
+        if (status != UX_STATE_NEXT)
+            return; // waiting for host
 
-    UINT status = ux_device_class_cdc_acm_read_run(ctx, (UCHAR *)acm_rx_buffer, read_length, &actual_length);
-        
-    if (status <= UX_STATE_ERROR)
-        return;
-    
-    if (status == UX_STATE_NEXT)
-    {
         if (actual_length != 0)
         {
-          	if (_rx_handler != NULL)
-	        {
-		        _rx_handler(acm_rx_buffer, actual_length);
-	        }
+            _rx_handler(port, _rx_pending[port], actual_length);
         }
+        _rx_pending[port] = NULL;
     }
 }
 
+RAMFUNC void ux_device_cdc_acm_task(void)
+{
+    UX_SLAVE_DEVICE *device;
+    u8 port;
+
+    device = &_ux_system_slave->ux_system_slave_device;
+
+    if (device->ux_slave_device_state != UX_DEVICE_CONFIGURED)
+        return;
 
+    if ((_rx_get_buffer == NULL) || (_rx_handler == NULL))
+        return;
 
+    for (port = 0; port < USB_CDC_ACM_PORTS; port++)
+    {
+        _rx_task(port);
+    }
+}
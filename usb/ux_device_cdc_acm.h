@@ -16,12 +16,10 @@ extern "C" {
 #include "ux_api.h"
 #include "ux_device_class_cdc_acm.h"
 
-void ux_device_cdc_acm_rx_init(usb_cdc_rx_pfunc_t rx_handler);
-void ux_device_cdc_acm_activate(void *cdc_acm_instance);
-void ux_device_cdc_acm_deactivate(void *cdc_acm_instance);
-void ux_device_cdc_acm_parameterchange(void *cdc_acm_instance);
-bool ux_device_cdc_acm_connected(void);
-bool ux_device_cdc_acm_tx(u8* data, u16 len);
+void ux_device_cdc_acm_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler);
+void ux_device_cdc_acm_params(u8 port, UX_SLAVE_CLASS_CDC_ACM_PARAMETER *param);
+bool ux_device_cdc_acm_connected(u8 port);
+bool ux_device_cdc_acm_tx_run(u8 port, u8* data, u16 len);
 
 void ux_device_cdc_acm_task(void);
 
@@ -34,6 +34,22 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+/* BOS: header, USB 2.0 extension and Microsoft OS 2.0 platform capability */
+#define USBD_BOS_DESC_SZ              (5U + 7U + 28U)
+
+/* CCID class descriptor */
+#define USBD_CCID_DESC_SZ             54U
+
+/* Microsoft OS 2.0 descriptor set: set header, configuration subset,
+   function subset of the vendor interface, WINUSB compatible ID and the
+   DeviceInterfaceGUIDs registry property libusb looks the device up by */
+#define MS_OS_20_PROPERTY_NAME        "DeviceInterfaceGUIDs"
+#define MS_OS_20_NAME_SZ              (2U * sizeof(MS_OS_20_PROPERTY_NAME))              /* UTF-16 with NUL */
+#define MS_OS_20_DATA_SZ              (2U * (sizeof(USBD_MS_OS_20_INTERFACE_GUID) + 1U)) /* REG_MULTI_SZ */
+#define MS_OS_20_REGISTRY_SZ          (10U + MS_OS_20_NAME_SZ + MS_OS_20_DATA_SZ)
+#define MS_OS_20_FUNCTION_SZ          (8U + 20U + MS_OS_20_REGISTRY_SZ)
+#define MS_OS_20_CONFIGURATION_SZ     (8U + MS_OS_20_FUNCTION_SZ)
+#define MS_OS_20_SET_SZ               (10U + MS_OS_20_CONFIGURATION_SZ)
 
 /* USER CODE END PD */
 
@@ -46,7 +62,14 @@
 USBD_DevClassHandleTypeDef  USBD_Device_FS, USBD_Device_HS;
 
 uint8_t UserClassInstance[USBD_MAX_CLASS_INTERFACES] = {
-  CLASS_TYPE_CDC_ACM,
+  CLASS_TYPE_CDC_ACM, /* console */
+#if (USB_ECM == 1)
+  CLASS_TYPE_CDC_ECM, /* AVP over UDP/TCP, make USB_ECM=1 */
+#else
+  CLASS_TYPE_CDC_ACM, /* AVP */
+#endif /* USB_ECM */
+  CLASS_TYPE_VENDOR,  /* AVP over libusb / WinUSB */
+  CLASS_TYPE_CCID,    /* APDUs through PC/SC */
 };
 
 /* The generic device descriptor buffer that will be filled by builder
@@ -93,6 +116,10 @@ __ALIGN_BEGIN UCHAR USBD_language_id_framework[LANGUAGE_ID_MAX_LENGTH]
 __ALIGN_END = {0};
 
 /* USER CODE BEGIN PV1 */
+#if defined ( __ICCARM__ ) /* IAR Compiler */
+#pragma data_alignment=4
+#endif /* defined ( __ICCARM__ ) */
+__ALIGN_BEGIN static uint8_t USBD_MS_OS_20_DescSet[MS_OS_20_SET_SZ] __ALIGN_END = {0};
 
 /* USER CODE END PV1 */
 
@@ -127,6 +154,18 @@ static void USBD_FrameWork_CDCDesc(USBD_DevClassHandleTypeDef *pdev,
 #endif /* USBD_CDC_ACM_CLASS_ACTIVATED == 1U */
 
 /* USER CODE BEGIN PFP */
+static void USBD_FrameWork_VendorDesc(USBD_DevClassHandleTypeDef *pdev,
+                                      uint32_t pConf, uint32_t *Sze);
+
+static void USBD_FrameWork_CCIDDesc(USBD_DevClassHandleTypeDef *pdev,
+                                    uint32_t pConf, uint32_t *Sze);
+
+#if (USB_ECM == 1)
+static void USBD_FrameWork_ECMDesc(USBD_DevClassHandleTypeDef *pdev,
+                                   uint32_t pConf, uint32_t *Sze);
+#endif /* USB_ECM */
+
+static uint32_t USBD_FrameWork_AddBOS(uint8_t *pBosDesc);
 
 /* USER CODE END PFP */
 
@@ -149,6 +188,74 @@ char *ux_device_sn_text(void)
 }
 #define USBD_SERIAL_NUMBER ux_device_sn_text()
 
+/* CDC-ECM MAC addresses from the same UID, locally administered unicast:
+   host side goes to iMACAddress, device side to the IP stack */
+void ux_device_mac_address(uint8_t *mac, uint8_t host)
+{
+  uint32_t sn0 = LL_GetUID_Word0() + LL_GetUID_Word2();
+  uint32_t sn1 = LL_GetUID_Word1();
+
+  mac[0] = (host != 0U) ? 0x02U : 0x06U;
+  mac[1] = (uint8_t)((sn1 >> 16) ^ sn1);
+  mac[2] = (uint8_t)(sn0 >> 24);
+  mac[3] = (uint8_t)(sn0 >> 16);
+  mac[4] = (uint8_t)(sn0 >> 8);
+  mac[5] = (uint8_t)sn0;
+}
+
+#if (USB_ECM == 1)
+static char *ux_device_mac_text(void)
+{
+  static char buf[13];
+  uint8_t mac[6];
+
+  ux_device_mac_address(mac, 1U);
+  snprintf(buf, sizeof(buf), "%02X%02X%02X%02X%02X%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return (buf);
+}
+#endif /* USB_ECM */
+
+/* Number of CDC ACM functions added before the current class */
+static uint8_t USBD_FrameWork_CDCInstance(USBD_DevClassHandleTypeDef *pdev)
+{
+  uint8_t count = 0U;
+
+  for (uint32_t i = 0U; i < pdev->classId; i++)
+  {
+    if (pdev->tclasslist[i].ClassType == CLASS_TYPE_CDC_ACM)
+    {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+  * @brief  USBD_Get_CDC_ACM_Interface_Number
+  *         Return the control interface of the n-th CDC ACM function
+  * @param  instance : 0 for the first CDC ACM function
+  * @retval interface number
+  */
+uint16_t USBD_Get_CDC_ACM_Interface_Number(uint8_t instance)
+{
+  uint8_t count = 0U;
+
+  for (uint32_t idx = 0U; idx < USBD_MAX_SUPPORTED_CLASS; idx++)
+  {
+    if ((USBD_Device_FS.tclasslist[idx].Active != 0U) &&
+        (USBD_Device_FS.tclasslist[idx].ClassType == CLASS_TYPE_CDC_ACM))
+    {
+      if (count == instance)
+      {
+        return USBD_Device_FS.tclasslist[idx].Ifs[0];
+      }
+      count++;
+    }
+  }
+  return 0U;
+}
+
 /* USER CODE END 0 */
 
 /**
@@ -186,6 +293,8 @@ uint8_t *USBD_Get_Device_Framework_Speed(uint8_t Speed, ULONG *Length)
     pFrameWork = pDevFrameWorkDesc_HS;
   }
   /* USER CODE BEGIN Device_Framework1 */
+  /* BOS follows the configuration, USBX finds it by descriptor type */
+  *Length += USBD_FrameWork_AddBOS(pFrameWork + *Length);
 
   /* USER CODE END Device_Framework1 */
   return pFrameWork;
@@ -233,6 +342,16 @@ uint8_t *USBD_Get_String_Framework(ULONG *Length)
   USBD_Desc_GetString((uint8_t *)USBD_SERIAL_NUMBER, USBD_string_framework + count, &len);
 
   /* USER CODE BEGIN String_Framework1 */
+#if (USB_ECM == 1)
+  /* Set the host MAC address language Id and index in USBD_string_framework */
+  count += len + 1;
+  USBD_string_framework[count++] = USBD_LANGID_STRING & 0xFF;
+  USBD_string_framework[count++] = USBD_LANGID_STRING >> 8;
+  USBD_string_framework[count++] = USBD_IDX_MAC_STR;
+
+  /* Set the host MAC address, 12 hex digits, in USBD_string_framework */
+  USBD_Desc_GetString((uint8_t *)ux_device_mac_text(), USBD_string_framework + count, &len);
+#endif /* USB_ECM */
 
   /* USER CODE END String_Framework1 */
 
@@ -514,6 +633,9 @@ uint8_t  USBD_FrameWork_AddToConfDesc(USBD_DevClassHandleTypeDef *pdev, uint8_t
                                       uint8_t *pCmpstConfDesc)
 {
   uint8_t interface = 0U;
+#if USBD_CDC_ACM_CLASS_ACTIVATED == 1
+  uint8_t ep_out, ep_in, ep_cmd;
+#endif /* USBD_CDC_ACM_CLASS_ACTIVATED */
 
   /* USER CODE BEGIN FrameWork_AddToConfDesc_0 */
 
@@ -545,33 +667,47 @@ uint8_t  USBD_FrameWork_AddToConfDesc(USBD_DevClassHandleTypeDef *pdev, uint8_t
       /* Assign endpoint numbers */
       pdev->tclasslist[pdev->classId].NumEps = 3U;  /* EP_IN, EP_OUT, CMD_EP */
 
+      /* Second function (AVP port) has its own endpoints */
+      if (USBD_FrameWork_CDCInstance(pdev) == 0U)
+      {
+        ep_out = USBD_CDCACM_EPOUT_ADDR;
+        ep_in = USBD_CDCACM_EPIN_ADDR;
+        ep_cmd = USBD_CDCACM_EPINCMD_ADDR;
+      }
+      else
+      {
+        ep_out = USBD_CDCACM2_EPOUT_ADDR;
+        ep_in = USBD_CDCACM2_EPIN_ADDR;
+        ep_cmd = USBD_CDCACM2_EPINCMD_ADDR;
+      }
+
       /* Check the current speed to assign endpoints */
       if (Speed == USBD_HIGH_SPEED)
       {
         /* Assign OUT Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPOUT_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_out,
                                 USBD_EP_TYPE_BULK, USBD_CDCACM_EPOUT_HS_MPS);
 
         /* Assign IN Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPIN_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_in,
                                 USBD_EP_TYPE_BULK, USBD_CDCACM_EPIN_HS_MPS);
 
         /* Assign CMD Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPINCMD_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_cmd,
                                 USBD_EP_TYPE_INTR, USBD_CDCACM_EPINCMD_HS_MPS);
       }
       else
       {
         /* Assign OUT Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPOUT_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_out,
                                 USBD_EP_TYPE_BULK, USBD_CDCACM_EPOUT_FS_MPS);
 
         /* Assign IN Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPIN_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_in,
                                 USBD_EP_TYPE_BULK, USBD_CDCACM_EPIN_FS_MPS);
 
         /* Assign CMD Endpoint */
-        USBD_FrameWork_AssignEp(pdev, USBD_CDCACM_EPINCMD_ADDR,
+        USBD_FrameWork_AssignEp(pdev, ep_cmd,
                                 USBD_EP_TYPE_INTR, USBD_CDCACM_EPINCMD_FS_MPS);
       }
 
@@ -583,6 +719,103 @@ uint8_t  USBD_FrameWork_AddToConfDesc(USBD_DevClassHandleTypeDef *pdev, uint8_t
 #endif /* USBD_CDC_ACM_CLASS_ACTIVATED */
     /* USER CODE BEGIN FrameWork_AddToConfDesc_1 */
 
+    case CLASS_TYPE_VENDOR:
+
+      /* One interface, no class requests */
+      interface = USBD_FrameWork_FindFreeIFNbr(pdev);
+      pdev->tclasslist[pdev->classId].NumIf = 1U;
+      pdev->tclasslist[pdev->classId].Ifs[0] = interface;
+
+      /* Assign endpoint numbers */
+      pdev->tclasslist[pdev->classId].NumEps = 2U;  /* EP_OUT, EP_IN */
+
+      if (Speed == USBD_HIGH_SPEED)
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_VENDOR_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_VENDOR_EP_HS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_VENDOR_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_VENDOR_EP_HS_MPS);
+      }
+      else
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_VENDOR_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_VENDOR_EP_FS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_VENDOR_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_VENDOR_EP_FS_MPS);
+      }
+
+      /* Configure and Append the Descriptor */
+      USBD_FrameWork_VendorDesc(pdev, (uint32_t)pCmpstConfDesc, &pdev->CurrConfDescSz);
+
+      break;
+
+    case CLASS_TYPE_CCID:
+
+      /* One interface, class descriptor, bulk endpoints only */
+      interface = USBD_FrameWork_FindFreeIFNbr(pdev);
+      pdev->tclasslist[pdev->classId].NumIf = 1U;
+      pdev->tclasslist[pdev->classId].Ifs[0] = interface;
+
+      /* Assign endpoint numbers */
+      pdev->tclasslist[pdev->classId].NumEps = 2U;  /* EP_OUT, EP_IN */
+
+      if (Speed == USBD_HIGH_SPEED)
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_CCID_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_CCID_EP_HS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_CCID_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_CCID_EP_HS_MPS);
+      }
+      else
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_CCID_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_CCID_EP_FS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_CCID_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_CCID_EP_FS_MPS);
+      }
+
+      /* Configure and Append the Descriptor */
+      USBD_FrameWork_CCIDDesc(pdev, (uint32_t)pCmpstConfDesc, &pdev->CurrConfDescSz);
+
+      break;
+
+#if (USB_ECM == 1)
+    case CLASS_TYPE_CDC_ECM:
+
+      /* Communication and data interface */
+      interface = USBD_FrameWork_FindFreeIFNbr(pdev);
+      pdev->tclasslist[pdev->classId].NumIf = 2U;
+      pdev->tclasslist[pdev->classId].Ifs[0] = interface;
+      pdev->tclasslist[pdev->classId].Ifs[1] = (uint8_t)(interface + 1U);
+
+      /* Assign endpoint numbers */
+      pdev->tclasslist[pdev->classId].NumEps = 3U;  /* EP_IN, EP_OUT, CMD_EP */
+
+      if (Speed == USBD_HIGH_SPEED)
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_ECM_EP_HS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_ECM_EP_HS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPINCMD_ADDR,
+                                USBD_EP_TYPE_INTR, USBD_ECM_EPINCMD_HS_MPS);
+      }
+      else
+      {
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPOUT_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_ECM_EP_FS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPIN_ADDR,
+                                USBD_EP_TYPE_BULK, USBD_ECM_EP_FS_MPS);
+        USBD_FrameWork_AssignEp(pdev, USBD_ECM_EPINCMD_ADDR,
+                                USBD_EP_TYPE_INTR, USBD_ECM_EPINCMD_FS_MPS);
+      }
+
+      /* Configure and Append the Descriptor */
+      USBD_FrameWork_ECMDesc(pdev, (uint32_t)pCmpstConfDesc, &pdev->CurrConfDescSz);
+
+      break;
+#endif /* USB_ECM */
+
     /* USER CODE END FrameWork_AddToConfDesc_1 */
 
     default:
@@ -777,4 +1010,315 @@ static void USBD_FrameWork_CDCDesc(USBD_DevClassHandleTypeDef *pdev,
 
 /* USER CODE BEGIN 1 */
 
+/* Descriptors below are byte arrays on the wire, little endian */
+static uint8_t *USBD_Put16(uint8_t *p, uint16_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  return p + 2;
+}
+
+static uint8_t *USBD_Put32(uint8_t *p, uint32_t value)
+{
+  p = USBD_Put16(p, (uint16_t)value);
+  return USBD_Put16(p, (uint16_t)(value >> 16));
+}
+
+/* ASCII to UTF-16LE, len characters including the terminating NULs */
+static uint8_t *USBD_PutUnicode(uint8_t *p, const char *text, uint32_t len)
+{
+  for (uint32_t i = 0U; i < len; i++)
+  {
+    p = USBD_Put16(p, (*text != '\0') ? (uint8_t)*text++ : 0U);
+  }
+  return p;
+}
+
+/**
+  * @brief  USBD_FrameWork_VendorDesc
+  *         Configure and Append the vendor specific interface Descriptor
+  * @param  pdev: device instance
+  * @param  pConf: Configuration descriptor pointer
+  * @param  Sze: pointer to the current configuration descriptor size
+  * @retval None
+  */
+static void USBD_FrameWork_VendorDesc(USBD_DevClassHandleTypeDef *pdev,
+                                      uint32_t pConf, uint32_t *Sze)
+{
+  static USBD_IfDescTypedef               *pIfDesc;
+  static USBD_EpDescTypedef               *pEpDesc;
+
+  /* Interface Descriptor */
+  __USBD_FRAMEWORK_SET_IF(pdev->tclasslist[pdev->classId].Ifs[0], 0U, 2U,
+                          USBD_VENDOR_CLASS, 0U, 0U, 0U);
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[0].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[0].size),
+                          (0x00U), (0x00U));
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[1].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[1].size),
+                          (0x00U), (0x00U));
+
+  /* Update Config Descriptor */
+  ((USBD_ConfigDescTypedef *)pConf)->bNumInterfaces += 1U;
+  ((USBD_ConfigDescTypedef *)pConf)->wDescriptorLength = *Sze;
+}
+
+/**
+  * @brief  USBD_FrameWork_CCIDDesc
+  *         Configure and Append the CCID interface Descriptor
+  * @param  pdev: device instance
+  * @param  pConf: Configuration descriptor pointer
+  * @param  Sze: pointer to the current configuration descriptor size
+  * @retval None
+  */
+static void USBD_FrameWork_CCIDDesc(USBD_DevClassHandleTypeDef *pdev,
+                                    uint32_t pConf, uint32_t *Sze)
+{
+  static USBD_IfDescTypedef               *pIfDesc;
+  static USBD_EpDescTypedef               *pEpDesc;
+  uint8_t *p;
+
+  /* Interface Descriptor */
+  __USBD_FRAMEWORK_SET_IF(pdev->tclasslist[pdev->classId].Ifs[0], 0U, 2U,
+                          UX_DEVICE_CLASS_CCID_CLASS, 0U, 0U, 0U);
+
+  /* CCID class descriptor: one slot at 5 V, T=1 */
+  p = (uint8_t *)(pConf + *Sze);
+  *p++ = USBD_CCID_DESC_SZ;
+  *p++ = USB_DESC_TYPE_CCID;
+  p = USBD_Put16(p, 0x0110U);                 /* bcdCCID */
+  *p++ = 0U;                                  /* bMaxSlotIndex */
+  *p++ = 0x01U;                               /* bVoltageSupport: 5 V */
+  p = USBD_Put32(p, 0x00000002U);             /* dwProtocols: T=1 */
+  p = USBD_Put32(p, USBD_CCID_CLOCK_KHZ);     /* dwDefaultClock */
+  p = USBD_Put32(p, USBD_CCID_CLOCK_KHZ);     /* dwMaximumClock */
+  *p++ = 1U;                                  /* bNumClockSupported */
+  p = USBD_Put32(p, USBD_CCID_DATA_RATE);     /* dwDataRate */
+  p = USBD_Put32(p, USBD_CCID_DATA_RATE);     /* dwMaxDataRate */
+  *p++ = 1U;                                  /* bNumDataRatesSupported */
+  p = USBD_Put32(p, 254U);                    /* dwMaxIFSD */
+  p = USBD_Put32(p, 0U);                      /* dwSynchProtocols */
+  p = USBD_Put32(p, 0U);                      /* dwMechanical */
+  p = USBD_Put32(p, USBD_CCID_FEATURES);      /* dwFeatures */
+  p = USBD_Put32(p, USBD_CCID_MAX_MESSAGE);   /* dwMaxCCIDMessageLength */
+  *p++ = 0xFFU;                               /* bClassGetResponse: echo */
+  *p++ = 0xFFU;                               /* bClassEnvelope: echo */
+  p = USBD_Put16(p, 0U);                      /* wLcdLayout: none */
+  *p++ = 0U;                                  /* bPINSupport: none */
+  *p++ = 1U;                                  /* bMaxCCIDBusySlots */
+  *Sze += USBD_CCID_DESC_SZ;
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[0].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[0].size),
+                          (0x00U), (0x00U));
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[1].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[1].size),
+                          (0x00U), (0x00U));
+
+  /* Update Config Descriptor */
+  ((USBD_ConfigDescTypedef *)pConf)->bNumInterfaces += 1U;
+  ((USBD_ConfigDescTypedef *)pConf)->wDescriptorLength = *Sze;
+}
+
+#if (USB_ECM == 1)
+/**
+  * @brief  USBD_FrameWork_ECMDesc
+  *         Configure and Append the CDC-ECM Descriptor
+  * @param  pdev: device instance
+  * @param  pConf: Configuration descriptor pointer
+  * @param  Sze: pointer to the current configuration descriptor size
+  * @retval None
+  */
+static void USBD_FrameWork_ECMDesc(USBD_DevClassHandleTypeDef *pdev,
+                                   uint32_t pConf, uint32_t *Sze)
+{
+  static USBD_IfDescTypedef               *pIfDesc;
+  static USBD_EpDescTypedef               *pEpDesc;
+  static USBD_CDCHeaderFuncDescTypedef    *pHeadDesc;
+  static USBD_CDCUnionFuncDescTypedef     *pUnionDesc;
+  static USBD_IadDescTypedef              *pIadDesc;
+  uint8_t *p;
+
+  pIadDesc = ((USBD_IadDescTypedef *)(pConf + *Sze));
+  pIadDesc->bLength = (uint8_t)sizeof(USBD_IadDescTypedef);
+  pIadDesc->bDescriptorType = USB_DESC_TYPE_IAD; /* IAD descriptor */
+  pIadDesc->bFirstInterface = pdev->tclasslist[pdev->classId].Ifs[0];
+  pIadDesc->bInterfaceCount = 2U;    /* 2 interfaces */
+  pIadDesc->bFunctionClass = 0x02U;
+  pIadDesc->bFunctionSubClass = USBD_ECM_SUBCLASS;
+  pIadDesc->bFunctionProtocol = 0x00U;
+  pIadDesc->iFunction = 0; /* String Index */
+  *Sze += (uint32_t)sizeof(USBD_IadDescTypedef);
+
+  /* Communication Interface Descriptor */
+  __USBD_FRAMEWORK_SET_IF(pdev->tclasslist[pdev->classId].Ifs[0], 0U, 1U, 0x02,
+                          USBD_ECM_SUBCLASS, 0x00U, 0U);
+
+  /* Header Functional Descriptor*/
+  pHeadDesc = ((USBD_CDCHeaderFuncDescTypedef *)((uint32_t)pConf + *Sze));
+  pHeadDesc->bLength = 0x05U;
+  pHeadDesc->bDescriptorType = 0x24U;
+  pHeadDesc->bDescriptorSubtype = 0x00U;
+  pHeadDesc->bcdCDC = 0x0110;
+  *Sze += (uint32_t)sizeof(USBD_CDCHeaderFuncDescTypedef);
+
+  /* Union Functional Descriptor*/
+  pUnionDesc = ((USBD_CDCUnionFuncDescTypedef *)((uint32_t)pConf + *Sze));
+  pUnionDesc->bLength = 0x05U;
+  pUnionDesc->bDescriptorType = 0x24U;
+  pUnionDesc->bDescriptorSubtype = 0x06U;
+  pUnionDesc->bMasterInterface = pdev->tclasslist[pdev->classId].Ifs[0];
+  pUnionDesc->bSlaveInterface = pdev->tclasslist[pdev->classId].Ifs[1];
+  *Sze += (uint32_t)sizeof(USBD_CDCUnionFuncDescTypedef);
+
+  /* Ethernet Networking Functional Descriptor */
+  p = (uint8_t *)(pConf + *Sze);
+  *p++ = 13U;
+  *p++ = 0x24U;
+  *p++ = 0x0FU;
+  *p++ = USBD_IDX_MAC_STR;                    /* iMACAddress */
+  p = USBD_Put32(p, 0U);                      /* bmEthernetStatistics: none */
+  p = USBD_Put16(p, USBD_ECM_MAX_SEGMENT);    /* wMaxSegmentSize */
+  p = USBD_Put16(p, 0U);                      /* wNumberMCFilters: none */
+  *p++ = 0U;                                  /* bNumberPowerFilters */
+  *Sze += 13U;
+
+  /* Notification endpoint */
+  __USBD_FRAMEWORK_SET_EP(pdev->tclasslist[pdev->classId].Eps[2].add, \
+                          USBD_EP_TYPE_INTR,
+                          (uint16_t)pdev->tclasslist[pdev->classId].Eps[2].size,
+                          USBD_ECM_EPINCMD_HS_BINTERVAL,
+                          USBD_ECM_EPINCMD_FS_BINTERVAL);
+
+  /* Data Interface, alternate setting 0 without endpoints: interface closed */
+  __USBD_FRAMEWORK_SET_IF(pdev->tclasslist[pdev->classId].Ifs[1], 0U, 0U,
+                          USBD_CDC_DATA_CLASS, 0U, 0U, 0U);
+
+  /* Data Interface, alternate setting 1: host brings the link up */
+  __USBD_FRAMEWORK_SET_IF(pdev->tclasslist[pdev->classId].Ifs[1], 1U, 2U,
+                          USBD_CDC_DATA_CLASS, 0U, 0U, 0U);
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[0].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[0].size),
+                          (0x00U), (0x00U));
+
+  /* Append Endpoint descriptor to Configuration descriptor */
+  __USBD_FRAMEWORK_SET_EP((pdev->tclasslist[pdev->classId].Eps[1].add), \
+                          (USBD_EP_TYPE_BULK),
+                          (uint16_t)(pdev->tclasslist[pdev->classId].Eps[1].size),
+                          (0x00U), (0x00U));
+
+  /* Update Config Descriptor */
+  ((USBD_ConfigDescTypedef *)pConf)->bNumInterfaces += 2U;
+  ((USBD_ConfigDescTypedef *)pConf)->wDescriptorLength = *Sze;
+}
+#endif /* USB_ECM */
+
+/**
+  * @brief  USBD_FrameWork_AddBOS
+  *         Write the BOS descriptor, read by hosts since bcdUSB is 2.01
+  * @param  pBosDesc: where to write, right after the configuration
+  * @retval BOS descriptor size
+  */
+static uint32_t USBD_FrameWork_AddBOS(uint8_t *pBosDesc)
+{
+  /* {D8DD60DF-4589-4CC7-9CD2-659D9E648A9F} in wire order */
+  static const uint8_t ms_os_20_uuid[16] = {
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,
+    0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F
+  };
+  uint8_t *p = pBosDesc;
+
+  /* BOS header */
+  *p++ = 5U;
+  *p++ = USB_DESC_TYPE_BOS;
+  p = USBD_Put16(p, USBD_BOS_DESC_SZ);
+  *p++ = 2U;                                  /* bNumDeviceCaps */
+
+  /* USB 2.0 extension, no LPM */
+  *p++ = 7U;
+  *p++ = USB_DESC_TYPE_DEVICE_CAPABILITY;
+  *p++ = 0x02U;                               /* USB 2.0 EXTENSION */
+  p = USBD_Put32(p, 0U);
+
+  /* Microsoft OS 2.0 platform capability */
+  *p++ = 28U;
+  *p++ = USB_DESC_TYPE_DEVICE_CAPABILITY;
+  *p++ = 0x05U;                               /* PLATFORM */
+  *p++ = 0U;
+  memcpy(p, ms_os_20_uuid, sizeof(ms_os_20_uuid));
+  p += sizeof(ms_os_20_uuid);
+  p = USBD_Put32(p, USBD_MS_OS_20_WINDOWS_VERSION);
+  p = USBD_Put16(p, MS_OS_20_SET_SZ);
+  *p++ = USBD_MS_VENDOR_CODE;
+  *p++ = 0U;                                  /* no alternate enumeration */
+
+  return (uint32_t)(p - pBosDesc);
+}
+
+/**
+  * @brief  USBD_Get_MS_OS_20_Descriptor_Set
+  *         Return the Microsoft OS 2.0 descriptor set (vendor request
+  *         USBD_MS_VENDOR_CODE, wIndex USBD_MS_OS_20_DESCRIPTOR_INDEX)
+  * @param  Length : Length of the descriptor set
+  * @retval Pointer to the descriptor set
+  */
+uint8_t *USBD_Get_MS_OS_20_Descriptor_Set(ULONG *Length)
+{
+  uint8_t *p = USBD_MS_OS_20_DescSet;
+
+  /* Descriptor set header */
+  p = USBD_Put16(p, 10U);
+  p = USBD_Put16(p, 0x0000U);                 /* MS_OS_20_SET_HEADER_DESCRIPTOR */
+  p = USBD_Put32(p, USBD_MS_OS_20_WINDOWS_VERSION);
+  p = USBD_Put16(p, MS_OS_20_SET_SZ);
+
+  /* Configuration subset header, first configuration */
+  p = USBD_Put16(p, 8U);
+  p = USBD_Put16(p, 0x0001U);                 /* MS_OS_20_SUBSET_HEADER_CONFIGURATION */
+  *p++ = 0U;
+  *p++ = 0U;
+  p = USBD_Put16(p, MS_OS_20_CONFIGURATION_SZ);
+
+  /* Function subset header, CDC functions keep the inbox driver */
+  p = USBD_Put16(p, 8U);
+  p = USBD_Put16(p, 0x0002U);                 /* MS_OS_20_SUBSET_HEADER_FUNCTION */
+  *p++ = (uint8_t)USBD_Get_Interface_Number(CLASS_TYPE_VENDOR, 0U);
+  *p++ = 0U;
+  p = USBD_Put16(p, MS_OS_20_FUNCTION_SZ);
+
+  /* Compatible ID */
+  p = USBD_Put16(p, 20U);
+  p = USBD_Put16(p, 0x0003U);                 /* MS_OS_20_FEATURE_COMPATBLE_ID */
+  memcpy(p, "WINUSB\0\0", 8U);
+  p += 8U;
+  memset(p, 0, 8U);                           /* no sub-compatible ID */
+  p += 8U;
+
+  /* Registry property */
+  p = USBD_Put16(p, MS_OS_20_REGISTRY_SZ);
+  p = USBD_Put16(p, 0x0004U);                 /* MS_OS_20_FEATURE_REG_PROPERTY */
+  p = USBD_Put16(p, 7U);                      /* REG_MULTI_SZ */
+  p = USBD_Put16(p, MS_OS_20_NAME_SZ);
+  p = USBD_PutUnicode(p, MS_OS_20_PROPERTY_NAME, MS_OS_20_NAME_SZ / 2U);
+  p = USBD_Put16(p, MS_OS_20_DATA_SZ);
+  p = USBD_PutUnicode(p, USBD_MS_OS_20_INTERFACE_GUID, MS_OS_20_DATA_SZ / 2U);
+
+  *Length = (ULONG)(p - USBD_MS_OS_20_DescSet);
+  return USBD_MS_OS_20_DescSet;
+}
+
 /* USER CODE END 1 */
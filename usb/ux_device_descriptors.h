@@ -32,12 +32,13 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "ux_device_class_ccid.h"
 
 /* USER CODE END Includes */
 
 /* Private defines -----------------------------------------------------------*/
 #define USBD_MAX_NUM_CONFIGURATION                     1U
-#define USBD_MAX_SUPPORTED_CLASS                       3U
+#define USBD_MAX_SUPPORTED_CLASS                       4U
 #define USBD_MAX_CLASS_ENDPOINTS                       9U
 #define USBD_MAX_CLASS_INTERFACES                      11U
 
@@ -47,7 +48,7 @@ extern "C" {
 #define USBD_COMPOSITE_USE_IAD                         1U
 #define USBD_DEVICE_FRAMEWORK_BUILDER_ENABLED          1U
 
-#define USBD_FRAMEWORK_MAX_DESC_SZ                     200U
+#define USBD_FRAMEWORK_MAX_DESC_SZ                     352U
 /* Exported types ------------------------------------------------------------*/
 /* USER CODE BEGIN ET */
 
@@ -66,6 +67,7 @@ typedef enum
   CLASS_TYPE_VIDEO    = 8,
   CLASS_TYPE_CCID     = 9,
   CLASS_TYPE_PRINTER  = 10,
+  CLASS_TYPE_VENDOR   = 11, /* vendor specific bulk interface, not a CubeMX class */
 } USBD_CompositeClassTypeDef;
 
 /* USB Endpoint handle structure */
@@ -246,6 +248,8 @@ typedef struct
 
 /* Exported functions prototypes ---------------------------------------------*/
 /* USER CODE BEGIN EFP */
+uint8_t *USBD_Get_MS_OS_20_Descriptor_Set(ULONG *Length);
+void ux_device_mac_address(uint8_t *mac, uint8_t host);
 
 /* USER CODE END EFP */
 
@@ -254,6 +258,7 @@ uint8_t *USBD_Get_String_Framework(ULONG *Length);
 uint8_t *USBD_Get_Language_Id_Framework(ULONG *Length);
 uint16_t USBD_Get_Interface_Number(uint8_t class_type, uint8_t interface_type);
 uint16_t USBD_Get_Configuration_Number(uint8_t class_type, uint8_t interface_type);
+uint16_t USBD_Get_CDC_ACM_Interface_Number(uint8_t instance);
 
 /* Private defines -----------------------------------------------------------*/
 /* USER CODE BEGIN Private_defines */
@@ -280,12 +285,13 @@ uint16_t USBD_Get_Configuration_Number(uint8_t class_type, uint8_t interface_typ
 #define USBD_FULL_SPEED                               0x00U
 #define USBD_HIGH_SPEED                               0x01U
 
-#define USB_BCDUSB                                    0x0200U
+#define USB_BCDUSB                                    0x0201U /* 2.01: host reads BOS */
 #define LANGUAGE_ID_MAX_LENGTH                        2U
 
 #define USBD_IDX_MFC_STR                              0x01U
 #define USBD_IDX_PRODUCT_STR                          0x02U
 #define USBD_IDX_SERIAL_STR                           0x03U
+#define USBD_IDX_MAC_STR                              0x04U /* CDC-ECM iMACAddress */
 
 #define USBD_MAX_EP0_SIZE                             64U
 #define USBD_DEVICE_QUALIFIER_DESC_SIZE               0x0AU
@@ -297,7 +303,7 @@ uint16_t USBD_Get_Configuration_Number(uint8_t class_type, uint8_t interface_typ
 #define USBD_CDCACM_EPINCMD_FS_MPS                    8U
 #define USBD_CDCACM_EPINCMD_HS_MPS                    8U
 #define USBD_CDCACM_EPIN_ADDR                         0x81U
-#define USBD_CDCACM_EPOUT_ADDR                        0x01U
+#define USBD_CDCACM_EPOUT_ADDR                        0x03U /* not 0x01, double buffered endpoints are one direction only */
 #define USBD_CDCACM_EPIN_FS_MPS                       64U
 #define USBD_CDCACM_EPIN_HS_MPS                       512U
 #define USBD_CDCACM_EPOUT_FS_MPS                      64U
@@ -305,6 +311,55 @@ uint16_t USBD_Get_Configuration_Number(uint8_t class_type, uint8_t interface_typ
 #define USBD_CDCACM_EPINCMD_FS_BINTERVAL              5U
 #define USBD_CDCACM_EPINCMD_HS_BINTERVAL              5U
 
+/* Second CDC-ACM function (AVP port), same packet sizes */
+#define USBD_CDCACM2_EPINCMD_ADDR                     0x86U
+#define USBD_CDCACM2_EPIN_ADDR                        0x84U
+#define USBD_CDCACM2_EPOUT_ADDR                       0x04U /* single buffered, shares EP4 with IN, EP5 is CCID */
+
+/* CDC-ECM function in place of the AVP port (make USB_ECM=1), takes over
+   its endpoints: bulk IN and OUT on EP4, notifications on EP6 */
+#define USBD_ECM_EPINCMD_ADDR                         USBD_CDCACM2_EPINCMD_ADDR
+#define USBD_ECM_EPINCMD_FS_MPS                       16U /* CONNECTION_SPEED_CHANGE in one packet */
+#define USBD_ECM_EPINCMD_HS_MPS                       16U
+#define USBD_ECM_EPINCMD_FS_BINTERVAL                 5U
+#define USBD_ECM_EPINCMD_HS_BINTERVAL                 5U
+#define USBD_ECM_EPIN_ADDR                            USBD_CDCACM2_EPIN_ADDR
+#define USBD_ECM_EPOUT_ADDR                           USBD_CDCACM2_EPOUT_ADDR
+#define USBD_ECM_EP_FS_MPS                            64U
+#define USBD_ECM_EP_HS_MPS                            512U
+#define USBD_ECM_MAX_SEGMENT                          1514U /* wMaxSegmentSize */
+#define USBD_ECM_SUBCLASS                             0x06U
+#define USBD_CDC_COMM_CLASS                           0x02U
+#define USBD_CDC_DATA_CLASS                           0x0AU
+
+/* Vendor specific bulk interface, EP7 is the only free endpoint number so
+   IN and OUT share it, single buffered */
+#define USBD_VENDOR_CLASS                             0xFFU
+#define USBD_VENDOR_EPIN_ADDR                         0x87U
+#define USBD_VENDOR_EPOUT_ADDR                        0x07U
+#define USBD_VENDOR_EP_FS_MPS                         64U
+#define USBD_VENDOR_EP_HS_MPS                         512U
+
+/* Microsoft OS 2.0 descriptors, WinUSB binds to the vendor interface */
+#define USBD_MS_VENDOR_CODE                           0x01U /* bRequest of the descriptor set request */
+#define USBD_MS_OS_20_DESCRIPTOR_INDEX                0x07U /* wIndex of the descriptor set request */
+#define USBD_MS_OS_20_WINDOWS_VERSION                 0x06030000UL /* Windows 8.1 */
+#define USBD_MS_OS_20_INTERFACE_GUID                  "{1105DED2-10E1-4410-9379-3EB203BEA324}"
+#define USB_DESC_TYPE_BOS                             0x0FU
+#define USB_DESC_TYPE_DEVICE_CAPABILITY               0x10U
+
+/* CCID smart card function, one slot, card always present so there is no
+   interrupt endpoint, bulk IN and OUT share EP5, single buffered */
+#define USBD_CCID_EPIN_ADDR                           0x85U
+#define USBD_CCID_EPOUT_ADDR                          0x05U
+#define USBD_CCID_EP_FS_MPS                           64U
+#define USBD_CCID_EP_HS_MPS                           512U
+#define USBD_CCID_MAX_MESSAGE                         512U /* dwMaxCCIDMessageLength, USBX bulk buffer size */
+#define USBD_CCID_CLOCK_KHZ                           3580U
+#define USBD_CCID_DATA_RATE                           9600U
+#define USBD_CCID_FEATURES                            0x000400FEUL /* automatic everything, extended APDU level */
+#define USB_DESC_TYPE_CCID                            0x21U
+
 #ifndef USBD_CONFIG_STR_DESC_IDX
 #define USBD_CONFIG_STR_DESC_IDX                      0U
 #endif /* USBD_CONFIG_STR_DESC_IDX */
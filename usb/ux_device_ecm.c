@@ -0,0 +1,360 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_ecm.c
+  * @author  Tropicsquare
+  * @brief   CDC-ECM network function, Ethernet frames to the application
+  ******************************************************************************
+  */
+
+#include "type.h"
+#include "usb_device.h"
+#include "ux_device_ecm.h"
+#include "ux_device_descriptors.h"
+#include "ux_device_stack.h"
+#include "log.h"
+
+LOG_DEF("ECM");
+
+// USBX has a CDC-ECM class but it needs NetX and threads, this one runs
+// standalone: the communication interface with the notification endpoint,
+// the data interface whose alternate setting 1 holds the bulk endpoints.
+#define ECM_SET_ETHERNET_PACKET_FILTER  (0x43)
+
+#define ECM_NOTIFY_NETWORK_CONNECTION   (0x00)
+#define ECM_NOTIFY_SPEED_CHANGE         (0x2A)
+#define ECM_LINK_SPEED                  (12000000UL) // full speed, bit/s
+
+typedef struct {
+    UX_SLAVE_INTERFACE *interface;  // communication interface
+    UX_SLAVE_ENDPOINT *ep_notify;
+    UX_SLAVE_ENDPOINT *ep_in;       // NULL until host selects alternate setting 1
+    UX_SLAVE_ENDPOINT *ep_out;
+    u8 notify;                      // notifications left to send
+    bool notify_busy;
+    bool write_busy;
+    bool read_busy;
+    u8 *tx_frame;                   // frame going out, NULL == idle
+    u16 tx_len;
+} ux_device_ecm_t;
+
+static ux_device_ecm_t ecm;
+
+static u8 _notify_buf[16] __attribute__((aligned(4)));
+
+UCHAR _ux_system_slave_class_ecm_name[] = "ux_slave_class_ecm";
+
+static usb_ecm_rx_buf_pfunc_t _rx_get_buffer = NULL;
+static usb_ecm_rx_pfunc_t _rx_handler = NULL;
+static u8 *_rx_pending = NULL; // frame buffer of the read in progress (zero copy)
+
+void ux_device_ecm_rx_init(usb_ecm_rx_buf_pfunc_t get_buffer, usb_ecm_rx_pfunc_t rx_handler)
+{
+    _rx_get_buffer = get_buffer;
+    _rx_handler = rx_handler;
+}
+
+static void _link_reset(void)
+{
+    ecm.ep_in = UX_NULL;
+    ecm.ep_out = UX_NULL;
+    ecm.write_busy = false;
+    ecm.read_busy = false;
+    ecm.tx_frame = NULL;    // dropped, the application reuses the buffer
+    _rx_pending = NULL;     // transfer aborted, buffer not filled
+}
+
+/**
+  * @brief  ux_device_ecm_activate
+  *         Configuration selected: communication interface takes the
+  *         notification endpoint, data interface starts without endpoints.
+  * @param  command: class command with the interface
+  * @retval status
+  */
+static UINT ux_device_ecm_activate(UX_SLAVE_CLASS_COMMAND *command)
+{
+    UX_SLAVE_INTERFACE *interface = (UX_SLAVE_INTERFACE *)command->ux_slave_class_command_interface;
+
+    if (interface->ux_slave_interface_descriptor.bInterfaceClass == USBD_CDC_DATA_CLASS)
+        return (UX_SUCCESS);
+
+    ecm.ep_notify = interface->ux_slave_interface_first_endpoint;
+    if (ecm.ep_notify == UX_NULL)
+        return (UX_DESCRIPTOR_CORRUPTED);
+
+    ecm.notify = 0;
+    ecm.notify_busy = false;
+    _link_reset();
+    ecm.interface = interface;
+    interface->ux_slave_interface_class_instance = &ecm;
+
+    LOG_DEBUG("ux_device_ecm_activate");
+    return (UX_SUCCESS);
+}
+
+/**
+  * @brief  ux_device_ecm_change
+  *         Host switched the data interface: alternate setting 1 brings
+  *         the link up, 0 takes it down.
+  * @param  command: class command with the data interface
+  * @retval status
+  */
+static UINT ux_device_ecm_change(UX_SLAVE_CLASS_COMMAND *command)
+{
+    UX_SLAVE_INTERFACE *interface = (UX_SLAVE_INTERFACE *)command->ux_slave_class_command_interface;
+    UX_SLAVE_ENDPOINT *endpoint;
+
+    // stack already dropped the endpoints of the previous setting
+    _link_reset();
+    if (interface->ux_slave_interface_descriptor.bAlternateSetting == 0)
+        return (UX_SUCCESS);
+
+    for (endpoint = interface->ux_slave_interface_first_endpoint; endpoint != UX_NULL;
+         endpoint = endpoint->ux_slave_endpoint_next_endpoint)
+    {
+        if ((endpoint->ux_slave_endpoint_descriptor.bEndpointAddress & UX_ENDPOINT_DIRECTION) == UX_ENDPOINT_IN)
+            ecm.ep_in = endpoint;
+        else
+            ecm.ep_out = endpoint;
+    }
+
+    if ((ecm.ep_in == UX_NULL) || (ecm.ep_out == UX_NULL))
+    {
+        ecm.ep_in = UX_NULL;
+        ecm.ep_out = UX_NULL;
+        return (UX_DESCRIPTOR_CORRUPTED);
+    }
+
+    ecm.notify = 2; // speed, then connection
+    LOG_DEBUG("link up");
+    return (UX_SUCCESS);
+}
+
+/**
+  * @brief  ux_device_ecm_deactivate
+  *         Device reset or unplugged, drop transfers in progress.
+  * @retval status
+  */
+static UINT ux_device_ecm_deactivate(void)
+{
+    if (ecm.interface == UX_NULL)
+        return (UX_SUCCESS);
+
+    ecm.interface = UX_NULL;
+    _ux_device_stack_transfer_all_request_abort(ecm.ep_notify, UX_TRANSFER_BUS_RESET);
+    if (ecm.ep_in != UX_NULL)
+    {
+        _ux_device_stack_transfer_all_request_abort(ecm.ep_in, UX_TRANSFER_BUS_RESET);
+        _ux_device_stack_transfer_all_request_abort(ecm.ep_out, UX_TRANSFER_BUS_RESET);
+    }
+    ecm.ep_notify = UX_NULL;
+    ecm.notify = 0;
+    _link_reset();
+    return (UX_SUCCESS);
+}
+
+/**
+  * @brief  ux_device_ecm_request
+  *         Class requests. Packet filter is accepted and ignored, the
+  *         device answers only frames addressed to it anyway.
+  * @retval UX_SUCCESS or UX_ERROR (control endpoint stalled)
+  */
+static UINT ux_device_ecm_request(void)
+{
+    UX_SLAVE_TRANSFER *transfer_request = &_ux_system_slave->ux_system_slave_device.ux_slave_device_control_endpoint.ux_slave_endpoint_transfer_request;
+
+    if (*(transfer_request->ux_slave_transfer_request_setup + UX_SETUP_REQUEST) == ECM_SET_ETHERNET_PACKET_FILTER)
+        return (UX_SUCCESS);
+
+    return (UX_ERROR);
+}
+
+/**
+  * @brief  ux_device_ecm_entry
+  *         USBX class entry of the CDC-ECM function.
+  * @param  command: class command from the device stack
+  * @retval status
+  */
+UINT ux_device_ecm_entry(UX_SLAVE_CLASS_COMMAND *command)
+{
+    switch (command->ux_slave_class_command_request)
+    {
+    case UX_SLAVE_CLASS_COMMAND_INITIALIZE:
+    case UX_SLAVE_CLASS_COMMAND_UNINITIALIZE:
+        return (UX_SUCCESS);
+
+    case UX_SLAVE_CLASS_COMMAND_QUERY:
+        if ((command->ux_slave_class_command_class == USBD_CDC_COMM_CLASS) ||
+            (command->ux_slave_class_command_class == USBD_CDC_DATA_CLASS))
+            return (UX_SUCCESS);
+        return (UX_NO_CLASS_MATCH);
+
+    case UX_SLAVE_CLASS_COMMAND_ACTIVATE:
+        return (ux_device_ecm_activate(command));
+
+    case UX_SLAVE_CLASS_COMMAND_CHANGE:
+        return (ux_device_ecm_change(command));
+
+    case UX_SLAVE_CLASS_COMMAND_DEACTIVATE:
+        return (ux_device_ecm_deactivate());
+
+    case UX_SLAVE_CLASS_COMMAND_REQUEST:
+        return (ux_device_ecm_request());
+
+    default:
+        break;
+    }
+    return (UX_FUNCTION_NOT_SUPPORTED);
+}
+
+bool ux_device_ecm_connected(void)
+{
+    if ((ecm.interface == UX_NULL) || (ecm.ep_in == UX_NULL))
+        return (false);
+
+    return (_ux_system_slave->ux_system_slave_device.ux_slave_device_state == UX_DEVICE_CONFIGURED);
+}
+
+// Frame stays in place until ux_device_ecm_tx_busy() returns false
+bool ux_device_ecm_tx(u8 *frame, u16 len)
+{
+    if ((! ux_device_ecm_connected()) || (ecm.tx_frame != NULL))
+        return (false);
+
+    ecm.tx_frame = frame;
+    ecm.tx_len = len;
+    return (true);
+}
+
+bool ux_device_ecm_tx_busy(void)
+{
+    return (ecm.tx_frame != NULL);
+}
+
+static void _notify_task(void)
+{
+    UX_SLAVE_TRANSFER *transfer_request;
+    u16 len = 8;
+    UINT status;
+
+    if ((ecm.notify == 0) || (ecm.interface == UX_NULL))
+        return;
+
+    transfer_request = &ecm.ep_notify->ux_slave_endpoint_transfer_request;
+    if (! ecm.notify_busy)
+    {
+        _notify_buf[0] = 0xA1; // class, interface, device to host
+        _notify_buf[1] = (ecm.notify == 2) ? ECM_NOTIFY_SPEED_CHANGE : ECM_NOTIFY_NETWORK_CONNECTION;
+        _notify_buf[2] = (ecm.notify == 2) ? 0 : 1; // wValue: connected
+        _notify_buf[3] = 0;
+        _notify_buf[4] = ecm.interface->ux_slave_interface_descriptor.bInterfaceNumber;
+        _notify_buf[5] = 0;
+        _notify_buf[6] = (ecm.notify == 2) ? 8 : 0; // wLength
+        _notify_buf[7] = 0;
+        _ux_utility_long_put(&_notify_buf[8], ECM_LINK_SPEED);  // downlink
+        _ux_utility_long_put(&_notify_buf[12], ECM_LINK_SPEED); // uplink
+        transfer_request->ux_slave_transfer_request_data_pointer = _notify_buf;
+        UX_SLAVE_TRANSFER_STATE_RESET(transfer_request);
+        ecm.notify_busy = true;
+    }
+
+    if (ecm.notify == 2)
+        len = 16;
+
+    status = ux_device_stack_transfer_run(transfer_request, len, len);
+    if (UX_STATE_IS_BUSY(status))
+        return;
+
+    ecm.notify_busy = false;
+    ecm.notify--;
+}
+
+// One frame per bulk IN transfer, a frame of whole packets ends with a ZLP
+static void _tx_task(void)
+{
+    UX_SLAVE_TRANSFER *transfer_request;
+    UINT status;
+
+    if (ecm.tx_frame == NULL)
+        return;
+
+    if (! ux_device_ecm_connected())
+    {
+        ecm.tx_frame = NULL;
+        return;
+    }
+
+    transfer_request = &ecm.ep_in->ux_slave_endpoint_transfer_request;
+    if (! ecm.write_busy)
+    {
+        transfer_request->ux_slave_transfer_request_data_pointer = ecm.tx_frame;
+        UX_SLAVE_TRANSFER_STATE_RESET(transfer_request);
+        ecm.write_busy = true;
+    }
+
+    status = ux_device_stack_transfer_run(transfer_request, ecm.tx_len, ecm.tx_len + 1);
+    if (UX_STATE_IS_BUSY(status))
+        return;
+
+    ecm.write_busy = false;
+    ecm.tx_frame = NULL;
+}
+
+// One frame per bulk OUT transfer, ended by a short packet
+static void _rx_task(void)
+{
+    UX_SLAVE_TRANSFER *transfer_request;
+    UINT status;
+
+    if ((_rx_get_buffer == NULL) || (_rx_handler == NULL))
+        return;
+
+    transfer_request = &ecm.ep_out->ux_slave_endpoint_transfer_request;
+
+    while (1)
+    {
+        if (_rx_pending == NULL)
+        {   // no free frame buffer, host gets NAK
+            if ((_rx_pending = _rx_get_buffer()) == NULL)
+                return;
+        }
+
+        if (! ecm.read_busy)
+        {
+            transfer_request->ux_slave_transfer_request_data_pointer = _rx_pending;
+            UX_SLAVE_TRANSFER_STATE_RESET(transfer_request);
+            ecm.read_busy = true;
+        }
+
+        status = ux_device_stack_transfer_run(transfer_request, USB_ECM_FRAME_MAX, USB_ECM_FRAME_MAX);
+
+        if (UX_STATE_IS_BUSY(status))
+            return; // waiting for host
+
+        ecm.read_busy = false;
+        if (status < UX_STATE_NEXT)
+        {
+            _rx_pending = NULL;
+            return;
+        }
+
+        if (transfer_request->ux_slave_transfer_request_actual_length != 0)
+        {
+            _rx_handler(_rx_pending, transfer_request->ux_slave_transfer_request_actual_length);
+        }
+        _rx_pending = NULL;
+    }
+}
+
+void ux_device_ecm_task(void)
+{
+    if (ecm.interface == UX_NULL)
+        return;
+
+    _notify_task();
+
+    if (! ux_device_ecm_connected())
+        return;
+
+    _tx_task();
+    _rx_task();
+}
@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_ecm.h
+  * @author  Tropicsquare
+  * @brief   CDC-ECM network function header file
+  ******************************************************************************
+  */
+
+#ifndef UX_DEVICE_ECM_H
+#define UX_DEVICE_ECM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+
+extern UCHAR _ux_system_slave_class_ecm_name[];
+
+UINT ux_device_ecm_entry(UX_SLAVE_CLASS_COMMAND *command);
+
+void ux_device_ecm_rx_init(usb_ecm_rx_buf_pfunc_t get_buffer, usb_ecm_rx_pfunc_t rx_handler);
+bool ux_device_ecm_connected(void);
+bool ux_device_ecm_tx(u8 *frame, u16 len);
+bool ux_device_ecm_tx_busy(void);
+
+void ux_device_ecm_task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ! UX_DEVICE_ECM_H
@@ -0,0 +1,238 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_vendor.c
+  * @author  Tropicsquare
+  * @brief   Vendor specific bulk interface (WinUSB, libusb), AVP JSON only
+  ******************************************************************************
+  */
+
+#include "type.h"
+#include "usb_device.h"
+#include "ux_device_vendor.h"
+#include "ux_device_descriptors.h"
+#include "ux_device_stack.h"
+#include "log.h"
+
+LOG_DEF("VND");
+
+// USBX has no generic vendor class, this is the minimal one: one interface,
+// one bulk OUT and one bulk IN endpoint, no class requests.
+typedef struct {
+    UX_SLAVE_INTERFACE *interface;
+    UX_SLAVE_ENDPOINT *ep_in;
+    UX_SLAVE_ENDPOINT *ep_out;
+    bool write_busy;
+    bool read_busy;
+} ux_device_vendor_t;
+
+static ux_device_vendor_t vendor;
+
+UCHAR _ux_system_slave_class_vendor_name[] = "ux_slave_class_vendor";
+
+static usb_cdc_rx_buf_pfunc_t _rx_get_buffer = NULL;
+static usb_cdc_rx_pfunc_t _rx_handler = NULL;
+static u8 *_rx_pending = NULL; // buffer of the read in progress (zero copy)
+
+void ux_device_vendor_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler)
+{
+    _rx_get_buffer = get_buffer;
+    _rx_handler = rx_handler;
+}
+
+/**
+  * @brief  ux_device_vendor_activate
+  *         Host selected the configuration, take the bulk endpoints.
+  * @param  command: class command with the interface
+  * @retval status
+  */
+static UINT ux_device_vendor_activate(UX_SLAVE_CLASS_COMMAND *command)
+{
+    UX_SLAVE_INTERFACE *interface = (UX_SLAVE_INTERFACE *)command->ux_slave_class_command_interface;
+    UX_SLAVE_ENDPOINT *endpoint;
+
+    vendor.ep_in = UX_NULL;
+    vendor.ep_out = UX_NULL;
+
+    for (endpoint = interface->ux_slave_interface_first_endpoint; endpoint != UX_NULL;
+         endpoint = endpoint->ux_slave_endpoint_next_endpoint)
+    {
+        if ((endpoint->ux_slave_endpoint_descriptor.bEndpointAddress & UX_ENDPOINT_DIRECTION) == UX_ENDPOINT_IN)
+            vendor.ep_in = endpoint;
+        else
+            vendor.ep_out = endpoint;
+    }
+
+    if ((vendor.ep_in == UX_NULL) || (vendor.ep_out == UX_NULL))
+        return (UX_DESCRIPTOR_CORRUPTED);
+
+    vendor.write_busy = false;
+    vendor.read_busy = false;
+    _rx_pending = NULL;
+    vendor.interface = interface;
+    interface->ux_slave_interface_class_instance = &vendor;
+
+    LOG_DEBUG("ux_device_vendor_activate");
+    return (UX_SUCCESS);
+}
+
+/**
+  * @brief  ux_device_vendor_deactivate
+  *         Device reset or unplugged, drop transfers in progress.
+  * @retval status
+  */
+static UINT ux_device_vendor_deactivate(void)
+{
+    if (vendor.interface == UX_NULL)
+        return (UX_SUCCESS);
+
+    vendor.interface = UX_NULL;
+    _ux_device_stack_transfer_all_request_abort(vendor.ep_in, UX_TRANSFER_BUS_RESET);
+    _ux_device_stack_transfer_all_request_abort(vendor.ep_out, UX_TRANSFER_BUS_RESET);
+    _rx_pending = NULL; // transfer aborted, buffer not filled
+    return (UX_SUCCESS);
+}
+
+/**
+  * @brief  ux_device_vendor_entry
+  *         USBX class entry of the vendor interface.
+  * @param  command: class command from the device stack
+  * @retval status
+  */
+UINT ux_device_vendor_entry(UX_SLAVE_CLASS_COMMAND *command)
+{
+    switch (command->ux_slave_class_command_request)
+    {
+    case UX_SLAVE_CLASS_COMMAND_INITIALIZE:
+    case UX_SLAVE_CLASS_COMMAND_UNINITIALIZE:
+        return (UX_SUCCESS);
+
+    case UX_SLAVE_CLASS_COMMAND_QUERY:
+        if (command->ux_slave_class_command_class == USBD_VENDOR_CLASS)
+            return (UX_SUCCESS);
+        return (UX_NO_CLASS_MATCH);
+
+    case UX_SLAVE_CLASS_COMMAND_ACTIVATE:
+        return (ux_device_vendor_activate(command));
+
+    case UX_SLAVE_CLASS_COMMAND_DEACTIVATE:
+        return (ux_device_vendor_deactivate());
+
+    default:
+        break;
+    }
+    return (UX_FUNCTION_NOT_SUPPORTED);
+}
+
+/**
+  * @brief  ux_device_vendor_request
+  *         Microsoft OS 2.0 descriptor set, asked for by Windows after it
+  *         found the platform capability in BOS. Registered with
+  *         ux_device_stack_microsoft_extension_register().
+  * @retval UX_SUCCESS or UX_ERROR (control endpoint stalled)
+  */
+UINT ux_device_vendor_request(ULONG request, ULONG request_value, ULONG request_index,
+                              ULONG request_length, UCHAR *transfer_request_buffer,
+                              ULONG *transfer_request_length)
+{
+    uint8_t *desc;
+    ULONG len;
+
+    UX_PARAMETER_NOT_USED(request_value);
+    UX_PARAMETER_NOT_USED(request_length);
+
+    if ((request != USBD_MS_VENDOR_CODE) || (request_index != USBD_MS_OS_20_DESCRIPTOR_INDEX))
+        return (UX_ERROR);
+
+    desc = USBD_Get_MS_OS_20_Descriptor_Set(&len);
+    if (len > *transfer_request_length)
+        return (UX_ERROR);
+
+    _ux_utility_memory_copy(transfer_request_buffer, desc, len); /* Use case of memcpy is verified. */
+    *transfer_request_length = len;
+    return (UX_SUCCESS);
+}
+
+RAMFUNC bool ux_device_vendor_connected(void)
+{
+    if (vendor.interface == UX_NULL)
+        return (false);
+
+    return (_ux_system_slave->ux_system_slave_device.ux_slave_device_state == UX_DEVICE_CONFIGURED);
+}
+
+// One step of the bulk IN write, data must stay in place until it returns
+// true (sent, or failed and dropped). A write of whole packets ends with
+// a ZLP so a libusb read with a larger buffer completes.
+RAMFUNC bool ux_device_vendor_tx_run(u8 *data, u16 len)
+{
+    UX_SLAVE_TRANSFER *transfer_request;
+    UINT status;
+
+    if (! ux_device_vendor_connected())
+        return (true);
+
+    transfer_request = &vendor.ep_in->ux_slave_endpoint_transfer_request;
+    if (! vendor.write_busy)
+    {
+        transfer_request->ux_slave_transfer_request_data_pointer = data;
+        UX_SLAVE_TRANSFER_STATE_RESET(transfer_request);
+        vendor.write_busy = true;
+    }
+
+    status = ux_device_stack_transfer_run(transfer_request, len, len + 1);
+    if (UX_STATE_IS_BUSY(status))
+        return (false);
+
+    vendor.write_busy = false;
+    return (true);
+}
+
+RAMFUNC void ux_device_vendor_task(void)
+{
+    UX_SLAVE_TRANSFER *transfer_request;
+    UINT status;
+
+    if (! ux_device_vendor_connected())
+        return;
+
+    if ((_rx_get_buffer == NULL) || (_rx_handler == NULL))
+        return;
+
+    transfer_request = &vendor.ep_out->ux_slave_endpoint_transfer_request;
+
+    // take all packets already received, not just one per pass
+    while (1)
+    {
+        if (_rx_pending == NULL)
+        {   // packet goes from PMA straight to the application buffer,
+            // without free buffer the endpoint is not armed and host gets NAK
+            if ((_rx_pending = _rx_get_buffer(USB_VENDOR_AVP)) == NULL)
+                return;
+        }
+
+        if (! vendor.read_busy)
+        {
+            transfer_request->ux_slave_transfer_request_data_pointer = _rx_pending;
+            UX_SLAVE_TRANSFER_STATE_RESET(transfer_request);
+            vendor.read_busy = true;
+        }
+
+        status = ux_device_stack_transfer_run(transfer_request, USB_CDC_RX_PACKET, USB_CDC_RX_PACKET);
+
+        if (UX_STATE_IS_BUSY(status))
+            return; // waiting for host
+
+        vendor.read_busy = false;
+        if (status < UX_STATE_NEXT)
+        {
+            _rx_pending = NULL;
+            return;
+        }
+
+        if (transfer_request->ux_slave_transfer_request_actual_length != 0)
+        {
+            _rx_handler(USB_VENDOR_AVP, _rx_pending, transfer_request->ux_slave_transfer_request_actual_length);
+        }
+        _rx_pending = NULL;
+    }
+}
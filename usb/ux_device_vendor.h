@@ -0,0 +1,35 @@
+/**
+  ******************************************************************************
+  * @file    ux_device_vendor.h
+  * @author  Tropicsquare
+  * @brief   Vendor specific bulk interface header file
+  ******************************************************************************
+  */
+
+#ifndef UX_DEVICE_VENDOR_H
+#define UX_DEVICE_VENDOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ux_api.h"
+
+extern UCHAR _ux_system_slave_class_vendor_name[];
+
+UINT ux_device_vendor_entry(UX_SLAVE_CLASS_COMMAND *command);
+UINT ux_device_vendor_request(ULONG request, ULONG request_value, ULONG request_index,
+                              ULONG request_length, UCHAR *transfer_request_buffer,
+                              ULONG *transfer_request_length);
+
+void ux_device_vendor_rx_init(usb_cdc_rx_buf_pfunc_t get_buffer, usb_cdc_rx_pfunc_t rx_handler);
+bool ux_device_vendor_connected(void);
+bool ux_device_vendor_tx_run(u8 *data, u16 len);
+
+void ux_device_vendor_task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ! UX_DEVICE_VENDOR_H
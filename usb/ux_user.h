@@ -166,7 +166,7 @@
 /* Defined, this value is the maximum number of classes in the device stack that can be loaded by
    USBX.  */
 
-#define UX_MAX_SLAVE_CLASS_DRIVER    1
+#define UX_MAX_SLAVE_CLASS_DRIVER    4
 
 /* Defined, this value represents the number of different host controllers available in the system.
    For USB 1.1 support, this value will usually be 1. For USB 2.0 support, this value can be more
@@ -206,14 +206,14 @@
    0 - The default, endpoint buffer is managed by core stack. Each endpoint takes UX_SLAVE_REQUEST_DATA_MAX_LENGTH bytes.
    1 - Endpoint buffer managed by classes. In this case not all endpoints consume UX_SLAVE_REQUEST_DATA_MAX_LENGTH bytes.  */
 
-/* #define UX_DEVICE_ENDPOINT_BUFFER_OWNER      0 */
+#define UX_DEVICE_ENDPOINT_BUFFER_OWNER      1
 
 /* Defined, it enables device CDC ACM zero copy for bulk in/out endpoints (write/read).
    Enabled, the endpoint buffer is not allocated in class, application must provide the buffer for read/write,
    and the buffer must meet device controller driver (DCD) buffer requirements (e.g., aligned and cache safe).
    It only works if  UX_DEVICE_ENDPOINT_BUFFER_OWNER is 1 (endpoint buffer managed by class).  */
 
-/* #define UX_DEVICE_CLASS_CDC_ACM_ZERO_COPY  */
+#define UX_DEVICE_CLASS_CDC_ACM_ZERO_COPY
 
 /* Defined, it enables device HID zero copy and flexible queue support (works if HID owns endpoint buffer).
     Enabled, the internal queue buffer is directly used for transfer, the APIs are kept to keep
@@ -572,6 +572,10 @@
 /* Defined, this enables the assert checks inside usbx.  */
 /* #define UX_ENABLE_ASSERT */
 
+/* Defined, the byte pools track their lowest free size and allocation counts
+   (usb_device_pool(), MEM console command).  */
+#define UX_ENABLE_MEMORY_STATISTICS
+
 /* Defined, this defines the assert action taken when failure detected. By default
    it halts without any output.  */
 /* #define UX_ASSERT_FAIL  for (;;) {tx_thread_sleep(UX_WAIT_FOREVER); }  */